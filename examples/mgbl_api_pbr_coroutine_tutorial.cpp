@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "gnmi/mgbl_gnmi_client.h"
+#include "gnmi/mgbl_gnmi_coroutine.h"
+#include "mgbl_api.h"
+#include "pbr/mgbl_pbr.h"
+
+// https://github.com/openconfig/reference/blob/master/rpc/gnmi/gnmi-specification.md
+/*
+ * This tutorial code showcases how to use the mgbl_api library
+ * from C++20 coroutines. Every device is collected by a coroutine,
+ * which awaits a subscribe once request then the samples of a
+ * subscribe stream request, without a thread or a condition
+ * variable per device. It must be compiled as C++20.
+ */
+
+using namespace mgbl_api;
+
+// Derived class of the the logger implementation
+class console_logger : public logger
+{
+   public:
+    ~console_logger() override = default;
+
+    // Log function is overriden to print the log to stdout
+    void log(const std::string& message, log_level level) override
+    {
+        std::cout << logger::log_level_to_string(level) << ": " << message << '\n';
+    }
+};
+
+// Collects the stats of one device: a once request, then 10 batches of the stream.
+gnmi_task collect_device(std::string server_address, client_context_args context_args,
+                         rpc_args rpc_args)
+{
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r3_p1"});
+    pbr_counters->keys.push_back({"p1", "r2_p1"});
+
+    gnmi_client_connection connection(rpc_channel_args{server_address, false});
+    GnmiClient client(connection.get_channel(), pbr_counters);
+
+    // The coroutine is suspended until the once request is finished.
+    auto result = co_await subscribe_once(client, context_args, rpc_args);
+    if (result.first != error_code::SUCCESS)
+    {
+        std::cout << server_address << ": once request failed, "
+                  << result.second.error_message() << std::endl;
+        co_return;
+    }
+    std::cout << server_address << ": " << pbr_counters->stats.size() << " stats received once"
+              << std::endl;
+    pbr_counters->stats.clear();
+
+    // The stream hands the samples received every 500 milliseconds to the coroutine.
+    sample_stream stream(client, pbr_counters, std::chrono::milliseconds(500));
+    if (client.rpc_register_stats_stream(context_args, rpc_args) != error_code::SUCCESS)
+    {
+        stream.close();
+        co_return;
+    }
+
+    const int NUMBER_OF_BATCHES = 10;
+    for (int i = 0; i < NUMBER_OF_BATCHES; i++)
+    {
+        std::vector<PbrBasicStat> batch = co_await stream.next_batch();
+        if (batch.empty())
+        {
+            // The stream ended, the user can decide to retry according to the status.
+            std::cout << server_address << ": stream ended, " << stream.status().error_message()
+                      << std::endl;
+            break;
+        }
+        for (const auto& response_stats : batch)
+        {
+            std::cout << server_address << ": " << response_stats.policy_name << "/"
+                      << response_stats.rule_name << " byte-count " << response_stats.byte_count
+                      << " packet-count " << response_stats.packet_count << std::endl;
+        }
+    }
+    stream.close();
+}
+
+int main(int argc, char** argv)
+{
+    // Example of how to implement own logging
+    auto console_logger_instance = std::make_shared<console_logger>();
+    logger_manager::get_instance().set_logger(console_logger_instance);
+
+    client_context_args context_args;
+    context_args.username = "username";
+    context_args.password = "password";
+
+    rpc_args rpc_args;
+    // Set the sample interval for a grpc stream. Default is 1 second
+    rpc_args.sample_interval_nsec *= 2;
+
+    // Set server addresses. Each one is collected by its own coroutine.
+    const std::vector<std::string> server_addresses{"111.111.111.111:11111",
+                                                    "111.111.111.112:11111"};
+
+    // The coroutines run on the few worker threads of the default executor.
+    std::vector<gnmi_task> tasks;
+    for (const auto& server_address : server_addresses)
+    {
+        tasks.push_back(collect_device(server_address, context_args, rpc_args));
+    }
+    for (auto& task : tasks)
+    {
+        task.wait();
+    }
+    return 0;
+}
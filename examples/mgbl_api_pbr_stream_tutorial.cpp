@@ -189,6 +189,13 @@ int main(int argc, char** argv)
                 }
             });
 
+        // The client reconnects the failed stream by itself, with a capped exponential backoff
+        // and jitter, and sends the same request again. The rpc_failed_handler is only called
+        // once it gives up, here after retry_stream attempts in a row.
+        reconnect_policy reconnect;
+        reconnect.max_attempts = retry_stream;
+        newStream.set_reconnect_policy(reconnect);
+
         while (count_retry < retry_stream)
         {
             // Upon retry, the context deadline should be updated if used
@@ -209,9 +216,10 @@ int main(int argc, char** argv)
                 // is related to a grpc::Status. Must be handled through rpc_failed_handler.
                 // SUCCESS handled through pbr_function_handler
 
-                // Here is an example of adding another seperate request on the same stream.
-                // The user can do this by calling the register function again.
-                err = newStream.rpc_register_stats_stream(context_args, rpc_args);
+                // gNMI allows one request per stream. To subscribe to other counters, or
+                // with another interval, the user can add a subscription on the same channel:
+                // auto subscription = newStream.subscribe(other_counters);
+                // subscription->start(context_args, other_rpc_args);
 
                 std::unique_lock<std::mutex> lock(queue_mtx);
                 queue_cv.wait(lock, [&] { return !my_deque.empty(); });
@@ -234,28 +242,27 @@ int main(int argc, char** argv)
                             rpc_err_status.second.error_message());
                         logger_manager::get_instance().log(msg, log_level::ERROR);
                         // Upon Deadline Exceed in stream case we choose to not retry.
-                        // Close the stream and join the receive thread
+                        // Close the stream and wait for it to finish
                         newStream.rpc_stream_close();
                         break;
                     }
                     else if (rpc_err_status.second.error_code() == grpc::StatusCode::UNAVAILABLE)
                     {
-                        // If Unavailable, it is best to retry after a certain backoff period
-                        // How the user signals to do that, is up to them
+                        // The client already reconnected with a backoff and gave up,
+                        // the server is considered gone.
+                        auto reconnect_stats = newStream.get_reconnect_statistics();
                         std::string msg = fmt::format(
-                            "Stream retry due to Unavailable error\n"
+                            "Stream stopped due to Unavailable error after {} reconnections\n"
                             "Error Code: {} \n"
                             "Error message: {} \n",
+                            reconnect_stats.attempts,
                             static_cast<int>(rpc_err_status.second.error_code()),
                             rpc_err_status.second.error_message());
                         logger_manager::get_instance().log(msg, log_level::ERROR);
 
-                        // Close the stream and try again after backoff
+                        // Close the stream and quit
                         newStream.rpc_stream_close();
-                        count_retry++;
-
-                        // Simulating retry backoff period by making thread sleep
-                        std::this_thread::sleep_for(std::chrono::seconds(5));
+                        break;
                     }
                     else if (rpc_err_status.second.error_code() ==
                              grpc::StatusCode::UNAUTHENTICATED)
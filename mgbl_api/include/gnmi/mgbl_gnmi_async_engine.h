@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_ASYNC_ENGINE_H_
+#define MGBL_GNMI_ASYNC_ENGINE_H_
+
+#include <grpcpp/grpcpp.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "gnmi/mgbl_gnmi_thread.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Interface of every tag placed on a completion queue owned by the engine.
+ *
+ * The poller threads call `proceed` with the `ok` flag returned by
+ * grpc::CompletionQueue::Next for the tag.
+ */
+class async_tag
+{
+   public:
+    virtual ~async_tag() = default;
+
+    /**
+     * @brief Called on a poller thread when the operation bound to this tag completes.
+     *
+     * @param ok Whether the operation completed successfully.
+     */
+    virtual void proceed(bool ok) = 0;
+};
+
+/**
+ * @brief Tag forwarding its completion to a callback, used for timers set on the engine.
+ */
+class callback_tag : public async_tag
+{
+   public:
+    explicit callback_tag(std::function<void(bool)> callback) : callback(std::move(callback)) {}
+
+    void proceed(bool ok) override
+    {
+        callback(ok);
+    }
+
+   private:
+    std::function<void(bool)> callback;
+};
+
+/**
+ * @class gnmi_async_engine
+ * @brief Drives asynchronous gRPC calls from a fixed pool of poller threads.
+ *
+ * The engine owns one grpc::CompletionQueue per poller thread. Streams are spread
+ * over the completion queues round robin, so thousands of subscriptions can be
+ * served by a handful of threads instead of one receive thread per stream.
+ *
+ * Handlers of the streams driven by the engine are called on its poller threads.
+ */
+class gnmi_async_engine
+{
+   public:
+    /**
+     * @brief Struct for configuring the engine.
+     */
+    struct options
+    {
+        static constexpr uint32_t DEFAULT_POLLER_THREADS = 2; /**< Default poller thread count */
+        uint32_t poller_threads =
+            DEFAULT_POLLER_THREADS; /**< Number of completion queues and poller threads */
+    };
+
+    /**
+     * @brief Creates the completion queues and starts the poller threads.
+     * If the options are not valid, an exception is thrown.
+     *
+     * @param engine_options The options of the engine.
+     * @throws std::invalid_argument if `poller_threads` is 0.
+     */
+    explicit gnmi_async_engine(const options& engine_options);
+    gnmi_async_engine() : gnmi_async_engine(options{}) {}
+
+    gnmi_async_engine(const gnmi_async_engine&) = delete;
+    gnmi_async_engine& operator=(const gnmi_async_engine&) = delete;
+    gnmi_async_engine(gnmi_async_engine&&) = delete;
+    gnmi_async_engine& operator=(gnmi_async_engine&&) = delete;
+
+    /**
+     * @brief Shuts down the completion queues and joins the poller threads.
+     */
+    ~gnmi_async_engine();
+
+    /**
+     * @brief Returns the engine shared by every GnmiClient that is not given one explicitly.
+     *
+     * The engine is created on first use with the default options.
+     *
+     * @return A shared pointer to the default engine.
+     */
+    static std::shared_ptr<gnmi_async_engine> default_engine();
+
+    /**
+     * @brief Picks the completion queue the next call should be bound to.
+     *
+     * @return A completion queue owned by the engine.
+     */
+    grpc::CompletionQueue* next_completion_queue();
+
+    /**
+     * @brief Returns the number of poller threads of the engine.
+     */
+    uint32_t poller_count() const
+    {
+        return static_cast<uint32_t>(completion_queues.size());
+    }
+
+    /**
+     * @brief Checks whether the calling thread is one of the poller threads of this engine.
+     *
+     * Used to avoid waiting on a completion from the thread that has to deliver it.
+     *
+     * @return True if called from a poller thread of this engine.
+     */
+    bool is_poller_thread() const;
+
+    /**
+     * @brief Returns the completion queue polled by the calling thread.
+     *
+     * Tags placed on this queue are dispatched by the calling thread, so their handlers
+     * are serialized with the one currently running.
+     *
+     * @return The completion queue, or nullptr if not called from a poller thread of this engine.
+     */
+    grpc::CompletionQueue* current_completion_queue() const;
+
+    /**
+     * @brief Shuts down the completion queues and joins the poller threads.
+     *
+     * Every call bound to the engine must be finished before this function is called,
+     * as the pollers drain the queues before exiting. Safe to call more than once.
+     */
+    void shutdown();
+
+   private:
+    std::vector<std::shared_ptr<grpc::CompletionQueue>> completion_queues;
+    std::vector<gnmi_thread> pollers;
+    std::atomic<uint32_t> next_queue{0};
+    std::mutex shutdown_mtx;
+    bool is_shutdown = false;
+};
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_ASYNC_ENGINE_H_
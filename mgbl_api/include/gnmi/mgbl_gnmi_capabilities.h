@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_CAPABILITIES_H_
+#define MGBL_GNMI_CAPABILITIES_H_
+
+#include <grpcpp/grpcpp.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "gnmi.grpc.pb.h"
+#include "rpc/mgbl_rpc.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @class capabilities_cache
+ * @brief Capabilities of the targets, fetched once per channel.
+ *
+ * The clients sharing a channel share its entry: the first of them calls the Capabilities
+ * RPC, the others wait for its result instead of sending their own. A failed call is not
+ * cached, the next request tries again. An entry lives as long as a client of its channel.
+ */
+class capabilities_cache
+{
+   public:
+    /**
+     * @brief Entry of a channel, held by its clients.
+     */
+    struct entry
+    {
+        std::weak_ptr<grpc::Channel> channel;                  /**< Channel of the entry */
+        std::mutex fetch_mtx;                                  /**< Serializes the fetches */
+        std::shared_ptr<const gnmi::CapabilityResponse> value; /**< nullptr until fetched */
+    };
+
+    /**
+     * @brief Returns the cache shared by the clients of the process.
+     */
+    static capabilities_cache& get_instance();
+
+    /**
+     * @brief Returns the entry of a channel, creating it for its first client.
+     *
+     * @param channel The channel of the client.
+     * @return The entry, to be kept by the client.
+     */
+    std::shared_ptr<entry> get_entry(const std::shared_ptr<grpc::Channel>& channel);
+
+    /**
+     * @brief Returns the capabilities of an entry, calling Capabilities if not fetched yet.
+     *
+     * @param cached The entry of the channel of the stub.
+     * @param stub The stub the Capabilities RPC is called on.
+     * @param context_args The context arguments of the Capabilities RPC.
+     * @param capabilities Set to the capabilities of the target on success.
+     * @return The status of the Capabilities RPC, OK if they were cached.
+     */
+    static grpc::Status fetch(entry& cached, gnmi::gNMI::Stub& stub,
+                              const client_context_args& context_args,
+                              std::shared_ptr<const gnmi::CapabilityResponse>* capabilities);
+
+    /**
+     * @brief Returns the capabilities of an entry if already fetched, without blocking.
+     *
+     * @param cached The entry of the channel.
+     * @param capabilities Set to the capabilities of the target if they were cached.
+     * @return False if they were not fetched yet, or are being fetched.
+     */
+    static bool peek(entry& cached, std::shared_ptr<const gnmi::CapabilityResponse>* capabilities);
+
+    /**
+     * @brief Forgets the capabilities of an entry, e.g. after the target was upgraded.
+     *
+     * @param cached The entry of the channel.
+     */
+    static void invalidate(entry& cached);
+
+   private:
+    capabilities_cache() = default;
+
+    std::mutex cache_mtx;
+    std::unordered_map<const grpc::Channel*, std::weak_ptr<entry>> entries;
+};
+
+/**
+ * @brief Picks the cheapest encoding supported by a target, PROTO before JSON_IETF.
+ *
+ * @param capabilities The capabilities of the target.
+ * @param fallback The encoding returned if the target supports neither.
+ * @return The encoding to request.
+ */
+gnmi::Encoding select_encoding(const gnmi::CapabilityResponse& capabilities,
+                               gnmi::Encoding fallback);
+
+/**
+ * @brief Picks the models of a target which define the paths of an origin.
+ *
+ * @param capabilities The capabilities of the target.
+ * @param origin The origin of the paths, which is the name of their model.
+ * @return The supported models with that name, for `use_models`.
+ */
+std::vector<gnmi::ModelData> select_models(const gnmi::CapabilityResponse& capabilities,
+                                           const std::string& origin);
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_CAPABILITIES_H_
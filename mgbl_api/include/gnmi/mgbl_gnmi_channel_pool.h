@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_CHANNEL_POOL_H_
+#define MGBL_GNMI_CHANNEL_POOL_H_
+
+#include <grpcpp/grpcpp.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "rpc/mgbl_rpc.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Counters of the channel_pool.
+ */
+struct channel_pool_statistics
+{
+    size_t targets = 0;      /**< Targets with at least one open channel */
+    size_t channels = 0;     /**< Open channels, each with its own connection */
+    uint64_t created = 0;    /**< Channels created since the start of the process */
+    uint64_t reused = 0;     /**< Connections given an open channel */
+};
+
+/**
+ * @class channel_pool
+ * @brief Channels of the process, shared by the connections to the same target.
+ *
+ * The channels are keyed by the rpc_channel_args of the target: its address, its
+ * credentials and its tuning. Every target has up to `pool_subchannels` channels, each
+ * with its own HTTP/2 connection, and a connection is given the channel with the fewest
+ * users, so the streams of many clients are spread over them. The pool only keeps weak
+ * references: a channel is closed once the last connection and client using it are gone.
+ * Connections use the pool when `rpc_channel_args::pool_subchannels` is set.
+ */
+class channel_pool
+{
+   public:
+    using channel_factory = std::function<std::shared_ptr<grpc::Channel>()>;
+
+    /**
+     * @brief Returns the pool shared by the connections of the process.
+     */
+    static channel_pool& get_instance();
+
+    /**
+     * @brief Returns a channel to a target, reusing an open one unless one of its
+     * `pool_subchannels` slots is free.
+     *
+     * @param channel_args The arguments of the channel, `pool_subchannels` must not be 0.
+     * @param create Creates a channel with its own connection for a free slot.
+     * @return The channel, held by the caller.
+     */
+    std::shared_ptr<grpc::Channel> acquire(const rpc_channel_args& channel_args,
+                                           const channel_factory& create);
+
+    /**
+     * @brief Returns the counters of the pool.
+     */
+    channel_pool_statistics get_statistics();
+
+   private:
+    channel_pool() = default;
+
+    /** Returns the key of the channels of a target. */
+    static std::string key_of(const rpc_channel_args& channel_args);
+
+    std::mutex pool_mtx;
+    std::unordered_map<std::string, std::vector<std::weak_ptr<grpc::Channel>>> targets;
+    uint64_t created = 0;
+    uint64_t reused = 0;
+};
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_CHANNEL_POOL_H_
@@ -21,10 +21,21 @@
 
 #include <grpcpp/grpcpp.h>
 
+#include <chrono>
+#include <exception>
+#include <future>
 #include <utility>
+#include <vector>
 #include "gnmi.grpc.pb.h"
+#include "gnmi/mgbl_gnmi_async_engine.h"
+#include "gnmi/mgbl_gnmi_delivery_queue.h"
+#include "gnmi/mgbl_gnmi_executor.h"
+#include "gnmi/mgbl_gnmi_once_cache.h"
+#include "gnmi/mgbl_gnmi_reconnect.h"
+#include "gnmi/mgbl_gnmi_subscription.h"
 #include "mgbl_api.h"
 #include "mgbl_api_impl.h"
+#include "pbr/mgbl_pbr.h"
 #include "rpc/mgbl_rpc.h"
 
 namespace mgbl_api
@@ -45,22 +56,49 @@ class GnmiClient
      * @brief Constructor takes a grpc::Channel shared ptr and a CounterInterface type.
      * It creates a stub which is used to make rpc calls.
      *
+     * The stream of the client is driven by `gnmi_async_engine::default_engine()`.
+     *
      * @param channel Shared pointer to the grpc::Channel object.
      * @param interface The CounterInterface type.
      */
     GnmiClient(const std::shared_ptr<grpc::Channel>& channel,
                std::shared_ptr<GnmiCounters> interface);
+
+    /**
+     * @brief Constructor takes a grpc::Channel shared ptr, a CounterInterface type and the
+     * gnmi_async_engine whose poller threads drive the stream of the client.
+     *
+     * @param channel Shared pointer to the grpc::Channel object.
+     * @param interface The CounterInterface type.
+     * @param engine The engine driving the stream.
+     */
+    GnmiClient(const std::shared_ptr<grpc::Channel>& channel,
+               std::shared_ptr<GnmiCounters> interface, std::shared_ptr<gnmi_async_engine> engine);
     GnmiClient() = delete;
     GnmiClient(const GnmiClient&) = delete;
     GnmiClient(GnmiClient&&) = delete;
     GnmiClient& operator=(const GnmiClient&) = delete;
     GnmiClient& operator=(GnmiClient&&) = delete;
 
+    /**
+     * @brief Cancels the stream and the once request and waits for them to finish.
+     *
+     * Must not run from within a handler of the client or a task of its handler executor:
+     * the wait would return without the handlers, which still hold the client, so the
+     * process is terminated after logging an error. Close the client from the handler and
+     * destroy it from another thread instead.
+     */
     ~GnmiClient() noexcept
     {
+        if (called_from_handler())
+        {
+            logger_manager::get_instance().log("GnmiClient destroyed from its own handler",
+                                               log_level::ERROR);
+            std::terminate();
+        }
+        wait_async_closes();
         rpc_stream_close();
-        // destructor body
-        // Join the threads and calls stream stop;
+        rpc_once_cancel();
     }
 
     /**
@@ -68,12 +106,14 @@ class GnmiClient
      *
      * User will have to decide how they handle an rpc failure.
      * Handler called after RPC fails within `rpc_register_stats_stream`.
-     * It will be called within the receive thread.
+     * It will be called on a poller thread of the gnmi_async_engine.
      *
      * Rpc failure can happen for a multitude of reasons.
      * Channel Shutdown, Rpc cancelled, etc...
      * Cancel is expected when using `stream_pbr_close`, so it will not
-     * call this function.
+     * call this function. With a reconnect policy, it is only called when the client
+     * gives up reconnecting the stream. The failure of a resubscription is reported to
+     * the `on_done` of `rpc_resubscribe_stats_stream` instead.
      *
      * @param status The grpc::Status object.
      */
@@ -82,11 +122,29 @@ class GnmiClient
         rpc_failed_handler = std::move(handler);
     }
 
+    /**
+     * @brief Gets called when the stream of `rpc_register_stats_stream` has ended.
+     *
+     * Unlike `rpc_failed_handler`, it is called for every final status: OK when the server
+     * ended the stream, CANCELLED when it was closed, the failure otherwise. It runs where the
+     * other handlers run, after them. With a reconnect policy, it is only called once the
+     * client gives up reconnecting the stream. A failed resubscription does not end the
+     * stream, see `rpc_resubscribe_stats_stream`.
+     *
+     * @param handler The handler called with the final grpc::Status.
+     */
+    void set_rpc_finished_handler(std::function<void(grpc::Status)> handler)
+    {
+        rpc_finished_handler = std::move(handler);
+    }
+
     /**
      * @brief User defined function that is called after a response is received and parsed with no
      * errors.
      *
-     * Specifically used within the `rpc_register_stats_stream` receive thread.
+     * Specifically used for the `rpc_register_stats_stream` responses, on a poller thread of the
+     * gnmi_async_engine. The handler should not block, as it delays the other streams served by
+     * the same poller thread.
      *
      * If not defined by the user this function will do nothing.
      * It is up to the user to decide what they want to do with the response.
@@ -98,6 +156,103 @@ class GnmiClient
         rpc_success_handler = std::move(handler);
     }
 
+    /**
+     * @brief User defined function called with the stats decoded since its previous call.
+     *
+     * The span covers the stats added to the stats vector of the PBRBasic CounterInterface
+     * since the previous call, without casting the interface or guessing how many stats
+     * arrived. They are kept apart from the vector, so stats may be erased from it by any
+     * handler. The span is only valid during the call.
+     *
+     * With a `quantum` of 0 the handler is called after every read batch: every response,
+     * or every batch drained from the delivery queue. Otherwise it is called once the quantum
+     * elapsed since the first stat not handed over yet. The remaining stats are handed over
+     * when the stream ends. The handler runs where the success handler runs, after it.
+     *
+     * Must be called before `rpc_register_stats_stream`.
+     *
+     * @param handler The batch handler.
+     * @param quantum The time the stats are accumulated before calling the handler.
+     * @return error_code::CLIENT_TYPE_FAILURE if the CounterInterface is not PBRBasic.
+     */
+    error_code set_rpc_batch_handler(
+        std::function<void(stat_span<PbrBasicStat>)> handler,
+        std::chrono::milliseconds quantum = std::chrono::milliseconds(0));
+
+    /**
+     * @brief Runs the stream handlers of the client on the given executor.
+     *
+     * The stats are still decoded on the poller thread, then adding them to the
+     * CounterInterface and calling `rpc_success_handler` run as tasks of the strand of
+     * their key, hashed by policy and rule, in the order of the responses of that key. An
+     * expensive handler then no longer delays the other streams of the poller thread, and
+     * the keys of a bursty device are handled by up to `key_strands` workers at a time.
+     * The other handlers, like `rpc_failed_handler`, run once the handlers of every key
+     * queued before them have run.
+     *
+     * The stats vector is appended to under a lock of the client, and the batch handler is
+     * called under it. With a single strand, the success handler can read the stats vector
+     * while no other handler appends to it; with more, the success handlers of other keys
+     * run concurrently and only the batch handler may read it.
+     *
+     * Must be called before `rpc_register_stats_stream`. Passing nullptr restores
+     * the handlers on the poller thread.
+     *
+     * @param executor The executor running the handlers.
+     * @param key_strands The number of strands the keys are spread over, at least 1.
+     */
+    void set_handler_executor(std::shared_ptr<work_stealing_executor> executor,
+                              uint32_t key_strands = 1);
+
+    /**
+     * @brief Queues the decoded samples of the stream in a bounded queue before the handlers.
+     *
+     * The samples are delivered by the handler executor, `work_stealing_executor::default_executor`
+     * if none was set. When the handlers fall behind, the overflow_policy of the queue decides
+     * which samples are dropped or coalesced. With overflow_policy::BLOCK the client stops
+     * reading the stream until a slot is free, so gRPC flow control pushes back on the server
+     * without blocking the poller thread.
+     *
+     * Must be called before `rpc_register_stats_stream`.
+     *
+     * @param options The capacity and overflow policy of the queue.
+     * @throws std::invalid_argument if `capacity` is 0.
+     */
+    void set_delivery_queue(const delivery_queue_options& options);
+
+    /**
+     * @brief Returns the depth and the drop counters of the delivery queue.
+     *
+     * @return The statistics of the queue, all zero if no queue is set.
+     */
+    delivery_queue_statistics get_delivery_statistics() const;
+
+    /**
+     * @brief Reconnects the stream of `rpc_register_stats_stream` when it fails.
+     *
+     * When the stream ends with another status than CANCELLED, the client waits for the
+     * backoff of the policy and for a token of `reconnect_limiter::global()`, then opens a new
+     * RPC with the same context arguments and the last subscription request sent. The backoff
+     * starts again once a response is received on the new RPC.
+     *
+     * `rpc_failed_handler` is only called when the client gives up: after `max_attempts`
+     * attempts in a row, or on DEADLINE_EXCEEDED if the context arguments set a deadline, as
+     * the same deadline would be sent again. `rpc_stream_close` cancels a pending attempt.
+     *
+     * Must be called before `rpc_register_stats_stream`. A policy with `enabled` false
+     * calls `rpc_failed_handler` on every failure again; set while an attempt is pending, it
+     * cancels the attempt and the client gives up with the failure of the stream.
+     *
+     * @param policy The backoff of the reconnection.
+     * @throws std::invalid_argument if the policy is not valid.
+     */
+    void set_reconnect_policy(const reconnect_policy& policy);
+
+    /**
+     * @brief Returns the reconnection counters and the times to recover of the stream.
+     */
+    reconnect_statistics get_reconnect_statistics() const;
+
     /**
      * @brief This pertains only to subscription mode as Stream.
      *
@@ -107,14 +262,56 @@ class GnmiClient
      * It tries to end the stream without regard for responses.
      * This will result in an rpc_failure, thus a
      * grpc::StatusCode::CANCELLED is expected.
-     * Then receive thread is joined.
+     * Then waits until the stream is finished, and the handlers queued on the handler
+     * executor have run, so no handler runs after this call returns.
      *
-     * This is a blocking call.
+     * This is a blocking call, unless called from within a handler or any task of the
+     * handler executor, where it only cancels: the handlers already queued still run, and
+     * the next close or the destructor waits for them.
      *
      * @return An error_code.
      */
     error_code rpc_stream_close();
 
+    /**
+     * @brief Same as `rpc_stream_close`, with a bound on the wait for the RPCs to finish.
+     *
+     * Every wait is bounded by the timeout. Once it expired, the RPCs not finished yet are
+     * detached: their handlers are dropped and gRPC releases them in the background. A
+     * handler already running, a pending timer or queued handlers are left as they are,
+     * the next close, or the destructor, waits for them.
+     *
+     * @param timeout The longest time waited for the RPCs, the timers and the handlers.
+     * @return error_code::RPC_FAILURE if a wait expired, error_code::SUCCESS otherwise.
+     */
+    error_code rpc_stream_close(std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Cancels the stream and returns without waiting for it.
+     *
+     * The wait of `rpc_stream_close` is done by a library thread shared by all the clients,
+     * the future is ready once no handler of the stream runs anymore. The destructor of the
+     * client waits for the pending asynchronous closes.
+     *
+     * @return The future result of the close.
+     */
+    std::future<error_code> rpc_stream_close_async();
+
+    /**
+     * @brief Closes the streams of many clients, cancelled together then waited for.
+     *
+     * The streams finish concurrently, so closing N clients takes about as long as closing
+     * one, instead of N times as long with `rpc_stream_close` on each client in turn.
+     *
+     * @param clients The clients to close.
+     * @param timeout The longest time waited for all the RPCs, see
+     * `rpc_stream_close(std::chrono::milliseconds)`.
+     * @return error_code::RPC_FAILURE if a wait expired, error_code::SUCCESS otherwise.
+     */
+    static error_code rpc_stream_close_all(
+        const std::vector<GnmiClient*>& clients,
+        std::chrono::milliseconds timeout = std::chrono::milliseconds::max());
+
     /**
      * @brief Creates and sends subscription once request and blocks until response is received or
      * connection/rpc error occurs.
@@ -122,6 +319,7 @@ class GnmiClient
      * The request will use the paths from CounterInterface.
      * Requires The context arguments for the stream, and subscription rpc metadata.
      * The returned data will be directly stored in the stats vector of the CounterInterface.
+     * With a cache set by `set_once_cache`, the result may come from an identical request.
      *
      * @param context_args The context arguments for the stream.
      * @param rpc_args The subscription rpc metadata.
@@ -130,12 +328,66 @@ class GnmiClient
     std::pair<error_code, grpc::Status> rpc_register_stats_once(
         const client_context_args& context_args, rpc_args& rpc_args);
 
+    /**
+     * @brief Sets the cache shared by the once requests of the clients of a target.
+     *
+     * `rpc_register_stats_once` then waits for an identical request in flight on the cache
+     * instead of sending its own, and serves a successful result for the ttl of the cache.
+     * Requests are only identical with the same credentials: username, password and TLS
+     * identity of the channel. The stats are added to the CounterInterface either way. Must
+     * not be called while a once request is in flight.
+     *
+     * @param cache The cache, nullptr to send every request.
+     * @param target The name of the target of the client, e.g. its address.
+     * @param tls_identity The identity the channel authenticates with, e.g. the paths of its
+     * certificates, empty without TLS.
+     */
+    void set_once_cache(std::shared_ptr<once_cache> cache, std::string target,
+                        std::string tls_identity = std::string())
+    {
+        once_results = std::move(cache);
+        once_target = std::move(target);
+        once_tls_identity = std::move(tls_identity);
+    }
+
+    /**
+     * @brief Sets the cache shared by the once requests, with the address of the channel
+     * arguments as target and their certificates as TLS identity.
+     *
+     * @param cache The cache, nullptr to send every request.
+     * @param channel_args The arguments the channel of the client was created with.
+     */
+    void set_once_cache(std::shared_ptr<once_cache> cache, const rpc_channel_args& channel_args);
+
+    /**
+     * @brief Creates and sends subscription once request without blocking.
+     *
+     * The request is driven by the gnmi_async_engine of the client. The stats are added to
+     * the CounterInterface where the handlers of the client run, then `on_done` is called
+     * there once the server ended the RPC, with error_code::RPC_FAILURE and the grpc::Status
+     * if the RPC failed. Only one once request is in flight per client at a time.
+     *
+     * It never blocks, so it may be called from `on_done`. With `rpc_args.negotiate`, the
+     * capabilities must have been fetched by `rpc_negotiate` first, the request is refused
+     * with error_code::CLIENT_TYPE_FAILURE otherwise.
+     *
+     * @param context_args The context arguments for the request.
+     * @param rpc_args The subscription rpc metadata.
+     * @param on_done Handler called once the request is finished.
+     * @return error_code::SUCCESS if the request is started, `on_done` is only called then.
+     */
+    error_code rpc_register_stats_once_async(
+        const client_context_args& context_args, rpc_args& rpc_args,
+        std::function<void(error_code, grpc::Status)> on_done);
+
     /**
      * @brief Creates and sends subscription stream request.
      *
-     * Starts the receive function in a new thread which will later be joined by calling the
-     * `rpc_stream_close` function. Then sends the request.
-     * If the receive thread already exists, it only sends the request.
+     * Starts the stream on the gnmi_async_engine of the client, which will later be cancelled by
+     * calling the `rpc_stream_close` function. Then sends the request.
+     * If the stream already exists, the request is refused with error_code::RPC_FAILURE, as
+     * gNMI allows a single request per Subscribe RPC. Independent subscriptions should use
+     * `subscribe` instead, and new keys `rpc_resubscribe_stats_stream`.
      *
      * The request will use the paths from CounterInterface.
      * Requires context arguments for the stream, and subscription rpc metadata.
@@ -143,9 +395,9 @@ class GnmiClient
      * The user should always call `rpc_stream_close` after a transaction (successful or not).
      *
      * The user needs to implement the `rpc_failed_handler` to handle when, an RPC failure occurs,
-     * as grpc::Status is returned only in the receive thread.
+     * as grpc::Status is returned only on the poller thread.
      *
-     * The user needs to implement the `rpc_success_handler`. Called within the receive thread when
+     * The user needs to implement the `rpc_success_handler`. Called on the poller thread when
      * a response is received and checked successfully.
      *
      * @param context_args The context arguments for the stream.
@@ -155,6 +407,107 @@ class GnmiClient
     error_code rpc_register_stats_stream(const client_context_args& context_args,
                                          rpc_args& rpc_args);
 
+    /**
+     * @brief Moves the stream to the current keys of the CounterInterface without a gap.
+     *
+     * Make-before-break: a new Subscribe RPC is opened with the current keys while the
+     * running stream keeps delivering. The responses of the new RPC are held until its
+     * sync_response, then delivered in order, and the running stream is cancelled. From then
+     * on only the new RPC is delivered, so no sample is lost, some may be delivered twice.
+     *
+     * If the new RPC fails before its sync_response, the running stream keeps the previous
+     * keys and `on_done` is called with the failure; the stream handlers are not called, the
+     * stream did not end. If the running stream is reconnected first, the reconnection uses
+     * the new keys and `on_done` is called once it recovered, or with the failure once the
+     * client gives up. A resubscription still waiting is superseded by the next one, or
+     * dropped by `rpc_stream_close`, and `on_done` is then not called. Without a running
+     * stream, the stream is opened as by `rpc_register_stats_stream`, checked and opened
+     * under the same lock, and `on_done` is called with OK once the stream is started.
+     *
+     * @param context_args The context arguments for the new stream.
+     * @param rpc_args The subscription rpc metadata.
+     * @param on_done Handler called where the stream handlers run, with OK once the new keys
+     * are in use or with the failure of the resubscription.
+     * @return An error_code, `on_done` is only called on error_code::SUCCESS.
+     */
+    error_code rpc_resubscribe_stats_stream(const client_context_args& context_args,
+                                            rpc_args& rpc_args,
+                                            std::function<void(grpc::Status)> on_done = nullptr);
+
+    /**
+     * @brief Seeds a latest value state with one Get, then streams only the changes.
+     *
+     * The current values of the keys are read with a single GetRequest and merged into
+     * `latest`, then the stream is registered with `updates_only` and `resume_updates_only`,
+     * so neither the first Subscribe RPC nor its reconnections make the device send the
+     * whole initial state again. The success handler only sees the stream, not the Get.
+     *
+     * If the Get fails, e.g. on a device without Get support, the stream is registered
+     * with its initial state instead, and the failure is logged. The flags and the
+     * negotiated encoding are set on a copy, `rpc_args` is left unchanged.
+     *
+     * @param context_args The context arguments for the Get and the stream.
+     * @param rpc_args The subscription rpc metadata.
+     * @param latest The state the values of the Get are merged into.
+     * @return error_code::CLIENT_TYPE_FAILURE if the username or password is empty, before
+     * the Get is sent, otherwise the error_code of the stream registration.
+     */
+    error_code rpc_seed_stats_stream(const client_context_args& context_args,
+                                     const rpc_args& rpc_args, pbr_latest_values& latest);
+
+    /**
+     * @brief Reads the state of the keys with a single Get request.
+     *
+     * All the keys are read with one GetRequest of type STATE, planned and prefixed like a
+     * subscription, and decoded the same way. The stats are stored in the stats vector of
+     * the CounterInterface. The deadline of `context_args` applies to the Get. Unlike
+     * `rpc_register_stats_once`, no Subscribe RPC is set up for the query.
+     *
+     * @param context_args The context arguments for the Get RPC.
+     * @param rpc_args The rpc metadata, for the encoding, models, prefix and planner.
+     * @return A pair of error_code and grpc::Status.
+     */
+    std::pair<error_code, grpc::Status> rpc_get_stats(const client_context_args& context_args,
+                                                      rpc_args& rpc_args);
+
+    /**
+     * @brief Returns the capabilities of the target, calling Capabilities once per channel.
+     *
+     * The clients sharing a channel share its capabilities, see `capabilities_cache`.
+     *
+     * @param context_args The context arguments for the Capabilities RPC.
+     * @param capabilities Set to the capabilities of the target.
+     * @return error_code::RPC_FAILURE if the Capabilities RPC failed.
+     */
+    error_code rpc_get_capabilities(const client_context_args& context_args,
+                                    gnmi::CapabilityResponse* capabilities);
+
+    /**
+     * @brief Sets the encoding and the models of the rpc_args from the target capabilities.
+     *
+     * The encoding is the cheapest one the target supports, PROTO before JSON_IETF, and
+     * `use_models` is set to the supported models of the counters. The requests do this
+     * themselves when `rpc_args.negotiate` is set.
+     *
+     * @param context_args The context arguments for the Capabilities RPC.
+     * @param rpc_args The rpc metadata to update.
+     * @return error_code::RPC_FAILURE if the Capabilities RPC failed, the rpc_args are then
+     * left as they are.
+     */
+    error_code rpc_negotiate(const client_context_args& context_args, rpc_args& rpc_args);
+
+    /**
+     * @brief Creates a subscription sharing the channel, stub and engine of the client.
+     *
+     * Every subscription runs its own Subscribe RPC, with its own counters, mode, sample
+     * interval and handlers, and is closed on its own. Use it instead of calling
+     * `rpc_register_stats_stream` several times, as gNMI allows one request per RPC.
+     * The subscription stays usable after the client is destroyed.
+     *
+     * @param counters The counters subscribed to, not shared with other subscriptions.
+     * @return The idle subscription, started with `gnmi_subscription::start`.
+     */
+    std::shared_ptr<gnmi_subscription> subscribe(std::shared_ptr<GnmiCounters> counters);
 
     /**
      * @brief get_counter_gnmi_paths returns the paths for the given counter.
@@ -165,9 +518,42 @@ class GnmiClient
     std::shared_ptr<GnmiClientDetails> impl_;
 
    private:
+    bool begin_close(std::vector<std::shared_ptr<gnmi_subscribe_call>>& calls);
+    bool finish_close(std::vector<std::shared_ptr<gnmi_subscribe_call>>& calls, bool had_stream,
+                      std::chrono::steady_clock::time_point deadline);
+    void wait_async_closes();
+    bool called_from_handler() const;
+    error_code open_stream(const client_context_args& context_args, const rpc_args& rpc_args,
+                           gnmi::SubscribeRequest& request,
+                           std::shared_ptr<const pbr_subscription_plan> plan);
+    bool start_stream_call(const client_context_args& context_args,
+                           const gnmi::SubscribeRequest& request,
+                           grpc::CompletionQueue* completion_queue = nullptr);
+    bool on_call_response(uint64_t generation, const gnmi::SubscribeResponse& response);
+    void on_call_finish(uint64_t generation, const grpc::Status& status);
+    bool schedule_reconnect(uint64_t generation, const grpc::Status& status);
+    void on_reconnect_timer(bool ok);
+    bool on_stream_response(const gnmi::SubscribeResponse& response,
+                            const pbr_subscription_plan* plan);
+    void drain_delivery_queue();
+    void add_stream_stat(PBRBase& counters, const std::shared_ptr<PBRBase::pbr_stat>& stat);
+    void on_new_stats();
+    void flush_batch();
+    void on_batch_timer(bool ok);
+    void on_stream_finish(const grpc::Status& status, bool reconnecting);
+    void run_handler(std::function<void()> handler);
+    void run_key_handler(const std::string& key, std::function<void()> handler);
+    void rpc_once_cancel();
+
     std::shared_ptr<GnmiCounters> interface;
     std::function<void(grpc::Status)> rpc_failed_handler;
+    std::function<void(grpc::Status)> rpc_finished_handler;
     std::function<void(std::shared_ptr<GnmiCounters>)> rpc_success_handler;
+    std::function<void(stat_span<PbrBasicStat>)> rpc_batch_handler;
+    std::chrono::milliseconds batch_quantum{0};
+    std::shared_ptr<once_cache> once_results;
+    std::string once_target;
+    std::string once_tls_identity;
 };
 /** @}*/  // end of gnmi
 }  // namespace mgbl_api
@@ -42,6 +42,9 @@ class gnmi_client_connection
      * @brief Constructs a channel object based off the channel_args.
      * If the channel arguments are not valid, an exception is thrown.
      *
+     * With `pool_subchannels` set, the channel is taken from the channel_pool and shared
+     * with the other connections to the same target.
+     *
      * @param channel_args The arguments for the channel.
      */
     explicit gnmi_client_connection(const rpc_channel_args& channel_args);
@@ -0,0 +1,454 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_COROUTINE_H_
+#define MGBL_GNMI_COROUTINE_H_
+
+/*
+ * Opt-in coroutine interface, header only. The library itself is built as C++14, the
+ * declarations below are only visible to code compiled with C++20 coroutine support.
+ *
+ * Mixing the standards is safe for the API below, but not for every generated header: the
+ * static constexpr members of the protobuf messages, e.g. gnmi::SubscriptionList::ONCE, are
+ * implicitly inline in C++17 and later while the C++14 gnmi.pb.cc defines them out of line.
+ * A C++20 translation unit must not odr-use them, e.g. bind them to a reference as
+ * EXPECT_EQ does, or the link fails with multiple definitions.
+ */
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#define MGBL_API_HAS_COROUTINES 1
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "gnmi/mgbl_gnmi_client.h"
+#include "gnmi/mgbl_gnmi_executor.h"
+#include "logger/logger.h"
+#include "pbr/mgbl_pbr.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+namespace detail
+{
+/**
+ * @brief Resumes a suspended coroutine on a worker of the executor.
+ *
+ * The coroutine is resumed inline if the executor is shut down.
+ */
+inline void resume_on(work_stealing_executor& executor, std::coroutine_handle<> handle)
+{
+    if (!executor.submit([handle]() { handle.resume(); }))
+    {
+        handle.resume();
+    }
+}
+}  // namespace detail
+
+/**
+ * @class gnmi_task
+ * @brief Coroutine return type of a collection task.
+ *
+ * The task starts running when it is called and runs until its first suspension, it is
+ * then resumed on the executor of the awaited operation. Destroying the task detaches it,
+ * the coroutine frame is then freed when the coroutine ends.
+ */
+class gnmi_task
+{
+   public:
+    /**
+     * @brief Completion state shared by the task and its coroutine.
+     */
+    struct task_state
+    {
+        std::mutex state_mtx;
+        std::condition_variable done_cv;
+        bool done = false;
+        bool detached = false;
+        std::exception_ptr exception;
+    };
+
+    /**
+     * @brief Promise of the coroutine, required by the compiler.
+     */
+    struct promise_type
+    {
+        std::shared_ptr<task_state> state = std::make_shared<task_state>();
+
+        gnmi_task get_return_object()
+        {
+            return gnmi_task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        auto final_suspend() noexcept
+        {
+            struct final_awaiter
+            {
+                bool await_ready() noexcept
+                {
+                    return false;
+                }
+                void await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+                {
+                    // The state outlives the frame, a detached frame is freed here.
+                    std::shared_ptr<task_state> state = handle.promise().state;
+                    bool detached = false;
+                    {
+                        std::lock_guard<std::mutex> lock(state->state_mtx);
+                        state->done = true;
+                        detached = state->detached;
+                    }
+                    state->done_cv.notify_all();
+                    if (detached)
+                    {
+                        handle.destroy();
+                    }
+                }
+                void await_resume() noexcept {}
+            };
+            return final_awaiter{};
+        }
+
+        void return_void() {}
+
+        void unhandled_exception()
+        {
+            state->exception = std::current_exception();
+        }
+    };
+
+    gnmi_task(const gnmi_task&) = delete;
+    gnmi_task& operator=(const gnmi_task&) = delete;
+    gnmi_task(gnmi_task&& other) noexcept
+        : handle(std::exchange(other.handle, nullptr)), state(std::move(other.state))
+    {
+    }
+    gnmi_task& operator=(gnmi_task&&) = delete;
+
+    ~gnmi_task()
+    {
+        if (handle == nullptr)
+        {
+            return;
+        }
+        bool done = false;
+        {
+            std::lock_guard<std::mutex> lock(state->state_mtx);
+            done = state->done;
+            state->detached = !done;
+        }
+        if (done)
+        {
+            handle.destroy();
+        }
+    }
+
+    /**
+     * @brief Whether the coroutine has ended.
+     */
+    bool done() const
+    {
+        std::lock_guard<std::mutex> lock(state->state_mtx);
+        return state->done;
+    }
+
+    /**
+     * @brief Blocks until the coroutine has ended.
+     *
+     * Must not be called from a worker of the executor resuming the coroutine.
+     *
+     * @throws The exception that escaped the coroutine, if any.
+     */
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(state->state_mtx);
+        state->done_cv.wait(lock, [this] { return state->done; });
+        if (state->exception)
+        {
+            std::rethrow_exception(state->exception);
+        }
+    }
+
+   private:
+    explicit gnmi_task(std::coroutine_handle<promise_type> handle)
+        : handle(handle), state(handle.promise().state)
+    {
+    }
+
+    std::coroutine_handle<promise_type> handle;
+    std::shared_ptr<task_state> state;
+};
+
+/**
+ * @brief Moves the calling coroutine to a worker of the executor.
+ *
+ * `co_await schedule_on(executor)` hands the rest of the coroutine to the executor,
+ * it continues inline if the executor is shut down.
+ *
+ * @param executor The executor running the rest of the coroutine.
+ */
+inline auto schedule_on(work_stealing_executor& executor)
+{
+    struct schedule_awaiter
+    {
+        work_stealing_executor& executor;
+
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            return executor.submit([handle]() { handle.resume(); });
+        }
+        void await_resume() noexcept {}
+    };
+    return schedule_awaiter{executor};
+}
+
+/**
+ * @class sample_stream
+ * @brief Awaitable view over the samples of the stream of a GnmiClient.
+ *
+ * Takes over the batch and finished handlers of the client, so the samples are consumed with
+ * `co_await stream.next_batch()` instead of callbacks. Samples received while nobody awaits
+ * are kept until the next call. The stream ends with any final status: a failure, the server
+ * ending it, or `close` and `rpc_stream_close` on the client. The stats handed over are erased
+ * from the PBRBasic counters. A single coroutine may await the stream at a time.
+ */
+class sample_stream
+{
+   public:
+    /**
+     * @brief Installs the handlers of the stream on the client.
+     * If the counters of the client are not PBRBasic, an exception is thrown.
+     *
+     * Must be called before `rpc_register_stats_stream`.
+     *
+     * @param client The client whose stream is consumed.
+     * @param counters The counters the client was created with.
+     * @param quantum The time the samples are accumulated before waking the coroutine.
+     * @param executor The executor the awaiting coroutine is resumed on.
+     * @throws std::invalid_argument if the client does not use PBRBasic counters.
+     */
+    sample_stream(GnmiClient& client, std::shared_ptr<PBRBasic> counters,
+                  std::chrono::milliseconds quantum = std::chrono::milliseconds(0),
+                  std::shared_ptr<work_stealing_executor> executor =
+                      work_stealing_executor::default_executor())
+        : client(client), state(std::make_shared<stream_state>())
+    {
+        state->executor = std::move(executor);
+        auto handler = [state = state, counters](stat_span<PbrBasicStat> stats)
+        {
+            std::coroutine_handle<> waiter;
+            {
+                std::lock_guard<std::mutex> lock(state->state_mtx);
+                state->batch.insert(state->batch.end(), stats.begin(), stats.end());
+                waiter = std::exchange(state->waiter, nullptr);
+            }
+            counters->stats.clear();
+            if (waiter)
+            {
+                detail::resume_on(*state->executor, waiter);
+            }
+        };
+        if (client.set_rpc_batch_handler(std::move(handler), quantum) != error_code::SUCCESS)
+        {
+            logger_manager::get_instance().log("sample_stream requires PBRBasic counters",
+                                               log_level::ERROR);
+            throw std::invalid_argument("sample_stream requires PBRBasic counters");
+        }
+        client.set_rpc_finished_handler([state = state](grpc::Status status)
+                                        { state->finish(std::move(status)); });
+    }
+
+    /**
+     * @brief Returns an awaitable for the samples received since the previous call.
+     *
+     * The awaitable resumes as soon as samples are available, on the executor of the stream.
+     * It yields an empty vector once the stream ended and its last samples were handed over,
+     * see `status`.
+     */
+    auto next_batch()
+    {
+        struct batch_awaiter
+        {
+            std::shared_ptr<stream_state> state;
+
+            bool await_ready()
+            {
+                std::lock_guard<std::mutex> lock(state->state_mtx);
+                return !state->batch.empty() || state->finished;
+            }
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                std::lock_guard<std::mutex> lock(state->state_mtx);
+                if (!state->batch.empty() || state->finished)
+                {
+                    return false;
+                }
+                state->waiter = handle;
+                return true;
+            }
+            std::vector<PbrBasicStat> await_resume()
+            {
+                std::lock_guard<std::mutex> lock(state->state_mtx);
+                return std::exchange(state->batch, {});
+            }
+        };
+        return batch_awaiter{state};
+    }
+
+    /**
+     * @brief Closes the stream of the client and wakes the awaiting coroutine, if any.
+     */
+    void close()
+    {
+        client.rpc_stream_close();
+        state->finish(grpc::Status::CANCELLED);
+    }
+
+    /**
+     * @brief Returns the final status of the stream, OK while it is running or if the server
+     * ended it.
+     */
+    grpc::Status status() const
+    {
+        std::lock_guard<std::mutex> lock(state->state_mtx);
+        return state->status;
+    }
+
+   private:
+    struct stream_state
+    {
+        std::shared_ptr<work_stealing_executor> executor;
+        mutable std::mutex state_mtx;
+        std::vector<PbrBasicStat> batch;
+        std::coroutine_handle<> waiter;
+        grpc::Status status;
+        bool finished = false;
+
+        void finish(grpc::Status final_status)
+        {
+            std::coroutine_handle<> resumed;
+            {
+                std::lock_guard<std::mutex> lock(state_mtx);
+                if (finished)
+                {
+                    return;
+                }
+                finished = true;
+                status = std::move(final_status);
+                resumed = std::exchange(waiter, nullptr);
+            }
+            if (resumed)
+            {
+                detail::resume_on(*executor, resumed);
+            }
+        }
+    };
+
+    GnmiClient& client;
+    std::shared_ptr<stream_state> state;
+};
+
+/**
+ * @brief Awaitable once request, see `subscribe_once`.
+ */
+class once_awaiter
+{
+   public:
+    once_awaiter(GnmiClient& client, const client_context_args& context_args,
+                 const rpc_args& args, std::shared_ptr<work_stealing_executor> executor)
+        : client(client), context_args(context_args), args(args), executor(std::move(executor))
+    {
+    }
+
+    bool await_ready() noexcept
+    {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        const error_code err = client.rpc_register_stats_once_async(
+            context_args, args,
+            [this, handle](error_code done_err, grpc::Status status)
+            {
+                result = {done_err, std::move(status)};
+                detail::resume_on(*executor, handle);
+            });
+        if (err != error_code::SUCCESS)
+        {
+            result.first = err;
+            return false;
+        }
+        // The request may already be done and the coroutine resumed, `this` is not used anymore.
+        return true;
+    }
+
+    std::pair<error_code, grpc::Status> await_resume()
+    {
+        return std::move(result);
+    }
+
+   private:
+    GnmiClient& client;
+    client_context_args context_args;
+    rpc_args args;
+    std::shared_ptr<work_stealing_executor> executor;
+    std::pair<error_code, grpc::Status> result{error_code::SUCCESS, grpc::Status::OK};
+};
+
+/**
+ * @brief Sends a subscription once request and suspends the coroutine until it is finished.
+ *
+ * `co_await subscribe_once(client, context_args, rpc_args)` is the coroutine counterpart of
+ * `rpc_register_stats_once`, without blocking a thread. The stats are added to the counters
+ * of the client, the coroutine is resumed on the executor.
+ *
+ * @param client The client sending the request.
+ * @param context_args The context arguments for the request.
+ * @param args The subscription rpc metadata.
+ * @param executor The executor the coroutine is resumed on.
+ * @return An awaitable yielding the error_code and the grpc::Status of the request.
+ */
+inline once_awaiter subscribe_once(
+    GnmiClient& client, const client_context_args& context_args, const rpc_args& args,
+    std::shared_ptr<work_stealing_executor> executor = work_stealing_executor::default_executor())
+{
+    return once_awaiter(client, context_args, args, std::move(executor));
+}
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+
+#endif  // __cpp_impl_coroutine
+#endif  // MGBL_GNMI_COROUTINE_H_
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_DELIVERY_QUEUE_H_
+#define MGBL_GNMI_DELIVERY_QUEUE_H_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "mgbl_api.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief What a delivery_queue does with a new sample when it is full.
+ */
+enum class overflow_policy
+{
+    BLOCK,          /**< Stop reading the stream until the consumer frees a slot */
+    DROP_OLDEST,    /**< Drop the oldest queued sample */
+    DROP_NEWEST,    /**< Drop the new sample */
+    COALESCE_LATEST /**< Merge into the queued sample of the same key, else drop the oldest */
+};
+
+/**
+ * @brief Struct for configuring a delivery_queue.
+ */
+struct delivery_queue_options
+{
+    static constexpr size_t DEFAULT_CAPACITY = 1024; /**< Default number of queued samples */
+    size_t capacity = DEFAULT_CAPACITY;              /**< Maximum number of queued samples */
+    overflow_policy policy = overflow_policy::BLOCK; /**< Behavior when the queue is full */
+};
+
+/**
+ * @brief Counters of a delivery_queue.
+ */
+struct delivery_queue_statistics
+{
+    size_t depth = 0;             /**< Samples currently queued */
+    size_t max_depth = 0;         /**< Highest number of samples queued */
+    uint64_t enqueued = 0;        /**< Samples accepted in the queue */
+    uint64_t delivered = 0;       /**< Samples taken by the consumer */
+    uint64_t dropped_oldest = 0;  /**< Queued samples dropped to make room */
+    uint64_t dropped_newest = 0;  /**< New samples dropped because the queue was full */
+    uint64_t coalesced = 0;       /**< Queued samples replaced by a newer one of the same key */
+    uint64_t blocked = 0;         /**< Times the producer was refused a slot with BLOCK */
+};
+
+/**
+ * @brief A decoded sample waiting for delivery.
+ */
+struct delivery_item
+{
+    std::string key;                /**< Identity of the sample, used to coalesce */
+    std::shared_ptr<IPbrStat> stat; /**< The decoded sample */
+};
+
+/**
+ * @class delivery_queue
+ * @brief Bounded queue between the receiving and the delivery of the samples of a stream.
+ *
+ * The queue never grows past its capacity, the overflow_policy decides which sample
+ * gives way when it is full, and every sample that does is counted.
+ */
+class delivery_queue
+{
+   public:
+    /**
+     * @brief Result of `push`.
+     */
+    enum class push_result
+    {
+        QUEUED,  /**< The sample is queued, possibly in place of another one */
+        DROPPED, /**< The sample was dropped */
+        FULL     /**< The queue is full and the policy is BLOCK, the sample was not taken */
+    };
+
+    /**
+     * @brief Creates an empty queue.
+     * If the options are not valid, an exception is thrown.
+     *
+     * @param queue_options The options of the queue.
+     * @throws std::invalid_argument if `capacity` is 0.
+     */
+    explicit delivery_queue(const delivery_queue_options& queue_options);
+
+    /**
+     * @brief Queues a sample, applying the overflow policy if the queue is full.
+     *
+     * @param item The sample to queue. Left untouched if FULL is returned.
+     * @return The outcome for the sample.
+     */
+    push_result push(delivery_item& item);
+
+    /**
+     * @brief Moves up to `max_items` of the oldest samples to `out`.
+     *
+     * @param out The vector the samples are appended to.
+     * @param max_items The maximum number of samples to take.
+     * @return The number of samples taken.
+     */
+    size_t pop_batch(std::vector<delivery_item>& out, size_t max_items);
+
+    /**
+     * @brief Returns the number of queued samples.
+     */
+    size_t size();
+
+    /**
+     * @brief Returns the counters of the queue.
+     */
+    delivery_queue_statistics get_statistics();
+
+   private:
+    void pop_front_locked(delivery_item* out);
+
+    delivery_queue_options options;
+    std::mutex queue_mtx;
+    std::deque<delivery_item> items;
+    /** Sequence number of the front item, to locate coalesced keys in `items`. */
+    uint64_t front_sequence = 0;
+    std::unordered_map<std::string, uint64_t> key_sequences;
+    delivery_queue_statistics statistics;
+};
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_DELIVERY_QUEUE_H_
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_EXECUTOR_H_
+#define MGBL_GNMI_EXECUTOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "gnmi/mgbl_gnmi_thread.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+class work_stealing_executor;
+
+/**
+ * @brief Serial queue of tasks run by a work_stealing_executor.
+ *
+ * Tasks submitted to the same strand run one at a time, in submission order,
+ * on whichever worker thread picks the strand up. Tasks of different strands
+ * run in parallel.
+ */
+class executor_strand
+{
+   public:
+    executor_strand() = default;
+    executor_strand(const executor_strand&) = delete;
+    executor_strand& operator=(const executor_strand&) = delete;
+
+    /**
+     * @brief Returns the number of tasks queued on the strand and not run yet.
+     */
+    size_t pending();
+
+    /**
+     * @brief Blocks until every task queued on the strand has run.
+     *
+     * Returns immediately if called from a task of the strand itself.
+     */
+    void wait_idle();
+
+    /**
+     * @brief Same as `wait_idle`, or until the deadline.
+     * @param deadline The time after which the strand is no longer waited for.
+     * @return False if the deadline expired first.
+     */
+    bool wait_idle_until(std::chrono::steady_clock::time_point deadline);
+
+   private:
+    friend class work_stealing_executor;
+
+    std::mutex strand_mtx;
+    std::condition_variable idle_cv;
+    std::deque<std::function<void()>> tasks;
+    bool scheduled = false;
+};
+
+/**
+ * @brief Metrics of a work_stealing_executor.
+ */
+struct executor_statistics
+{
+    size_t pending_tasks = 0;         /**< Tasks submitted and not run yet */
+    size_t max_pending_tasks = 0;     /**< Highest number of pending tasks observed */
+    std::vector<size_t> queue_depths; /**< Runnable items queued on each worker */
+    uint64_t executed_tasks = 0;      /**< Tasks run since creation */
+    uint64_t stolen_tasks = 0;        /**< Runnable items taken from another worker's queue */
+};
+
+/**
+ * @class work_stealing_executor
+ * @brief Thread pool running handlers off the poller threads.
+ *
+ * Every worker owns a queue. Items submitted from a worker go to its own queue,
+ * others are spread round robin. An idle worker first drains its own queue, then
+ * steals from the queues of the other workers, so a bursty producer borrows idle
+ * cores instead of waiting on a single thread.
+ *
+ * Ordering is only guaranteed between tasks of the same executor_strand.
+ */
+class work_stealing_executor
+{
+   public:
+    /**
+     * @brief Struct for configuring the executor.
+     */
+    struct options
+    {
+        static constexpr uint32_t DEFAULT_WORKER_THREADS = 4; /**< Default worker thread count */
+        static constexpr uint32_t DEFAULT_TASKS_PER_TURN = 32; /**< Default strand batch */
+        uint32_t worker_threads = DEFAULT_WORKER_THREADS;      /**< Number of worker threads */
+        uint32_t tasks_per_turn =
+            DEFAULT_TASKS_PER_TURN; /**< Tasks of a strand run before yielding the worker */
+    };
+
+    /**
+     * @brief Starts the worker threads.
+     * If the options are not valid, an exception is thrown.
+     *
+     * @param executor_options The options of the executor.
+     * @throws std::invalid_argument if `worker_threads` or `tasks_per_turn` is 0.
+     */
+    explicit work_stealing_executor(const options& executor_options);
+    work_stealing_executor() : work_stealing_executor(options{}) {}
+
+    work_stealing_executor(const work_stealing_executor&) = delete;
+    work_stealing_executor& operator=(const work_stealing_executor&) = delete;
+    work_stealing_executor(work_stealing_executor&&) = delete;
+    work_stealing_executor& operator=(work_stealing_executor&&) = delete;
+
+    /**
+     * @brief Runs the pending tasks and joins the worker threads.
+     */
+    ~work_stealing_executor();
+
+    /**
+     * @brief Returns the executor used by the clients that need one and were not given one.
+     *
+     * The executor is created on first use with the default options.
+     *
+     * @return A shared pointer to the default executor.
+     */
+    static std::shared_ptr<work_stealing_executor> default_executor();
+
+    /**
+     * @brief Creates a strand whose tasks run in submission order.
+     */
+    static std::shared_ptr<executor_strand> make_strand()
+    {
+        return std::make_shared<executor_strand>();
+    }
+
+    /**
+     * @brief Submits a task without ordering guarantee.
+     *
+     * @param task The task to run.
+     * @return False if the executor is shut down, the task is then not run.
+     */
+    bool submit(std::function<void()> task);
+
+    /**
+     * @brief Submits a task run after every task previously submitted to the strand.
+     *
+     * @param strand The strand of the task.
+     * @param task The task to run.
+     * @return False if the executor is shut down, the task is then not run.
+     */
+    bool submit(const std::shared_ptr<executor_strand>& strand, std::function<void()> task);
+
+    /**
+     * @brief Returns the number of worker threads.
+     */
+    uint32_t worker_count() const
+    {
+        return static_cast<uint32_t>(queues.size());
+    }
+
+    /**
+     * @brief Checks whether the calling thread is one of the worker threads of this executor.
+     */
+    bool is_worker_thread() const;
+
+    /**
+     * @brief Returns the queue depths and the task counters of the executor.
+     */
+    executor_statistics get_statistics() const;
+
+    /**
+     * @brief Runs the pending tasks and joins the worker threads.
+     *
+     * Tasks submitted afterwards are rejected. Safe to call more than once, but
+     * not from a task of the executor.
+     */
+    void shutdown();
+
+   private:
+    struct worker_queue
+    {
+        std::mutex queue_mtx;
+        std::deque<std::function<void()>> items;
+    };
+
+    bool reserve_task();
+    void release_task();
+    void push(std::function<void()> item);
+    bool pop_or_steal(uint32_t worker, std::function<void()>& item);
+    void run_worker(uint32_t worker);
+    void run_strand(const std::shared_ptr<executor_strand>& strand);
+    void run_task(const std::function<void()>& task);
+
+    uint32_t tasks_per_turn;
+    std::vector<std::unique_ptr<worker_queue>> queues;
+    std::vector<gnmi_thread> workers;
+    std::atomic<uint32_t> next_queue{0};
+    std::atomic<size_t> queued_items{0};
+    std::atomic<size_t> pending_tasks{0};
+    std::atomic<size_t> max_pending_tasks{0};
+    std::atomic<uint64_t> executed_tasks{0};
+    std::atomic<uint64_t> stolen_tasks{0};
+
+    std::mutex sleep_mtx;
+    std::condition_variable sleep_cv;
+    std::atomic<bool> stopping{false};
+    std::mutex shutdown_mtx;
+    bool is_shutdown = false;
+};
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_EXECUTOR_H_
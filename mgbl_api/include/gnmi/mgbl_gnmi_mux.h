@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_MUX_H_
+#define MGBL_GNMI_MUX_H_
+
+#include <grpcpp/grpcpp.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "gnmi/mgbl_gnmi_async_engine.h"
+#include "gnmi/mgbl_gnmi_reconnect.h"
+#include "mgbl_api.h"
+#include "pbr/mgbl_pbr.h"
+#include "rpc/mgbl_rpc.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Counters of a gnmi_subscription_mux.
+ */
+struct subscription_mux_statistics
+{
+    size_t targets = 0;             /**< Number of targets added */
+    size_t streams = 0;             /**< Upstream Subscribe RPCs, one per target with consumers */
+    size_t consumers = 0;           /**< Number of registered consumers */
+    size_t upstream_keys = 0;       /**< Keys the streams are in sync with, the union per target */
+    uint64_t samples_received = 0;  /**< Stats received from the targets */
+    uint64_t samples_delivered = 0; /**< Stats handed to the consumers */
+};
+
+/**
+ * @class gnmi_subscription_mux
+ * @brief Shares one stream per target between many consumers of its stats.
+ *
+ * Consumers register the keys of a target they are interested in. The mux keeps a single
+ * Subscribe RPC per target, on the union of the keys of its consumers, and hands every
+ * consumer the stats of its own keys only. A consumer whose keys are already subscribed
+ * costs the target nothing; otherwise the stream is moved to the new union without a gap,
+ * see `GnmiClient::rpc_resubscribe_stats_stream`. The new union is only committed once the
+ * stream is in sync with it; if the move fails, the stream keeps the previous keys and the
+ * failure is reported to the failed handler. The stream of a target is closed when its
+ * last consumer leaves.
+ *
+ * A key subscribed by several consumers is sampled at the shortest of their intervals.
+ */
+class gnmi_subscription_mux
+{
+   public:
+    /**
+     * @brief Struct for configuring the mux.
+     */
+    struct options
+    {
+        reconnect_policy reconnect;                /**< Reconnection of every stream */
+        std::shared_ptr<gnmi_async_engine> engine; /**< Engine of the streams, nullptr for the
+                                                        default engine */
+    };
+
+    using consumer_handler =
+        std::function<void(const std::string& target, stat_span<PbrBasicStat> stats)>;
+    using failed_handler = std::function<void(const std::string& target, grpc::Status status)>;
+
+    /**
+     * @brief Creates a mux without targets.
+     *
+     * @param args The subscription rpc metadata of every stream.
+     * @param mux_options The options of the mux.
+     */
+    gnmi_subscription_mux(const rpc_args& args, const options& mux_options);
+
+    gnmi_subscription_mux(const gnmi_subscription_mux&) = delete;
+    gnmi_subscription_mux& operator=(const gnmi_subscription_mux&) = delete;
+    gnmi_subscription_mux(gnmi_subscription_mux&&) = delete;
+    gnmi_subscription_mux& operator=(gnmi_subscription_mux&&) = delete;
+
+    /**
+     * @brief Closes every stream.
+     */
+    ~gnmi_subscription_mux();
+
+    /**
+     * @brief Sets the handler called when the stream of a target fails and is not
+     * reconnected, or could not be moved to the new keys of its consumers; the stream then
+     * keeps the previous keys. Must be set before the first `add_target`.
+     */
+    void set_failed_handler(failed_handler handler)
+    {
+        on_failure = std::move(handler);
+    }
+
+    /**
+     * @brief Adds a target the consumers can subscribe to, its stream is opened with its
+     * first consumer.
+     * If the arguments are not valid, an exception is thrown.
+     *
+     * @param name Unique name of the target.
+     * @param channel_args Channel arguments of the target.
+     * @param context_args Context arguments of the stream of the target.
+     * @throws std::invalid_argument if the name is already added or the channel arguments
+     * or the reconnect policy are not valid.
+     */
+    void add_target(const std::string& name, const rpc_channel_args& channel_args,
+                    const client_context_args& context_args);
+
+    /**
+     * @brief Registers a consumer of keys of a target.
+     *
+     * The handler runs where the handlers of the stream of the target run, with the stats
+     * of the keys of the consumer only. Only `key_policy`, `key_rule` and
+     * `sample_interval_nsec` of the keys are used. Must not be called from a handler.
+     *
+     * @param target The name of the target.
+     * @param keys The keys of the target the consumer is interested in.
+     * @param handler The handler receiving the stats.
+     * @return The id of the consumer, used to unsubscribe it.
+     * @throws std::invalid_argument if the target is unknown, `keys` is empty or the
+     * handler is empty.
+     */
+    uint64_t subscribe(const std::string& target, const std::vector<PBRBase::pbr_key>& keys,
+                       consumer_handler handler);
+
+    /**
+     * @brief Unregisters a consumer, and drops its keys from the stream if no other
+     * consumer wants them.
+     *
+     * A batch being delivered may still reach the consumer. Must not be called from a
+     * handler.
+     *
+     * @param id The id returned by `subscribe`.
+     * @return False if the id is not registered.
+     */
+    bool unsubscribe(uint64_t id);
+
+    /**
+     * @brief Returns the counters of the mux.
+     */
+    subscription_mux_statistics get_statistics();
+
+   private:
+    struct upstream;
+    struct consumer;
+
+    void update_stream(upstream& target);
+    void on_resubscribed(upstream& target, uint64_t serial, grpc::Status status);
+    void fan_out(upstream& target, stat_span<PbrBasicStat> stats);
+
+    rpc_args stream_args;
+    options mux_options;
+    failed_handler on_failure;
+    std::mutex mux_mtx;
+    std::map<std::string, std::unique_ptr<upstream>> upstreams;
+    std::map<uint64_t, std::shared_ptr<consumer>> consumers;
+    uint64_t next_id = 1;
+    std::atomic<uint64_t> samples_received{0};
+    std::atomic<uint64_t> samples_delivered{0};
+};
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_MUX_H_
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_ONCE_CACHE_H_
+#define MGBL_GNMI_ONCE_CACHE_H_
+
+#include <grpcpp/grpcpp.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "mgbl_api.h"
+#include "rpc/mgbl_rpc.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Counters of a once_cache.
+ */
+struct once_cache_statistics
+{
+    uint64_t hits = 0;      /**< Requests served from a fresh result */
+    uint64_t coalesced = 0; /**< Requests which waited for an identical request in flight */
+    uint64_t misses = 0;    /**< Requests sent to the target */
+    size_t entries = 0;     /**< Results currently cached */
+};
+
+/**
+ * @class once_cache
+ * @brief Shares the results of identical once requests between the clients of a process.
+ *
+ * A request is identified by its target, its credentials and its SubscribeRequest. While a
+ * request is in flight, the identical requests wait for its result instead of sending
+ * their own, and a successful result is then served for `ttl` without asking the target
+ * again. A failed result is only shared with the requests which waited for it. Clients
+ * use the cache once it is set with `GnmiClient::set_once_cache`.
+ */
+class once_cache
+{
+   public:
+    using stats_vector = std::vector<std::shared_ptr<PBRBase::pbr_stat>>;
+    using once_result = std::pair<error_code, grpc::Status>;
+
+    /**
+     * @brief Struct for configuring the cache.
+     */
+    struct options
+    {
+        static constexpr size_t DEFAULT_MAX_ENTRIES = 4096; /**< Default cached results */
+        std::chrono::milliseconds ttl{5000};       /**< Time a result is served, 0 disables it */
+        size_t max_entries = DEFAULT_MAX_ENTRIES; /**< Results kept at most */
+    };
+
+    /**
+     * @brief Creates an empty cache.
+     * If the options are not valid, an exception is thrown.
+     *
+     * @param cache_options The options of the cache.
+     * @throws std::invalid_argument if `ttl` is negative.
+     */
+    explicit once_cache(const options& cache_options);
+    once_cache() : once_cache(options{}) {}
+
+    once_cache(const once_cache&) = delete;
+    once_cache& operator=(const once_cache&) = delete;
+    once_cache(once_cache&&) = delete;
+    once_cache& operator=(once_cache&&) = delete;
+
+    /**
+     * @brief Returns the result of a request, from the cache, from an identical request in
+     * flight, or by calling `request`.
+     *
+     * @param key The identity of the request.
+     * @param deadline If not nullptr, the time after which waiting for an identical request
+     * in flight gives up with DEADLINE_EXCEEDED.
+     * @param request Sends the request and fills the stats it received. If it throws, the
+     * exception is rethrown and the requests waiting for it fail with INTERNAL.
+     * @param stats Set to the stats of the result.
+     * @return The error code and status of the result.
+     */
+    once_result fetch(const std::string& key,
+                      const std::chrono::system_clock::time_point* deadline,
+                      const std::function<once_result(stats_vector*)>& request,
+                      stats_vector* stats);
+
+    /**
+     * @brief Forgets every cached result, the requests in flight are not affected.
+     */
+    void clear();
+
+    /**
+     * @brief Returns the counters of the cache.
+     */
+    once_cache_statistics get_statistics();
+
+   private:
+    struct entry
+    {
+        bool pending = true;
+        once_result result;
+        std::shared_ptr<const stats_vector> stats;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    void prune_locked(std::chrono::steady_clock::time_point now);
+
+    options cache_options;
+    std::mutex cache_mtx;
+    std::condition_variable cache_cv;
+    std::unordered_map<std::string, std::shared_ptr<entry>> entries;
+    once_cache_statistics statistics;
+};
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_ONCE_CACHE_H_
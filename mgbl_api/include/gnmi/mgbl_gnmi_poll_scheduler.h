@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_POLL_SCHEDULER_H_
+#define MGBL_GNMI_POLL_SCHEDULER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "gnmi/mgbl_gnmi_thread.h"
+
+namespace mgbl_api
+{
+class gnmi_subscription;
+
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Counters of a poll_scheduler.
+ */
+struct poll_scheduler_statistics
+{
+    uint64_t polls_sent = 0;      /**< Number of Poll requests written */
+    uint64_t polls_coalesced = 0; /**< Polls skipped as the previous one was still pending */
+    uint64_t polls_failed = 0;    /**< Polls refused, or expired without their snapshot */
+    uint64_t late_ticks = 0;      /**< Ticks processed after the following one was due */
+    size_t subscriptions = 0;     /**< Number of subscriptions scheduled */
+};
+
+/**
+ * @class poll_scheduler
+ * @brief Drives the snapshots of many POLL subscriptions from a single thread.
+ *
+ * The subscriptions are kept on a hashed timer wheel: every tick, the thread of the
+ * scheduler advances to the next slot and polls the subscriptions due in it, so adding,
+ * removing and firing a subscription costs O(1) whatever the number of targets. The
+ * first poll of a subscription is drawn uniformly within its interval and every
+ * following one is moved by up to `jitter` of the interval, so targets added together do
+ * not all answer at once. A subscription whose previous snapshot has not ended yet is not
+ * polled again, see `gnmi_subscription::poll`, unless it has been pending for
+ * `poll_timeout_intervals` intervals: the poll is then expired, counted as failed, and a new
+ * one is sent.
+ */
+class poll_scheduler
+{
+   public:
+    /**
+     * @brief Struct for configuring the scheduler.
+     */
+    struct options
+    {
+        static constexpr uint32_t DEFAULT_WHEEL_SLOTS = 512; /**< Default slot count */
+        std::chrono::milliseconds tick{10};         /**< Resolution of the intervals */
+        uint32_t wheel_slots = DEFAULT_WHEEL_SLOTS; /**< Number of slots of the wheel */
+        double jitter = 0.1; /**< Share of the interval each poll is moved by, in [0, 1] */
+        uint32_t poll_timeout_intervals = 3; /**< Intervals a poll may stay pending, 0 for ever */
+    };
+
+    /**
+     * @brief Starts the thread of the scheduler.
+     * If the options are not valid, an exception is thrown.
+     *
+     * @param scheduler_options The options of the scheduler.
+     * @throws std::invalid_argument if `tick` is not positive, `wheel_slots` is 0 or
+     * `jitter` is not in [0, 1].
+     */
+    explicit poll_scheduler(const options& scheduler_options);
+    poll_scheduler() : poll_scheduler(options{}) {}
+
+    poll_scheduler(const poll_scheduler&) = delete;
+    poll_scheduler& operator=(const poll_scheduler&) = delete;
+    poll_scheduler(poll_scheduler&&) = delete;
+    poll_scheduler& operator=(poll_scheduler&&) = delete;
+
+    /**
+     * @brief Stops the thread of the scheduler, the subscriptions are left running.
+     */
+    ~poll_scheduler();
+
+    /**
+     * @brief Polls a subscription every `interval`, from a random point of the first one.
+     *
+     * The subscription is started by the caller with stream_mode::POLL, before or after it
+     * is added. It is polled until it is removed, a poll failing while it is not running is
+     * only counted.
+     *
+     * @param subscription The subscription to poll.
+     * @param interval The interval between two polls, rounded up to a tick.
+     * @return The id of the schedule, used to remove it.
+     * @throws std::invalid_argument if `subscription` is null or `interval` not positive.
+     */
+    uint64_t add(std::shared_ptr<gnmi_subscription> subscription,
+                 std::chrono::milliseconds interval);
+
+    /**
+     * @brief Stops polling a subscription.
+     *
+     * A poll of the subscription running on the thread of the scheduler may still complete.
+     *
+     * @param id The id returned by `add`.
+     * @return False if the id is not scheduled.
+     */
+    bool remove(uint64_t id);
+
+    /**
+     * @brief Returns the counters of the scheduler.
+     */
+    poll_scheduler_statistics get_statistics();
+
+   private:
+    struct schedule
+    {
+        uint64_t id;
+        std::shared_ptr<gnmi_subscription> subscription;
+        uint64_t interval_ticks;
+        uint64_t due_tick;
+        uint32_t pending_intervals = 0;
+        bool removed = false;
+    };
+
+    void run();
+    void insert_locked(const std::shared_ptr<schedule>& entry, uint64_t delay_ticks);
+
+    options scheduler_options;
+    std::mutex scheduler_mtx;
+    std::condition_variable scheduler_cv;
+    std::vector<std::vector<std::shared_ptr<schedule>>> wheel;
+    std::unordered_map<uint64_t, std::shared_ptr<schedule>> schedules;
+    uint64_t current_tick = 0;
+    uint64_t next_id = 1;
+    bool stopping = false;
+    std::mt19937 random;
+    poll_scheduler_statistics statistics;
+    gnmi_thread thread;
+};
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_POLL_SCHEDULER_H_
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_RECONNECT_H_
+#define MGBL_GNMI_RECONNECT_H_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <random>
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Struct for configuring the reconnection of a stream.
+ */
+struct reconnect_policy
+{
+    bool enabled = true;                             /**< Whether the stream is reconnected */
+    std::chrono::milliseconds initial_backoff{1000}; /**< Delay before the first attempt */
+    std::chrono::milliseconds max_backoff{30000};    /**< Cap of the delay between attempts */
+    double multiplier = 2.0;                         /**< Growth of the delay, at least 1 */
+    double jitter = 0.2;       /**< Random share removed from each delay, in [0, 1] */
+    uint32_t max_attempts = 0; /**< Attempts in a row before giving up, 0 is unlimited */
+};
+
+/**
+ * @brief Reconnection counters of a stream.
+ */
+struct reconnect_statistics
+{
+    uint64_t failures = 0;   /**< Number of stream failures, including failed attempts */
+    uint64_t attempts = 0;   /**< Number of reconnection attempts */
+    uint64_t recoveries = 0; /**< Number of outages ended by a response */
+    uint64_t limited = 0;    /**< Number of attempts delayed by the reconnect_limiter */
+    uint64_t give_ups = 0;   /**< Number of outages abandoned after `max_attempts` attempts */
+    bool recovering = false; /**< Whether the stream is currently reconnecting */
+    std::chrono::milliseconds last_time_to_recover{0};  /**< Failure to first response */
+    std::chrono::milliseconds max_time_to_recover{0};   /**< Longest outage recovered */
+    std::chrono::milliseconds total_time_to_recover{0}; /**< Sum of the outages recovered */
+};
+
+/**
+ * @brief Capped exponential backoff with jitter.
+ *
+ * The n-th delay is `initial_backoff * multiplier^(n-1)`, capped by `max_backoff`, then
+ * drawn uniformly in [(1 - jitter) * delay, delay], so the streams of a fleet failing
+ * together spread their attempts instead of reconnecting in lockstep.
+ */
+class reconnect_backoff
+{
+   public:
+    /**
+     * @brief Creates the backoff of a policy.
+     *
+     * @param policy The policy of the backoff.
+     * @throws std::invalid_argument if `initial_backoff` is not positive, is above
+     * `max_backoff`, if `multiplier` is below 1 or if `jitter` is not in [0, 1].
+     */
+    explicit reconnect_backoff(const reconnect_policy& policy);
+
+    /**
+     * @brief Returns the delay before the next attempt, and counts the attempt.
+     */
+    std::chrono::milliseconds next_delay();
+
+    /**
+     * @brief Starts again from `initial_backoff`, once the stream recovered.
+     */
+    void reset();
+
+    /**
+     * @brief Number of attempts since the last reset.
+     */
+    uint32_t attempts() const
+    {
+        return attempt_count;
+    }
+
+    /**
+     * @brief Whether `max_attempts` attempts were made since the last reset.
+     */
+    bool exhausted() const
+    {
+        return policy.max_attempts != 0 && attempt_count >= policy.max_attempts;
+    }
+
+    /**
+     * @brief The policy of the backoff.
+     */
+    const reconnect_policy& get_policy() const
+    {
+        return policy;
+    }
+
+   private:
+    reconnect_policy policy;
+    double backoff_msec;
+    uint32_t attempt_count = 0;
+    std::mt19937 random;
+};
+
+/**
+ * @class reconnect_limiter
+ * @brief Process wide token bucket bounding the rate of reconnection attempts.
+ *
+ * When a whole fleet of devices goes away, every stream starts reconnecting. Each attempt
+ * takes a token, an attempt finding none is postponed to when its token is refilled, so the
+ * attempts of the process never exceed `attempts_per_second` after a burst of `burst`.
+ */
+class reconnect_limiter
+{
+   public:
+    static constexpr double DEFAULT_ATTEMPTS_PER_SECOND = 50.0; /**< Default refill rate */
+    static constexpr uint32_t DEFAULT_BURST = 50;               /**< Default bucket size */
+
+    /**
+     * @brief Creates a full bucket.
+     *
+     * @param attempts_per_second Refill rate of the bucket, 0 does not limit the attempts.
+     * @param burst Size of the bucket, at least 1.
+     */
+    reconnect_limiter(double attempts_per_second = DEFAULT_ATTEMPTS_PER_SECOND,
+                      uint32_t burst = DEFAULT_BURST);
+
+    /**
+     * @brief The limiter shared by every client of the process.
+     */
+    static reconnect_limiter& global();
+
+    /**
+     * @brief Changes the rate and the size of the bucket, and refills it.
+     *
+     * @param attempts_per_second Refill rate of the bucket, 0 does not limit the attempts.
+     * @param burst Size of the bucket, at least 1.
+     */
+    void set_limit(double attempts_per_second, uint32_t burst);
+
+    /**
+     * @brief Takes a token for one attempt.
+     *
+     * The token is reserved even when the bucket is empty, so postponed attempts are
+     * admitted in order without asking again.
+     *
+     * @return 0 if the attempt can run now, otherwise the delay until its token is refilled.
+     */
+    std::chrono::milliseconds acquire();
+
+   private:
+    std::mutex limiter_mtx;
+    double rate;
+    double capacity;
+    double tokens;
+    std::chrono::steady_clock::time_point last_refill;
+};
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_RECONNECT_H_
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_SUBSCRIPTION_H_
+#define MGBL_GNMI_SUBSCRIPTION_H_
+
+#include <grpcpp/grpcpp.h>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "gnmi/mgbl_gnmi_executor.h"
+#include "mgbl_api.h"
+#include "pbr/mgbl_pbr.h"
+#include "rpc/mgbl_rpc.h"
+
+namespace mgbl_api
+{
+class GnmiClientDetails;
+class gnmi_subscribe_call;
+
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @class gnmi_subscription
+ * @brief One Subscribe RPC of a GnmiClient, with its own counters, mode and handlers.
+ *
+ * gNMI allows a single SubscribeRequest per Subscribe RPC, so every subscription runs its
+ * own RPC and grpc::ClientContext. The subscriptions of a client share its stub, so their
+ * RPCs are multiplexed on the HTTP/2 transport of the channel, and are driven by the
+ * gnmi_async_engine of the client. Subscriptions are created with `GnmiClient::subscribe`.
+ */
+class gnmi_subscription
+{
+   public:
+    /**
+     * @brief Creates an idle subscription on the stub and engine of a client.
+     *
+     * @param client The details of the client the subscription belongs to.
+     * @param interface The counters whose paths are subscribed and which receive the stats.
+     */
+    gnmi_subscription(std::shared_ptr<GnmiClientDetails> client,
+                      std::shared_ptr<GnmiCounters> interface);
+
+    gnmi_subscription(const gnmi_subscription&) = delete;
+    gnmi_subscription& operator=(const gnmi_subscription&) = delete;
+    gnmi_subscription(gnmi_subscription&&) = delete;
+    gnmi_subscription& operator=(gnmi_subscription&&) = delete;
+
+    /**
+     * @brief Cancels the RPC and waits for it to finish.
+     *
+     * Must not run from within a handler of the subscription, whose RPC would still hold it,
+     * the process is then terminated after logging an error. Close it from the handler and
+     * destroy it from another thread instead.
+     */
+    ~gnmi_subscription() noexcept
+    {
+        if (called_from_handler())
+        {
+            logger_manager::get_instance().log("gnmi_subscription destroyed from its own handler",
+                                               log_level::ERROR);
+            std::terminate();
+        }
+        close();
+    }
+
+    /**
+     * @brief Sets the handler called when the RPC of the subscription fails.
+     *
+     * It is not called when the subscription is closed. Must be called before `start`.
+     *
+     * @param handler The failed handler.
+     */
+    void set_rpc_failed_handler(std::function<void(grpc::Status)> handler)
+    {
+        rpc_failed_handler = std::move(handler);
+    }
+
+    /**
+     * @brief Sets the handler called after a response is received and added to the counters.
+     *
+     * Must be called before `start`.
+     *
+     * @param handler The success handler.
+     */
+    void set_rpc_success_handler(std::function<void(std::shared_ptr<GnmiCounters>)> handler)
+    {
+        rpc_success_handler = std::move(handler);
+    }
+
+    /**
+     * @brief Starts the RPC of the subscription and sends its request.
+     *
+     * The mode and the sample interval are taken from `rpc_args`. A subscription sends a
+     * single SubscribeRequest, besides the Poll requests of `poll`, it can only be started
+     * again once its RPC is finished, which includes from its failed handler.
+     *
+     * The handlers run on a strand of the handler executor of the client, if it has one,
+     * so the subscriptions of a client are handled concurrently. Otherwise they run on
+     * a poller thread of the engine.
+     *
+     * @param context_args The context arguments for the RPC.
+     * @param rpc_args The subscription rpc metadata.
+     * @return error_code::CLIENT_TYPE_FAILURE for a counter type other than pbr,
+     * error_code::RPC_FAILURE if the RPC is already running.
+     */
+    error_code start(const client_context_args& context_args, const rpc_args& rpc_args);
+
+    /**
+     * @brief Cancels the RPC of the subscription and waits until it is finished.
+     *
+     * The other subscriptions of the client are not affected. No handler runs after
+     * this call returns, unless it is called from within a handler, where it only cancels.
+     *
+     * @return An error_code.
+     */
+    error_code close();
+
+    /**
+     * @brief Whether the RPC of the subscription is started and not finished.
+     */
+    bool is_active();
+
+    /**
+     * @brief Asks the target of a POLL subscription for a snapshot on its open RPC.
+     *
+     * The snapshot ends with a sync_response. A poll requested before the previous one
+     * ended is coalesced into it, the target is not asked twice for the same snapshot. The
+     * sync_response ending the initial updates of the RPC does not end a poll, only the next
+     * one does. A target that never answers leaves the poll pending, see `expire_poll`.
+     *
+     * @return error_code::RPC_FAILURE if the RPC is not running in stream_mode::POLL.
+     */
+    error_code poll();
+
+    /**
+     * @brief Whether a poll was sent and its sync_response is not received yet.
+     */
+    bool is_poll_pending();
+
+    /**
+     * @brief Gives up on the pending poll, so the next `poll` asks the target again.
+     *
+     * A sync_response still received for the expired poll ends the next one early.
+     *
+     * @return False if no poll was pending.
+     */
+    bool expire_poll();
+
+   private:
+    bool on_response(const gnmi::SubscribeResponse& response);
+    void on_finish(const grpc::Status& status);
+    void run_handler(std::function<void()> handler);
+    bool called_from_handler();
+
+    std::shared_ptr<GnmiClientDetails> client;
+    std::shared_ptr<GnmiCounters> interface;
+    std::function<void(grpc::Status)> rpc_failed_handler;
+    std::function<void(std::shared_ptr<GnmiCounters>)> rpc_success_handler;
+
+    std::mutex subscription_mtx;
+    std::shared_ptr<gnmi_subscribe_call> call;
+    bool running = false;
+    stream_mode mode = stream_mode::STREAM;
+    bool poll_pending = false;
+    bool awaiting_initial_sync = false;
+    std::shared_ptr<const pbr_subscription_plan> plan;
+    std::shared_ptr<work_stealing_executor> handler_executor;
+    std::shared_ptr<executor_strand> handler_strand;
+};
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_SUBSCRIPTION_H_
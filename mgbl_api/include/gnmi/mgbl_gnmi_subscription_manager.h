@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_SUBSCRIPTION_MANAGER_H_
+#define MGBL_GNMI_SUBSCRIPTION_MANAGER_H_
+
+#include <grpcpp/grpcpp.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "gnmi/mgbl_gnmi_async_engine.h"
+#include "gnmi/mgbl_gnmi_reconnect.h"
+#include "mgbl_api.h"
+#include "pbr/mgbl_pbr.h"
+#include "rpc/mgbl_rpc.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Consistent hash ring mapping names onto a fixed number of shards.
+ *
+ * Every shard is placed on the ring `virtual_nodes` times, a name belongs to the
+ * first shard found clockwise from its hash. Changing the shard count only moves
+ * the names of the ring segments that changed owner.
+ */
+class consistent_hash_ring
+{
+   public:
+    static constexpr uint32_t DEFAULT_VIRTUAL_NODES = 64; /**< Default points per shard */
+
+    /**
+     * @brief Places every shard on the ring.
+     *
+     * @param shards Number of shards, must not be 0.
+     * @param virtual_nodes Number of points of each shard on the ring, must not be 0.
+     * @throws std::invalid_argument if `shards` or `virtual_nodes` is 0.
+     */
+    consistent_hash_ring(uint32_t shards, uint32_t virtual_nodes = DEFAULT_VIRTUAL_NODES);
+
+    /**
+     * @brief Returns the shard owning the given name.
+     *
+     * @param name The name to look up, typically a target name.
+     * @return The index of the shard, in [0, shards).
+     */
+    uint32_t shard_of(const std::string& name) const;
+
+    /**
+     * @brief Stable 64 bits FNV-1a hash used to place names and shards on the ring.
+     */
+    static uint64_t hash(const std::string& value);
+
+   private:
+    std::map<uint64_t, uint32_t> ring;
+};
+
+/**
+ * @brief Struct describing one device handled by the gnmi_subscription_manager.
+ */
+struct gnmi_target
+{
+    std::string name;                   /**< Unique name of the target, used for sharding */
+    rpc_channel_args channel_args;      /**< Channel arguments of the target */
+    client_context_args context_args;   /**< Context arguments of the target streams */
+    std::vector<PBRBase::pbr_key> keys; /**< The policy and rule combinations to subscribe */
+};
+
+/**
+ * @brief Statistics of one shard of the gnmi_subscription_manager.
+ */
+struct shard_statistics
+{
+    uint32_t targets = 0;             /**< Number of targets owned by the shard */
+    uint64_t samples = 0;             /**< Number of samples delivered */
+    uint64_t failures = 0;            /**< Number of stream failures */
+    uint64_t retries = 0;             /**< Number of reconnection attempts */
+    double samples_per_second = 0.0;  /**< Samples delivered per second since start */
+    double handler_utilization = 0.0; /**< Share of the elapsed time spent in success handlers */
+};
+
+/**
+ * @brief Aggregated statistics of the gnmi_subscription_manager.
+ */
+struct subscription_manager_statistics
+{
+    std::vector<shard_statistics> shards; /**< Statistics of each shard */
+    shard_statistics total;               /**< Sum of the statistics of every shard */
+    double elapsed_seconds = 0.0;         /**< Seconds elapsed since `start` */
+};
+
+/**
+ * @class gnmi_subscription_manager
+ * @brief Owns the connections, the streams and the retries of many targets.
+ *
+ * The targets are sharded over `shards` event loops by consistent hash of their
+ * name. Each event loop is a gnmi_async_engine with a single poller thread, so all
+ * handlers and retries of a target run on the same thread, and the load of a shard
+ * can be read from its statistics to size the collector per core.
+ *
+ * A target whose stream fails with another status than CANCELLED is reconnected by its
+ * client according to the `reconnect` policy, see `GnmiClient::set_reconnect_policy`.
+ */
+class gnmi_subscription_manager
+{
+   public:
+    /**
+     * @brief Struct for configuring the manager.
+     */
+    struct options
+    {
+        uint32_t shards = 1; /**< Number of event loop threads */
+        uint32_t virtual_nodes_per_shard =
+            consistent_hash_ring::DEFAULT_VIRTUAL_NODES; /**< Points of each shard on the ring */
+        reconnect_policy reconnect; /**< Reconnection of the stream of every target */
+    };
+
+    using success_handler =
+        std::function<void(const std::string& target, std::shared_ptr<GnmiCounters> counters)>;
+    using failed_handler = std::function<void(const std::string& target, grpc::Status status)>;
+
+    /**
+     * @brief Creates the event loops and a client for every target.
+     * If the arguments are not valid, an exception is thrown.
+     *
+     * @param targets The targets to subscribe to.
+     * @param args The subscription rpc metadata shared by every target.
+     * @param manager_options The options of the manager.
+     * @throws std::invalid_argument if `shards` is 0, if two targets have the same name, if
+     * the channel arguments of a target or the reconnect policy are not valid.
+     */
+    gnmi_subscription_manager(std::vector<gnmi_target> targets, const rpc_args& args,
+                              const options& manager_options);
+
+    gnmi_subscription_manager(const gnmi_subscription_manager&) = delete;
+    gnmi_subscription_manager& operator=(const gnmi_subscription_manager&) = delete;
+    gnmi_subscription_manager(gnmi_subscription_manager&&) = delete;
+    gnmi_subscription_manager& operator=(gnmi_subscription_manager&&) = delete;
+
+    /**
+     * @brief Stops every stream and the event loops.
+     */
+    ~gnmi_subscription_manager();
+
+    /**
+     * @brief Sets the handler called on the shard thread for every sample of a target.
+     * Must be set before `start`.
+     */
+    void set_success_handler(success_handler handler)
+    {
+        on_success = std::move(handler);
+    }
+
+    /**
+     * @brief Sets the handler called on the shard thread when the stream of a target fails
+     * and is not reconnected. Must be set before `start`.
+     */
+    void set_failed_handler(failed_handler handler)
+    {
+        on_failure = std::move(handler);
+    }
+
+    /**
+     * @brief Subscribes to every target.
+     *
+     * @return error_code::SUCCESS if every subscription was sent, the first error otherwise.
+     */
+    error_code start();
+
+    /**
+     * @brief Cancels the pending reconnections and closes every stream. This is a blocking call.
+     */
+    void stop();
+
+    /**
+     * @brief Returns the shard owning the given target.
+     */
+    uint32_t shard_of(const std::string& target) const
+    {
+        return ring.shard_of(target);
+    }
+
+    /**
+     * @brief Returns the counters of the given target, or nullptr if it is unknown.
+     *
+     * The counters are live: the event loop of the shard owning the target appends to them
+     * while its stream is open. Read them only from the success handler of the target, which
+     * runs on that shard, or after stop().
+     */
+    std::shared_ptr<PBRBasic> get_counters(const std::string& target) const;
+
+    /**
+     * @brief Returns the throughput of every shard and of the whole manager.
+     */
+    subscription_manager_statistics get_statistics() const;
+
+   private:
+    struct shard;
+    struct target_state;
+
+    consistent_hash_ring ring;
+    rpc_args subscription_args;
+    options manager_options;
+    success_handler on_success;
+    failed_handler on_failure;
+    std::vector<std::unique_ptr<shard>> shards;
+    std::vector<std::unique_ptr<target_state>> target_states;
+    std::map<std::string, target_state*> targets_by_name;
+    std::chrono::steady_clock::time_point start_time;
+    bool started = false;
+    bool stopped = false;
+};
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_SUBSCRIPTION_MANAGER_H_
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_SWEEP_H_
+#define MGBL_GNMI_SWEEP_H_
+
+#include <grpcpp/grpcpp.h>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "gnmi/mgbl_gnmi_async_engine.h"
+#include "gnmi/mgbl_gnmi_subscription_manager.h"
+#include "mgbl_api.h"
+#include "pbr/mgbl_pbr.h"
+#include "rpc/mgbl_rpc.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Outcome of the once request of one target of a gnmi_sweep.
+ */
+struct sweep_result
+{
+    std::string target;                 /**< Name of the target */
+    error_code code = error_code::SUCCESS; /**< Error code of the request */
+    grpc::Status status;                /**< Final status of the RPC */
+    std::shared_ptr<PBRBasic> counters; /**< Counters of the target, holding its stats */
+    std::chrono::nanoseconds latency{0}; /**< Time from sending the request to its end */
+};
+
+/**
+ * @brief Latency distribution of one run of a gnmi_sweep.
+ */
+struct sweep_statistics
+{
+    size_t targets = 0;                  /**< Number of targets swept */
+    size_t succeeded = 0;                /**< Targets whose request succeeded */
+    size_t failed = 0;                   /**< Targets whose request failed or timed out */
+    std::chrono::nanoseconds elapsed{0}; /**< Duration of the whole sweep */
+    std::chrono::nanoseconds min{0};     /**< Lowest latency of a target */
+    std::chrono::nanoseconds p50{0};     /**< Median latency of the targets */
+    std::chrono::nanoseconds p90{0};     /**< 90th percentile of the latencies */
+    std::chrono::nanoseconds p99{0};     /**< 99th percentile of the latencies */
+    std::chrono::nanoseconds max{0};     /**< Highest latency of a target */
+};
+
+/**
+ * @class gnmi_sweep
+ * @brief Collects the counters of many targets with concurrent once requests.
+ *
+ * Every run sends a subscribe once request to each target, at most `max_in_flight` of
+ * them at a time, each bounded by `target_timeout`. The requests are driven by a
+ * gnmi_async_engine, so a sweep over thousands of targets needs neither a thread per
+ * target nor one target after the other. The results are handed over as the targets
+ * answer, and the run ends with the latency distribution of the sweep.
+ */
+class gnmi_sweep
+{
+   public:
+    /**
+     * @brief Struct for configuring the sweep.
+     */
+    struct options
+    {
+        static constexpr size_t DEFAULT_MAX_IN_FLIGHT = 64; /**< Default concurrent requests */
+        size_t max_in_flight = DEFAULT_MAX_IN_FLIGHT; /**< Requests in flight at a time */
+        std::chrono::milliseconds target_timeout{10000}; /**< Deadline of every request */
+        std::shared_ptr<gnmi_async_engine> engine; /**< Engine of the requests, nullptr for
+                                                        the default engine */
+    };
+
+    using result_handler = std::function<void(const sweep_result& result)>;
+
+    /**
+     * @brief Creates a client for every target.
+     * If the arguments are not valid, an exception is thrown.
+     *
+     * @param targets The targets to sweep, their context arguments are used for the requests.
+     * @param sweep_options The options of the sweep.
+     * @throws std::invalid_argument if `max_in_flight` is 0, `target_timeout` is not positive,
+     * two targets have the same name or the channel arguments of a target are not valid.
+     */
+    gnmi_sweep(std::vector<gnmi_target> targets, const options& sweep_options);
+
+    gnmi_sweep(const gnmi_sweep&) = delete;
+    gnmi_sweep& operator=(const gnmi_sweep&) = delete;
+    gnmi_sweep(gnmi_sweep&&) = delete;
+    gnmi_sweep& operator=(gnmi_sweep&&) = delete;
+
+    ~gnmi_sweep();
+
+    /**
+     * @brief Sweeps every target once. This is a blocking call.
+     *
+     * The stats of the previous run are cleared first. `on_result` is called once per
+     * target as soon as its request ends, from the thread running the handlers of its
+     * client; the calls are serialized, so the handler needs no lock of its own.
+     *
+     * @param args The subscription rpc metadata shared by every target. With `negotiate`, the
+     * capabilities of every target are fetched on the calling thread before the requests are
+     * sent, each within `target_timeout`. A target whose Capabilities RPC fails is reported
+     * with error_code::RPC_FAILURE without sending its request.
+     * @param on_result Handler called with the result of every target, may be empty.
+     * @return The latency distribution of the sweep.
+     */
+    sweep_statistics run(const rpc_args& args, result_handler on_result);
+
+    /**
+     * @brief Returns the counters of the given target, or nullptr if it is unknown.
+     */
+    std::shared_ptr<PBRBasic> get_counters(const std::string& target) const;
+
+   private:
+    struct target_state;
+    struct run_state;
+
+    void launch(const std::shared_ptr<run_state>& state);
+    void complete(const std::shared_ptr<run_state>& state, target_state& target, error_code code,
+                  grpc::Status status);
+
+    options sweep_options;
+    std::mutex run_mtx;
+    std::vector<std::unique_ptr<target_state>> target_states;
+};
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_SWEEP_H_
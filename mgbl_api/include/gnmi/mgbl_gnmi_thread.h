@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_THREAD_H_
+#define MGBL_GNMI_THREAD_H_
+
+#include <pthread.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief What a thread created by the library is used for.
+ */
+enum class thread_role
+{
+    POLLER,   /**< Poller thread of a gnmi_async_engine */
+    WORKER,   /**< Worker thread of a work_stealing_executor */
+    CLOSER,   /**< Thread finishing the asynchronous stream closes */
+    SCHEDULER /**< Thread of a poll_scheduler */
+};
+
+/**
+ * @brief Scheduling policy of the threads created by the library.
+ */
+enum class thread_scheduling
+{
+    INHERIT,    /**< Same policy and priority as the creating thread */
+    OTHER,      /**< SCHED_OTHER, `priority` is the nice value of the thread */
+    FIFO,       /**< SCHED_FIFO real time policy, usually requires CAP_SYS_NICE */
+    ROUND_ROBIN /**< SCHED_RR real time policy, usually requires CAP_SYS_NICE */
+};
+
+/**
+ * @brief Struct for configuring the threads of one role.
+ */
+struct thread_options
+{
+    std::string name;           /**< Name of the threads, followed by their index */
+    std::vector<uint32_t> cpus; /**< CPUs the threads may run on, empty for any CPU */
+    thread_scheduling scheduling = thread_scheduling::INHERIT; /**< Scheduling policy */
+    int priority = 0;      /**< Real time priority, or nice value for OTHER */
+    size_t stack_size = 0; /**< Stack size in bytes, 0 for the default of the system */
+};
+
+/**
+ * @class gnmi_thread
+ * @brief Handle of a thread created by the thread_factory.
+ *
+ * Like std::thread, it must be joined or detached before it is destroyed. It exists as
+ * std::thread cannot be given a stack size or a scheduling policy at creation.
+ */
+class gnmi_thread
+{
+   public:
+    gnmi_thread() = default;
+    gnmi_thread(const gnmi_thread&) = delete;
+    gnmi_thread& operator=(const gnmi_thread&) = delete;
+    gnmi_thread(gnmi_thread&& other) noexcept;
+    gnmi_thread& operator=(gnmi_thread&& other) noexcept;
+    ~gnmi_thread();
+
+    /**
+     * @brief Whether the thread is running or finished, and not joined nor detached yet.
+     */
+    bool joinable() const
+    {
+        return started;
+    }
+
+    /**
+     * @brief Waits for the thread to exit.
+     */
+    void join();
+
+    /**
+     * @brief Lets the thread release its resources on exit, without being joined.
+     */
+    void detach();
+
+    /**
+     * @brief Whether the calling thread is this thread.
+     */
+    bool is_current() const;
+
+   private:
+    friend class thread_factory;
+
+    pthread_t handle{};
+    bool started = false;
+};
+
+/**
+ * @class thread_factory
+ * @brief Creates every thread of the library, with the options of its role.
+ *
+ * Collectors sharing a host with latency sensitive processes can pin the poller and worker
+ * threads to dedicated CPUs, name them for `top -H` and `perf`, and change their priority
+ * and stack size. The options of a role apply to the threads created after they are set,
+ * so they are set before the first client, engine or executor is created. The threads
+ * created by gRPC itself are not covered.
+ */
+class thread_factory
+{
+   public:
+    /**
+     * @brief Gets the singleton instance of the thread_factory.
+     *
+     * @return The singleton instance of the thread_factory.
+     */
+    static thread_factory& get_instance();
+
+    /**
+     * @brief Sets the options of the threads of a role created from now on.
+     *
+     * @param role The role of the threads.
+     * @param options The options of the threads.
+     * @throws std::invalid_argument if a CPU does not exist or if the priority is out of
+     * the range of the scheduling policy.
+     */
+    void set_options(thread_role role, const thread_options& options);
+
+    /**
+     * @brief Returns the options of the threads of a role.
+     */
+    thread_options get_options(thread_role role);
+
+    /**
+     * @brief Sets a hook called at the start of every new thread, before its work.
+     *
+     * The hook runs on the new thread once its options are applied, with the role and the
+     * index of the thread within its engine or executor, for placements the options do not
+     * cover. nullptr removes the hook.
+     *
+     * @param hook The hook.
+     */
+    void set_start_hook(std::function<void(thread_role, uint32_t)> hook);
+
+    /**
+     * @brief Creates a thread of the given role, running `body`.
+     *
+     * A scheduling policy refused by the system is logged, and the thread is created with
+     * the inherited one. Affinity, name or nice value failures are logged as well.
+     *
+     * @param role The role of the thread.
+     * @param index The index of the thread within its engine or executor.
+     * @param body The work of the thread.
+     * @return The handle of the thread.
+     * @throws std::system_error if the thread cannot be created.
+     */
+    gnmi_thread create(thread_role role, uint32_t index, std::function<void()> body);
+
+   private:
+    thread_factory();
+
+    std::mutex factory_mtx;
+    std::vector<thread_options> role_options;
+    std::function<void(thread_role, uint32_t)> start_hook;
+};
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_THREAD_H_
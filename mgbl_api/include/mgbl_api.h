@@ -19,6 +19,7 @@
 #ifndef MGBL_API_H_
 #define MGBL_API_H_
 
+#include <map>
 #include <memory>
 #include <mutex>
 #include <nlohmann/json.hpp>
@@ -66,6 +67,47 @@ class IPbrStat
     virtual ~IPbrStat() = default;
 };
 
+/**
+ * @brief Read-only view over contiguous statistics, valid only during the call it is passed to.
+ *
+ * @param T The statistics type.
+ */
+template <typename T>
+class stat_span
+{
+   public:
+    stat_span(const T* data, size_t size) : first(data), count(size) {}
+
+    const T* begin() const
+    {
+        return first;
+    }
+    const T* end() const
+    {
+        return first + count;
+    }
+    const T* data() const
+    {
+        return first;
+    }
+    size_t size() const
+    {
+        return count;
+    }
+    bool empty() const
+    {
+        return count == 0;
+    }
+    const T& operator[](size_t index) const
+    {
+        return first[index];
+    }
+
+   private:
+    const T* first;
+    size_t count;
+};
+
 /**
  * @brief PBRBase class is the base
  * class for all the PBR statistics that are to be implemented.
@@ -87,8 +129,10 @@ class PBRBase : public GnmiCounters
      */
     struct pbr_key
     {
-        std::string key_policy; /**< The policy key */
-        std::string key_rule;   /**< The rule key */
+        std::string key_policy;            /**< The policy key */
+        std::string key_rule;              /**< The rule key */
+        std::string key_class{};           /**< Class of the key, empty for none */
+        uint64_t sample_interval_nsec = 0; /**< 0 for the interval of the class or rpc_args */
     };
 
     std::vector<pbr_key> keys;
@@ -97,6 +141,14 @@ class PBRBase : public GnmiCounters
     virtual std::shared_ptr<IPbrStat> unordered_map_to_stats(
         const std::unordered_map<std::string, std::string>& map) = 0;
     std::vector<std::string> get_gnmi_paths() const override;
+    /**
+     * @brief Sample interval of every key, in the order of `get_gnmi_paths`.
+     *
+     * @param class_intervals The sample interval of every key class.
+     * @return The interval of the key, else the one of its class, else 0.
+     */
+    std::vector<uint64_t> get_sample_intervals(
+        const std::map<std::string, uint64_t>& class_intervals) const;
     virtual void add_stats(std::shared_ptr<pbr_stat> stat) = 0;
 };
 /** @} */
@@ -20,8 +20,13 @@
 #define MGBL_PBR_H_
 
 #include <grpcpp/grpcpp.h>
+#include <chrono>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "gnmi/mgbl_gnmi_helper.h"
 #include "mgbl_api.h"
 
@@ -55,6 +60,10 @@ class PbrBasicStat : public IPbrStat
     uint64_t collection_timestamp_nanoseconds = 0; /**< The collection timestamp in nanoseconds */
     std::string path_grp_name;                     /**< The path group name */
     std::string policy_action_type;                /**< The policy action type */
+    bool has_counters = false;     /**< Whether the response carried a fib-stats counter */
+    bool has_byte_count = false;   /**< Whether the response carried byte_count */
+    bool has_packet_count = false; /**< Whether the response carried packet_count */
+    bool has_action = false;       /**< Whether the response carried the paction leaves */
 };
 
 /**
@@ -103,6 +112,140 @@ class PBRBasic final : public PBRBase
 
     // internal_error_code set_specific_data(std::string printed_path, IPbrStat& pbr_stat) final;
 };
+
+/**
+ * @brief Paths subscribed for the keys of pbr counters, see `plan_subscription`.
+ */
+struct pbr_subscription_plan
+{
+    std::vector<std::string> paths;              /**< Paths to subscribe, in the order of keys */
+    std::vector<uint64_t> sample_intervals_nsec; /**< Interval of every path, 0 for rpc_args */
+    std::unordered_map<std::string, std::unordered_set<std::string>>
+        filtered_rules; /**< Wanted rules of the wildcarded policies which have others */
+    size_t key_paths = 0; /**< Paths without the planner, one per key */
+
+    /**
+     * @brief Number of paths saved by the wildcards.
+     */
+    size_t saved_paths() const
+    {
+        return key_paths - paths.size();
+    }
+
+    /**
+     * @brief Whether a received rule is one of the keys, rather than one of a wildcard.
+     *
+     * @param policy_name The policy name.
+     * @param rule_name The rule name.
+     */
+    bool is_wanted(const std::string& policy_name, const std::string& rule_name) const;
+};
+
+/**
+ * @brief Plans the paths subscribed for the keys of pbr counters.
+ *
+ * Without `rpc_args::planner`, every key has its own path. Otherwise the policies selected by
+ * the planner options are subscribed with a wildcard rule, and the plan tells which of the
+ * rules received are wanted.
+ *
+ * @param counters The counters whose keys are subscribed.
+ * @param rpc_args The subscription rpc metadata, with the planner options and key classes.
+ * @return The plan of the paths.
+ */
+pbr_subscription_plan plan_subscription(const PBRBase& counters, const rpc_args& rpc_args);
+
+/**
+ * @brief When a counter of a pbr_latest_value was last received.
+ */
+struct pbr_counter_time
+{
+    uint64_t collection_nsec = 0;                   /**< Collection timestamp, 0 if not sent */
+    std::chrono::steady_clock::time_point received; /**< Arrival time */
+};
+
+/**
+ * @brief Latest value and rates of one pbr rule and policy combination.
+ */
+struct pbr_latest_value
+{
+    PbrBasicStat stat;              /**< Latest value of every field received */
+    double bytes_per_second = 0;   /**< Rate of byte_count over the last change */
+    double packets_per_second = 0; /**< Rate of packet_count over the last change */
+    uint64_t updates = 0;          /**< Number of stats merged */
+    std::chrono::steady_clock::time_point last_counters; /**< When counters were last received */
+    pbr_counter_time byte_count_time;   /**< When byte_count was last received */
+    pbr_counter_time packet_count_time; /**< When packet_count was last received */
+};
+
+/**
+ * @class pbr_latest_values
+ * @brief Latest value state of the pbr rules, built from partial and suppressed updates.
+ *
+ * Stats are merged by policy and rule: each counter is only replaced by a stat which
+ * carried it, and the action only by a stat which carried it, so the stats of the
+ * paths of `rpc_args::path_modes`, or of single leaves, complete each other.
+ *
+ * With `suppress_redundant`, a device samples the counters every sample interval but
+ * only sends them when they changed. A missing update then means "unchanged": the
+ * counters received after a silence are known to have moved within the last sample
+ * interval, so the rates are computed over that interval instead of the whole silence,
+ * and a rule without update for two sample intervals has rates of 0.
+ */
+class pbr_latest_values
+{
+   public:
+    /**
+     * @brief Creates an empty state.
+     *
+     * @param sample_interval The sample interval of the subscription when it suppresses
+     * redundant updates, 0 if every sample is sent.
+     */
+    explicit pbr_latest_values(
+        std::chrono::nanoseconds sample_interval = std::chrono::nanoseconds(0));
+
+    /**
+     * @brief Merges a stat into the latest value of its rule.
+     *
+     * @param stat The stat, possibly carrying only some of the fields.
+     */
+    void merge(const PbrBasicStat& stat);
+
+    /**
+     * @brief Merges stats into the latest values of their rules.
+     *
+     * @param stats The stats, e.g. the batch of a batch handler.
+     */
+    void merge(stat_span<PbrBasicStat> stats);
+
+    /**
+     * @brief Returns the latest value of a rule.
+     *
+     * @param policy_name The policy name.
+     * @param rule_name The rule name.
+     * @param value Set to the latest value, with the rates as of now.
+     * @return False if nothing was received for the rule.
+     */
+    bool get(const std::string& policy_name, const std::string& rule_name,
+             pbr_latest_value* value);
+
+    /**
+     * @brief Returns the latest values of every rule, with the rates as of now.
+     */
+    std::vector<pbr_latest_value> snapshot();
+
+    /**
+     * @brief Number of rules with a latest value.
+     */
+    size_t size();
+
+   private:
+    pbr_latest_value current_locked(const pbr_latest_value& value,
+                                    std::chrono::steady_clock::time_point now) const;
+
+    std::chrono::nanoseconds sample_interval;
+    std::mutex values_mtx;
+    std::unordered_map<std::string, pbr_latest_value> values;
+};
 /** @} */  // end of pbr
 }  // namespace mgbl_api
 #endif  // MGBL_PRB_H_
\ No newline at end of file
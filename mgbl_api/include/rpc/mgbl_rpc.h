@@ -21,7 +21,12 @@
 
 #include <grpcpp/grpcpp.h>
 
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
 #include <utility>
+#include <vector>
 #include "gnmi.grpc.pb.h"
 
 namespace mgbl_api
@@ -50,7 +55,43 @@ enum class error_code
 enum class stream_mode
 {
     STREAM, /**< STREAM Stream mode*/
-    ONCE    /**< ONCE Once mode*/
+    ONCE,   /**< ONCE Once mode*/
+    POLL    /**< POLL Poll mode, snapshots are sent on the Poll requests of the client*/
+};
+
+/**
+ * @brief Struct for tuning the HTTP/2 transport of a channel.
+ *
+ * Every knob left at its default keeps the value chosen by gRPC. The defaults suit small
+ * requests: a 4 MiB limit on received messages rejects large wildcard responses, and the
+ * 64 KiB initial window throttles a stream until the bandwidth delay probe grows it.
+ */
+struct channel_tuning
+{
+    int max_receive_message_size = 0; /**< Bytes, 0 for the gRPC default, -1 for no limit */
+    int max_send_message_size = 0;    /**< Bytes, 0 for the gRPC default, -1 for no limit */
+    int http2_stream_window = 0;      /**< Initial HTTP/2 window of a stream, 0 for default */
+    int http2_max_frame_size = 0;     /**< Largest HTTP/2 frame accepted, 0 for default */
+    int http2_write_buffer_size = 0;  /**< Bytes buffered before a write, 0 for default */
+    bool http2_bdp_probe = true; /**< Whether windows grow with the bandwidth delay product */
+    std::chrono::milliseconds keepalive_time{0};    /**< Ping interval, 0 for no keepalive */
+    std::chrono::milliseconds keepalive_timeout{0}; /**< Ping ack timeout, 0 for default */
+    bool keepalive_permit_without_calls = false; /**< Whether to ping without an active RPC */
+    int http2_max_pings_without_data = -1; /**< Pings without data, 0 for any, -1 for default */
+    std::chrono::milliseconds initial_reconnect_backoff{0}; /**< 0 for the gRPC default */
+    std::chrono::milliseconds min_reconnect_backoff{0};     /**< 0 for the gRPC default */
+    std::chrono::milliseconds max_reconnect_backoff{0};     /**< 0 for the gRPC default */
+    size_t buffer_pool_bytes = 0; /**< Memory quota of the channel buffers, 0 for no quota */
+
+    /**
+     * @brief Returns the tuning suggested for high throughput telemetry.
+     *
+     * Accepts responses up to 64 MiB, starts streams with a 4 MiB window and 1 MiB frames so
+     * a wildcard response is not throttled by the first round trips, detects dead
+     * connections within 80 seconds without pinging idle channels, and lowers the gRPC
+     * reconnect backoff to 5 seconds, so the reconnect_policy of the clients drives it.
+     */
+    static channel_tuning high_throughput();
 };
 
 /**
@@ -63,6 +104,8 @@ struct rpc_channel_args
     std::string pem_roots_certs_path; /**< Root certificates for SSL */
     std::string pem_private_key_path; /**< Private key for SSL */
     std::string pem_cert_chain_path;  /**< Certificate chain for SSL */
+    channel_tuning tuning;            /**< Tuning of the HTTP/2 transport */
+    uint32_t pool_subchannels = 0;    /**< Pooled channels of the target, 0 for its own */
 
     rpc_channel_args() = default;
     rpc_channel_args(std::string address, bool tls)
@@ -91,6 +134,47 @@ struct client_context_args
     std::chrono::system_clock::time_point deadline; /**< The deadline for the RPC call */
 };
 
+/**
+ * @enum subscription_mode
+ * @brief Enum for specifying how the target sends the updates of a path in STREAM mode.
+ */
+enum class subscription_mode
+{
+    SAMPLE,        /**< Every sample interval */
+    ON_CHANGE,     /**< When a value changes, and every heartbeat interval if set */
+    TARGET_DEFINED /**< Chosen by the target for every leaf */
+};
+
+/**
+ * @brief Struct for configuring the subscription of the paths below every key.
+ *
+ * Lets the counters leaves be sampled while the configuration like leaves of the same
+ * keys are only sent when they change. A relative path which is not a valid gNMI path fails
+ * the request with error_code::CLIENT_TYPE_FAILURE.
+ */
+struct path_subscription
+{
+    std::string relative_path; /**< Path below the path of every key, e.g. "fib-stats" */
+    subscription_mode mode = subscription_mode::SAMPLE; /**< How the target sends updates */
+    uint64_t sample_interval_nsec = 0;    /**< 0 for the sample interval of the rpc_args */
+    uint64_t heartbeat_interval_nsec = 0; /**< Resend interval of unchanged values, 0 for none */
+    bool suppress_redundant = false; /**< Whether SAMPLE skips the values unchanged since sent */
+};
+
+/**
+ * @brief Struct for configuring how the keys of a request are compressed into wildcard paths.
+ *
+ * All the rules of a policy are subscribed with a single `rule-name[rule-name=*]` path when
+ * the keys of the policy share one sample interval, and either every rule of the policy is
+ * wanted according to `rules_per_policy`, or at least `min_rules_per_wildcard` of them are.
+ * The rules received but not among the keys are dropped by the client.
+ */
+struct planner_options
+{
+    size_t min_rules_per_wildcard = 0; /**< Rules of a policy from which it is wildcarded */
+    std::map<std::string, size_t> rules_per_policy; /**< Rules of the policies on the device */
+};
+
 /**
  * @brief Struct for configuring the subscription.
  */
@@ -104,6 +188,20 @@ struct rpc_args
         gnmi::Encoding::PROTO;              /**< Encoding of the responses through the RPC call*/
     stream_mode mode = stream_mode::STREAM; /**< Type of stream */
     int rpc_type = 0;                       /**< Type of RPC call */
+    subscription_mode path_mode =
+        subscription_mode::SAMPLE;        /**< Mode of the paths of the keys without path_modes */
+    uint64_t heartbeat_interval_nsec = 0; /**< Heartbeat of the paths of the keys, 0 for none */
+    bool suppress_redundant = false; /**< Whether the paths of the keys skip unchanged values */
+    bool updates_only = false; /**< Whether the initial state is skipped, only changes are sent */
+    bool resume_updates_only = false; /**< Whether reconnections skip the initial state */
+    bool use_prefix = true; /**< Whether the paths of the keys share a SubscriptionList prefix */
+    std::vector<path_subscription>
+        path_modes; /**< Subscriptions below every key, replacing the path of the key */
+    std::map<std::string, uint64_t>
+        class_sample_intervals_nsec; /**< Sample interval of the keys of every class */
+    planner_options planner;         /**< Compression of the keys into wildcard paths */
+    bool negotiate = false; /**< Whether encoding and use_models follow the target Capabilities */
+    std::vector<gnmi::ModelData> use_models; /**< Models the paths are defined by, empty for any */
 };
 /** @} */  // end of rpc
 }  // namespace mgbl_api
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_async_engine.h"
+#include <fmt/format.h>
+#include <stdexcept>
+#include "logger/logger.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+namespace
+{
+// Engine and completion queue polled by the current thread, if any.
+thread_local const gnmi_async_engine* current_engine = nullptr;
+thread_local grpc::CompletionQueue* current_queue = nullptr;
+
+/*
+ * Poller loop, dispatches every completed tag until the queue is shut down and drained.
+ * The queue is shared with the engine so a poller detached during shutdown never
+ * touches a destroyed queue.
+ */
+void poll(const gnmi_async_engine* engine, const std::shared_ptr<grpc::CompletionQueue>& queue)
+{
+    current_engine = engine;
+    current_queue = queue.get();
+    void* tag = nullptr;
+    bool ok = false;
+    while (queue->Next(&tag, &ok))
+    {
+        static_cast<async_tag*>(tag)->proceed(ok);
+    }
+    current_engine = nullptr;
+    current_queue = nullptr;
+    logger_manager::get_instance().log("Async engine poller stopped", log_level::VERBOSE);
+}
+}  // namespace
+
+/**
+ * @brief Creates the completion queues and starts the poller threads.
+ * @param engine_options The options of the engine.
+ */
+gnmi_async_engine::gnmi_async_engine(const options& engine_options)
+{
+    if (engine_options.poller_threads == 0)
+    {
+        logger_manager::get_instance().log("Async engine needs at least one poller thread",
+                                           log_level::ERROR);
+        throw std::invalid_argument("Async engine needs at least one poller thread");
+    }
+
+    for (uint32_t i = 0; i < engine_options.poller_threads; i++)
+    {
+        completion_queues.push_back(std::make_shared<grpc::CompletionQueue>());
+    }
+    for (uint32_t i = 0; i < engine_options.poller_threads; i++)
+    {
+        auto queue = completion_queues[i];
+        pollers.push_back(thread_factory::get_instance().create(
+            thread_role::POLLER, i, [this, queue]() { poll(this, queue); }));
+    }
+}
+
+/**
+ * @brief Shuts down the completion queues and joins the poller threads.
+ */
+gnmi_async_engine::~gnmi_async_engine()
+{
+    shutdown();
+}
+
+/**
+ * @brief Returns the engine shared by every GnmiClient that is not given one explicitly.
+ */
+std::shared_ptr<gnmi_async_engine> gnmi_async_engine::default_engine()
+{
+    static std::shared_ptr<gnmi_async_engine> instance = std::make_shared<gnmi_async_engine>();
+    return instance;
+}
+
+/**
+ * @brief Picks the completion queue the next call should be bound to.
+ */
+grpc::CompletionQueue* gnmi_async_engine::next_completion_queue()
+{
+    uint32_t index = next_queue.fetch_add(1, std::memory_order_relaxed);
+    return completion_queues[index % completion_queues.size()].get();
+}
+
+/**
+ * @brief Checks whether the calling thread is one of the poller threads of this engine.
+ */
+bool gnmi_async_engine::is_poller_thread() const
+{
+    return current_engine == this;
+}
+
+/**
+ * @brief Returns the completion queue polled by the calling thread.
+ */
+grpc::CompletionQueue* gnmi_async_engine::current_completion_queue() const
+{
+    return current_engine == this ? current_queue : nullptr;
+}
+
+/**
+ * @brief Shuts down the completion queues and joins the poller threads.
+ */
+void gnmi_async_engine::shutdown()
+{
+    std::lock_guard<std::mutex> lock(shutdown_mtx);
+    if (is_shutdown)
+    {
+        return;
+    }
+    is_shutdown = true;
+
+    for (const auto& queue : completion_queues)
+    {
+        queue->Shutdown();
+    }
+    for (auto& poller : pollers)
+    {
+        // The last reference can be released from a handler running on a poller.
+        if (poller.is_current())
+        {
+            poller.detach();
+        }
+        else if (poller.joinable())
+        {
+            poller.join();
+        }
+    }
+}
+
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
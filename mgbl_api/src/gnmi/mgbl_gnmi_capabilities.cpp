@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_capabilities.h"
+#include <fmt/format.h>
+#include "logger/logger.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Gets the singleton instance of the capabilities_cache.
+ */
+capabilities_cache& capabilities_cache::get_instance()
+{
+    static capabilities_cache instance;
+    return instance;
+}
+
+/**
+ * @brief Returns the entry of a channel, creating it for its first client.
+ * @param channel The channel of the client.
+ */
+std::shared_ptr<capabilities_cache::entry> capabilities_cache::get_entry(
+    const std::shared_ptr<grpc::Channel>& channel)
+{
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    auto it = entries.find(channel.get());
+    if (it != entries.end())
+    {
+        auto cached = it->second.lock();
+        // A new channel may reuse the address of a destroyed one.
+        if (cached != nullptr && cached->channel.lock() == channel)
+        {
+            return cached;
+        }
+    }
+    for (auto expired = entries.begin(); expired != entries.end();)
+    {
+        expired = expired->second.expired() ? entries.erase(expired) : std::next(expired);
+    }
+    auto cached = std::make_shared<entry>();
+    cached->channel = channel;
+    entries[channel.get()] = cached;
+    return cached;
+}
+
+/**
+ * @brief Returns the capabilities of an entry, calling Capabilities if not fetched yet.
+ * @param cached The entry of the channel of the stub.
+ * @param stub The stub the Capabilities RPC is called on.
+ * @param context_args The context arguments of the Capabilities RPC.
+ * @param capabilities Set to the capabilities of the target on success.
+ */
+grpc::Status capabilities_cache::fetch(
+    entry& cached, gnmi::gNMI::Stub& stub, const client_context_args& context_args,
+    std::shared_ptr<const gnmi::CapabilityResponse>* capabilities)
+{
+    // Held during the RPC, so the clients of a channel wait for the first one's result.
+    std::lock_guard<std::mutex> lock(cached.fetch_mtx);
+    if (cached.value == nullptr)
+    {
+        grpc::ClientContext context;
+        context.AddMetadata("username", context_args.username);
+        context.AddMetadata("password", context_args.password);
+        if (context_args.set_deadline)
+        {
+            context.set_deadline(context_args.deadline);
+        }
+        auto response = std::make_shared<gnmi::CapabilityResponse>();
+        const grpc::Status status =
+            stub.Capabilities(&context, gnmi::CapabilityRequest(), response.get());
+        if (!status.ok())
+        {
+            logger_manager::get_instance().log(
+                fmt::format("Capabilities RPC failed: {}", status.error_message()),
+                log_level::ERROR);
+            return status;
+        }
+        logger_manager::get_instance().log(
+            fmt::format("Target supports gNMI {} with {} models", response->gnmi_version(),
+                        response->supported_models_size()),
+            log_level::INFO);
+        cached.value = std::move(response);
+    }
+    *capabilities = cached.value;
+    return grpc::Status::OK;
+}
+
+/**
+ * @brief Returns the capabilities of an entry if already fetched, without blocking.
+ * @param cached The entry of the channel.
+ * @param capabilities Set to the capabilities of the target if they were cached.
+ * @return False if they were not fetched yet, or are being fetched.
+ */
+bool capabilities_cache::peek(entry& cached,
+                              std::shared_ptr<const gnmi::CapabilityResponse>* capabilities)
+{
+    std::unique_lock<std::mutex> lock(cached.fetch_mtx, std::try_to_lock);
+    if (!lock.owns_lock() || cached.value == nullptr)
+    {
+        return false;
+    }
+    *capabilities = cached.value;
+    return true;
+}
+
+/**
+ * @brief Forgets the capabilities of an entry.
+ * @param cached The entry of the channel.
+ */
+void capabilities_cache::invalidate(entry& cached)
+{
+    std::lock_guard<std::mutex> lock(cached.fetch_mtx);
+    cached.value = nullptr;
+}
+
+/**
+ * @brief Picks the cheapest encoding supported by a target, PROTO before JSON_IETF.
+ * @param capabilities The capabilities of the target.
+ * @param fallback The encoding returned if the target supports neither.
+ */
+gnmi::Encoding select_encoding(const gnmi::CapabilityResponse& capabilities,
+                               gnmi::Encoding fallback)
+{
+    // Only the encodings the responses can be decoded from, cheapest first.
+    for (const gnmi::Encoding preferred : {gnmi::Encoding::PROTO, gnmi::Encoding::JSON_IETF})
+    {
+        for (const int supported : capabilities.supported_encodings())
+        {
+            if (supported == preferred)
+            {
+                return preferred;
+            }
+        }
+    }
+    return fallback;
+}
+
+/**
+ * @brief Picks the models of a target which define the paths of an origin.
+ * @param capabilities The capabilities of the target.
+ * @param origin The origin of the paths, which is the name of their model.
+ */
+std::vector<gnmi::ModelData> select_models(const gnmi::CapabilityResponse& capabilities,
+                                           const std::string& origin)
+{
+    std::vector<gnmi::ModelData> models;
+    for (const auto& model : capabilities.supported_models())
+    {
+        if (model.name() == origin)
+        {
+            models.push_back(model);
+        }
+    }
+    return models;
+}
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_channel_pool.h"
+#include <fmt/format.h>
+#include <iterator>
+#include <stdexcept>
+#include "logger/logger.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Gets the singleton instance of the channel_pool.
+ */
+channel_pool& channel_pool::get_instance()
+{
+    static channel_pool instance;
+    return instance;
+}
+
+/**
+ * @brief Returns a channel to a target, creating one for a free slot.
+ * @param channel_args The arguments of the channel.
+ * @param create Creates a channel with its own connection.
+ * @return The channel.
+ */
+std::shared_ptr<grpc::Channel> channel_pool::acquire(const rpc_channel_args& channel_args,
+                                                     const channel_factory& create)
+{
+    if (channel_args.pool_subchannels == 0)
+    {
+        logger_manager::get_instance().log(
+            "Channel pool needs at least one subchannel per target", log_level::ERROR);
+        throw std::invalid_argument("Channel pool needs at least one subchannel per target");
+    }
+    const std::string key = key_of(channel_args);
+    std::lock_guard<std::mutex> lock(pool_mtx);
+    for (auto it = targets.begin(); it != targets.end();)
+    {
+        auto& slots = it->second;
+        for (auto slot = slots.begin(); slot != slots.end();)
+        {
+            slot = slot->expired() ? slots.erase(slot) : std::next(slot);
+        }
+        it = slots.empty() && it->first != key ? targets.erase(it) : std::next(it);
+    }
+
+    auto& slots = targets[key];
+    if (slots.size() < channel_args.pool_subchannels)
+    {
+        // Created under the lock, so concurrent connections do not open extra channels.
+        std::shared_ptr<grpc::Channel> channel = create();
+        slots.push_back(channel);
+        created++;
+        logger_manager::get_instance().log(
+            fmt::format("Channel pool: opened channel {} of {} to {}", slots.size(),
+                        channel_args.pool_subchannels, channel_args.server_address),
+            log_level::INFO);
+        return channel;
+    }
+
+    // The use count of a channel counts its connections and the stubs of its clients.
+    std::shared_ptr<grpc::Channel> least_used;
+    for (const auto& slot : slots)
+    {
+        auto channel = slot.lock();
+        if (channel != nullptr && (least_used == nullptr || channel.use_count() <
+                                                                least_used.use_count()))
+        {
+            least_used = std::move(channel);
+        }
+    }
+    reused++;
+    return least_used;
+}
+
+/**
+ * @brief Returns the counters of the pool.
+ */
+channel_pool_statistics channel_pool::get_statistics()
+{
+    std::lock_guard<std::mutex> lock(pool_mtx);
+    channel_pool_statistics statistics;
+    for (const auto& target : targets)
+    {
+        size_t open = 0;
+        for (const auto& slot : target.second)
+        {
+            open += slot.expired() ? 0 : 1;
+        }
+        statistics.targets += open != 0 ? 1 : 0;
+        statistics.channels += open;
+    }
+    statistics.created = created;
+    statistics.reused = reused;
+    return statistics;
+}
+
+/**
+ * @brief Returns the key of the channels of a target.
+ * @param channel_args The arguments of the channel.
+ */
+std::string channel_pool::key_of(const rpc_channel_args& channel_args)
+{
+    const channel_tuning& tuning = channel_args.tuning;
+    return fmt::format(
+        "{}|{}|{}|{}|{}|{},{},{},{},{},{},{},{},{},{},{},{},{},{}", channel_args.server_address,
+        channel_args.ssl_tls, channel_args.pem_roots_certs_path,
+        channel_args.pem_private_key_path, channel_args.pem_cert_chain_path,
+        tuning.max_receive_message_size, tuning.max_send_message_size,
+        tuning.http2_stream_window, tuning.http2_max_frame_size,
+        tuning.http2_write_buffer_size, tuning.http2_bdp_probe, tuning.keepalive_time.count(),
+        tuning.keepalive_timeout.count(), tuning.keepalive_permit_without_calls,
+        tuning.http2_max_pings_without_data, tuning.initial_reconnect_backoff.count(),
+        tuning.min_reconnect_backoff.count(), tuning.max_reconnect_backoff.count(),
+        tuning.buffer_pool_bytes);
+}
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_delivery_queue.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include "logger/logger.h"
+#include "pbr/mgbl_pbr.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+namespace
+{
+/**
+ * @brief Merges a newer sample of a key into its queued one, like pbr_latest_values::merge.
+ *
+ * A partial sample only replaces the fields it carries, the counter or the action it does
+ * not carry is still delivered from the queued sample.
+ *
+ * @param queued The queued sample, replaced by the merged one.
+ * @param newer The newer sample of the same key.
+ */
+void merge_sample(std::shared_ptr<IPbrStat>& queued, std::shared_ptr<IPbrStat> newer)
+{
+    const auto* older = dynamic_cast<const PbrBasicStat*>(queued.get());
+    const auto* latest = dynamic_cast<const PbrBasicStat*>(newer.get());
+    if (older == nullptr || latest == nullptr)
+    {
+        queued = std::move(newer);
+        return;
+    }
+    auto merged = std::make_shared<PbrBasicStat>(*latest);
+    if (!latest->has_action && older->has_action)
+    {
+        merged->path_grp_name = older->path_grp_name;
+        merged->policy_action_type = older->policy_action_type;
+        merged->has_action = true;
+    }
+    if (older->has_counters)
+    {
+        // A stat only flagged with has_counters carries both counters.
+        const bool older_both = !older->has_byte_count && !older->has_packet_count;
+        const bool latest_both =
+            latest->has_counters && !latest->has_byte_count && !latest->has_packet_count;
+        if (!latest->has_counters)
+        {
+            merged->collection_timestamp_seconds = older->collection_timestamp_seconds;
+            merged->collection_timestamp_nanoseconds = older->collection_timestamp_nanoseconds;
+        }
+        if (!latest->has_byte_count && !latest_both && (older->has_byte_count || older_both))
+        {
+            merged->byte_count = older->byte_count;
+            merged->has_byte_count = true;
+        }
+        if (!latest->has_packet_count && !latest_both && (older->has_packet_count || older_both))
+        {
+            merged->packet_count = older->packet_count;
+            merged->has_packet_count = true;
+        }
+        merged->has_counters = true;
+    }
+    queued = std::move(merged);
+}
+}  // namespace
+
+/**
+ * @brief Creates an empty queue.
+ * @param queue_options The options of the queue.
+ */
+delivery_queue::delivery_queue(const delivery_queue_options& queue_options)
+    : options(queue_options)
+{
+    if (options.capacity == 0)
+    {
+        logger_manager::get_instance().log("Delivery queue capacity must not be 0",
+                                           log_level::ERROR);
+        throw std::invalid_argument("Delivery queue capacity must not be 0");
+    }
+}
+
+/**
+ * @brief Queues a sample, applying the overflow policy if the queue is full.
+ * @param item The sample to queue.
+ * @return The outcome for the sample.
+ */
+delivery_queue::push_result delivery_queue::push(delivery_item& item)
+{
+    std::lock_guard<std::mutex> lock(queue_mtx);
+    const bool coalesce = options.policy == overflow_policy::COALESCE_LATEST;
+    if (coalesce)
+    {
+        const auto it = key_sequences.find(item.key);
+        if (it != key_sequences.end())
+        {
+            merge_sample(items[it->second - front_sequence].stat, std::move(item.stat));
+            statistics.coalesced++;
+            return push_result::QUEUED;
+        }
+    }
+
+    if (items.size() >= options.capacity)
+    {
+        switch (options.policy)
+        {
+            case overflow_policy::BLOCK:
+                statistics.blocked++;
+                return push_result::FULL;
+            case overflow_policy::DROP_NEWEST:
+                statistics.dropped_newest++;
+                return push_result::DROPPED;
+            case overflow_policy::DROP_OLDEST:
+            case overflow_policy::COALESCE_LATEST:
+                pop_front_locked(nullptr);
+                statistics.dropped_oldest++;
+                break;
+        }
+    }
+
+    if (coalesce)
+    {
+        key_sequences[item.key] = front_sequence + items.size();
+    }
+    items.push_back(std::move(item));
+    statistics.enqueued++;
+    statistics.max_depth = std::max(statistics.max_depth, items.size());
+    return push_result::QUEUED;
+}
+
+/**
+ * @brief Moves up to `max_items` of the oldest samples to `out`.
+ * @param out The vector the samples are appended to.
+ * @param max_items The maximum number of samples to take.
+ * @return The number of samples taken.
+ */
+size_t delivery_queue::pop_batch(std::vector<delivery_item>& out, size_t max_items)
+{
+    std::lock_guard<std::mutex> lock(queue_mtx);
+    const size_t count = std::min(max_items, items.size());
+    for (size_t i = 0; i < count; i++)
+    {
+        out.emplace_back();
+        pop_front_locked(&out.back());
+    }
+    statistics.delivered += count;
+    return count;
+}
+
+/**
+ * @brief Returns the number of queued samples.
+ */
+size_t delivery_queue::size()
+{
+    std::lock_guard<std::mutex> lock(queue_mtx);
+    return items.size();
+}
+
+/**
+ * @brief Returns the counters of the queue.
+ */
+delivery_queue_statistics delivery_queue::get_statistics()
+{
+    std::lock_guard<std::mutex> lock(queue_mtx);
+    delivery_queue_statistics result = statistics;
+    result.depth = items.size();
+    return result;
+}
+
+/**
+ * @brief Removes the front item, and its key when coalescing.
+ * @param out Receives the item if not nullptr.
+ */
+void delivery_queue::pop_front_locked(delivery_item* out)
+{
+    if (options.policy == overflow_policy::COALESCE_LATEST)
+    {
+        key_sequences.erase(items.front().key);
+    }
+    if (out != nullptr)
+    {
+        *out = std::move(items.front());
+    }
+    items.pop_front();
+    front_sequence++;
+}
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
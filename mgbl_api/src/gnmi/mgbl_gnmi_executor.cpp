@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_executor.h"
+#include <fmt/format.h>
+#include <stdexcept>
+#include <utility>
+#include "logger/logger.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+namespace
+{
+// Executor, worker index and strand of the task running on the current thread, if any.
+thread_local const work_stealing_executor* current_executor = nullptr;
+thread_local uint32_t current_worker = 0;
+thread_local const executor_strand* current_strand = nullptr;
+}  // namespace
+
+/**
+ * @brief Returns the number of tasks queued on the strand and not run yet.
+ */
+size_t executor_strand::pending()
+{
+    std::lock_guard<std::mutex> lock(strand_mtx);
+    return tasks.size();
+}
+
+/**
+ * @brief Blocks until every task queued on the strand has run.
+ */
+void executor_strand::wait_idle()
+{
+    if (current_strand == this)
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(strand_mtx);
+    idle_cv.wait(lock, [this] { return !scheduled; });
+}
+
+/**
+ * @brief Blocks until every task queued on the strand has run, or until the deadline.
+ * @param deadline The time after which the strand is no longer waited for.
+ * @return False if the deadline expired first.
+ */
+bool executor_strand::wait_idle_until(std::chrono::steady_clock::time_point deadline)
+{
+    if (current_strand == this)
+    {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(strand_mtx);
+    if (deadline == std::chrono::steady_clock::time_point::max())
+    {
+        idle_cv.wait(lock, [this] { return !scheduled; });
+        return true;
+    }
+    return idle_cv.wait_until(lock, deadline, [this] { return !scheduled; });
+}
+
+/**
+ * @brief Starts the worker threads.
+ * @param executor_options The options of the executor.
+ */
+work_stealing_executor::work_stealing_executor(const options& executor_options)
+    : tasks_per_turn(executor_options.tasks_per_turn)
+{
+    if (executor_options.worker_threads == 0 || executor_options.tasks_per_turn == 0)
+    {
+        logger_manager::get_instance().log(
+            "Executor needs at least one worker thread and one task per turn", log_level::ERROR);
+        throw std::invalid_argument(
+            "Executor needs at least one worker thread and one task per turn");
+    }
+
+    for (uint32_t i = 0; i < executor_options.worker_threads; i++)
+    {
+        queues.push_back(std::make_unique<worker_queue>());
+    }
+    for (uint32_t i = 0; i < executor_options.worker_threads; i++)
+    {
+        workers.push_back(thread_factory::get_instance().create(thread_role::WORKER, i,
+                                                                [this, i]() { run_worker(i); }));
+    }
+}
+
+/**
+ * @brief Runs the pending tasks and joins the worker threads.
+ */
+work_stealing_executor::~work_stealing_executor()
+{
+    shutdown();
+}
+
+/**
+ * @brief Returns the executor used by the clients that need one and were not given one.
+ */
+std::shared_ptr<work_stealing_executor> work_stealing_executor::default_executor()
+{
+    static std::shared_ptr<work_stealing_executor> instance =
+        std::make_shared<work_stealing_executor>();
+    return instance;
+}
+
+/**
+ * @brief Submits a task without ordering guarantee.
+ * @param task The task to run.
+ * @return False if the executor is shut down.
+ */
+bool work_stealing_executor::submit(std::function<void()> task)
+{
+    if (!reserve_task())
+    {
+        return false;
+    }
+    push([this, task = std::move(task)]() { run_task(task); });
+    return true;
+}
+
+/**
+ * @brief Submits a task run after every task previously submitted to the strand.
+ * @param strand The strand of the task.
+ * @param task The task to run.
+ * @return False if the executor is shut down.
+ */
+bool work_stealing_executor::submit(const std::shared_ptr<executor_strand>& strand,
+                                    std::function<void()> task)
+{
+    if (!reserve_task())
+    {
+        return false;
+    }
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(strand->strand_mtx);
+        strand->tasks.push_back(std::move(task));
+        if (!strand->scheduled)
+        {
+            strand->scheduled = true;
+            schedule = true;
+        }
+    }
+    // A scheduled strand picks the task up itself, only an idle strand is queued on a worker.
+    if (schedule)
+    {
+        push([this, strand]() { run_strand(strand); });
+    }
+    return true;
+}
+
+/**
+ * @brief Checks whether the calling thread is one of the worker threads of this executor.
+ */
+bool work_stealing_executor::is_worker_thread() const
+{
+    return current_executor == this;
+}
+
+/**
+ * @brief Returns the queue depths and the task counters of the executor.
+ */
+executor_statistics work_stealing_executor::get_statistics() const
+{
+    executor_statistics statistics;
+    statistics.pending_tasks = pending_tasks.load();
+    statistics.max_pending_tasks = max_pending_tasks.load();
+    statistics.executed_tasks = executed_tasks.load();
+    statistics.stolen_tasks = stolen_tasks.load();
+    for (const auto& queue : queues)
+    {
+        std::lock_guard<std::mutex> lock(queue->queue_mtx);
+        statistics.queue_depths.push_back(queue->items.size());
+    }
+    return statistics;
+}
+
+/**
+ * @brief Runs the pending tasks and joins the worker threads.
+ */
+void work_stealing_executor::shutdown()
+{
+    std::lock_guard<std::mutex> lock(shutdown_mtx);
+    if (is_shutdown)
+    {
+        return;
+    }
+    is_shutdown = true;
+    {
+        std::lock_guard<std::mutex> sleep_lock(sleep_mtx);
+        stopping = true;
+    }
+    sleep_cv.notify_all();
+
+    for (auto& worker : workers)
+    {
+        if (worker.is_current())
+        {
+            logger_manager::get_instance().log("Executor shut down from one of its own tasks",
+                                               log_level::ERROR);
+            worker.detach();
+        }
+        else if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+}
+
+/**
+ * @brief Accounts a new task, unless the executor is stopping.
+ * @return False if the task is rejected.
+ */
+bool work_stealing_executor::reserve_task()
+{
+    // The workers only exit once stopping is set and no task is pending, so a task
+    // counted before stopping is observed is always run.
+    const size_t pending = ++pending_tasks;
+    if (stopping)
+    {
+        release_task();
+        logger_manager::get_instance().log("Executor is shut down, task rejected",
+                                           log_level::ERROR);
+        return false;
+    }
+    size_t max_pending = max_pending_tasks.load();
+    while (pending > max_pending && !max_pending_tasks.compare_exchange_weak(max_pending, pending))
+    {
+    }
+    return true;
+}
+
+/**
+ * @brief Accounts a task that has run or was rejected.
+ */
+void work_stealing_executor::release_task()
+{
+    if (--pending_tasks == 0 && stopping)
+    {
+        std::lock_guard<std::mutex> lock(sleep_mtx);
+        sleep_cv.notify_all();
+    }
+}
+
+/**
+ * @brief Queues a runnable item on the calling worker, or on the next worker round robin.
+ * @param item The item to queue.
+ */
+void work_stealing_executor::push(std::function<void()> item)
+{
+    const uint32_t index = current_executor == this
+                               ? current_worker
+                               : next_queue++ % static_cast<uint32_t>(queues.size());
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->queue_mtx);
+        queues[index]->items.push_back(std::move(item));
+        queued_items++;
+    }
+    std::lock_guard<std::mutex> lock(sleep_mtx);
+    sleep_cv.notify_one();
+}
+
+/**
+ * @brief Takes the oldest item of the worker queue, or steals the newest item of another queue.
+ * @param worker The index of the calling worker.
+ * @param item Set to the item taken.
+ * @return False if every queue is empty.
+ */
+bool work_stealing_executor::pop_or_steal(uint32_t worker, std::function<void()>& item)
+{
+    {
+        worker_queue& own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.queue_mtx);
+        if (!own.items.empty())
+        {
+            item = std::move(own.items.front());
+            own.items.pop_front();
+            queued_items--;
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); i++)
+    {
+        worker_queue& victim = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.queue_mtx);
+        if (!victim.items.empty())
+        {
+            item = std::move(victim.items.back());
+            victim.items.pop_back();
+            queued_items--;
+            stolen_tasks++;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Worker loop, runs items until the executor is stopped and no task is pending.
+ * @param worker The index of the worker.
+ */
+void work_stealing_executor::run_worker(uint32_t worker)
+{
+    current_executor = this;
+    current_worker = worker;
+    std::function<void()> item;
+    while (true)
+    {
+        if (pop_or_steal(worker, item))
+        {
+            item();
+            item = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mtx);
+        sleep_cv.wait(lock,
+                      [this] { return queued_items > 0 || (stopping && pending_tasks == 0); });
+        if (queued_items == 0 && stopping && pending_tasks == 0)
+        {
+            break;
+        }
+    }
+    current_executor = nullptr;
+}
+
+/**
+ * @brief Runs up to `tasks_per_turn` tasks of the strand, then yields the worker.
+ * @param strand The strand to run.
+ */
+void work_stealing_executor::run_strand(const std::shared_ptr<executor_strand>& strand)
+{
+    const executor_strand* previous_strand = current_strand;
+    current_strand = strand.get();
+    for (uint32_t i = 0; i < tasks_per_turn; i++)
+    {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(strand->strand_mtx);
+            if (strand->tasks.empty())
+            {
+                strand->scheduled = false;
+                strand->idle_cv.notify_all();
+                current_strand = previous_strand;
+                return;
+            }
+            task = std::move(strand->tasks.front());
+            strand->tasks.pop_front();
+        }
+        run_task(task);
+    }
+    current_strand = previous_strand;
+
+    {
+        std::lock_guard<std::mutex> lock(strand->strand_mtx);
+        if (strand->tasks.empty())
+        {
+            strand->scheduled = false;
+            strand->idle_cv.notify_all();
+            return;
+        }
+    }
+    // Requeued behind the other items so a busy strand does not starve them.
+    push([this, strand]() { run_strand(strand); });
+}
+
+/**
+ * @brief Runs one task and accounts it.
+ * @param task The task to run.
+ */
+void work_stealing_executor::run_task(const std::function<void()>& task)
+{
+    try
+    {
+        task();
+    }
+    catch (const std::exception& e)
+    {
+        logger_manager::get_instance().log(
+            fmt::format("Executor task threw an exception: {}", e.what()), log_level::ERROR);
+    }
+    catch (...)
+    {
+        // Still released below, a shutdown waiting for the pending tasks would hang.
+        logger_manager::get_instance().log("Executor task threw an unknown exception",
+                                           log_level::ERROR);
+    }
+    executed_tasks++;
+    release_task();
+}
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
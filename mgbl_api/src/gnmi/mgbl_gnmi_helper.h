@@ -45,6 +45,8 @@ enum class internal_error_code
     NO_POLICY_NAME_IN_RESPONSE,
     NO_RULE_NAME_IN_RESPONSE,
     UNSUPPORTED_ENCODING,
+    INVALID_RELATIVE_PATH,
+    KEY_FILTERED,
     UNKNOWN_ERROR
 };
 
@@ -56,6 +58,8 @@ struct rpc_stream_args
     std::string prefix; /**< Prefix of the gnmi path */
     std::vector<std::string>
         paths_of_interest; /**< Vector of strings representing the paths to get data from */
+    std::vector<uint64_t>
+        sample_intervals_nsec; /**< Interval of every path, 0 or none for that of rpc_args */
 };
 
 /**
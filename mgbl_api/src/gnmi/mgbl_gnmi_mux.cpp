@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_mux.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include "gnmi/mgbl_gnmi_client.h"
+#include "gnmi/mgbl_gnmi_connection.h"
+#include "logger/logger.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Connection, client and consumers of one target.
+ */
+struct gnmi_subscription_mux::upstream
+{
+    using consumer_list = std::vector<std::shared_ptr<consumer>>;
+
+    std::string name;
+    client_context_args context_args;
+    rpc_args args;
+    std::unique_ptr<gnmi_client_connection> connection;
+    std::shared_ptr<PBRBasic> counters;
+
+    /**
+     * Guards the keys of the counters, the keys of the running stream and the serial of
+     * the last change, also used by the resubscription handler of the client.
+     */
+    std::mutex keys_mtx;
+    std::vector<PBRBase::pbr_key> committed_keys;
+    uint64_t keys_serial = 0;
+
+    std::unique_ptr<GnmiClient> client;
+
+    /** Serializes the changes of the stream, held while it is moved to new keys. */
+    std::mutex stream_mtx;
+    consumer_list members;
+    std::atomic<bool> streaming{false};
+    std::atomic<size_t> subscribed_keys{0};
+
+    /** Guards the consumers the stats are handed to. */
+    std::mutex delivery_mtx;
+    std::shared_ptr<const consumer_list> delivered;
+};
+
+/**
+ * @brief One consumer and the keys it is interested in.
+ */
+struct gnmi_subscription_mux::consumer
+{
+    uint64_t id;
+    upstream* target;
+    std::vector<PBRBase::pbr_key> keys;
+    std::set<std::pair<std::string, std::string>> wanted;
+    consumer_handler handler;
+};
+
+/**
+ * @brief Creates a mux without targets.
+ * @param args The subscription rpc metadata of every stream.
+ * @param mux_options The options of the mux.
+ */
+gnmi_subscription_mux::gnmi_subscription_mux(const rpc_args& args, const options& mux_options)
+    : stream_args(args), mux_options(mux_options)
+{
+    stream_args.mode = stream_mode::STREAM;
+}
+
+/**
+ * @brief Closes every stream.
+ */
+gnmi_subscription_mux::~gnmi_subscription_mux()
+{
+    // The clients wait for their handlers, which use the state of their target.
+    for (auto& target : upstreams)
+    {
+        target.second->client.reset();
+    }
+    upstreams.clear();
+}
+
+/**
+ * @brief Adds a target the consumers can subscribe to.
+ * @param name Unique name of the target.
+ * @param channel_args Channel arguments of the target.
+ * @param context_args Context arguments of the stream of the target.
+ */
+void gnmi_subscription_mux::add_target(const std::string& name,
+                                       const rpc_channel_args& channel_args,
+                                       const client_context_args& context_args)
+{
+    std::lock_guard<std::mutex> lock(mux_mtx);
+    if (upstreams.count(name) != 0)
+    {
+        logger_manager::get_instance().log(
+            fmt::format("Subscription mux: duplicate target {}", name), log_level::ERROR);
+        throw std::invalid_argument("Duplicate target name: " + name);
+    }
+    auto target = std::make_unique<upstream>();
+    target->name = name;
+    target->context_args = context_args;
+    target->args = stream_args;
+    target->connection = std::make_unique<gnmi_client_connection>(channel_args);
+    target->counters = std::make_shared<PBRBasic>();
+    target->client =
+        mux_options.engine != nullptr
+            ? std::make_unique<GnmiClient>(target->connection->get_channel(), target->counters,
+                                           mux_options.engine)
+            : std::make_unique<GnmiClient>(target->connection->get_channel(), target->counters);
+    target->delivered = std::make_shared<const upstream::consumer_list>();
+
+    upstream* state = target.get();
+    target->client->set_rpc_batch_handler([this, state](stat_span<PbrBasicStat> stats)
+                                          { fan_out(*state, stats); });
+    target->client->set_rpc_failed_handler(
+        [this, state](grpc::Status status)
+        {
+            if (on_failure)
+            {
+                on_failure(state->name, std::move(status));
+            }
+        });
+    target->client->set_reconnect_policy(mux_options.reconnect);
+    upstreams.emplace(name, std::move(target));
+}
+
+/**
+ * @brief Registers a consumer of keys of a target.
+ * @param target The name of the target.
+ * @param keys The keys of the target the consumer is interested in.
+ * @param handler The handler receiving the stats.
+ * @return The id of the consumer.
+ */
+uint64_t gnmi_subscription_mux::subscribe(const std::string& target,
+                                          const std::vector<PBRBase::pbr_key>& keys,
+                                          consumer_handler handler)
+{
+    auto registered = std::make_shared<consumer>();
+    {
+        std::lock_guard<std::mutex> lock(mux_mtx);
+        auto found = upstreams.find(target);
+        if (found == upstreams.end() || keys.empty() || !handler)
+        {
+            logger_manager::get_instance().log(
+                "Subscription mux needs a known target, keys and a handler", log_level::ERROR);
+            throw std::invalid_argument(
+                "Subscription mux needs a known target, keys and a handler");
+        }
+        registered->id = next_id++;
+        registered->target = found->second.get();
+        registered->keys = keys;
+        for (const auto& key : keys)
+        {
+            registered->wanted.emplace(key.key_policy, key.key_rule);
+        }
+        registered->handler = std::move(handler);
+        consumers.emplace(registered->id, registered);
+    }
+
+    upstream& state = *registered->target;
+    std::lock_guard<std::mutex> stream_lock(state.stream_mtx);
+    state.members.push_back(registered);
+    update_stream(state);
+    return registered->id;
+}
+
+/**
+ * @brief Unregisters a consumer.
+ * @param id The id returned by `subscribe`.
+ * @return False if the id is not registered.
+ */
+bool gnmi_subscription_mux::unsubscribe(uint64_t id)
+{
+    std::shared_ptr<consumer> removed;
+    {
+        std::lock_guard<std::mutex> lock(mux_mtx);
+        auto found = consumers.find(id);
+        if (found == consumers.end())
+        {
+            return false;
+        }
+        removed = std::move(found->second);
+        consumers.erase(found);
+    }
+
+    upstream& state = *removed->target;
+    std::lock_guard<std::mutex> stream_lock(state.stream_mtx);
+    state.members.erase(std::remove(state.members.begin(), state.members.end(), removed),
+                        state.members.end());
+    update_stream(state);
+    return true;
+}
+
+/**
+ * @brief Returns the counters of the mux.
+ */
+subscription_mux_statistics gnmi_subscription_mux::get_statistics()
+{
+    subscription_mux_statistics statistics;
+    std::lock_guard<std::mutex> lock(mux_mtx);
+    statistics.targets = upstreams.size();
+    statistics.consumers = consumers.size();
+    for (const auto& target : upstreams)
+    {
+        statistics.streams += target.second->streaming ? 1 : 0;
+        statistics.upstream_keys += target.second->subscribed_keys;
+    }
+    statistics.samples_received = samples_received;
+    statistics.samples_delivered = samples_delivered;
+    return statistics;
+}
+
+/**
+ * @brief Moves the stream of a target to the union of the keys of its consumers, with
+ * stream_mtx held.
+ * @param target The target whose consumers changed.
+ */
+void gnmi_subscription_mux::update_stream(upstream& target)
+{
+    {
+        std::lock_guard<std::mutex> lock(target.delivery_mtx);
+        target.delivered = std::make_shared<const upstream::consumer_list>(target.members);
+    }
+
+    // The shortest interval asked for a key, 0 is the interval of the rpc_args.
+    std::map<std::pair<std::string, std::string>, uint64_t> union_keys;
+    for (const auto& member : target.members)
+    {
+        for (const auto& key : member->keys)
+        {
+            const uint64_t interval = key.sample_interval_nsec != 0
+                                          ? key.sample_interval_nsec
+                                          : target.args.sample_interval_nsec;
+            auto inserted = union_keys.emplace(std::make_pair(key.key_policy, key.key_rule),
+                                               interval);
+            if (!inserted.second)
+            {
+                inserted.first->second = std::min(inserted.first->second, interval);
+            }
+        }
+    }
+    std::vector<PBRBase::pbr_key> keys;
+    keys.reserve(union_keys.size());
+    for (const auto& key : union_keys)
+    {
+        keys.push_back({key.first.first, key.first.second, "", key.second});
+    }
+
+    bool unchanged = false;
+    {
+        // The keys last asked for, the previous ones again if that resubscription failed.
+        std::lock_guard<std::mutex> lock(target.keys_mtx);
+        const auto& current = target.counters->keys;
+        unchanged = std::equal(
+            keys.begin(), keys.end(), current.begin(), current.end(),
+            [](const PBRBase::pbr_key& lhs, const PBRBase::pbr_key& rhs)
+            {
+                return lhs.key_policy == rhs.key_policy && lhs.key_rule == rhs.key_rule &&
+                       lhs.sample_interval_nsec == rhs.sample_interval_nsec;
+            });
+    }
+    if (unchanged && target.streaming == !keys.empty())
+    {
+        return;
+    }
+
+    uint64_t serial = 0;
+    {
+        std::lock_guard<std::mutex> lock(target.keys_mtx);
+        serial = ++target.keys_serial;
+        target.counters->keys = keys;
+        if (keys.empty())
+        {
+            target.committed_keys.clear();
+        }
+    }
+    if (keys.empty())
+    {
+        target.client->rpc_stream_close();
+        target.streaming = false;
+        target.subscribed_keys = 0;
+        logger_manager::get_instance().log(
+            fmt::format("Subscription mux: closed the stream of {}", target.name),
+            log_level::INFO);
+        return;
+    }
+
+    // The new keys are only committed once the stream is in sync with them.
+    upstream* state = &target;
+    auto on_done = [this, state, serial](grpc::Status status)
+    { on_resubscribed(*state, serial, std::move(status)); };
+    if (target.client->rpc_resubscribe_stats_stream(target.context_args, target.args,
+                                                    on_done) != error_code::SUCCESS)
+    {
+        on_resubscribed(target, serial,
+                        grpc::Status(grpc::StatusCode::UNKNOWN,
+                                     "The stream could not be moved to the new keys"));
+        return;
+    }
+    target.streaming = true;
+    logger_manager::get_instance().log(
+        fmt::format("Subscription mux: moving the stream of {} to {} keys shared by {} consumers",
+                    target.name, keys.size(), target.members.size()),
+        log_level::INFO);
+}
+
+/**
+ * @brief Commits the keys of a resubscription once in sync, or restores the previous keys.
+ * @param target The target whose stream was moved.
+ * @param serial The change of the keys the resubscription was sent for.
+ * @param status OK once the stream uses the new keys, the failure otherwise.
+ */
+void gnmi_subscription_mux::on_resubscribed(upstream& target, uint64_t serial,
+                                            grpc::Status status)
+{
+    {
+        std::lock_guard<std::mutex> lock(target.keys_mtx);
+        if (serial != target.keys_serial)
+        {
+            // Superseded by a later change of the keys.
+            return;
+        }
+        if (status.ok())
+        {
+            target.committed_keys = target.counters->keys;
+            target.subscribed_keys = target.committed_keys.size();
+            return;
+        }
+        target.counters->keys = target.committed_keys;
+    }
+    logger_manager::get_instance().log(
+        fmt::format("Subscription mux: failed to move the stream of {} to new keys: {}",
+                    target.name, status.error_message()),
+        log_level::ERROR);
+    if (on_failure)
+    {
+        on_failure(target.name, std::move(status));
+    }
+}
+
+/**
+ * @brief Hands the stats of a batch to the consumers of their keys.
+ * @param target The target the batch was received from.
+ * @param stats The batch.
+ */
+void gnmi_subscription_mux::fan_out(upstream& target, stat_span<PbrBasicStat> stats)
+{
+    std::shared_ptr<const upstream::consumer_list> delivered;
+    {
+        std::lock_guard<std::mutex> lock(target.delivery_mtx);
+        delivered = target.delivered;
+    }
+    samples_received += stats.size();
+
+    std::vector<PbrBasicStat> filtered;
+    for (const auto& member : *delivered)
+    {
+        filtered.clear();
+        for (const auto& stat : stats)
+        {
+            if (member->wanted.count(std::make_pair(stat.policy_name, stat.rule_name)) != 0)
+            {
+                filtered.push_back(stat);
+            }
+        }
+        if (!filtered.empty())
+        {
+            samples_delivered += filtered.size();
+            member->handler(target.name,
+                            stat_span<PbrBasicStat>(filtered.data(), filtered.size()));
+        }
+    }
+    // The stats were handed over, the counters of the stream do not keep them.
+    target.counters->stats.clear();
+}
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
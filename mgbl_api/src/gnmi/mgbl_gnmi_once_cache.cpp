@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_once_cache.h"
+#include <iterator>
+#include <stdexcept>
+#include "logger/logger.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Creates an empty cache.
+ * @param cache_options The options of the cache.
+ */
+once_cache::once_cache(const options& cache_options) : cache_options(cache_options)
+{
+    if (cache_options.ttl.count() < 0)
+    {
+        logger_manager::get_instance().log("Once cache needs a ttl of at least 0",
+                                           log_level::ERROR);
+        throw std::invalid_argument("Once cache needs a ttl of at least 0");
+    }
+}
+
+/**
+ * @brief Returns the result of a request, cached, shared or sent.
+ * @param key The identity of the request.
+ * @param deadline If not nullptr, the deadline of the wait for a request in flight.
+ * @param request Sends the request and fills the stats it received.
+ * @param stats Set to the stats of the result.
+ * @return The error code and status of the result.
+ */
+once_cache::once_result once_cache::fetch(const std::string& key,
+                                          const std::chrono::system_clock::time_point* deadline,
+                                          const std::function<once_result(stats_vector*)>& request,
+                                          stats_vector* stats)
+{
+    std::unique_lock<std::mutex> lock(cache_mtx);
+    auto found = entries.find(key);
+    if (found != entries.end())
+    {
+        std::shared_ptr<entry> cached = found->second;
+        if (!cached->pending && cached->expires > std::chrono::steady_clock::now())
+        {
+            statistics.hits++;
+            *stats = *cached->stats;
+            return cached->result;
+        }
+        if (cached->pending)
+        {
+            statistics.coalesced++;
+            auto done = [&cached]() { return !cached->pending; };
+            if (deadline == nullptr)
+            {
+                cache_cv.wait(lock, done);
+            }
+            else if (!cache_cv.wait_until(lock, *deadline, done))
+            {
+                return once_result(error_code::RPC_FAILURE,
+                                   grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED,
+                                                "Deadline exceeded waiting for the identical "
+                                                "request in flight"));
+            }
+            *stats = *cached->stats;
+            return cached->result;
+        }
+    }
+
+    statistics.misses++;
+    auto sent = std::make_shared<entry>();
+    entries[key] = sent;
+    lock.unlock();
+
+    stats_vector received;
+    once_result result;
+    try
+    {
+        result = request(&received);
+    }
+    catch (...)
+    {
+        // The waiters are woken with a failure, the exception is left to the caller.
+        lock.lock();
+        sent->result = once_result(
+            error_code::RPC_FAILURE,
+            grpc::Status(grpc::StatusCode::INTERNAL, "The identical request in flight threw"));
+        sent->stats = std::make_shared<const stats_vector>();
+        sent->pending = false;
+        found = entries.find(key);
+        if (found != entries.end() && found->second == sent)
+        {
+            entries.erase(found);
+        }
+        cache_cv.notify_all();
+        throw;
+    }
+
+    lock.lock();
+    const auto now = std::chrono::steady_clock::now();
+    sent->result = result;
+    sent->stats = std::make_shared<const stats_vector>(std::move(received));
+    sent->expires = now + cache_options.ttl;
+    sent->pending = false;
+    // A failed result is only shared with the requests which waited for it.
+    if (result.first != error_code::SUCCESS || cache_options.ttl.count() == 0)
+    {
+        found = entries.find(key);
+        if (found != entries.end() && found->second == sent)
+        {
+            entries.erase(found);
+        }
+    }
+    else if (entries.size() > cache_options.max_entries)
+    {
+        prune_locked(now);
+    }
+    cache_cv.notify_all();
+    *stats = *sent->stats;
+    return result;
+}
+
+/**
+ * @brief Forgets every cached result.
+ */
+void once_cache::clear()
+{
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        it = it->second->pending ? std::next(it) : entries.erase(it);
+    }
+}
+
+/**
+ * @brief Returns the counters of the cache.
+ */
+once_cache_statistics once_cache::get_statistics()
+{
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    once_cache_statistics current = statistics;
+    current.entries = entries.size();
+    return current;
+}
+
+/**
+ * @brief Drops the expired results, then the oldest ones while the cache is too large.
+ * @param now The current time.
+ */
+void once_cache::prune_locked(std::chrono::steady_clock::time_point now)
+{
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        it = !it->second->pending && it->second->expires <= now ? entries.erase(it)
+                                                                : std::next(it);
+    }
+    while (entries.size() > cache_options.max_entries)
+    {
+        auto oldest = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+        {
+            if (!it->second->pending &&
+                (oldest == entries.end() || it->second->expires < oldest->second->expires))
+            {
+                oldest = it;
+            }
+        }
+        if (oldest == entries.end())
+        {
+            // Only requests in flight are left, they are dropped or kept when they end.
+            return;
+        }
+        entries.erase(oldest);
+    }
+}
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
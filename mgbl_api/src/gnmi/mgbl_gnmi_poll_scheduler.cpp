@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_poll_scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include "gnmi/mgbl_gnmi_subscription.h"
+#include "logger/logger.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Starts the thread of the scheduler.
+ * @param scheduler_options The options of the scheduler.
+ */
+poll_scheduler::poll_scheduler(const options& scheduler_options)
+    : scheduler_options(scheduler_options), random(std::random_device{}())
+{
+    if (scheduler_options.tick.count() <= 0 || scheduler_options.wheel_slots == 0 ||
+        !(scheduler_options.jitter >= 0.0 && scheduler_options.jitter <= 1.0))
+    {
+        logger_manager::get_instance().log(
+            "Poll scheduler needs a positive tick, at least one slot and a jitter in [0, 1]",
+            log_level::ERROR);
+        throw std::invalid_argument(
+            "Poll scheduler needs a positive tick, at least one slot and a jitter in [0, 1]");
+    }
+    wheel.resize(scheduler_options.wheel_slots);
+
+    static std::atomic<uint32_t> scheduler_count{0};
+    thread = thread_factory::get_instance().create(thread_role::SCHEDULER, scheduler_count++,
+                                                   [this]() { run(); });
+}
+
+/**
+ * @brief Stops the thread of the scheduler.
+ */
+poll_scheduler::~poll_scheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(scheduler_mtx);
+        stopping = true;
+    }
+    scheduler_cv.notify_all();
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+/**
+ * @brief Polls a subscription every `interval`, from a random point of the first one.
+ * @param subscription The subscription to poll.
+ * @param interval The interval between two polls.
+ * @return The id of the schedule.
+ */
+uint64_t poll_scheduler::add(std::shared_ptr<gnmi_subscription> subscription,
+                             std::chrono::milliseconds interval)
+{
+    if (subscription == nullptr || interval.count() <= 0)
+    {
+        logger_manager::get_instance().log(
+            "Poll scheduler needs a subscription and a positive interval", log_level::ERROR);
+        throw std::invalid_argument("Poll scheduler needs a subscription and a positive interval");
+    }
+    const auto tick = scheduler_options.tick.count();
+    auto entry = std::make_shared<schedule>();
+    entry->subscription = std::move(subscription);
+    entry->interval_ticks = std::max<uint64_t>(1, (interval.count() + tick - 1) / tick);
+
+    std::lock_guard<std::mutex> lock(scheduler_mtx);
+    entry->id = next_id++;
+    // The first polls of the subscriptions added together are spread over their interval.
+    std::uniform_int_distribution<uint64_t> first_delay(1, entry->interval_ticks);
+    insert_locked(entry, first_delay(random));
+    schedules.emplace(entry->id, entry);
+    return entry->id;
+}
+
+/**
+ * @brief Stops polling a subscription.
+ * @param id The id returned by `add`.
+ * @return False if the id is not scheduled.
+ */
+bool poll_scheduler::remove(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(scheduler_mtx);
+    auto found = schedules.find(id);
+    if (found == schedules.end())
+    {
+        return false;
+    }
+    // Dropped from its slot when the wheel reaches it.
+    found->second->removed = true;
+    schedules.erase(found);
+    return true;
+}
+
+/**
+ * @brief Returns the counters of the scheduler.
+ */
+poll_scheduler_statistics poll_scheduler::get_statistics()
+{
+    std::lock_guard<std::mutex> lock(scheduler_mtx);
+    poll_scheduler_statistics result = statistics;
+    result.subscriptions = schedules.size();
+    return result;
+}
+
+/**
+ * @brief Advances the wheel every tick and polls the subscriptions due.
+ */
+void poll_scheduler::run()
+{
+    const auto tick = scheduler_options.tick;
+    auto next_tick_time = std::chrono::steady_clock::now() + tick;
+    std::uniform_real_distribution<double> spread(-1.0, 1.0);
+    std::vector<std::shared_ptr<schedule>> due;
+
+    std::unique_lock<std::mutex> lock(scheduler_mtx);
+    while (true)
+    {
+        scheduler_cv.wait_until(lock, next_tick_time, [this] { return stopping; });
+        if (stopping)
+        {
+            return;
+        }
+        // A late thread catches up one tick per turn, without waiting in between.
+        if (std::chrono::steady_clock::now() >= next_tick_time + tick)
+        {
+            statistics.late_ticks++;
+        }
+        current_tick++;
+        next_tick_time += tick;
+
+        auto& slot = wheel[current_tick % wheel.size()];
+        auto kept = std::remove_if(slot.begin(), slot.end(),
+                                   [this, &due](const std::shared_ptr<schedule>& entry)
+                                   {
+                                       if (entry->removed)
+                                       {
+                                           return true;
+                                       }
+                                       if (entry->due_tick != current_tick)
+                                       {
+                                           // Due on a later turn of the wheel.
+                                           return false;
+                                       }
+                                       due.push_back(entry);
+                                       return true;
+                                   });
+        slot.erase(kept, slot.end());
+
+        // Scheduled again before polling, so the cadence does not drift with the polls.
+        for (const auto& entry : due)
+        {
+            const double delay = static_cast<double>(entry->interval_ticks) *
+                                 (1.0 + scheduler_options.jitter * spread(random));
+            insert_locked(entry, std::max<uint64_t>(1, std::llround(delay)));
+        }
+        if (due.empty())
+        {
+            continue;
+        }
+
+        lock.unlock();
+        uint64_t sent = 0;
+        uint64_t coalesced = 0;
+        uint64_t failed = 0;
+        for (const auto& entry : due)
+        {
+            if (entry->subscription->is_poll_pending())
+            {
+                // Only the thread of the scheduler touches the count, without the lock.
+                entry->pending_intervals++;
+                if (scheduler_options.poll_timeout_intervals == 0 ||
+                    entry->pending_intervals < scheduler_options.poll_timeout_intervals)
+                {
+                    coalesced++;
+                    continue;
+                }
+                // The target did not answer, the poll is dropped and asked again.
+                if (entry->subscription->expire_poll())
+                {
+                    failed++;
+                }
+            }
+            entry->pending_intervals = 0;
+            if (entry->subscription->poll() == error_code::SUCCESS)
+            {
+                sent++;
+            }
+            else
+            {
+                failed++;
+            }
+        }
+        due.clear();
+        lock.lock();
+        statistics.polls_sent += sent;
+        statistics.polls_coalesced += coalesced;
+        statistics.polls_failed += failed;
+    }
+}
+
+/**
+ * @brief Places a schedule in the slot of the wheel it is due in.
+ * @param entry The schedule.
+ * @param delay_ticks The number of ticks from now it is due in, at least 1.
+ */
+void poll_scheduler::insert_locked(const std::shared_ptr<schedule>& entry, uint64_t delay_ticks)
+{
+    entry->due_tick = current_tick + delay_ticks;
+    wheel[entry->due_tick % wheel.size()].push_back(entry);
+}
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_reconnect.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "logger/logger.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Creates the backoff of a policy.
+ * @param policy The policy of the backoff.
+ */
+reconnect_backoff::reconnect_backoff(const reconnect_policy& policy)
+    : policy(policy),
+      backoff_msec(static_cast<double>(policy.initial_backoff.count())),
+      random(std::random_device{}())
+{
+    if (policy.initial_backoff.count() <= 0 || policy.initial_backoff > policy.max_backoff ||
+        !(policy.multiplier >= 1.0) || !(policy.jitter >= 0.0 && policy.jitter <= 1.0))
+    {
+        logger_manager::get_instance().log("Reconnect policy is not valid", log_level::ERROR);
+        throw std::invalid_argument(
+            "Reconnect policy needs 0 < initial_backoff <= max_backoff, multiplier >= 1 "
+            "and jitter in [0, 1]");
+    }
+}
+
+/**
+ * @brief Returns the delay before the next attempt, and counts the attempt.
+ */
+std::chrono::milliseconds reconnect_backoff::next_delay()
+{
+    const double cap = static_cast<double>(policy.max_backoff.count());
+    const double delay = std::min(backoff_msec, cap);
+    backoff_msec = std::min(backoff_msec * policy.multiplier, cap);
+    attempt_count++;
+
+    std::uniform_real_distribution<double> share(1.0 - policy.jitter, 1.0);
+    return std::chrono::milliseconds(static_cast<int64_t>(std::llround(delay * share(random))));
+}
+
+/**
+ * @brief Starts again from the initial backoff.
+ */
+void reconnect_backoff::reset()
+{
+    backoff_msec = static_cast<double>(policy.initial_backoff.count());
+    attempt_count = 0;
+}
+
+/**
+ * @brief Creates a full bucket.
+ * @param attempts_per_second Refill rate of the bucket.
+ * @param burst Size of the bucket.
+ */
+reconnect_limiter::reconnect_limiter(double attempts_per_second, uint32_t burst)
+{
+    set_limit(attempts_per_second, burst);
+}
+
+/**
+ * @brief The limiter shared by every client of the process.
+ */
+reconnect_limiter& reconnect_limiter::global()
+{
+    static reconnect_limiter instance;
+    return instance;
+}
+
+/**
+ * @brief Changes the rate and the size of the bucket, and refills it.
+ * @param attempts_per_second Refill rate of the bucket, 0 does not limit the attempts.
+ * @param burst Size of the bucket.
+ */
+void reconnect_limiter::set_limit(double attempts_per_second, uint32_t burst)
+{
+    std::lock_guard<std::mutex> lock(limiter_mtx);
+    rate = std::max(attempts_per_second, 0.0);
+    capacity = static_cast<double>(std::max<uint32_t>(burst, 1));
+    tokens = capacity;
+    last_refill = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief Takes a token for one attempt.
+ * @return 0 if the attempt can run now, otherwise the delay until its token is refilled.
+ */
+std::chrono::milliseconds reconnect_limiter::acquire()
+{
+    std::lock_guard<std::mutex> lock(limiter_mtx);
+    if (rate == 0.0)
+    {
+        return std::chrono::milliseconds(0);
+    }
+    const auto now = std::chrono::steady_clock::now();
+    tokens = std::min(capacity,
+                      tokens + std::chrono::duration<double>(now - last_refill).count() * rate);
+    last_refill = now;
+    tokens -= 1.0;
+    if (tokens >= 0.0)
+    {
+        return std::chrono::milliseconds(0);
+    }
+    // Negative tokens are the attempts already postponed, this one is served after them.
+    return std::chrono::milliseconds(static_cast<int64_t>(std::ceil(-tokens / rate * 1000.0)));
+}
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_subscribe_call.h"
+#include <utility>
+#include "logger/logger.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Creates a call bound to one of the completion queues of the engine.
+ * @param engine The engine that drives the call.
+ * @param on_response Handler called for every response received.
+ * @param on_finish Handler called once the RPC is finished.
+ */
+gnmi_subscribe_call::gnmi_subscribe_call(std::shared_ptr<gnmi_async_engine> engine,
+                                         response_handler on_response, finish_handler on_finish)
+    : engine(std::move(engine)),
+      on_response(std::move(on_response)),
+      on_finish(std::move(on_finish))
+{
+    completion_queue = this->engine->next_completion_queue();
+}
+
+/**
+ * @brief Creates a call bound to the given completion queue of the engine.
+ * @param engine The engine that drives the call.
+ * @param completion_queue The completion queue of the engine polled for the call.
+ * @param on_response Handler called for every response received.
+ * @param on_finish Handler called once the RPC is finished.
+ */
+gnmi_subscribe_call::gnmi_subscribe_call(std::shared_ptr<gnmi_async_engine> engine,
+                                         grpc::CompletionQueue* completion_queue,
+                                         response_handler on_response, finish_handler on_finish)
+    : engine(std::move(engine)),
+      completion_queue(completion_queue),
+      on_response(std::move(on_response)),
+      on_finish(std::move(on_finish))
+{
+}
+
+/**
+ * @brief Sets up the client context and starts the RPC.
+ * @param stub The stub used to create the RPC.
+ * @param context_args The context arguments for the stream.
+ */
+void gnmi_subscribe_call::start(gnmi::gNMI::Stub& stub, const client_context_args& context_args)
+{
+    context.AddMetadata("username", context_args.username);
+    context.AddMetadata("password", context_args.password);
+    if (context_args.set_deadline)
+    {
+        context.set_deadline(context_args.deadline);
+    }
+
+    std::lock_guard<std::mutex> lock(call_mtx);
+    self = shared_from_this();
+    stream = stub.PrepareAsyncSubscribe(&context, completion_queue);
+    stream->StartCall(&start_tag);
+}
+
+/**
+ * @brief Queues a request to be written on the stream.
+ * @param request The request to write.
+ * @return False if the call is already finishing, true otherwise.
+ */
+bool gnmi_subscribe_call::write(const gnmi::SubscribeRequest& request)
+{
+    std::lock_guard<std::mutex> lock(call_mtx);
+    if (reads_done || finish_requested)
+    {
+        return false;
+    }
+    pending_writes.push_back(request);
+    write_next_locked();
+    return true;
+}
+
+/**
+ * @brief Tries to cancel the RPC.
+ */
+void gnmi_subscribe_call::cancel()
+{
+    context.TryCancel();
+    std::lock_guard<std::mutex> lock(call_mtx);
+    // No read is pending to report the cancellation, ask for the final status directly.
+    if (reads_paused && !reads_done)
+    {
+        reads_paused = false;
+        reads_done = true;
+        finish_locked();
+    }
+}
+
+/**
+ * @brief Reads the next response after the response handler returned false.
+ */
+void gnmi_subscribe_call::resume_reads()
+{
+    std::lock_guard<std::mutex> lock(call_mtx);
+    if (reads_done)
+    {
+        return;
+    }
+    if (reads_paused)
+    {
+        reads_paused = false;
+        stream->Read(&response, &read_tag);
+    }
+    else
+    {
+        resume_requested = true;
+    }
+}
+
+/**
+ * @brief Blocks until the finish handler has run.
+ */
+void gnmi_subscribe_call::wait_finished()
+{
+    if (engine->current_completion_queue() == completion_queue)
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(call_mtx);
+    finished_cv.wait(lock, [this] { return finished; });
+}
+
+/**
+ * @brief Blocks until the finish handler has run, or until the deadline.
+ * @param deadline The time after which the call is no longer waited for.
+ * @return False if the deadline expired first.
+ */
+bool gnmi_subscribe_call::wait_finished_until(std::chrono::steady_clock::time_point deadline)
+{
+    if (engine->current_completion_queue() == completion_queue)
+    {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(call_mtx);
+    if (deadline == std::chrono::steady_clock::time_point::max())
+    {
+        finished_cv.wait(lock, [this] { return finished; });
+        return true;
+    }
+    return finished_cv.wait_until(lock, deadline, [this] { return finished; });
+}
+
+/**
+ * @brief Drops the handlers, the call finishes on its own without calling them.
+ * @return False if a handler is still running.
+ */
+bool gnmi_subscribe_call::detach()
+{
+    detached = true;
+    std::unique_lock<std::timed_mutex> lock(handler_mtx, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        return false;
+    }
+    on_response = nullptr;
+    on_finish = nullptr;
+    return true;
+}
+
+/**
+ * @brief Blocks until the handler running when the call was detached has returned.
+ * @param deadline The time after which the handler is no longer waited for.
+ * @return False if the deadline expired first.
+ */
+bool gnmi_subscribe_call::wait_detached_until(std::chrono::steady_clock::time_point deadline)
+{
+    if (deadline == std::chrono::steady_clock::time_point::max())
+    {
+        std::lock_guard<std::timed_mutex> lock(handler_mtx);
+        return true;
+    }
+    std::unique_lock<std::timed_mutex> lock(handler_mtx, deadline);
+    return lock.owns_lock();
+}
+
+/**
+ * @brief Whether the finish handler has run.
+ */
+bool gnmi_subscribe_call::is_finished()
+{
+    std::lock_guard<std::mutex> lock(call_mtx);
+    return finished;
+}
+
+/**
+ * @brief State machine of the call, runs on a poller thread of the engine.
+ * @param op The operation that completed.
+ * @param ok Whether the operation completed successfully.
+ */
+void gnmi_subscribe_call::on_operation(operation op, bool ok)
+{
+    switch (op)
+    {
+        case operation::START:
+        {
+            std::lock_guard<std::mutex> lock(call_mtx);
+            if (!ok)
+            {
+                reads_done = true;
+                finish_locked();
+                break;
+            }
+            started = true;
+            stream->Read(&response, &read_tag);
+            write_next_locked();
+            break;
+        }
+        case operation::READ:
+        {
+            if (ok)
+            {
+                // Only one read is in flight, so the handler is never called concurrently.
+                bool keep_reading = true;
+                {
+                    std::lock_guard<std::timed_mutex> handler_lock(handler_mtx);
+                    if (on_response && !detached)
+                    {
+                        keep_reading = on_response(response);
+                    }
+                }
+                std::lock_guard<std::mutex> lock(call_mtx);
+                if (keep_reading || resume_requested)
+                {
+                    resume_requested = false;
+                    stream->Read(&response, &read_tag);
+                }
+                else
+                {
+                    reads_paused = true;
+                }
+                break;
+            }
+            std::lock_guard<std::mutex> lock(call_mtx);
+            reads_done = true;
+            finish_locked();
+            break;
+        }
+        case operation::WRITE:
+        {
+            std::lock_guard<std::mutex> lock(call_mtx);
+            write_in_flight = false;
+            if (ok)
+            {
+                pending_writes.pop_front();
+                logger_manager::get_instance().log(
+                    "Subscribe Stream Request: Write operation succeeded", log_level::INFO);
+                write_next_locked();
+            }
+            else
+            {
+                // The stream is broken, the pending read reports the final status.
+                pending_writes.clear();
+                logger_manager::get_instance().log(
+                    "Subscribe Stream Request: Write operation failed", log_level::ERROR);
+            }
+            if (reads_done)
+            {
+                finish_locked();
+            }
+            break;
+        }
+        case operation::FINISH:
+        {
+            {
+                std::lock_guard<std::timed_mutex> handler_lock(handler_mtx);
+                if (on_finish && !detached)
+                {
+                    on_finish(status);
+                }
+            }
+            std::shared_ptr<gnmi_subscribe_call> keep_alive;
+            {
+                std::lock_guard<std::mutex> lock(call_mtx);
+                finished = true;
+                keep_alive = std::move(self);
+            }
+            finished_cv.notify_all();
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Writes the oldest queued request if the stream allows it.
+ */
+void gnmi_subscribe_call::write_next_locked()
+{
+    if (!started || write_in_flight || reads_done || pending_writes.empty())
+    {
+        return;
+    }
+    write_in_flight = true;
+    stream->Write(pending_writes.front(), &write_tag);
+}
+
+/**
+ * @brief Requests the final status once no write is in flight anymore.
+ */
+void gnmi_subscribe_call::finish_locked()
+{
+    if (finish_requested || write_in_flight)
+    {
+        return;
+    }
+    finish_requested = true;
+    stream->Finish(&status, &finish_tag);
+}
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
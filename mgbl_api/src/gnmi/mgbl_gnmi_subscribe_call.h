@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_SUBSCRIBE_CALL_H_
+#define MGBL_GNMI_SUBSCRIBE_CALL_H_
+
+#include <grpcpp/grpcpp.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "gnmi.grpc.pb.h"
+#include "gnmi/mgbl_gnmi_async_engine.h"
+#include "rpc/mgbl_rpc.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief One asynchronous Subscribe RPC driven by a gnmi_async_engine.
+ *
+ * The call keeps at most one Read and one Write in flight. Requests written before
+ * the call is started, or while a write is pending, are queued and sent in order.
+ * Responses are handed to the response handler on a poller thread, one at a time.
+ * The handler returns false to stop reading until `resume_reads` is called, which
+ * lets gRPC flow control push back on the server without blocking the poller thread.
+ * Once the server ends the stream, or the call is cancelled, the finish handler is
+ * called exactly once with the final grpc::Status.
+ *
+ * The call keeps itself alive until the finish handler has run.
+ */
+class gnmi_subscribe_call : public std::enable_shared_from_this<gnmi_subscribe_call>
+{
+   public:
+    using response_handler = std::function<bool(const gnmi::SubscribeResponse&)>;
+    using finish_handler = std::function<void(const grpc::Status&)>;
+
+    /**
+     * @brief Creates a call bound to one of the completion queues of the engine.
+     *
+     * @param engine The engine that drives the call.
+     * @param on_response Handler called for every response received.
+     * @param on_finish Handler called once the RPC is finished.
+     */
+    gnmi_subscribe_call(std::shared_ptr<gnmi_async_engine> engine, response_handler on_response,
+                        finish_handler on_finish);
+
+    /**
+     * @brief Creates a call bound to the given completion queue of the engine.
+     *
+     * Calls sharing a completion queue have their handlers run by the same poller thread.
+     *
+     * @param engine The engine that drives the call.
+     * @param completion_queue The completion queue of the engine polled for the call.
+     * @param on_response Handler called for every response received.
+     * @param on_finish Handler called once the RPC is finished.
+     */
+    gnmi_subscribe_call(std::shared_ptr<gnmi_async_engine> engine,
+                        grpc::CompletionQueue* completion_queue, response_handler on_response,
+                        finish_handler on_finish);
+
+    gnmi_subscribe_call(const gnmi_subscribe_call&) = delete;
+    gnmi_subscribe_call& operator=(const gnmi_subscribe_call&) = delete;
+    gnmi_subscribe_call(gnmi_subscribe_call&&) = delete;
+    gnmi_subscribe_call& operator=(gnmi_subscribe_call&&) = delete;
+    ~gnmi_subscribe_call() = default;
+
+    /**
+     * @brief Sets up the client context and starts the RPC.
+     *
+     * @param stub The stub used to create the RPC.
+     * @param context_args The context arguments for the stream.
+     */
+    void start(gnmi::gNMI::Stub& stub, const client_context_args& context_args);
+
+    /**
+     * @brief Queues a request to be written on the stream.
+     *
+     * @param request The request to write.
+     * @return False if the call is already finishing, true otherwise.
+     */
+    bool write(const gnmi::SubscribeRequest& request);
+
+    /**
+     * @brief Tries to cancel the RPC. The finish handler is called with CANCELLED.
+     */
+    void cancel();
+
+    /**
+     * @brief Reads the next response after the response handler returned false.
+     *
+     * May be called before the handler returned, the read is then not paused.
+     */
+    void resume_reads();
+
+    /**
+     * @brief Blocks until the finish handler has run.
+     *
+     * Returns immediately if called from the poller thread of the completion queue of
+     * the call, as the completion could only be delivered by the calling thread. The
+     * other poller threads of the engine wait like any other thread.
+     */
+    void wait_finished();
+
+    /**
+     * @brief Blocks until the finish handler has run, or until the deadline.
+     *
+     * Returns true immediately if called from the poller thread of the completion queue
+     * of the call, like `wait_finished`.
+     *
+     * @param deadline The time after which the call is no longer waited for.
+     * @return False if the deadline expired first.
+     */
+    bool wait_finished_until(std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * @brief Drops the handlers, the call finishes on its own without calling them.
+     *
+     * Never blocks: a handler running on another thread is left to return, see
+     * `wait_detached_until`. Used when the owner of the call no longer waits for it, the
+     * call releases itself once gRPC finished it.
+     *
+     * @return False if a handler is still running.
+     */
+    bool detach();
+
+    /**
+     * @brief Blocks until the handler running when the call was detached has returned.
+     * @param deadline The time after which the handler is no longer waited for.
+     * @return False if the deadline expired first.
+     */
+    bool wait_detached_until(std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * @brief Whether the finish handler has run.
+     */
+    bool is_finished();
+
+    /**
+     * @brief Returns the completion queue the call is bound to.
+     */
+    grpc::CompletionQueue* get_completion_queue() const
+    {
+        return completion_queue;
+    }
+
+   private:
+    enum class operation
+    {
+        START,
+        READ,
+        WRITE,
+        FINISH
+    };
+
+    class operation_tag : public async_tag
+    {
+       public:
+        operation_tag(gnmi_subscribe_call* owner, operation op) : owner(owner), op(op) {}
+        void proceed(bool ok) override
+        {
+            owner->on_operation(op, ok);
+        }
+
+       private:
+        gnmi_subscribe_call* owner;
+        operation op;
+    };
+
+    void on_operation(operation op, bool ok);
+    void write_next_locked();
+    void finish_locked();
+
+    std::shared_ptr<gnmi_async_engine> engine;
+    grpc::CompletionQueue* completion_queue;
+    response_handler on_response;
+    finish_handler on_finish;
+
+    grpc::ClientContext context;
+    std::unique_ptr<grpc::ClientAsyncReaderWriter<gnmi::SubscribeRequest, gnmi::SubscribeResponse>>
+        stream;
+    gnmi::SubscribeResponse response;
+    grpc::Status status;
+
+    operation_tag start_tag{this, operation::START};
+    operation_tag read_tag{this, operation::READ};
+    operation_tag write_tag{this, operation::WRITE};
+    operation_tag finish_tag{this, operation::FINISH};
+
+    /** Held while a handler runs, so detach can drop them. */
+    std::timed_mutex handler_mtx;
+
+    /** Set by detach, the handlers are no longer called. */
+    std::atomic<bool> detached{false};
+
+    std::mutex call_mtx;
+    std::condition_variable finished_cv;
+    std::deque<gnmi::SubscribeRequest> pending_writes;
+    bool started = false;
+    bool write_in_flight = false;
+    bool reads_paused = false;
+    bool resume_requested = false;
+    bool reads_done = false;
+    bool finish_requested = false;
+    bool finished = false;
+
+    /** Holds the call alive while operations are pending on the completion queue. */
+    std::shared_ptr<gnmi_subscribe_call> self;
+};
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
+#endif  // MGBL_GNMI_SUBSCRIBE_CALL_H_
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_subscription.h"
+#include <fmt/format.h>
+#include <utility>
+#include "gnmi/mgbl_gnmi_subscribe_call.h"
+#include "logger/logger.h"
+#include "mgbl_api_impl.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Creates an idle subscription on the stub and engine of a client.
+ * @param client The details of the client the subscription belongs to.
+ * @param interface The counters whose paths are subscribed and which receive the stats.
+ */
+gnmi_subscription::gnmi_subscription(std::shared_ptr<GnmiClientDetails> client,
+                                     std::shared_ptr<GnmiCounters> interface)
+    : client(std::move(client)), interface(std::move(interface))
+{
+}
+
+/**
+ * @brief Starts the RPC of the subscription and sends its request.
+ * @param context_args Configuration for the client context.
+ * @param rpc_args Configuration for the RPC call, including its mode.
+ * @return Error code indicating success or failure.
+ */
+error_code gnmi_subscription::start(const client_context_args& context_args,
+                                    const rpc_args& rpc_args)
+{
+    auto pbr_interface = GnmiClientDetails::pbr_counters_of(interface);
+    if (pbr_interface == nullptr)
+    {
+        return error_code::CLIENT_TYPE_FAILURE;
+    }
+    mgbl_api::rpc_args negotiated = rpc_args;
+    auto prepared =
+        client->prepare_subscription(context_args, negotiated, *pbr_interface, rpc_args.mode);
+    if (prepared.second != error_code::SUCCESS)
+    {
+        return prepared.second;
+    }
+
+    std::lock_guard<std::mutex> lock(subscription_mtx);
+    if (running)
+    {
+        logger_manager::get_instance().log(
+            "Subscription is already running, gNMI allows one request per Subscribe RPC",
+            log_level::ERROR);
+        return error_code::RPC_FAILURE;
+    }
+
+    // A restarted subscription keeps its strand, so its handlers stay in order.
+    if (handler_executor != client->handler_executor)
+    {
+        handler_executor = client->handler_executor;
+        handler_strand =
+            handler_executor != nullptr ? work_stealing_executor::make_strand() : nullptr;
+    }
+    call = std::make_shared<gnmi_subscribe_call>(
+        client->engine,
+        [this](const gnmi::SubscribeResponse& response) { return on_response(response); },
+        [this](const grpc::Status& status) { on_finish(status); });
+    running = true;
+    mode = rpc_args.mode;
+    plan = std::move(prepared.first.plan);
+    poll_pending = false;
+    awaiting_initial_sync = true;
+    call->write(prepared.first.request);
+    call->start(*client->stub, context_args);
+    logger_manager::get_instance().log("Subscription Request: Write operation queued",
+                                       log_level::VERBOSE);
+    return error_code::SUCCESS;
+}
+
+/**
+ * @brief Cancels the RPC of the subscription and waits until it is finished.
+ */
+error_code gnmi_subscription::close()
+{
+    std::shared_ptr<gnmi_subscribe_call> closed_call;
+    std::shared_ptr<executor_strand> strand;
+    {
+        std::lock_guard<std::mutex> lock(subscription_mtx);
+        closed_call = call;
+        strand = handler_strand;
+    }
+    if (closed_call != nullptr)
+    {
+        closed_call->cancel();
+        // Need to wait without the lock, the finish handler runs on a poller thread.
+        closed_call->wait_finished();
+    }
+    if (strand != nullptr)
+    {
+        strand->wait_idle();
+    }
+    return error_code::SUCCESS;
+}
+
+/**
+ * @brief Whether the calling thread runs a handler of the subscription, where it cannot be
+ * destroyed.
+ */
+bool gnmi_subscription::called_from_handler()
+{
+    std::lock_guard<std::mutex> lock(subscription_mtx);
+    if (handler_executor != nullptr && handler_executor->is_worker_thread())
+    {
+        return true;
+    }
+    return call != nullptr &&
+           client->engine->current_completion_queue() == call->get_completion_queue();
+}
+
+/**
+ * @brief Whether the RPC of the subscription is started and not finished.
+ */
+bool gnmi_subscription::is_active()
+{
+    std::lock_guard<std::mutex> lock(subscription_mtx);
+    return running;
+}
+
+/**
+ * @brief Asks the target of a POLL subscription for a snapshot on its open RPC.
+ */
+error_code gnmi_subscription::poll()
+{
+    std::lock_guard<std::mutex> lock(subscription_mtx);
+    if (!running || mode != stream_mode::POLL)
+    {
+        logger_manager::get_instance().log("Poll needs a running subscription in POLL mode",
+                                           log_level::ERROR);
+        return error_code::RPC_FAILURE;
+    }
+    if (poll_pending)
+    {
+        return error_code::SUCCESS;
+    }
+    gnmi::SubscribeRequest request;
+    request.mutable_poll();
+    if (!call->write(request))
+    {
+        return error_code::WRITES_FAILED;
+    }
+    poll_pending = true;
+    return error_code::SUCCESS;
+}
+
+/**
+ * @brief Whether a poll was sent and its sync_response is not received yet.
+ */
+bool gnmi_subscription::is_poll_pending()
+{
+    std::lock_guard<std::mutex> lock(subscription_mtx);
+    return poll_pending;
+}
+
+/**
+ * @brief Gives up on the pending poll, so the next `poll` asks the target again.
+ * @return False if no poll was pending.
+ */
+bool gnmi_subscription::expire_poll()
+{
+    std::lock_guard<std::mutex> lock(subscription_mtx);
+    const bool expired = poll_pending;
+    poll_pending = false;
+    return expired;
+}
+
+/**
+ * @brief Processes one response of the subscription, called on a poller thread.
+ * @param response The response received on the RPC.
+ * @return Always true, the subscription keeps reading.
+ */
+bool gnmi_subscription::on_response(const gnmi::SubscribeResponse& response)
+{
+    if (response.sync_response())
+    {
+        std::lock_guard<std::mutex> lock(subscription_mtx);
+        // The first one ends the initial updates of the RPC, not a poll sent meanwhile.
+        if (awaiting_initial_sync)
+        {
+            awaiting_initial_sync = false;
+        }
+        else
+        {
+            poll_pending = false;
+        }
+    }
+    auto pbr_interface = std::dynamic_pointer_cast<PBRBase>(interface);
+    auto expected_response_stats =
+        client->check_response(response, *pbr_interface, nullptr, plan.get());
+    if (expected_response_stats.second == internal_error_code::KEY_FILTERED)
+    {
+        return true;
+    }
+    if (expected_response_stats.second != internal_error_code::SUCCESS)
+    {
+        std::string message = fmt::format("Error while processing response: {}",
+                                          static_cast<int>(expected_response_stats.second));
+        logger_manager::get_instance().log(message, log_level::ERROR);
+        return true;
+    }
+    logger_manager::get_instance().log("Subscription received a response.", log_level::VERBOSE);
+
+    for (auto& stat : expected_response_stats.first)
+    {
+        run_handler(
+            [this, pbr_interface, stat = std::move(stat)]()
+            {
+                pbr_interface->add_stats(stat);
+                if (rpc_success_handler)
+                {
+                    rpc_success_handler(pbr_interface);
+                }
+            });
+    }
+    return true;
+}
+
+/**
+ * @brief Reports the final status of the subscription, called on a poller thread.
+ * @param status The final status of the RPC.
+ */
+void gnmi_subscription::on_finish(const grpc::Status& status)
+{
+    {
+        // Cleared before the handler runs, so the handler can start the subscription again.
+        std::lock_guard<std::mutex> lock(subscription_mtx);
+        running = false;
+    }
+    if (status.ok() || status.error_code() == grpc::StatusCode::CANCELLED)
+    {
+        logger_manager::get_instance().log(
+            fmt::format("Subscription rpc passed: {}", status.error_message()), log_level::INFO);
+        return;
+    }
+    logger_manager::get_instance().log(
+        fmt::format("Subscription RPC failed with error: {}", status.error_message()),
+        log_level::ERROR);
+    if (rpc_failed_handler)
+    {
+        run_handler([this, status]() { rpc_failed_handler(status); });
+    }
+}
+
+/**
+ * @brief Runs a handler on the strand of the subscription, or inline if there is none.
+ * @param handler The handler invocation.
+ */
+void gnmi_subscription::run_handler(std::function<void()> handler)
+{
+    if (handler_executor != nullptr && handler_executor->submit(handler_strand, handler))
+    {
+        return;
+    }
+    handler();
+}
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
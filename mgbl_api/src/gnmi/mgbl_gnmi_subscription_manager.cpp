@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_subscription_manager.h"
+#include <fmt/format.h>
+#include <atomic>
+#include <stdexcept>
+#include <utility>
+#include "gnmi/mgbl_gnmi_client.h"
+#include "gnmi/mgbl_gnmi_connection.h"
+#include "logger/logger.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Places every shard on the ring.
+ * @param shards Number of shards.
+ * @param virtual_nodes Number of points of each shard on the ring.
+ */
+consistent_hash_ring::consistent_hash_ring(uint32_t shards, uint32_t virtual_nodes)
+{
+    if (shards == 0 || virtual_nodes == 0)
+    {
+        throw std::invalid_argument("Hash ring needs at least one shard and one virtual node");
+    }
+    for (uint32_t shard = 0; shard < shards; shard++)
+    {
+        for (uint32_t node = 0; node < virtual_nodes; node++)
+        {
+            // On the rare collision the lowest shard keeps the point, the ring stays stable.
+            ring.emplace(hash(fmt::format("shard-{}#{}", shard, node)), shard);
+        }
+    }
+}
+
+/**
+ * @brief Returns the shard owning the given name.
+ * @param name The name to look up.
+ */
+uint32_t consistent_hash_ring::shard_of(const std::string& name) const
+{
+    auto it = ring.lower_bound(hash(name));
+    if (it == ring.end())
+    {
+        it = ring.begin();
+    }
+    return it->second;
+}
+
+/**
+ * @brief Stable 64 bits FNV-1a hash.
+ * @param value The value to hash.
+ */
+uint64_t consistent_hash_ring::hash(const std::string& value)
+{
+    uint64_t result = 14695981039346656037ULL;
+    for (const unsigned char c : value)
+    {
+        result ^= c;
+        result *= 1099511628211ULL;
+    }
+    // FNV-1a alone clusters similar short names, the finalizer spreads them over the ring.
+    result ^= result >> 33;
+    result *= 0xff51afd7ed558ccdULL;
+    result ^= result >> 33;
+    return result;
+}
+
+/**
+ * @brief One event loop of the manager and the counters of the targets it owns.
+ */
+struct gnmi_subscription_manager::shard
+{
+    std::shared_ptr<gnmi_async_engine> engine;
+    uint32_t targets = 0;
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> handler_nsec{0};
+};
+
+/**
+ * @brief Connection and client of one target.
+ */
+struct gnmi_subscription_manager::target_state
+{
+    target_state(gnmi_target&& description, shard* owner)
+        : name(std::move(description.name)),
+          context_args(std::move(description.context_args)),
+          owner(owner)
+    {
+        connection = std::make_unique<gnmi_client_connection>(description.channel_args);
+        counters = std::make_shared<PBRBasic>();
+        counters->keys = std::move(description.keys);
+        client = std::make_unique<GnmiClient>(connection->get_channel(), counters, owner->engine);
+    }
+
+    std::string name;
+    client_context_args context_args;
+    rpc_args args;
+    shard* owner;
+    std::unique_ptr<gnmi_client_connection> connection;
+    std::shared_ptr<PBRBasic> counters;
+    std::unique_ptr<GnmiClient> client;
+};
+
+/**
+ * @brief Creates the event loops and a client for every target.
+ * @param targets The targets to subscribe to.
+ * @param args The subscription rpc metadata shared by every target.
+ * @param manager_options The options of the manager.
+ */
+gnmi_subscription_manager::gnmi_subscription_manager(std::vector<gnmi_target> targets,
+                                                     const rpc_args& args,
+                                                     const options& manager_options)
+    : ring(manager_options.shards, manager_options.virtual_nodes_per_shard),
+      subscription_args(args),
+      manager_options(manager_options)
+{
+    gnmi_async_engine::options engine_options;
+    engine_options.poller_threads = 1;
+    for (uint32_t i = 0; i < manager_options.shards; i++)
+    {
+        shards.push_back(std::make_unique<shard>());
+        shards.back()->engine = std::make_shared<gnmi_async_engine>(engine_options);
+    }
+
+    for (auto& target : targets)
+    {
+        if (targets_by_name.count(target.name) != 0)
+        {
+            logger_manager::get_instance().log(
+                fmt::format("Subscription manager: duplicate target {}", target.name),
+                log_level::ERROR);
+            throw std::invalid_argument("Duplicate target name: " + target.name);
+        }
+        shard* owner = shards[ring.shard_of(target.name)].get();
+        target_states.push_back(std::make_unique<target_state>(std::move(target), owner));
+        target_state& state = *target_states.back();
+        state.args = subscription_args;
+        owner->targets++;
+        targets_by_name[state.name] = &state;
+
+        state.client->set_rpc_success_handler(
+            [this, &state](std::shared_ptr<GnmiCounters> counters)
+            {
+                const auto begin = std::chrono::steady_clock::now();
+                if (on_success)
+                {
+                    on_success(state.name, std::move(counters));
+                }
+                const auto spent = std::chrono::steady_clock::now() - begin;
+                state.owner->samples++;
+                state.owner->handler_nsec +=
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(spent).count();
+            });
+        state.client->set_rpc_failed_handler(
+            [this, &state](grpc::Status status)
+            {
+                if (on_failure)
+                {
+                    on_failure(state.name, std::move(status));
+                }
+            });
+        // The clients of a shard reconnect on its event loop.
+        state.client->set_reconnect_policy(manager_options.reconnect);
+    }
+}
+
+/**
+ * @brief Stops every stream and the event loops.
+ */
+gnmi_subscription_manager::~gnmi_subscription_manager()
+{
+    stop();
+}
+
+/**
+ * @brief Subscribes to every target.
+ * @return error_code::SUCCESS if every subscription was sent, the first error otherwise.
+ */
+error_code gnmi_subscription_manager::start()
+{
+    if (started || stopped)
+    {
+        logger_manager::get_instance().log("Subscription manager can only be started once",
+                                           log_level::ERROR);
+        return error_code::RPC_FAILURE;
+    }
+    started = true;
+    start_time = std::chrono::steady_clock::now();
+
+    error_code result = error_code::SUCCESS;
+    for (auto& target : target_states)
+    {
+        const error_code code =
+            target->client->rpc_register_stats_stream(target->context_args, target->args);
+        if (code != error_code::SUCCESS && result == error_code::SUCCESS)
+        {
+            logger_manager::get_instance().log(
+                fmt::format("Subscription manager: failed to subscribe to {}", target->name),
+                log_level::ERROR);
+            result = code;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Cancels the pending reconnections and closes every stream.
+ */
+void gnmi_subscription_manager::stop()
+{
+    if (stopped)
+    {
+        return;
+    }
+    stopped = true;
+
+    std::vector<GnmiClient*> clients;
+    for (auto& target : target_states)
+    {
+        clients.push_back(target->client.get());
+    }
+    GnmiClient::rpc_stream_close_all(clients);
+}
+
+/**
+ * @brief Returns the counters of the given target, or nullptr if it is unknown.
+ *
+ * The counters are appended to by the shard owning the target, they are read from its success
+ * handler or after stop().
+ *
+ * @param target The name of the target.
+ */
+std::shared_ptr<PBRBasic> gnmi_subscription_manager::get_counters(const std::string& target) const
+{
+    const auto it = targets_by_name.find(target);
+    return it == targets_by_name.end() ? nullptr : it->second->counters;
+}
+
+/**
+ * @brief Returns the throughput of every shard and of the whole manager.
+ */
+subscription_manager_statistics gnmi_subscription_manager::get_statistics() const
+{
+    subscription_manager_statistics statistics;
+    if (started)
+    {
+        statistics.elapsed_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    }
+
+    std::map<const shard*, reconnect_statistics> reconnects;
+    for (const auto& target : target_states)
+    {
+        const reconnect_statistics target_stats = target->client->get_reconnect_statistics();
+        reconnect_statistics& shard_reconnects = reconnects[target->owner];
+        shard_reconnects.failures += target_stats.failures;
+        shard_reconnects.attempts += target_stats.attempts;
+    }
+
+    uint64_t total_handler_nsec = 0;
+    for (const auto& current : shards)
+    {
+        shard_statistics shard_stats;
+        shard_stats.targets = current->targets;
+        shard_stats.samples = current->samples.load();
+        shard_stats.failures = reconnects[current.get()].failures;
+        shard_stats.retries = reconnects[current.get()].attempts;
+        const uint64_t handler_nsec = current->handler_nsec.load();
+        if (statistics.elapsed_seconds > 0.0)
+        {
+            shard_stats.samples_per_second =
+                static_cast<double>(shard_stats.samples) / statistics.elapsed_seconds;
+            shard_stats.handler_utilization =
+                static_cast<double>(handler_nsec) / 1e9 / statistics.elapsed_seconds;
+        }
+        statistics.total.targets += shard_stats.targets;
+        statistics.total.samples += shard_stats.samples;
+        statistics.total.failures += shard_stats.failures;
+        statistics.total.retries += shard_stats.retries;
+        statistics.total.samples_per_second += shard_stats.samples_per_second;
+        total_handler_nsec += handler_nsec;
+        statistics.shards.push_back(shard_stats);
+    }
+    if (statistics.elapsed_seconds > 0.0)
+    {
+        // Averaged over the shards, 1.0 means every event loop is saturated by its handlers.
+        statistics.total.handler_utilization = static_cast<double>(total_handler_nsec) / 1e9 /
+                                               statistics.elapsed_seconds /
+                                               static_cast<double>(shards.size());
+    }
+    return statistics;
+}
+
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_sweep.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <condition_variable>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include "gnmi/mgbl_gnmi_client.h"
+#include "gnmi/mgbl_gnmi_connection.h"
+#include "logger/logger.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+/**
+ * @brief Connection and client of one target.
+ */
+struct gnmi_sweep::target_state
+{
+    target_state(gnmi_target&& description, const std::shared_ptr<gnmi_async_engine>& engine)
+        : name(std::move(description.name)), context_args(std::move(description.context_args))
+    {
+        connection = std::make_unique<gnmi_client_connection>(description.channel_args);
+        counters = std::make_shared<PBRBasic>();
+        counters->keys = std::move(description.keys);
+        client = engine != nullptr
+                     ? std::make_unique<GnmiClient>(connection->get_channel(), counters, engine)
+                     : std::make_unique<GnmiClient>(connection->get_channel(), counters);
+    }
+
+    std::string name;
+    client_context_args context_args;
+    rpc_args args;
+    grpc::Status negotiated;
+    std::chrono::steady_clock::time_point sent;
+    std::unique_ptr<gnmi_client_connection> connection;
+    std::shared_ptr<PBRBasic> counters;
+    std::unique_ptr<GnmiClient> client;
+};
+
+/**
+ * @brief Progress of one run, shared with the handlers of its requests.
+ */
+struct gnmi_sweep::run_state
+{
+    std::mutex run_state_mtx;
+    std::condition_variable done_cv;
+    size_t next = 0;
+    size_t in_flight = 0;
+    size_t completed = 0;
+    size_t max_in_flight = 0;
+    sweep_statistics statistics;
+    std::vector<std::chrono::nanoseconds> latencies;
+    std::mutex handler_mtx;
+    result_handler on_result;
+};
+
+/**
+ * @brief Creates a client for every target.
+ * @param targets The targets to sweep.
+ * @param sweep_options The options of the sweep.
+ */
+gnmi_sweep::gnmi_sweep(std::vector<gnmi_target> targets, const options& sweep_options)
+    : sweep_options(sweep_options)
+{
+    if (sweep_options.max_in_flight == 0 || sweep_options.target_timeout.count() <= 0)
+    {
+        logger_manager::get_instance().log(
+            "Sweep needs at least one request in flight and a positive target timeout",
+            log_level::ERROR);
+        throw std::invalid_argument(
+            "Sweep needs at least one request in flight and a positive target timeout");
+    }
+    std::set<std::string> names;
+    for (auto& target : targets)
+    {
+        if (!names.insert(target.name).second)
+        {
+            logger_manager::get_instance().log(
+                fmt::format("Sweep: duplicate target {}", target.name), log_level::ERROR);
+            throw std::invalid_argument("Duplicate target name: " + target.name);
+        }
+        target_states.push_back(
+            std::make_unique<target_state>(std::move(target), sweep_options.engine));
+    }
+}
+
+/**
+ * @brief Destroys the clients, which waits for their requests.
+ */
+gnmi_sweep::~gnmi_sweep() = default;
+
+/**
+ * @brief Sweeps every target once.
+ * @param args The subscription rpc metadata shared by every target.
+ * @param on_result Handler called with the result of every target.
+ * @return The latency distribution of the sweep.
+ */
+sweep_statistics gnmi_sweep::run(const rpc_args& args, result_handler on_result)
+{
+    std::lock_guard<std::mutex> run_lock(run_mtx);
+    auto state = std::make_shared<run_state>();
+    state->on_result = std::move(on_result);
+    state->statistics.targets = target_states.size();
+    state->max_in_flight = sweep_options.max_in_flight;
+    state->latencies.reserve(target_states.size());
+    for (auto& target : target_states)
+    {
+        target->counters->stats.clear();
+        target->args = args;
+        target->negotiated = grpc::Status::OK;
+        if (args.negotiate)
+        {
+            // The once requests never call Capabilities, so they are fetched here, bounded
+            // like the requests. The arguments are negotiated once, per target.
+            client_context_args context_args = target->context_args;
+            context_args.set_deadline = true;
+            context_args.deadline =
+                std::chrono::system_clock::now() + sweep_options.target_timeout;
+            if (target->client->rpc_negotiate(context_args, target->args) != error_code::SUCCESS)
+            {
+                target->negotiated = grpc::Status(grpc::StatusCode::UNAVAILABLE,
+                                                  "Capabilities failed, request not sent");
+            }
+            target->args.negotiate = false;
+        }
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    launch(state);
+    std::unique_lock<std::mutex> lock(state->run_state_mtx);
+    state->done_cv.wait(lock, [&]() { return state->completed == target_states.size(); });
+    state->statistics.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - begin);
+
+    auto& latencies = state->latencies;
+    std::sort(latencies.begin(), latencies.end());
+    if (!latencies.empty())
+    {
+        // Nearest rank percentiles.
+        auto percentile = [&latencies](size_t rank)
+        { return latencies[(latencies.size() * rank + 99) / 100 - 1]; };
+        state->statistics.min = latencies.front();
+        state->statistics.p50 = percentile(50);
+        state->statistics.p90 = percentile(90);
+        state->statistics.p99 = percentile(99);
+        state->statistics.max = latencies.back();
+    }
+    logger_manager::get_instance().log(
+        fmt::format("Sweep of {} targets: {} succeeded, {} failed in {} ms",
+                    state->statistics.targets, state->statistics.succeeded,
+                    state->statistics.failed,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        state->statistics.elapsed)
+                        .count()),
+        log_level::INFO);
+    return state->statistics;
+}
+
+/**
+ * @brief Returns the counters of the given target.
+ * @param target The name of the target.
+ */
+std::shared_ptr<PBRBasic> gnmi_sweep::get_counters(const std::string& target) const
+{
+    for (const auto& state : target_states)
+    {
+        if (state->name == target)
+        {
+            return state->counters;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Sends the requests of the next targets, up to the in-flight limit.
+ * @param state The run the targets belong to.
+ */
+void gnmi_sweep::launch(const std::shared_ptr<run_state>& state)
+{
+    while (true)
+    {
+        target_state* target = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(state->run_state_mtx);
+            // Only the run state is read until a target is left, run() may have returned.
+            if (state->next == state->statistics.targets ||
+                state->in_flight == state->max_in_flight)
+            {
+                return;
+            }
+            target = target_states[state->next++].get();
+            state->in_flight++;
+        }
+
+        target->sent = std::chrono::steady_clock::now();
+        if (!target->negotiated.ok())
+        {
+            complete(state, *target, error_code::RPC_FAILURE, target->negotiated);
+            continue;
+        }
+        client_context_args context_args = target->context_args;
+        context_args.set_deadline = true;
+        context_args.deadline = std::chrono::system_clock::now() + sweep_options.target_timeout;
+        const error_code started = target->client->rpc_register_stats_once_async(
+            context_args, target->args,
+            [this, state, target](error_code code, grpc::Status status)
+            {
+                complete(state, *target, code, std::move(status));
+                launch(state);
+            });
+        if (started != error_code::SUCCESS)
+        {
+            // Not sent, its slot is taken by the next target of this loop.
+            complete(state, *target, started,
+                     grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, "Request not sent"));
+        }
+    }
+}
+
+/**
+ * @brief Records the result of a target and hands it to the result handler.
+ * @param state The run the target belongs to.
+ * @param target The target whose request ended.
+ * @param code The error code of the request.
+ * @param status The final status of the RPC.
+ */
+void gnmi_sweep::complete(const std::shared_ptr<run_state>& state, target_state& target,
+                          error_code code, grpc::Status status)
+{
+    sweep_result result;
+    result.target = target.name;
+    result.code = code;
+    result.status = std::move(status);
+    result.counters = target.counters;
+    result.latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - target.sent);
+
+    if (state->on_result)
+    {
+        std::lock_guard<std::mutex> handler_lock(state->handler_mtx);
+        state->on_result(result);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state->run_state_mtx);
+        state->in_flight--;
+        state->completed++;
+        state->latencies.push_back(result.latency);
+        if (code == error_code::SUCCESS)
+        {
+            state->statistics.succeeded++;
+        }
+        else
+        {
+            state->statistics.failed++;
+        }
+    }
+    state->done_cv.notify_all();
+}
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "gnmi/mgbl_gnmi_thread.h"
+#include <fmt/format.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include "logger/logger.h"
+
+namespace mgbl_api
+{
+/** \addtogroup gnmi
+ *  @{
+ */
+namespace
+{
+/**
+ * @brief What a new thread needs to set itself up, owned by the thread.
+ */
+struct thread_start
+{
+    thread_role role;
+    uint32_t index;
+    thread_options options;
+    std::function<void(thread_role, uint32_t)> hook;
+    std::function<void()> body;
+};
+
+/**
+ * @brief Applies the options that can only be set by the thread itself.
+ * @param start The options of the thread.
+ */
+void apply_thread_options(const thread_start& start)
+{
+    const thread_options& options = start.options;
+    if (!options.name.empty())
+    {
+        // Linux limits thread names to 15 characters, the index is kept.
+        const std::string suffix = fmt::format("-{}", start.index);
+        const std::string name =
+            options.name.substr(0, 15 - std::min<size_t>(suffix.size(), 15)) + suffix;
+        pthread_setname_np(pthread_self(), name.c_str());
+    }
+    if (!options.cpus.empty())
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (const uint32_t cpu : options.cpus)
+        {
+            CPU_SET(cpu, &cpus);
+        }
+        const int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (result != 0)
+        {
+            logger_manager::get_instance().log(
+                fmt::format("Failed to set the CPU affinity of a library thread: {}",
+                            std::strerror(result)),
+                log_level::ERROR);
+        }
+    }
+    if (options.scheduling == thread_scheduling::OTHER && options.priority != 0)
+    {
+        // The nice value of a Linux thread is set on its thread id.
+        const auto tid = static_cast<id_t>(syscall(SYS_gettid));
+        if (setpriority(PRIO_PROCESS, tid, options.priority) != 0)
+        {
+            logger_manager::get_instance().log(
+                fmt::format("Failed to set the nice value of a library thread: {}",
+                            std::strerror(errno)),
+                log_level::ERROR);
+        }
+    }
+}
+
+/**
+ * @brief Entry point of the threads created by the thread_factory.
+ * @param argument The thread_start of the thread.
+ */
+void* run_thread(void* argument)
+{
+    std::unique_ptr<thread_start> start(static_cast<thread_start*>(argument));
+    apply_thread_options(*start);
+    if (start->hook)
+    {
+        start->hook(start->role, start->index);
+    }
+    start->body();
+    return nullptr;
+}
+
+/**
+ * @brief Returns the POSIX policy of a scheduling, for the explicit ones.
+ */
+int posix_policy(thread_scheduling scheduling)
+{
+    switch (scheduling)
+    {
+        case thread_scheduling::FIFO:
+            return SCHED_FIFO;
+        case thread_scheduling::ROUND_ROBIN:
+            return SCHED_RR;
+        default:
+            return SCHED_OTHER;
+    }
+}
+}  // namespace
+
+gnmi_thread::gnmi_thread(gnmi_thread&& other) noexcept
+    : handle(other.handle), started(other.started)
+{
+    other.started = false;
+}
+
+gnmi_thread& gnmi_thread::operator=(gnmi_thread&& other) noexcept
+{
+    if (started)
+    {
+        std::terminate();
+    }
+    handle = other.handle;
+    started = other.started;
+    other.started = false;
+    return *this;
+}
+
+gnmi_thread::~gnmi_thread()
+{
+    // Same contract as std::thread, a running thread must not lose its handle.
+    if (started)
+    {
+        std::terminate();
+    }
+}
+
+/**
+ * @brief Waits for the thread to exit.
+ */
+void gnmi_thread::join()
+{
+    if (!started)
+    {
+        throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                                "Thread is not joinable");
+    }
+    const int result = pthread_join(handle, nullptr);
+    started = false;
+    if (result != 0)
+    {
+        throw std::system_error(result, std::system_category(), "Failed to join a thread");
+    }
+}
+
+/**
+ * @brief Lets the thread release its resources on exit.
+ */
+void gnmi_thread::detach()
+{
+    if (started)
+    {
+        pthread_detach(handle);
+        started = false;
+    }
+}
+
+/**
+ * @brief Whether the calling thread is this thread.
+ */
+bool gnmi_thread::is_current() const
+{
+    return started && pthread_equal(handle, pthread_self()) != 0;
+}
+
+/**
+ * @brief Gets the singleton instance of the thread_factory.
+ */
+thread_factory& thread_factory::get_instance()
+{
+    static thread_factory instance;
+    return instance;
+}
+
+/**
+ * @brief Names the threads of every role by default.
+ */
+thread_factory::thread_factory() : role_options(4)
+{
+    role_options[static_cast<size_t>(thread_role::POLLER)].name = "gnmi-poller";
+    role_options[static_cast<size_t>(thread_role::WORKER)].name = "gnmi-worker";
+    role_options[static_cast<size_t>(thread_role::CLOSER)].name = "gnmi-closer";
+    role_options[static_cast<size_t>(thread_role::SCHEDULER)].name = "gnmi-poll";
+}
+
+/**
+ * @brief Sets the options of the threads of a role created from now on.
+ * @param role The role of the threads.
+ * @param options The options of the threads.
+ */
+void thread_factory::set_options(thread_role role, const thread_options& options)
+{
+    for (const uint32_t cpu : options.cpus)
+    {
+        if (cpu >= CPU_SETSIZE)
+        {
+            logger_manager::get_instance().log(fmt::format("CPU {} does not exist", cpu),
+                                               log_level::ERROR);
+            throw std::invalid_argument(fmt::format("CPU {} does not exist", cpu));
+        }
+    }
+    int min_priority = 0;
+    int max_priority = 0;
+    if (options.scheduling == thread_scheduling::OTHER)
+    {
+        min_priority = -20;
+        max_priority = 19;
+    }
+    else if (options.scheduling != thread_scheduling::INHERIT)
+    {
+        min_priority = sched_get_priority_min(posix_policy(options.scheduling));
+        max_priority = sched_get_priority_max(posix_policy(options.scheduling));
+    }
+    if (options.priority < min_priority || options.priority > max_priority)
+    {
+        logger_manager::get_instance().log(
+            fmt::format("Thread priority {} is not in [{}, {}]", options.priority, min_priority,
+                        max_priority),
+            log_level::ERROR);
+        throw std::invalid_argument("Thread priority is out of the range of its scheduling");
+    }
+
+    std::lock_guard<std::mutex> lock(factory_mtx);
+    role_options[static_cast<size_t>(role)] = options;
+}
+
+/**
+ * @brief Returns the options of the threads of a role.
+ * @param role The role of the threads.
+ */
+thread_options thread_factory::get_options(thread_role role)
+{
+    std::lock_guard<std::mutex> lock(factory_mtx);
+    return role_options[static_cast<size_t>(role)];
+}
+
+/**
+ * @brief Sets a hook called at the start of every new thread.
+ * @param hook The hook.
+ */
+void thread_factory::set_start_hook(std::function<void(thread_role, uint32_t)> hook)
+{
+    std::lock_guard<std::mutex> lock(factory_mtx);
+    start_hook = std::move(hook);
+}
+
+/**
+ * @brief Creates a thread of the given role, running `body`.
+ * @param role The role of the thread.
+ * @param index The index of the thread within its engine or executor.
+ * @param body The work of the thread.
+ * @return The handle of the thread.
+ */
+gnmi_thread thread_factory::create(thread_role role, uint32_t index, std::function<void()> body)
+{
+    auto start = std::make_unique<thread_start>();
+    start->role = role;
+    start->index = index;
+    start->body = std::move(body);
+    {
+        std::lock_guard<std::mutex> lock(factory_mtx);
+        start->options = role_options[static_cast<size_t>(role)];
+        start->hook = start_hook;
+    }
+    const thread_options& options = start->options;
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    if (options.stack_size != 0)
+    {
+        pthread_attr_setstacksize(&attributes,
+                                  std::max<size_t>(options.stack_size, PTHREAD_STACK_MIN));
+    }
+    const bool real_time = options.scheduling == thread_scheduling::FIFO ||
+                           options.scheduling == thread_scheduling::ROUND_ROBIN;
+    if (real_time)
+    {
+        sched_param parameters{};
+        parameters.sched_priority = options.priority;
+        pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attributes, posix_policy(options.scheduling));
+        pthread_attr_setschedparam(&attributes, &parameters);
+    }
+
+    gnmi_thread thread;
+    int result = pthread_create(&thread.handle, &attributes, run_thread, start.get());
+    if (result == EPERM && real_time)
+    {
+        logger_manager::get_instance().log(
+            "Not allowed to use a real time scheduling, the library thread inherits it",
+            log_level::ERROR);
+        pthread_attr_setinheritsched(&attributes, PTHREAD_INHERIT_SCHED);
+        result = pthread_create(&thread.handle, &attributes, run_thread, start.get());
+    }
+    pthread_attr_destroy(&attributes);
+    if (result != 0)
+    {
+        logger_manager::get_instance().log(
+            fmt::format("Failed to create a library thread: {}", std::strerror(result)),
+            log_level::ERROR);
+        throw std::system_error(result, std::system_category(), "Failed to create a thread");
+    }
+    // Owned by the thread from now on.
+    start.release();
+    thread.started = true;
+    return thread;
+}
+/** @}*/  // end of gnmi
+}  // namespace mgbl_api
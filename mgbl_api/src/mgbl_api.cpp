@@ -19,14 +19,24 @@
 
 #include "mgbl_api.h"
 #include <fmt/format.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <exception>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <map>
 #include <nlohmann/json.hpp>
-#include <regex>
 #include <stdexcept>
 #include <string>
+#include "gnmi/mgbl_gnmi_channel_pool.h"
 #include "gnmi/mgbl_gnmi_client.h"
 #include "gnmi/mgbl_gnmi_helper.h"
+#include "gnmi/mgbl_gnmi_thread.h"
 #include "mgbl_api_impl.h"
 #include "pbr/mgbl_pbr.h"
 
@@ -39,6 +49,117 @@ using json = nlohmann::json;
  *  @{
  */
 
+namespace
+{
+/**
+ * @brief Converts the tuning of a channel to its gRPC channel arguments.
+ * @param tuning The tuning of the channel.
+ * @return The channel arguments, with only the knobs which are set.
+ */
+grpc::ChannelArguments make_channel_arguments(const channel_tuning& tuning)
+{
+    const bool invalid =
+        tuning.max_receive_message_size < -1 || tuning.max_send_message_size < -1 ||
+        tuning.http2_stream_window < 0 || tuning.http2_max_frame_size < 0 ||
+        tuning.http2_write_buffer_size < 0 || tuning.http2_max_pings_without_data < -1 ||
+        tuning.keepalive_time.count() < 0 || tuning.keepalive_timeout.count() < 0 ||
+        tuning.initial_reconnect_backoff.count() < 0 ||
+        tuning.min_reconnect_backoff.count() < 0 || tuning.max_reconnect_backoff.count() < 0 ||
+        (tuning.min_reconnect_backoff.count() != 0 && tuning.max_reconnect_backoff.count() != 0 &&
+         tuning.min_reconnect_backoff > tuning.max_reconnect_backoff);
+    if (invalid)
+    {
+        logger_manager::get_instance().log("Channel tuning has a negative or inconsistent value",
+                                           log_level::ERROR);
+        throw std::invalid_argument("Channel tuning has a negative or inconsistent value");
+    }
+
+    grpc::ChannelArguments arguments;
+    if (tuning.max_receive_message_size != 0)
+    {
+        arguments.SetMaxReceiveMessageSize(tuning.max_receive_message_size);
+    }
+    if (tuning.max_send_message_size != 0)
+    {
+        arguments.SetMaxSendMessageSize(tuning.max_send_message_size);
+    }
+    if (tuning.http2_stream_window != 0)
+    {
+        arguments.SetInt(GRPC_ARG_HTTP2_STREAM_LOOKAHEAD_BYTES, tuning.http2_stream_window);
+    }
+    if (tuning.http2_max_frame_size != 0)
+    {
+        arguments.SetInt(GRPC_ARG_HTTP2_MAX_FRAME_SIZE, tuning.http2_max_frame_size);
+    }
+    if (tuning.http2_write_buffer_size != 0)
+    {
+        arguments.SetInt(GRPC_ARG_HTTP2_WRITE_BUFFER_SIZE, tuning.http2_write_buffer_size);
+    }
+    if (!tuning.http2_bdp_probe)
+    {
+        arguments.SetInt(GRPC_ARG_HTTP2_BDP_PROBE, 0);
+    }
+    if (tuning.keepalive_time.count() != 0)
+    {
+        arguments.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS,
+                         static_cast<int>(tuning.keepalive_time.count()));
+    }
+    if (tuning.keepalive_timeout.count() != 0)
+    {
+        arguments.SetInt(GRPC_ARG_KEEPALIVE_TIMEOUT_MS,
+                         static_cast<int>(tuning.keepalive_timeout.count()));
+    }
+    if (tuning.keepalive_permit_without_calls)
+    {
+        arguments.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+    }
+    if (tuning.http2_max_pings_without_data != -1)
+    {
+        arguments.SetInt(GRPC_ARG_HTTP2_MAX_PINGS_WITHOUT_DATA,
+                         tuning.http2_max_pings_without_data);
+    }
+    if (tuning.initial_reconnect_backoff.count() != 0)
+    {
+        arguments.SetInt(GRPC_ARG_INITIAL_RECONNECT_BACKOFF_MS,
+                         static_cast<int>(tuning.initial_reconnect_backoff.count()));
+    }
+    if (tuning.min_reconnect_backoff.count() != 0)
+    {
+        arguments.SetInt(GRPC_ARG_MIN_RECONNECT_BACKOFF_MS,
+                         static_cast<int>(tuning.min_reconnect_backoff.count()));
+    }
+    if (tuning.max_reconnect_backoff.count() != 0)
+    {
+        arguments.SetInt(GRPC_ARG_MAX_RECONNECT_BACKOFF_MS,
+                         static_cast<int>(tuning.max_reconnect_backoff.count()));
+    }
+    if (tuning.buffer_pool_bytes != 0)
+    {
+        grpc::ResourceQuota quota("mgbl_api_channel");
+        quota.Resize(tuning.buffer_pool_bytes);
+        arguments.SetResourceQuota(quota);
+    }
+    return arguments;
+}
+}  // namespace
+
+/**
+ * @brief Returns the tuning suggested for high throughput telemetry.
+ */
+channel_tuning channel_tuning::high_throughput()
+{
+    channel_tuning tuning;
+    tuning.max_receive_message_size = 64 * 1024 * 1024;
+    tuning.http2_stream_window = 4 * 1024 * 1024;
+    tuning.http2_max_frame_size = 1024 * 1024;
+    tuning.keepalive_time = std::chrono::milliseconds(60000);
+    tuning.keepalive_timeout = std::chrono::milliseconds(20000);
+    tuning.initial_reconnect_backoff = std::chrono::milliseconds(200);
+    tuning.min_reconnect_backoff = std::chrono::milliseconds(200);
+    tuning.max_reconnect_backoff = std::chrono::milliseconds(5000);
+    return tuning;
+}
+
 /**
  * @brief Creates the gnmi client connection for the user.
  * @param channel_args Configuration for the channel.
@@ -78,7 +199,21 @@ gnmi_client_connection::gnmi_client_connection(const rpc_channel_args& channel_a
     {
         this->creds = grpc::InsecureChannelCredentials();
     }
-    this->channel = grpc::CreateChannel(channel_args.server_address, this->creds);
+    grpc::ChannelArguments arguments = make_channel_arguments(channel_args.tuning);
+    if (channel_args.pool_subchannels == 0)
+    {
+        this->channel =
+            grpc::CreateCustomChannel(channel_args.server_address, this->creds, arguments);
+        return;
+    }
+    // Otherwise the channels of a target would share one connection from the global pool.
+    arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    this->channel = channel_pool::get_instance().acquire(
+        channel_args,
+        [&]() {
+            return grpc::CreateCustomChannel(channel_args.server_address, this->creds,
+                                             arguments);
+        });
 }
 
 /**
@@ -114,389 +249,422 @@ bool gnmi_client_connection::wait_for_grpc_server_connection(
     return false;
 }
 
+namespace
+{
 /**
- * @brief Helper function to populate the subscription request object.
- * @param request Pointer to the SubscribeRequest.
- * @param rpc_args Configuration for the RPC call.
- * @param info Configuration for the subscription paths.
- * @return Internal error code indicating success or failure.
+ * @brief Converts a subscription mode to its gnmi value.
+ * @param mode The subscription mode.
  */
-internal_error_code GnmiClientDetails::subscribe_request_helper(gnmi::SubscribeRequest* request,
-                                                                const rpc_args& rpc_args,
-                                                                const rpc_stream_args& info)
+gnmi::SubscriptionMode to_gnmi_subscription_mode(subscription_mode mode)
 {
-    auto* subscription_list = request->mutable_subscribe();
-
-    subscription_list->set_mode(static_cast<gnmi::SubscriptionList_Mode>(rpc_args.mode));
-
-    // set encoding
-    if (rpc_args.encoding == gnmi::Encoding::JSON_IETF ||
-        rpc_args.encoding == gnmi::Encoding::PROTO)
+    switch (mode)
     {
-        // Default is always set to gnmi::Encoding::PROTO
-        subscription_list->set_encoding(rpc_args.encoding);
+        case subscription_mode::ON_CHANGE:
+            return gnmi::SubscriptionMode::ON_CHANGE;
+        case subscription_mode::TARGET_DEFINED:
+            return gnmi::SubscriptionMode::TARGET_DEFINED;
+        default:
+            return gnmi::SubscriptionMode::SAMPLE;
     }
-    else
+}
+
+/**
+ * @brief Converts a path to a gnmi::Path, or to an empty one if it is invalid.
+ * @param path The path to convert.
+ */
+gnmi::Path to_gnmi_path(const std::string& path)
+{
+    try
     {
-        std::string msg = fmt::format("Unknown encoding: {}", static_cast<int>(rpc_args.encoding));
-        logger_manager::get_instance().log(msg, log_level::ERROR);
-        return internal_error_code::UNSUPPORTED_ENCODING;
+        return string_to_gnmipath(path);
     }
-
-    for (int i = 0; i < info.paths_of_interest.size(); i++)
+    catch (const std::invalid_argument& e)
     {
-        std::string path = info.paths_of_interest.at(i);
-        auto* subscription = subscription_list->add_subscription();
-        subscription->set_mode(gnmi::SubscriptionMode::SAMPLE);
-        subscription->set_sample_interval(rpc_args.sample_interval_nsec);
-        // set path (since we used set_allocated we have to provide the memory but
-        // it will handle freeing it by itself)
-        gnmi::Path* temp_path = new gnmi::Path();
-        try
-        {
-            *temp_path = string_to_gnmipath(path);
-        }
-        catch (const std::invalid_argument& e)
-        {
-            std::string msg = fmt::format(
-                "Invalid argument while attempting to "
-                "convert gnmi path to string: {}",
-                e.what());
-            logger_manager::get_instance().log(msg, log_level::WARNING);
-        }
-        subscription->set_allocated_path(temp_path);
+        std::string msg = fmt::format(
+            "Invalid argument while attempting to "
+            "convert gnmi path to string: {}",
+            e.what());
+        logger_manager::get_instance().log(msg, log_level::WARNING);
     }
-    return internal_error_code::SUCCESS;
+    return gnmi::Path();
 }
 
 /**
- * @brief Checks if the SubscribeResponse object is valid.
- * @param response The SubscribeResponse object.
- * @param response_stats Pointer to the response stats.
- * @param interface The interface object.
- * @return Internal error code indicating success or failure.
+ * @brief Moves the leading elements shared by all the paths into a prefix.
+ *
+ * The paths of the counters carry their origin in their first element, it is moved to the
+ * origin of the prefix. The prefix stops before the first list, so it holds the containers
+ * above the keys, e.g. `pbr-stats/policy-maps`, and every path keeps at least one element.
+ *
+ * @param origin The origin of the paths.
+ * @param paths The paths, made relative to the prefix.
+ * @param prefix The prefix to populate.
  */
-std::pair<std::shared_ptr<PBRBase::pbr_stat>, internal_error_code>
-GnmiClientDetails::check_response(const gnmi::SubscribeResponse& response, PBRBase& pbr_counter)
+void split_common_prefix(const std::string& origin, std::vector<gnmi::Path>& paths,
+                         gnmi::Path* prefix)
 {
-    std::pair<std::shared_ptr<PBRBase::pbr_stat>, internal_error_code> result = {
-        nullptr, internal_error_code::SUCCESS};
-    // Indicate target has sent all values associated with the subscription at
-    // least once.
-    if (response.sync_response())
+    const std::string qualifier = origin + ":";
+    for (auto& path : paths)
     {
-        logger_manager::get_instance().log(
-            "Target has sent all values associated "
-            "with the subscription at least once.",
-            log_level::VERBOSE);
+        if (path.elem_size() > 0 &&
+            path.elem(0).name().compare(0, qualifier.size(), qualifier) == 0)
+        {
+            path.mutable_elem(0)->mutable_name()->erase(0, qualifier.size());
+        }
+    }
+    prefix->set_origin(origin);
+    if (paths.empty())
+    {
+        return;
     }
 
-    if (response.has_update())
+    const gnmi::Path& first = paths.front();
+    int shared = 0;
+    for (; shared < first.elem_size() && first.elem(shared).key().empty(); shared++)
     {
-        std::map<std::string, std::string> flattened_map;
-        const gnmi::Notification& notification = response.update();
-        auto expected_gnmi_map = gnmi_parse_response(notification, pbr_counter.path_origin);
-        if (expected_gnmi_map.second != internal_error_code::SUCCESS)
+        const bool all_share = std::all_of(
+            paths.begin(), paths.end(),
+            [&](const gnmi::Path& path)
+            {
+                return path.elem_size() > shared + 1 &&
+                       path.elem(shared).name() == first.elem(shared).name() &&
+                       path.elem(shared).key().empty();
+            });
+        if (!all_share)
         {
-            return {{}, expected_gnmi_map.second};
+            break;
         }
-        auto pbr_stat = pbr_counter.unordered_map_to_stats(*expected_gnmi_map.first);
-        result.first = pbr_stat;
+        *prefix->add_elem() = first.elem(shared);
     }
-    else
+    for (auto& path : paths)
     {
-        logger_manager::get_instance().log("No new Notifications", log_level::VERBOSE);
-        result.second = internal_error_code::NO_NOTIFICATION;
+        path.mutable_elem()->DeleteSubrange(0, shared);
     }
-    return result;
 }
 
 /**
- * @brief Decode a gnmi::Update as Json IETF format and returns a map of the flattened json
+ * @brief Resolves the path of an update against the prefix of its notification.
  *
- * @param data_update A gnmi::Update object
- * @param flattened_json Pointer to the map to be populated
- * @throws nlohmann::json::exception if the json string is not valid
+ * The policy and rule names are taken from whichever of the two carries them. Every
+ * element after the rule, of the prefix then of the update, is part of the path.
+ *
+ * @param prefix The prefix of the notification.
+ * @param path The path of the update.
+ * @param policy_name Set to the name of the policy of the update, if an element names it.
+ * @param rule_name Set to the name of the rule of the update, if an element names it.
+ * @return The path below the rule, e.g. "/fib-stats/byte-count", or the path of the update
+ * if no element names the rule.
  */
-void GnmiClientDetails::gnmi_decode_json_ietf(
-    const gnmi::Update& data_update,
-    std::shared_ptr<std::unordered_map<std::string, std::string>>& flattened_json)
+std::string resolve_update_path(const gnmi::Path& prefix, const gnmi::Path& path,
+                                std::string& policy_name, std::string& rule_name)
 {
-    std::string json_string = data_update.val().json_ietf_val();
-    nlohmann::json json_struct = nlohmann::json::parse(json_string);
-
-    std::unordered_map<std::string, std::string> result;
-    auto flatten_struct = json_struct.flatten();
-    for (auto it = flatten_struct.begin(); it != flatten_struct.end(); ++it)
+    std::string resolved;
+    bool below_rule = false;
+    const auto visit = [&](const gnmi::PathElem& elem, bool in_update)
     {
-        std::string key = it.key();
-        std::string new_key = key;
-
-        if (key.find("/0/") != std::string::npos)
-        {
-            // Replace /0/ with /
-            new_key = std::regex_replace(key, std::regex("/0/"), "/");
-        }
-        else
+        if (elem.name() == "policy-map")
         {
-            new_key = key;
+            const auto it = elem.key().find("policy-name");
+            if (it != elem.key().end())
+            {
+                policy_name = it->second;
+            }
         }
-
-        if (it.value().type() == nlohmann::json::value_t::string)
+        else if (elem.name() == "rule-name")
         {
-            // If type is already string then dump with put the string in another string
-            result[new_key] = it.value();
+            const auto it = elem.key().find("rule-name");
+            if (it != elem.key().end())
+            {
+                rule_name = it->second;
+                resolved.clear();
+                below_rule = true;
+                return;
+            }
         }
-        else
+        if (in_update || below_rule)
         {
-            result[new_key] = it.value().dump();
+            resolved += '/';
+            resolved += elem.name();
+            for (const auto& key : elem.key())
+            {
+                resolved += '[' + key.first + '=' + key.second + ']';
+            }
         }
+    };
+    for (const auto& elem : prefix.elem())
+    {
+        visit(elem, false);
     }
-    flattened_json->insert(result.begin(), result.end());
+    for (const auto& elem : path.elem())
+    {
+        visit(elem, true);
+    }
+    return resolved;
 }
+
 /**
- * @brief Decode a gnmi::Update as Proto format and returns a map of the flattened proto
- *
- * @param data_update A gnmi::Update object
- * @param flattened_proto Pointer to the map to be populated
+ * @brief Removes the list indices of a flattened json pointer, "/a/0/b" becomes "/a/b".
+ * @param pointer The json pointer.
  */
-void GnmiClientDetails::gnmi_decode_proto(
-    const gnmi::Update& data_update,
-    std::shared_ptr<std::unordered_map<std::string, std::string>>& flattened_proto)
+std::string remove_list_indices(const std::string& pointer)
 {
-    const std::string partial_path = gnmipath_to_string(data_update.path());
-    const gnmi::TypedValue& typedVal = data_update.val();
+    std::string result;
+    result.reserve(pointer.size());
+    std::string::size_type start = 0;
+    std::string::size_type found = pointer.find("/0/");
+    while (found != std::string::npos)
+    {
+        result.append(pointer, start, found - start);
+        result += '/';
+        start = found + 3;
+        found = pointer.find("/0/", start);
+    }
+    result.append(pointer, start, std::string::npos);
+    return result;
+}
 
-    switch (typedVal.value_case())
+/**
+ * @brief Serializes a message with a stable order of its map fields, e.g. the path keys.
+ * @param message The message to serialize.
+ */
+std::string deterministic_bytes(const google::protobuf::Message& message)
+{
+    std::string bytes;
     {
-        case gnmi::TypedValue::kUintVal:
-            (*flattened_proto)[partial_path] = std::to_string(typedVal.uint_val());
-            break;
-        case gnmi::TypedValue::kIntVal:
-            (*flattened_proto)[partial_path] = std::to_string(typedVal.int_val());
-            break;
-        case gnmi::TypedValue::kStringVal:
-            (*flattened_proto)[partial_path] = typedVal.string_val();
-            break;
-        case gnmi::TypedValue::kBoolVal:
-            (*flattened_proto)[partial_path] = typedVal.bool_val() ? "true" : "false";
-            break;
-        case gnmi::TypedValue::kDoubleVal:
-            (*flattened_proto)[partial_path] = std::to_string(typedVal.double_val());
-            break;
-        // Add more cases as needed for other value types
-        default:
-            (*flattened_proto)[partial_path] = "unsupported_type";
-            break;
+        google::protobuf::io::StringOutputStream output(&bytes);
+        google::protobuf::io::CodedOutputStream coded(&output);
+        coded.SetSerializationDeterministic(true);
+        message.SerializeToCodedStream(&coded);
     }
-};
+    return bytes;
+}
+
 /**
- * @brief Generates and populates pbr return structure from the subscription response
- *
- * @param notification Reference to the gnmi::Notification object
- * @param pbr_stats Pointer to the pbr_stats structure to be populated
- * @return internal_error_code Error code indicating the result of the operation
+ * @brief Appends a field to a key, prefixed by its size so fields cannot run into each other.
+ * @param key The key to append to.
+ * @param field The field appended.
  */
-std::pair<std::shared_ptr<std::unordered_map<std::string, std::string>>, internal_error_code>
-GnmiClientDetails::gnmi_parse_response(const gnmi::Notification& notification,
-                                       const std::string path_origin)
+void append_key_field(std::string& key, const std::string& field)
 {
-    gnmi::Path prefix;
-    gnmi::Path printed_path;
-    gnmi::Update data_update;
-    gnmi::Path path;
-    gnmi::Encoding encoding = gnmi::Encoding::PROTO;
-    std::shared_ptr<std::unordered_map<std::string, std::string>> result =
-        std::make_shared<std::unordered_map<std::string, std::string>>();
+    key += std::to_string(field.size());
+    key += ':';
+    key += field;
+}
+}  // namespace
 
-    if (!notification.has_prefix())
+/**
+ * @brief Helper function to populate the subscription request object.
+ * @param request Pointer to the SubscribeRequest.
+ * @param rpc_args Configuration for the RPC call.
+ * @param info Configuration for the subscription paths.
+ * @return Internal error code indicating success or failure.
+ */
+internal_error_code GnmiClientDetails::subscribe_request_helper(gnmi::SubscribeRequest* request,
+                                                                const rpc_args& rpc_args,
+                                                                const rpc_stream_args& info)
+{
+    auto* subscription_list = request->mutable_subscribe();
+
+    subscription_list->set_mode(static_cast<gnmi::SubscriptionList_Mode>(rpc_args.mode));
+    subscription_list->set_updates_only(rpc_args.updates_only);
+    for (const auto& model : rpc_args.use_models)
     {
-        logger_manager::get_instance().log("Response contained no prefix", log_level::ERROR);
-        return {nullptr, internal_error_code::NO_PREFIX_IN_RESPONSE};
+        *subscription_list->add_use_models() = model;
     }
-    if (notification.prefix().origin().find(path_origin) != std::string::npos)
+
+    // set encoding
+    if (rpc_args.encoding == gnmi::Encoding::JSON_IETF ||
+        rpc_args.encoding == gnmi::Encoding::PROTO)
     {
-        prefix = notification.prefix();
+        // Default is always set to gnmi::Encoding::PROTO
+        subscription_list->set_encoding(rpc_args.encoding);
     }
     else
     {
-        logger_manager::get_instance().log("Response contained wrong prefix", log_level::ERROR);
-        return {nullptr, internal_error_code::UNKNOWN_ERROR};
+        std::string msg = fmt::format("Unknown encoding: {}", static_cast<int>(rpc_args.encoding));
+        logger_manager::get_instance().log(msg, log_level::ERROR);
+        return internal_error_code::UNSUPPORTED_ENCODING;
     }
 
-    // Update: a set of path-value pairs indicating the path whose value has
-    // changed in the data tree
-    int update_size = notification.update_size();
-    if (update_size == 0)
+    // Without path modes, every key is subscribed as a whole with the mode of the rpc_args.
+    std::vector<path_subscription> path_modes = rpc_args.path_modes;
+    if (path_modes.empty())
     {
-        logger_manager::get_instance().log("Update does not exist.", log_level::VERBOSE);
-        return {nullptr, internal_error_code::NO_UPDATE_IN_NOTIFICATION};
+        path_subscription whole_key;
+        whole_key.mode = rpc_args.path_mode;
+        whole_key.heartbeat_interval_nsec = rpc_args.heartbeat_interval_nsec;
+        whole_key.suppress_redundant = rpc_args.suppress_redundant;
+        path_modes.push_back(whole_key);
     }
 
-    for (int j = 0; j < update_size; j++)
+    // Every path is converted once, the subscriptions only append the relative paths.
+    std::vector<gnmi::Path> key_paths;
+    key_paths.reserve(info.paths_of_interest.size());
+    for (const auto& path : info.paths_of_interest)
     {
-        data_update = notification.update(j);
-        if (!data_update.has_path())
-        {
-            continue;
-        }
-        if (data_update.has_val())
+        key_paths.push_back(to_gnmi_path(path));
+    }
+    if (rpc_args.use_prefix && !info.prefix.empty())
+    {
+        split_common_prefix(info.prefix, key_paths, subscription_list->mutable_prefix());
+    }
+    std::vector<gnmi::Path> relative_paths;
+    relative_paths.reserve(path_modes.size());
+    for (const auto& path_mode : path_modes)
+    {
+        relative_paths.push_back(to_gnmi_path(path_mode.relative_path));
+        // An empty path would subscribe the whole tree of every key instead.
+        if (!path_mode.relative_path.empty() && relative_paths.back().elem_size() == 0)
         {
-            if (data_update.val().has_json_ietf_val())
-            {
-                encoding = gnmi::Encoding::JSON_IETF;
-                path = data_update.path();
-                try
-                {
-                    gnmi_decode_json_ietf(data_update, result);
-                }
-                catch (const nlohmann::json::exception& e)
-                {
-                    std::string msg = fmt::format(
-                        "Json exception while parsing update as Json IETF: {}", e.what());
-                    logger_manager::get_instance().log(msg, log_level::WARNING);
-                }
-                catch (const std::exception& e)
-                {
-                    std::string msg =
-                        fmt::format("Exception while parsing update as Json IETF: {}", e.what());
-                    logger_manager::get_instance().log(msg, log_level::WARNING);
-                }
-            }
-            /* Other type of encodings in the future (Bytes, ASCII, ...) */
-            /* https://github.com/openconfig/reference/blob/master/rpc/gnmi/gnmi-specification.md#23-structured-data-types
-             */
-            else
-            {
-                // Default is protobuf encoding
-                encoding = gnmi::Encoding::PROTO;
-                gnmi_decode_proto(data_update, result);
-            }
+            std::string msg = fmt::format("Invalid relative path: {}", path_mode.relative_path);
+            logger_manager::get_instance().log(msg, log_level::ERROR);
+            return internal_error_code::INVALID_RELATIVE_PATH;
         }
     }
 
-    printed_path = (encoding == gnmi::Encoding::PROTO)
-                       ? prefix  // Path in Protobuf case is reliant on the prefix
-                       : path;
-
-    for (int i = 0; i < printed_path.elem_size(); i++)
+    for (size_t k = 0; k < key_paths.size(); k++)
     {
-        if (printed_path.elem(i).name() == "policy-map")
-        {
-            auto key_map = printed_path.elem(i).key();
-            auto it = key_map.find("policy-name");
-            if (it != key_map.end())
-            {
-                (*result)["policy_name"] = it->second;
-            }
-        }
-        else if (printed_path.elem(i).name() == "rule-name")
+        const gnmi::Path& key_path = key_paths[k];
+        // A key with its own interval, or the one of its class, replaces that of the rpc_args.
+        const uint64_t key_interval =
+            k < info.sample_intervals_nsec.size() && info.sample_intervals_nsec[k] != 0
+                ? info.sample_intervals_nsec[k]
+                : rpc_args.sample_interval_nsec;
+        for (size_t i = 0; i < path_modes.size(); i++)
         {
-            auto key_map = printed_path.elem(i).key();
-            auto it = key_map.find("rule-name");
-            if (it != key_map.end())
+            const path_subscription& path_mode = path_modes[i];
+            auto* subscription = subscription_list->add_subscription();
+            subscription->set_mode(to_gnmi_subscription_mode(path_mode.mode));
+            // An ON_CHANGE path has no sample interval, only its heartbeat.
+            if (path_mode.mode != subscription_mode::ON_CHANGE)
             {
-                (*result)["rule_name"] = it->second;
+                subscription->set_sample_interval(path_mode.sample_interval_nsec != 0
+                                                      ? path_mode.sample_interval_nsec
+                                                      : key_interval);
             }
+            subscription->set_heartbeat_interval(path_mode.heartbeat_interval_nsec);
+            subscription->set_suppress_redundant(path_mode.suppress_redundant);
+            gnmi::Path* path = subscription->mutable_path();
+            *path = key_path;
+            path->mutable_elem()->MergeFrom(relative_paths[i].elem());
         }
     }
+    return internal_error_code::SUCCESS;
+}
 
-    if ((*result)["policy_name"].empty())
+/**
+ * @brief Sets the encoding and the models of the rpc_args from the target capabilities.
+ * @param context_args Configuration for the client context.
+ * @param rpc_args Configuration for the RPC call, updated.
+ * @param origin The origin of the paths of the counters.
+ * @param may_block False if the Capabilities RPC must not be called.
+ * @return False if the capabilities are not available.
+ */
+bool GnmiClientDetails::negotiate(const client_context_args& context_args, rpc_args& rpc_args,
+                                  const std::string& origin, bool may_block)
+{
+    std::shared_ptr<const gnmi::CapabilityResponse> target;
+    if (!may_block)
     {
-        logger_manager::get_instance().log("Could not find policy name on return path",
-                                           log_level::ERROR);
-        return {nullptr, internal_error_code::NO_POLICY_NAME_IN_RESPONSE};
+        // Never calls Capabilities, which would block the poller thread of a chained request.
+        if (!capabilities_cache::peek(*capabilities, &target))
+        {
+            logger_manager::get_instance().log(
+                "Capabilities not fetched yet, call rpc_negotiate before the request",
+                log_level::ERROR);
+            return false;
+        }
     }
-
-    if ((*result)["rule_name"].empty())
+    else if (!capabilities_cache::fetch(*capabilities, *stub, context_args, &target).ok())
     {
-        logger_manager::get_instance().log("Could not find rule name on return path",
-                                           log_level::ERROR);
-        return {nullptr, internal_error_code::NO_RULE_NAME_IN_RESPONSE};
+        return false;
     }
-
-    return {std::move(result), internal_error_code::SUCCESS};
+    rpc_args.encoding = select_encoding(*target, rpc_args.encoding);
+    rpc_args.use_models = select_models(*target, origin);
+    return true;
 }
+
 /**
- * @brief Constructor for GnmiClient.
- * @param channel Shared pointer to the grpc::Channel.
- * @param interface The interface object.
- * Creates a stub which is used to make RPC calls.
+ * @brief Returns the PBR counters of an interface, logging an error for any other type.
+ * @param interface The counters of a client or subscription.
+ * @return The PBR counters, nullptr if the interface is not a PBR one.
  */
-GnmiClient::GnmiClient(const std::shared_ptr<grpc::Channel>& channel,
-                       std::shared_ptr<GnmiCounters> interface)
-    : interface(std::move(interface)), impl_(std::make_shared<GnmiClientDetails>())
+std::shared_ptr<PBRBase> GnmiClientDetails::pbr_counters_of(
+    const std::shared_ptr<GnmiCounters>& interface)
 {
-    impl_->stub = gnmi::gNMI::NewStub(channel);
+    /*
+        Further there is implication that everything is a pbr counter, which should be
+        presented in better way codewise, but because that's only one counter to support
+        as for now, then it will be planned with further extensions
+    */
+    if (interface->name() != "pbr")
+    {
+        std::string err_message = fmt::format(
+            "Error, this client can only do one type of request. "
+            "Current request type is {}",
+            interface->name());
+        logger_manager::get_instance().log(err_message, log_level::ERROR);
+        return nullptr;
+    }
+    return std::dynamic_pointer_cast<PBRBase>(interface);
 }
 
 /**
- * @brief Destructor for GnmiClient.
- * Joins the receive thread if it is active.
+ * @brief Negotiates, plans and builds the SubscribeRequest of the keys of a counter.
+ * @param context_args Configuration for the client context.
+ * @param rpc_args Configuration for the RPC call, updated.
+ * @param pbr_counter The counter whose keys are subscribed.
+ * @param mode The mode of the subscription.
+ * @param may_block False if the Capabilities RPC must not be called.
+ * @return The request and its plan, and an error code.
  */
-error_code GnmiClient::rpc_stream_close()
+std::pair<prepared_subscription, error_code> GnmiClientDetails::prepare_subscription(
+    const client_context_args& context_args, rpc_args& rpc_args, PBRBase& pbr_counter,
+    stream_mode mode, bool may_block)
 {
-    if (impl_->receive_thread.joinable())
+    std::pair<prepared_subscription, error_code> prepared({}, error_code::SUCCESS);
+    if (rpc_args.negotiate && !negotiate(context_args, rpc_args, pbr_counter.path_origin,
+                                         may_block) &&
+        !may_block)
     {
-        std::unique_lock<std::mutex> lock(impl_->subscription_mode_stream_mtx);
-        if (impl_->stream_context != nullptr)
-        {
-            impl_->stream_context->TryCancel();
-        }
-
-        // Need to unlock before joining read thread.
-        lock.unlock();
-        impl_->receive_thread.join();
+        prepared.second = error_code::CLIENT_TYPE_FAILURE;
+        return prepared;
     }
-    if (impl_->subscribe_stream_rw != nullptr)
+    prepared.first.plan = std::make_shared<const pbr_subscription_plan>(
+        plan_subscription(pbr_counter, rpc_args));
+
+    rpc_stream_args info;
+    info.paths_of_interest = prepared.first.plan->paths;
+    info.sample_intervals_nsec = prepared.first.plan->sample_intervals_nsec;
+    info.prefix = pbr_counter.path_origin;
+    rpc_args.mode = mode;
+    if (subscribe_request_helper(&prepared.first.request, rpc_args, info) !=
+        internal_error_code::SUCCESS)
     {
-        impl_->subscribe_stream_rw.reset();
+        prepared.second = error_code::CLIENT_TYPE_FAILURE;
     }
-    return error_code::SUCCESS;
+    return prepared;
 }
 
 /**
- * @brief Makes a single request to the server.
+ * @brief Sends a subscribe once request and reads its responses until the RPC ends.
  * @param context_args Configuration for the client context.
- * @param rpc_args Configuration for the RPC call.
+ * @param request The SubscribeRequest in ONCE mode.
+ * @param pbr_counter The counter the responses are decoded for.
+ * @param plan The plan of the paths of the request.
+ * @param stats Set to the decoded stats.
  * @return Pair of error code and grpc::Status indicating success or failure.
  */
-std::pair<error_code, grpc::Status> GnmiClient::rpc_register_stats_once(
-    const client_context_args& context_args, rpc_args& rpc_args)
+std::pair<error_code, grpc::Status> GnmiClientDetails::subscribe_once(
+    const client_context_args& context_args, const gnmi::SubscribeRequest& request,
+    PBRBase& pbr_counter, const pbr_subscription_plan& plan,
+    std::vector<std::shared_ptr<PBRBase::pbr_stat>>* stats)
 {
-    error_code err = error_code::SUCCESS;
-    grpc::Status status;
-    gnmi::SubscribeRequest request;
+    std::pair<error_code, grpc::Status> ret_pair(error_code::SUCCESS, grpc::Status());
     gnmi::SubscribeResponse response;
     grpc::WriteOptions wr_opts;
-    rpc_stream_args info;
-
-    std::pair<error_code, grpc::Status> ret_pair(error_code::SUCCESS, status);
-
-    /*
-        Further there is implication that everything is a pbr counter, which should be
-        presented in better way codewise, but because that's only one counter to support
-        as for now, then it will be planned with further extensions
-    */
-    if (interface->name() != "pbr")
-    {
-        std::string err_message = fmt::format(
-            "Error, this client can only do one type of request. "
-            "Current request type is {}\n",
-            interface->name());
-        logger_manager::get_instance().log(err_message, log_level::ERROR);
-        ret_pair.first = error_code::CLIENT_TYPE_FAILURE;
-        return ret_pair;
-    }
-    auto pbr_interface = std::dynamic_pointer_cast<PBRBase>(interface);
 
     grpc::ClientContext stream_once_context;
-    if (context_args.username.empty() || context_args.password.empty())
-    {
-        logger_manager::get_instance().log("Username or password is empty", log_level::ERROR);
-        ret_pair.first = error_code::CLIENT_TYPE_FAILURE;
-        return ret_pair;
-    }
     stream_once_context.AddMetadata("username", context_args.username);
     stream_once_context.AddMetadata("password", context_args.password);
     if (context_args.set_deadline)
@@ -504,13 +672,8 @@ std::pair<error_code, grpc::Status> GnmiClient::rpc_register_stats_once(
         stream_once_context.set_deadline(context_args.deadline);
     }
 
-    info.paths_of_interest = pbr_interface->get_gnmi_paths();
-    info.prefix = pbr_interface->path_origin;
-    rpc_args.mode = stream_mode::ONCE;
-    impl_->subscribe_request_helper(&request, rpc_args, info);
-
     std::shared_ptr<grpc::ClientReaderWriter<gnmi::SubscribeRequest, gnmi::SubscribeResponse>>
-        subscribe_once_rw(impl_->stub->Subscribe(&stream_once_context));
+        subscribe_once_rw(stub->Subscribe(&stream_once_context));
 
     if (subscribe_once_rw->Write(request, wr_opts))
     {
@@ -525,11 +688,12 @@ std::pair<error_code, grpc::Status> GnmiClient::rpc_register_stats_once(
 
     while (subscribe_once_rw->Read(&response))
     {
-        auto expected_response_stats = impl_->check_response(response, *pbr_interface);
+        auto expected_response_stats = check_response(response, pbr_counter, nullptr, &plan);
         if (expected_response_stats.second == internal_error_code::SUCCESS)
         {
             logger_manager::get_instance().log("Client received a response.", log_level::VERBOSE);
-            pbr_interface->add_stats(expected_response_stats.first);
+            stats->insert(stats->end(), expected_response_stats.first.begin(),
+                          expected_response_stats.first.end());
         }
     }
 
@@ -539,10 +703,11 @@ std::pair<error_code, grpc::Status> GnmiClient::rpc_register_stats_once(
             "Signal to server that we are done writing, was unsuccessful", log_level::WARNING);
     }
 
-    status = subscribe_once_rw->Finish();
-    if (!status.ok())
+    ret_pair.second = subscribe_once_rw->Finish();
+    if (!ret_pair.second.ok())
     {
-        std::string result = fmt::format("Subscribe rpc failed: {}", status.error_message());
+        std::string result =
+            fmt::format("Subscribe rpc failed: {}", ret_pair.second.error_message());
         logger_manager::get_instance().log(result, log_level::ERROR);
         ret_pair.first = error_code::RPC_FAILURE;
     }
@@ -550,149 +715,2057 @@ std::pair<error_code, grpc::Status> GnmiClient::rpc_register_stats_once(
     {
         logger_manager::get_instance().log("Subscribe rpc passed ", log_level::INFO);
     }
-    ret_pair.second = status;
     return ret_pair;
 }
 
 /**
- * @brief Makes a stream request to the server.
+ * @brief Reads the stats of the keys of a counter with one Get.
  * @param context_args Configuration for the client context.
  * @param rpc_args Configuration for the RPC call.
- * @return Error code indicating success or failure.
+ * @param pbr_counter The counter whose keys are read.
+ * @param type The data type of the Get.
+ * @param stats Set to the decoded stats of the keys.
+ * @return Status of the Get RPC.
  */
-error_code GnmiClient::rpc_register_stats_stream(const client_context_args& context_args,
-                                                 rpc_args& rpc_args)
+grpc::Status GnmiClientDetails::get_stats(const client_context_args& context_args,
+                                          const rpc_args& rpc_args, PBRBase& pbr_counter,
+                                          gnmi::GetRequest::DataType type,
+                                          std::vector<std::shared_ptr<PBRBase::pbr_stat>>* stats)
 {
-    error_code err = error_code::SUCCESS;
-    gnmi::SubscribeRequest request;
-    grpc::WriteOptions wr_opts;
-    rpc_stream_args info;
+    gnmi::GetRequest request;
+    request.set_type(type);
+    request.set_encoding(rpc_args.encoding);
+    for (const auto& model : rpc_args.use_models)
+    {
+        *request.add_use_models() = model;
+    }
+    const pbr_subscription_plan plan = plan_subscription(pbr_counter, rpc_args);
+    std::vector<gnmi::Path> key_paths;
+    for (const auto& path : plan.paths)
+    {
+        key_paths.push_back(to_gnmi_path(path));
+    }
+    if (rpc_args.use_prefix)
+    {
+        split_common_prefix(pbr_counter.path_origin, key_paths, request.mutable_prefix());
+    }
+    for (auto& path : key_paths)
+    {
+        *request.add_path() = std::move(path);
+    }
 
-    if (interface->name() != "pbr")
+    grpc::ClientContext context;
+    context.AddMetadata("username", context_args.username);
+    context.AddMetadata("password", context_args.password);
+    if (context_args.set_deadline)
     {
-        std::string err_message = fmt::format(
-            "Error, this client can only do one type of request. "
-            "Current request type is {}",
-            interface->name());
-        logger_manager::get_instance().log(err_message, log_level::ERROR);
-        return error_code::CLIENT_TYPE_FAILURE;
+        context.set_deadline(context_args.deadline);
+    }
+    gnmi::GetResponse response;
+    const grpc::Status status = stub->Get(&context, request, &response);
+    if (!status.ok())
+    {
+        return status;
     }
 
-    auto pbr_interface = std::dynamic_pointer_cast<PBRBase>(interface);
-    info.paths_of_interest = pbr_interface->get_gnmi_paths();
-    info.prefix = pbr_interface->path_origin;
-    rpc_args.mode = stream_mode::STREAM;
-    impl_->subscribe_request_helper(&request, rpc_args, info);
+    for (const auto& notification : response.notification())
+    {
+        // A notification of a target returning every list entry at once holds several rules.
+        decode_notification(notification, pbr_counter, &plan, stats, nullptr);
+    }
+    return status;
+}
+
+/**
+ * @brief Checks if the SubscribeResponse object is valid.
+ * @param response The SubscribeResponse object.
+ * @param pbr_counter The counter the response is decoded for.
+ * @param keys If not nullptr, set to the policy and rule names of every stat.
+ * @param plan If not nullptr, the plan whose wildcards may bring rules which are not keys.
+ * @return The stats of the rules of the response and an internal error code.
+ */
+std::pair<std::vector<std::shared_ptr<PBRBase::pbr_stat>>, internal_error_code>
+GnmiClientDetails::check_response(const gnmi::SubscribeResponse& response, PBRBase& pbr_counter,
+                                  std::vector<std::string>* keys,
+                                  const pbr_subscription_plan* plan)
+{
+    std::pair<std::vector<std::shared_ptr<PBRBase::pbr_stat>>, internal_error_code> result = {
+        {}, internal_error_code::SUCCESS};
+    // Indicate target has sent all values associated with the subscription at
+    // least once.
+    if (response.sync_response())
+    {
+        logger_manager::get_instance().log(
+            "Target has sent all values associated "
+            "with the subscription at least once.",
+            log_level::VERBOSE);
+    }
 
-    // Check if the receive thread is active. If not then we have to create it.
-    if (!impl_->receive_thread.joinable())
+    if (response.has_update())
+    {
+        result.second = decode_notification(response.update(), pbr_counter, plan, &result.first,
+                                             keys);
+    }
+    else
     {
-        std::lock_guard<std::mutex> lock(impl_->subscription_mode_stream_mtx);
+        logger_manager::get_instance().log("No new Notifications", log_level::VERBOSE);
+        result.second = internal_error_code::NO_NOTIFICATION;
+    }
+    return result;
+}
 
-        impl_->stream_context = std::make_shared<grpc::ClientContext>();
-        impl_->stream_context->AddMetadata("username", context_args.username);
-        impl_->stream_context->AddMetadata("password", context_args.password);
-        if (context_args.set_deadline)
+/**
+ * @brief Decodes the stats of the rules of a notification.
+ * @param notification The notification to decode.
+ * @param pbr_counter The counter the notification is decoded for.
+ * @param plan If not nullptr, the plan whose wildcards may bring rules which are not keys.
+ * @param stats The stats of the rules are appended to it.
+ * @param keys If not nullptr, the policy and rule names of every stat are appended to it.
+ * @return Internal error code indicating success or failure.
+ */
+internal_error_code GnmiClientDetails::decode_notification(
+    const gnmi::Notification& notification, PBRBase& pbr_counter,
+    const pbr_subscription_plan* plan, std::vector<std::shared_ptr<PBRBase::pbr_stat>>* stats,
+    std::vector<std::string>* keys)
+{
+    auto expected_gnmi_maps = gnmi_parse_response(notification, pbr_counter.path_origin);
+    if (expected_gnmi_maps.second != internal_error_code::SUCCESS)
+    {
+        return expected_gnmi_maps.second;
+    }
+    size_t decoded = 0;
+    for (const auto& gnmi_map : expected_gnmi_maps.first)
+    {
+        const std::string& policy = gnmi_map->at("policy_name");
+        const std::string& rule = gnmi_map->at("rule_name");
+        if (plan != nullptr && !plan->is_wanted(policy, rule))
         {
-            impl_->stream_context->set_deadline(context_args.deadline);
+            continue;
         }
+        auto pbr_stat = pbr_counter.unordered_map_to_stats(*gnmi_map);
+        if (pbr_stat == nullptr)
+        {
+            continue;
+        }
+        stats->push_back(std::move(pbr_stat));
+        if (keys != nullptr)
+        {
+            keys->push_back(fmt::format("{}|{}", policy, rule));
+        }
+        decoded++;
+    }
+    return decoded == 0 && plan != nullptr ? internal_error_code::KEY_FILTERED
+                                           : internal_error_code::SUCCESS;
+}
 
-        std::shared_ptr<grpc::ClientReaderWriter<gnmi::SubscribeRequest, gnmi::SubscribeResponse>>
-            srw(impl_->stub->Subscribe(impl_->stream_context.get()));
-        impl_->subscribe_stream_rw = srw;
-
-        /*
-         * This lambda function handles the receive loop for the gNMI stream.
-         * It processes responses and populates pbr_stats via pbr_function_handler.
-         * Once the stream finishes, it cleans up the stream context.
-         */
-        impl_->receive_thread = std::thread(
-            [this]()
-            {
-                gnmi::SubscribeResponse response;
-                // Check response
-                while (impl_->subscribe_stream_rw->Read(&response))
-                {
-                    PBRBase::pbr_stat response_stats;
-                    auto pbr_interface = std::dynamic_pointer_cast<PBRBase>(interface);
-                    // If the interface no longer exists, we do not want to use it
-                    if (pbr_interface == nullptr)
-                    {
-                            continue;
-                    }
-                    auto expected_response_stats = impl_->check_response(response, *pbr_interface);
-                    if (expected_response_stats.second == internal_error_code::SUCCESS)
-                    {
-                        logger_manager::get_instance().log("Client received a response.",
-                                                           log_level::VERBOSE);
-                        pbr_interface->add_stats(expected_response_stats.first);
-                        rpc_success_handler(pbr_interface);
-                    }
-                    else
-                    {
-                        std::string message =
-                            fmt::format("Error while processing response: {}",
-                                        static_cast<int>(expected_response_stats.second));
-                        logger_manager::get_instance().log(message, log_level::ERROR);
-                    }
-                }
-
-                // ClientContext should only be alive for the duration of the stream
-                std::lock_guard<std::mutex> lock(impl_->subscription_mode_stream_mtx);
-
-                impl_->subscribe_stream_rw->WritesDone();
-                grpc::Status status = impl_->subscribe_stream_rw->Finish();
+/**
+ * @brief Decode a gnmi::Update as Json IETF format and returns a map of the flattened json
+ *
+ * @param data_update A gnmi::Update object
+ * @param flattened_json Pointer to the map to be populated
+ * @param resolved_path If not nullptr, the path below the rule the json keys are under.
+ * @throws nlohmann::json::exception if the json string is not valid
+ */
+void GnmiClientDetails::gnmi_decode_json_ietf(
+    const gnmi::Update& data_update,
+    std::shared_ptr<std::unordered_map<std::string, std::string>>& flattened_json,
+    const std::string* resolved_path)
+{
+    nlohmann::json json_struct = nlohmann::json::parse(data_update.val().json_ietf_val());
 
-                if (!status.ok())
-                {
-                    if (status.error_code() != grpc::StatusCode::CANCELLED)
-                    {
-                        std::string result = fmt::format(
-                            "Subscribe stream RPC failed with error: {}", status.error_message());
-                        logger_manager::get_instance().log(result, log_level::ERROR);
-                        rpc_failed_handler(status);
-                    }
-                    else
-                    {
-                        std::string result =
-                            fmt::format("Subscribe rpc passed: {}", status.error_message());
-                        logger_manager::get_instance().log(result, log_level::INFO);
-                    }
-                }
-                else
-                {
-                    logger_manager::get_instance().log("Subscribe rpc passed.", log_level::INFO);
-                }
-            });
-    }
-    /*
-     * Locking required when write is called after disconnect.
-     * In such case, a WritesDone and Finish was called, so prevent a write
-     */
-    std::lock_guard<std::mutex> lock(impl_->subscription_mode_stream_mtx);
-    if (impl_->stream_context != nullptr)
+    std::unordered_map<std::string, std::string> result;
+    auto flatten_struct = json_struct.flatten();
+    for (auto it = flatten_struct.begin(); it != flatten_struct.end(); ++it)
     {
-        bool check_write = impl_->subscribe_stream_rw->Write(request, wr_opts);
-        if (check_write)
+        // Replace /0/ with /
+        std::string new_key = remove_list_indices(it.key());
+        if (resolved_path != nullptr)
         {
-            logger_manager::get_instance().log(
-                "Subscribe Stream Request: Write operation succeeded", log_level::INFO);
+            new_key.insert(0, *resolved_path);
+        }
+
+        if (it.value().type() == nlohmann::json::value_t::string)
+        {
+            // If type is already string then dump with put the string in another string
+            result[new_key] = it.value();
         }
         else
         {
-            logger_manager::get_instance().log("Subscribe Stream Request: Write operation failed",
-                                               log_level::ERROR);
-            err = error_code::WRITES_FAILED;
+            result[new_key] = it.value().dump();
         }
     }
-    else
+    flattened_json->insert(result.begin(), result.end());
+}
+/**
+ * @brief Decode a gnmi::Update as Proto format and returns a map of the flattened proto
+ *
+ * @param data_update A gnmi::Update object
+ * @param flattened_proto Pointer to the map to be populated
+ * @param resolved_path If not nullptr, the path below the rule the value is stored under.
+ */
+void GnmiClientDetails::gnmi_decode_proto(
+    const gnmi::Update& data_update,
+    std::shared_ptr<std::unordered_map<std::string, std::string>>& flattened_proto,
+    const std::string* resolved_path)
+{
+    const std::string partial_path =
+        resolved_path != nullptr ? *resolved_path : gnmipath_to_string(data_update.path());
+    const gnmi::TypedValue& typedVal = data_update.val();
+
+    switch (typedVal.value_case())
     {
-        logger_manager::get_instance().log("Please close the stream. An rpc failure occurred",
-                                           log_level::ERROR);
-        err = error_code::RPC_FAILURE;
+        case gnmi::TypedValue::kUintVal:
+            (*flattened_proto)[partial_path] = std::to_string(typedVal.uint_val());
+            break;
+        case gnmi::TypedValue::kIntVal:
+            (*flattened_proto)[partial_path] = std::to_string(typedVal.int_val());
+            break;
+        case gnmi::TypedValue::kStringVal:
+            (*flattened_proto)[partial_path] = typedVal.string_val();
+            break;
+        case gnmi::TypedValue::kBoolVal:
+            (*flattened_proto)[partial_path] = typedVal.bool_val() ? "true" : "false";
+            break;
+        case gnmi::TypedValue::kDoubleVal:
+            (*flattened_proto)[partial_path] = std::to_string(typedVal.double_val());
+            break;
+        // Add more cases as needed for other value types
+        default:
+            (*flattened_proto)[partial_path] = "unsupported_type";
+            break;
+    }
+};
+/**
+ * @brief Generates and populates pbr return structures from the subscription response
+ *
+ * @param notification Reference to the gnmi::Notification object
+ * @param path_origin The origin the prefix of the notification must have
+ * @return The flattened maps of the rules, one per policy and rule, in the order of their
+ * first update, and an internal_error_code indicating the result of the operation
+ */
+std::pair<std::vector<std::shared_ptr<std::unordered_map<std::string, std::string>>>,
+          internal_error_code>
+GnmiClientDetails::gnmi_parse_response(const gnmi::Notification& notification,
+                                       const std::string path_origin)
+{
+    std::vector<std::shared_ptr<std::unordered_map<std::string, std::string>>> results;
+
+    if (!notification.has_prefix())
+    {
+        logger_manager::get_instance().log("Response contained no prefix", log_level::ERROR);
+        return {{}, internal_error_code::NO_PREFIX_IN_RESPONSE};
+    }
+    const gnmi::Path& prefix = notification.prefix();
+    if (prefix.origin().find(path_origin) == std::string::npos)
+    {
+        logger_manager::get_instance().log("Response contained wrong prefix", log_level::ERROR);
+        return {{}, internal_error_code::UNKNOWN_ERROR};
+    }
+
+    // Update: a set of path-value pairs indicating the path whose value has
+    // changed in the data tree
+    int update_size = notification.update_size();
+    if (update_size == 0)
+    {
+        logger_manager::get_instance().log("Update does not exist.", log_level::VERBOSE);
+        return {{}, internal_error_code::NO_UPDATE_IN_NOTIFICATION};
     }
 
-    return err;
+    // A prefix above the rules lets a notification carry the updates of several rules.
+    std::map<std::pair<std::string, std::string>, size_t> result_of_rule;
+    bool missing_policy = false;
+    bool missing_rule = false;
+    for (const auto& data_update : notification.update())
+    {
+        if (!data_update.has_path())
+        {
+            continue;
+        }
+        std::string policy_name;
+        std::string rule_name;
+        const std::string resolved_path =
+            resolve_update_path(prefix, data_update.path(), policy_name, rule_name);
+        if (policy_name.empty() || rule_name.empty())
+        {
+            missing_policy = missing_policy || policy_name.empty();
+            missing_rule = missing_rule || rule_name.empty();
+            continue;
+        }
+        const auto inserted =
+            result_of_rule.emplace(std::make_pair(policy_name, rule_name), results.size());
+        if (inserted.second)
+        {
+            results.push_back(std::make_shared<std::unordered_map<std::string, std::string>>());
+            (*results.back())["policy_name"] = policy_name;
+            (*results.back())["rule_name"] = rule_name;
+        }
+        auto& result = results[inserted.first->second];
+        if (data_update.has_val())
+        {
+            if (data_update.val().has_json_ietf_val())
+            {
+                try
+                {
+                    gnmi_decode_json_ietf(data_update, result, &resolved_path);
+                }
+                catch (const nlohmann::json::exception& e)
+                {
+                    std::string msg = fmt::format(
+                        "Json exception while parsing update as Json IETF: {}", e.what());
+                    logger_manager::get_instance().log(msg, log_level::WARNING);
+                }
+                catch (const std::exception& e)
+                {
+                    std::string msg =
+                        fmt::format("Exception while parsing update as Json IETF: {}", e.what());
+                    logger_manager::get_instance().log(msg, log_level::WARNING);
+                }
+            }
+            /* Other type of encodings in the future (Bytes, ASCII, ...) */
+            /* https://github.com/openconfig/reference/blob/master/rpc/gnmi/gnmi-specification.md#23-structured-data-types
+             */
+            else
+            {
+                // Default is protobuf encoding
+                gnmi_decode_proto(data_update, result, &resolved_path);
+            }
+        }
+    }
+
+    if (results.empty())
+    {
+        // Without any update naming a rule, the missing policy name is reported first.
+        const bool no_policy = missing_policy || !missing_rule;
+        logger_manager::get_instance().log(no_policy ? "Could not find policy name on return path"
+                                                     : "Could not find rule name on return path",
+                                           log_level::ERROR);
+        return {{},
+                no_policy ? internal_error_code::NO_POLICY_NAME_IN_RESPONSE
+                          : internal_error_code::NO_RULE_NAME_IN_RESPONSE};
+    }
+
+    if (missing_policy || missing_rule)
+    {
+        logger_manager::get_instance().log(
+            "Dropped the updates without policy or rule name on return path", log_level::WARNING);
+    }
+    return {std::move(results), internal_error_code::SUCCESS};
+}
+namespace
+{
+/**
+ * @brief Thread finishing the asynchronous stream closes.
+ *
+ * The streams are cancelled by `rpc_stream_close_async` itself, so the closes queued here
+ * finish concurrently and the thread mostly waits for the last one.
+ */
+class stream_closer
+{
+   public:
+    static stream_closer& instance()
+    {
+        static stream_closer closer;
+        return closer;
+    }
+
+    void post(std::function<void()> task)
+    {
+        std::lock_guard<std::mutex> lock(closer_mtx);
+        tasks.push_back(std::move(task));
+        if (!worker.joinable())
+        {
+            worker = thread_factory::get_instance().create(thread_role::CLOSER, 0,
+                                                           [this] { run(); });
+        }
+        closer_cv.notify_one();
+    }
+
+    ~stream_closer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(closer_mtx);
+            stopping = true;
+        }
+        closer_cv.notify_one();
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+
+   private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(closer_mtx);
+        while (true)
+        {
+            closer_cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+            {
+                return;
+            }
+            std::function<void()> task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+
+    std::mutex closer_mtx;
+    std::condition_variable closer_cv;
+    std::deque<std::function<void()>> tasks;
+    bool stopping = false;
+    gnmi_thread worker;
+};
+
+/**
+ * @brief Returns the time point after the timeout, saturated for the largest timeouts.
+ */
+std::chrono::steady_clock::time_point deadline_after(std::chrono::milliseconds timeout)
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (timeout >= std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::time_point::max() - now))
+    {
+        return std::chrono::steady_clock::time_point::max();
+    }
+    return now + timeout;
+}
+
+/**
+ * @brief Waits on the condition variable until the predicate holds, or until the deadline.
+ * @return False if the deadline expired first.
+ */
+template <typename Predicate>
+bool wait_until_deadline(std::condition_variable& cv, std::unique_lock<std::mutex>& lock,
+                         std::chrono::steady_clock::time_point deadline, Predicate predicate)
+{
+    if (deadline == std::chrono::steady_clock::time_point::max())
+    {
+        cv.wait(lock, predicate);
+        return true;
+    }
+    return cv.wait_until(lock, deadline, predicate);
+}
+}  // namespace
+
+/**
+ * @brief Constructor for GnmiClient.
+ * @param channel Shared pointer to the grpc::Channel.
+ * @param interface The interface object.
+ * Creates a stub which is used to make RPC calls.
+ */
+GnmiClient::GnmiClient(const std::shared_ptr<grpc::Channel>& channel,
+                       std::shared_ptr<GnmiCounters> interface)
+    : GnmiClient(channel, std::move(interface), gnmi_async_engine::default_engine())
+{
+}
+
+/**
+ * @brief Constructor for GnmiClient.
+ * @param channel Shared pointer to the grpc::Channel.
+ * @param interface The interface object.
+ * @param engine The engine driving the stream.
+ * Creates a stub which is used to make RPC calls.
+ */
+GnmiClient::GnmiClient(const std::shared_ptr<grpc::Channel>& channel,
+                       std::shared_ptr<GnmiCounters> interface,
+                       std::shared_ptr<gnmi_async_engine> engine)
+    : interface(std::move(interface)), impl_(std::make_shared<GnmiClientDetails>())
+{
+    impl_->stub = gnmi::gNMI::NewStub(channel);
+    impl_->engine = std::move(engine);
+    impl_->capabilities = capabilities_cache::get_instance().get_entry(channel);
+}
+
+/**
+ * @brief Cancels the stream and waits until it is finished.
+ */
+error_code GnmiClient::rpc_stream_close()
+{
+    std::vector<std::shared_ptr<gnmi_subscribe_call>> calls;
+    const bool had_stream = begin_close(calls);
+    finish_close(calls, had_stream, std::chrono::steady_clock::time_point::max());
+    return error_code::SUCCESS;
+}
+
+/**
+ * @brief Cancels the stream and waits until it is finished, or until the deadline.
+ * @param timeout The longest time waited for the RPCs to finish.
+ * @return error_code::RPC_FAILURE if an RPC did not finish in time.
+ */
+error_code GnmiClient::rpc_stream_close(std::chrono::milliseconds timeout)
+{
+    std::vector<std::shared_ptr<gnmi_subscribe_call>> calls;
+    const bool had_stream = begin_close(calls);
+    const bool in_time = finish_close(calls, had_stream, deadline_after(timeout));
+    return in_time ? error_code::SUCCESS : error_code::RPC_FAILURE;
+}
+
+/**
+ * @brief Cancels the stream and returns, the close is finished by the closer thread.
+ * @return The future result of the close.
+ */
+std::future<error_code> GnmiClient::rpc_stream_close_async()
+{
+    auto calls = std::make_shared<std::vector<std::shared_ptr<gnmi_subscribe_call>>>();
+    const bool had_stream = begin_close(*calls);
+    auto result = std::make_shared<std::promise<error_code>>();
+    std::future<error_code> future = result->get_future();
+    {
+        std::lock_guard<std::mutex> lock(impl_->close_mtx);
+        impl_->closes_in_flight++;
+    }
+    stream_closer::instance().post(
+        [this, calls, had_stream, result]()
+        {
+            finish_close(*calls, had_stream, std::chrono::steady_clock::time_point::max());
+            // Copied first, the client may be destroyed as soon as the count drops to 0.
+            std::shared_ptr<GnmiClientDetails> details = impl_;
+            result->set_value(error_code::SUCCESS);
+            {
+                std::lock_guard<std::mutex> lock(details->close_mtx);
+                details->closes_in_flight--;
+            }
+            details->close_cv.notify_all();
+        });
+    return future;
+}
+
+/**
+ * @brief Closes the streams of many clients together.
+ * @param clients The clients to close.
+ * @param timeout The longest time waited for all the RPCs to finish.
+ * @return error_code::RPC_FAILURE if an RPC did not finish in time.
+ */
+error_code GnmiClient::rpc_stream_close_all(const std::vector<GnmiClient*>& clients,
+                                            std::chrono::milliseconds timeout)
+{
+    const auto deadline = deadline_after(timeout);
+    std::vector<std::vector<std::shared_ptr<gnmi_subscribe_call>>> calls(clients.size());
+    std::vector<bool> had_stream(clients.size());
+    // Every stream is cancelled before waiting for any, so they finish concurrently.
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        had_stream[i] = clients[i]->begin_close(calls[i]);
+    }
+    bool in_time = true;
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        in_time = clients[i]->finish_close(calls[i], had_stream[i], deadline) && in_time;
+    }
+    return in_time ? error_code::SUCCESS : error_code::RPC_FAILURE;
+}
+
+/**
+ * @brief Whether the calling thread runs a handler of the client, where it cannot be destroyed.
+ */
+bool GnmiClient::called_from_handler() const
+{
+    if (impl_->handler_executor != nullptr && impl_->handler_executor->is_worker_thread())
+    {
+        return true;
+    }
+    grpc::CompletionQueue* current_queue = impl_->engine->current_completion_queue();
+    if (current_queue == nullptr)
+    {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(impl_->reconnect.mtx);
+        if (current_queue == impl_->reconnect.queue)
+        {
+            return true;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(impl_->batch.mtx);
+        if (current_queue == impl_->batch.queue)
+        {
+            return true;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(impl_->once_mtx);
+        if (impl_->once_call != nullptr &&
+            impl_->once_call->get_completion_queue() == current_queue)
+        {
+            return true;
+        }
+    }
+    std::lock_guard<std::mutex> lock(impl_->stream.mtx);
+    for (const auto& call : {impl_->stream.call, impl_->stream.pending_call})
+    {
+        if (call != nullptr && call->get_completion_queue() == current_queue)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Waits until the asynchronous closes of the client are finished.
+ */
+void GnmiClient::wait_async_closes()
+{
+    std::unique_lock<std::mutex> lock(impl_->close_mtx);
+    impl_->close_cv.wait(lock, [this] { return impl_->closes_in_flight == 0; });
+}
+
+/**
+ * @brief Takes the calls of the stream and cancels them, and the pending timers.
+ * @param calls Receives the cancelled calls.
+ * @return Whether the stream was open.
+ */
+bool GnmiClient::begin_close(std::vector<std::shared_ptr<gnmi_subscribe_call>>& calls)
+{
+    bool had_stream = false;
+    {
+        std::lock_guard<std::mutex> lock(impl_->stream.mtx);
+        std::lock_guard<std::mutex> reconnect_lock(impl_->reconnect.mtx);
+        calls = std::move(impl_->stream.retired_calls);
+        impl_->stream.retired_calls.clear();
+        if (impl_->stream.pending_call != nullptr)
+        {
+            calls.push_back(std::move(impl_->stream.pending_call));
+            impl_->stream.pending_call = nullptr;
+        }
+        impl_->stream.pending_responses.clear();
+        impl_->stream.pending_done = nullptr;
+        impl_->reconnect.done = nullptr;
+        if (impl_->stream.call != nullptr)
+        {
+            had_stream = true;
+            calls.push_back(std::move(impl_->stream.call));
+            impl_->stream.call = nullptr;
+            if (impl_->reconnect.pending)
+            {
+                impl_->reconnect.alarm->Cancel();
+            }
+        }
+        if (impl_->reconnect.stats.recovering)
+        {
+            // The outage is abandoned, it is not counted as recovered.
+            impl_->reconnect.stats.recovering = false;
+            impl_->reconnect.backoff->reset();
+        }
+    }
+    for (const auto& call : calls)
+    {
+        call->cancel();
+    }
+    if (had_stream)
+    {
+        std::lock_guard<std::mutex> lock(impl_->batch.mtx);
+        if (impl_->batch.timer_pending)
+        {
+            impl_->batch.alarm->Cancel();
+        }
+    }
+    return had_stream;
+}
+
+/**
+ * @brief Waits for the cancelled calls, the timers and the handlers of the stream.
+ * @param calls The calls taken by begin_close.
+ * @param had_stream Whether the stream was open.
+ * @param deadline The time after which the close no longer waits.
+ * @return False if a wait expired before the deadline.
+ */
+bool GnmiClient::finish_close(std::vector<std::shared_ptr<gnmi_subscribe_call>>& calls,
+                              bool had_stream, std::chrono::steady_clock::time_point deadline)
+{
+    if (impl_->handler_executor != nullptr && impl_->handler_executor->is_worker_thread())
+    {
+        // A handler cannot wait for the strands, its worker may be the one to run them. The
+        // calls are only cancelled, a later close or the destructor waits for them.
+        {
+            std::lock_guard<std::mutex> lock(impl_->stream.mtx);
+            impl_->stream.retired_calls.insert(impl_->stream.retired_calls.end(), calls.begin(),
+                                               calls.end());
+            impl_->stream.close_unfinished = impl_->stream.close_unfinished || had_stream;
+        }
+        calls.clear();
+        std::lock_guard<std::mutex> lock(impl_->delivery.mtx);
+        impl_->delivery.blocked_items.clear();
+        return true;
+    }
+
+    bool in_time = true;
+    std::vector<std::shared_ptr<gnmi_subscribe_call>> detached;
+    {
+        // What an earlier close gave up on is waited for again.
+        std::lock_guard<std::mutex> lock(impl_->stream.mtx);
+        detached = std::move(impl_->stream.detached_calls);
+        impl_->stream.detached_calls.clear();
+        had_stream = had_stream || impl_->stream.close_unfinished;
+        impl_->stream.close_unfinished = false;
+    }
+    std::vector<std::shared_ptr<gnmi_subscribe_call>> still_running;
+    for (const auto& call : detached)
+    {
+        if (!call->wait_detached_until(deadline))
+        {
+            still_running.push_back(call);
+            in_time = false;
+        }
+    }
+    for (const auto& call : calls)
+    {
+        // Need to wait without the lock, the finish handler runs on a poller thread.
+        if (!call->wait_finished_until(deadline))
+        {
+            logger_manager::get_instance().log(
+                "Stream not finished before the close deadline, releasing it in the background",
+                log_level::WARNING);
+            if (!call->detach())
+            {
+                still_running.push_back(call);
+            }
+            in_time = false;
+        }
+    }
+    calls.clear();
+
+    if (had_stream)
+    {
+        // A timer is only left alone by the poller thread of its own queue, which dispatches it.
+        grpc::CompletionQueue* current_queue = impl_->engine->current_completion_queue();
+        {
+            std::unique_lock<std::mutex> lock(impl_->reconnect.mtx);
+            if (current_queue == nullptr || current_queue != impl_->reconnect.queue)
+            {
+                in_time = wait_until_deadline(impl_->reconnect.cv, lock, deadline,
+                                              [this] { return !impl_->reconnect.pending; }) &&
+                          in_time;
+            }
+        }
+        {
+            std::unique_lock<std::mutex> lock(impl_->batch.mtx);
+            if (current_queue == nullptr || current_queue != impl_->batch.queue)
+            {
+                in_time = wait_until_deadline(impl_->batch.cv, lock, deadline,
+                                              [this] { return !impl_->batch.timer_pending; }) &&
+                          in_time;
+            }
+        }
+        if (current_queue == nullptr && impl_->delivery.queue != nullptr)
+        {
+            // The drain hands samples to every strand, it ends before they are waited for.
+            std::unique_lock<std::mutex> lock(impl_->delivery.mtx);
+            in_time = wait_until_deadline(impl_->delivery.drain_cv, lock, deadline,
+                                          [this] { return !impl_->delivery.drain_scheduled; }) &&
+                      in_time;
+        }
+        for (const auto& strand : impl_->handler_strands)
+        {
+            in_time = strand->wait_idle_until(deadline) && in_time;
+        }
+    }
+    if (!in_time)
+    {
+        std::lock_guard<std::mutex> lock(impl_->stream.mtx);
+        impl_->stream.detached_calls.insert(impl_->stream.detached_calls.end(),
+                                            still_running.begin(), still_running.end());
+        impl_->stream.close_unfinished = true;
+        return false;
+    }
+    if (!had_stream)
+    {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(impl_->delivery.mtx);
+    if (!impl_->delivery.blocked_items.empty())
+    {
+        logger_manager::get_instance().log(
+            "Stream closed, dropping the samples waiting for the delivery queue",
+            log_level::VERBOSE);
+        impl_->delivery.blocked_items.clear();
+    }
+    return in_time;
+}
+
+/**
+ * @brief Sets the handler called with the stats decoded since its previous call.
+ * @param handler The batch handler.
+ * @param quantum The time the stats are accumulated before calling the handler.
+ * @return error_code::CLIENT_TYPE_FAILURE if the CounterInterface is not PBRBasic.
+ */
+error_code GnmiClient::set_rpc_batch_handler(std::function<void(stat_span<PbrBasicStat>)> handler,
+                                             std::chrono::milliseconds quantum)
+{
+    auto* pbr_basic = dynamic_cast<PBRBasic*>(interface.get());
+    if (pbr_basic == nullptr)
+    {
+        logger_manager::get_instance().log("Batch handler requires a PBRBasic CounterInterface",
+                                           log_level::ERROR);
+        return error_code::CLIENT_TYPE_FAILURE;
+    }
+    impl_->batch.counters = pbr_basic;
+    impl_->batch.stats.clear();
+    if (impl_->batch.tag == nullptr)
+    {
+        impl_->batch.tag =
+            std::make_unique<callback_tag>([this](bool ok) { on_batch_timer(ok); });
+    }
+    rpc_batch_handler = std::move(handler);
+    batch_quantum = quantum;
+    return error_code::SUCCESS;
+}
+
+/**
+ * @brief Sets the cache shared by the once requests, for the target of channel arguments.
+ * @param cache The cache, nullptr to send every request.
+ * @param channel_args The arguments the channel of the client was created with.
+ */
+void GnmiClient::set_once_cache(std::shared_ptr<once_cache> cache,
+                                const rpc_channel_args& channel_args)
+{
+    std::string tls_identity;
+    if (channel_args.ssl_tls)
+    {
+        append_key_field(tls_identity, channel_args.pem_roots_certs_path);
+        append_key_field(tls_identity, channel_args.pem_private_key_path);
+        append_key_field(tls_identity, channel_args.pem_cert_chain_path);
+    }
+    set_once_cache(std::move(cache), channel_args.server_address, std::move(tls_identity));
+}
+
+/**
+ * @brief Reconnects the stream with the given backoff when it fails.
+ * @param policy The backoff of the reconnection.
+ */
+void GnmiClient::set_reconnect_policy(const reconnect_policy& policy)
+{
+    std::unique_ptr<reconnect_backoff> backoff;
+    if (policy.enabled)
+    {
+        backoff = std::make_unique<reconnect_backoff>(policy);
+    }
+    std::lock_guard<std::mutex> lock(impl_->reconnect.mtx);
+    impl_->reconnect.backoff = std::move(backoff);
+    impl_->reconnect.stats.recovering = false;
+    if (impl_->reconnect.backoff == nullptr && impl_->reconnect.pending)
+    {
+        // The timer gives up the outage of the stream right away.
+        impl_->reconnect.alarm->Cancel();
+    }
+    if (impl_->reconnect.tag == nullptr)
+    {
+        impl_->reconnect.tag =
+            std::make_unique<callback_tag>([this](bool ok) { on_reconnect_timer(ok); });
+    }
+}
+
+/**
+ * @brief Returns the reconnection counters of the stream.
+ */
+reconnect_statistics GnmiClient::get_reconnect_statistics() const
+{
+    std::lock_guard<std::mutex> lock(impl_->reconnect.mtx);
+    return impl_->reconnect.stats;
+}
+
+/**
+ * @brief Queues the decoded samples between the poller thread and the handlers.
+ * @param options The capacity and overflow policy of the queue.
+ */
+void GnmiClient::set_delivery_queue(const delivery_queue_options& options)
+{
+    impl_->delivery.queue = std::make_shared<delivery_queue>(options);
+    if (impl_->handler_executor == nullptr)
+    {
+        set_handler_executor(work_stealing_executor::default_executor());
+    }
+}
+
+/**
+ * @brief Returns the counters of the delivery queue.
+ */
+delivery_queue_statistics GnmiClient::get_delivery_statistics() const
+{
+    return impl_->delivery.queue != nullptr ? impl_->delivery.queue->get_statistics()
+                                            : delivery_queue_statistics{};
+}
+
+/**
+ * @brief Runs the stream handlers of the client on strands of the given executor.
+ * @param executor The executor running the handlers, nullptr for the poller thread.
+ * @param key_strands The number of strands the keys are spread over.
+ */
+void GnmiClient::set_handler_executor(std::shared_ptr<work_stealing_executor> executor,
+                                      uint32_t key_strands)
+{
+    impl_->handler_strands.clear();
+    if (executor != nullptr)
+    {
+        for (uint32_t i = 0; i < std::max<uint32_t>(key_strands, 1); i++)
+        {
+            impl_->handler_strands.push_back(work_stealing_executor::make_strand());
+        }
+    }
+    impl_->handler_executor = std::move(executor);
+}
+
+/**
+ * @brief Makes a single request to the server.
+ * @param context_args Configuration for the client context.
+ * @param rpc_args Configuration for the RPC call.
+ * @return Pair of error code and grpc::Status indicating success or failure.
+ */
+std::pair<error_code, grpc::Status> GnmiClient::rpc_register_stats_once(
+    const client_context_args& context_args, rpc_args& rpc_args)
+{
+    std::pair<error_code, grpc::Status> ret_pair(error_code::SUCCESS, grpc::Status());
+    auto pbr_interface = GnmiClientDetails::pbr_counters_of(interface);
+    if (pbr_interface == nullptr)
+    {
+        ret_pair.first = error_code::CLIENT_TYPE_FAILURE;
+        return ret_pair;
+    }
+
+    if (context_args.username.empty() || context_args.password.empty())
+    {
+        logger_manager::get_instance().log("Username or password is empty", log_level::ERROR);
+        ret_pair.first = error_code::CLIENT_TYPE_FAILURE;
+        return ret_pair;
+    }
+
+    auto prepared =
+        impl_->prepare_subscription(context_args, rpc_args, *pbr_interface, stream_mode::ONCE);
+    if (prepared.second != error_code::SUCCESS)
+    {
+        ret_pair.first = prepared.second;
+        return ret_pair;
+    }
+    const gnmi::SubscribeRequest& request = prepared.first.request;
+    auto plan = std::move(prepared.first.plan);
+
+    std::vector<std::shared_ptr<PBRBase::pbr_stat>> stats;
+    auto send = [this, &context_args, &request, &pbr_interface,
+                 &plan](std::vector<std::shared_ptr<PBRBase::pbr_stat>>* received)
+    { return impl_->subscribe_once(context_args, request, *pbr_interface, *plan, received); };
+    if (once_results != nullptr)
+    {
+        // Only the requests with the same credentials share a result.
+        std::string key;
+        append_key_field(key, once_target);
+        append_key_field(key, once_tls_identity);
+        append_key_field(key, context_args.username);
+        append_key_field(key, context_args.password);
+        key += deterministic_bytes(request);
+        ret_pair = once_results->fetch(
+            key, context_args.set_deadline ? &context_args.deadline : nullptr, send, &stats);
+    }
+    else
+    {
+        ret_pair = send(&stats);
+    }
+    for (const auto& stat : stats)
+    {
+        pbr_interface->add_stats(stat);
+    }
+    return ret_pair;
+}
+
+/**
+ * @brief Makes a once request to the server without blocking.
+ * @param context_args Configuration for the client context.
+ * @param rpc_args Configuration for the RPC call.
+ * @param on_done Handler called once the request is finished.
+ * @return Error code indicating whether the request is started.
+ */
+error_code GnmiClient::rpc_register_stats_once_async(
+    const client_context_args& context_args, rpc_args& rpc_args,
+    std::function<void(error_code, grpc::Status)> on_done)
+{
+    auto pbr_interface = GnmiClientDetails::pbr_counters_of(interface);
+    if (pbr_interface == nullptr)
+    {
+        return error_code::CLIENT_TYPE_FAILURE;
+    }
+    if (context_args.username.empty() || context_args.password.empty())
+    {
+        logger_manager::get_instance().log("Username or password is empty", log_level::ERROR);
+        return error_code::CLIENT_TYPE_FAILURE;
+    }
+
+    auto prepared = impl_->prepare_subscription(context_args, rpc_args, *pbr_interface,
+                                                stream_mode::ONCE, false);
+    if (prepared.second != error_code::SUCCESS)
+    {
+        return prepared.second;
+    }
+    const gnmi::SubscribeRequest& request = prepared.first.request;
+    auto plan = std::move(prepared.first.plan);
+
+    std::lock_guard<std::mutex> lock(impl_->once_mtx);
+    if (impl_->once_call != nullptr)
+    {
+        logger_manager::get_instance().log("A once request is already in flight on this client",
+                                           log_level::ERROR);
+        return error_code::RPC_FAILURE;
+    }
+
+    auto on_response = [this, pbr_interface, plan](const gnmi::SubscribeResponse& response)
+    {
+        std::vector<std::string> keys;
+        auto expected_response_stats = impl_->check_response(
+            response, *pbr_interface, impl_->handler_strands.size() > 1 ? &keys : nullptr,
+            plan.get());
+        if (expected_response_stats.second == internal_error_code::SUCCESS)
+        {
+            logger_manager::get_instance().log("Client received a response.", log_level::VERBOSE);
+            auto& stats = expected_response_stats.first;
+            for (size_t i = 0; i < stats.size(); i++)
+            {
+                run_key_handler(i < keys.size() ? keys[i] : std::string(),
+                                [this, pbr_interface, stat = std::move(stats[i])]()
+                                {
+                                    std::lock_guard<std::mutex> lock(impl_->stats_mtx);
+                                    pbr_interface->add_stats(stat);
+                                });
+            }
+        }
+        return true;
+    };
+    auto on_finish = [this, on_done = std::move(on_done)](const grpc::Status& status)
+    {
+        {
+            // Cleared first, so on_done may start the next request.
+            std::lock_guard<std::mutex> once_lock(impl_->once_mtx);
+            impl_->once_call = nullptr;
+        }
+        error_code err = error_code::SUCCESS;
+        if (!status.ok())
+        {
+            std::string result = fmt::format("Subscribe rpc failed: {}", status.error_message());
+            logger_manager::get_instance().log(result, log_level::ERROR);
+            err = error_code::RPC_FAILURE;
+        }
+        else
+        {
+            logger_manager::get_instance().log("Subscribe rpc passed ", log_level::INFO);
+        }
+        if (on_done)
+        {
+            run_handler([on_done, err, status]() { on_done(err, status); });
+        }
+        // Last use of the client, rpc_once_cancel may release it once notified.
+        std::lock_guard<std::mutex> once_lock(impl_->once_mtx);
+        impl_->once_in_flight--;
+        impl_->once_cv.notify_all();
+    };
+
+    impl_->once_in_flight++;
+    impl_->once_call = std::make_shared<gnmi_subscribe_call>(impl_->engine, std::move(on_response),
+                                                             std::move(on_finish));
+    impl_->once_call->write(request);
+    impl_->once_call->start(*impl_->stub, context_args);
+    return error_code::SUCCESS;
+}
+
+/**
+ * @brief Cancels the once request in flight, if any, and waits until its handlers have run.
+ */
+void GnmiClient::rpc_once_cancel()
+{
+    {
+        // Also cancels the requests started by the on_done of the previous ones.
+        std::unique_lock<std::mutex> lock(impl_->once_mtx);
+        while (impl_->once_in_flight > 0)
+        {
+            if (impl_->once_call != nullptr)
+            {
+                impl_->once_call->cancel();
+            }
+            impl_->once_cv.wait(lock);
+        }
+    }
+    for (const auto& strand : impl_->handler_strands)
+    {
+        strand->wait_idle();
+    }
+}
+
+/**
+ * @brief Makes a stream request to the server.
+ * @param context_args Configuration for the client context.
+ * @param rpc_args Configuration for the RPC call.
+ * @return Error code indicating success or failure.
+ */
+error_code GnmiClient::rpc_register_stats_stream(const client_context_args& context_args,
+                                                 rpc_args& rpc_args)
+{
+    auto pbr_interface = GnmiClientDetails::pbr_counters_of(interface);
+    if (pbr_interface == nullptr)
+    {
+        return error_code::CLIENT_TYPE_FAILURE;
+    }
+    auto prepared =
+        impl_->prepare_subscription(context_args, rpc_args, *pbr_interface, stream_mode::STREAM);
+    if (prepared.second != error_code::SUCCESS)
+    {
+        return prepared.second;
+    }
+
+    std::lock_guard<std::mutex> lock(impl_->stream.mtx);
+    if (impl_->stream.call != nullptr)
+    {
+        logger_manager::get_instance().log(
+            "A stream is already open on this client, gNMI allows one request per Subscribe "
+            "RPC. Use subscribe for another subscription, or rpc_resubscribe_stats_stream to "
+            "change the keys",
+            log_level::ERROR);
+        return error_code::RPC_FAILURE;
+    }
+    return open_stream(context_args, rpc_args, prepared.first.request,
+                       std::move(prepared.first.plan));
+}
+
+/**
+ * @brief Opens the stream of the client, called with the stream mutex held.
+ * @param context_args Configuration for the client context.
+ * @param rpc_args Configuration for the RPC call.
+ * @param request The SubscribeRequest of the stream.
+ * @param plan The plan of the paths of the request.
+ * @return Error code indicating success or failure.
+ */
+error_code GnmiClient::open_stream(const client_context_args& context_args,
+                                   const rpc_args& rpc_args, gnmi::SubscribeRequest& request,
+                                   std::shared_ptr<const pbr_subscription_plan> plan)
+{
+    const bool queued = start_stream_call(context_args, request);
+    // Sent again if the stream is reconnected.
+    impl_->stream.request = std::move(request);
+    impl_->stream.context = context_args;
+    impl_->stream.plan = std::move(plan);
+    impl_->stream.resume_updates_only = rpc_args.resume_updates_only;
+
+    if (!queued)
+    {
+        logger_manager::get_instance().log("Please close the stream. An rpc failure occurred",
+                                           log_level::ERROR);
+        return error_code::RPC_FAILURE;
+    }
+    logger_manager::get_instance().log("Subscribe Stream Request: Write operation queued",
+                                       log_level::VERBOSE);
+    return error_code::SUCCESS;
+}
+
+/**
+ * @brief Opens a stream with the current keys, and switches to it once it is in sync.
+ * @param context_args Configuration for the client context.
+ * @param rpc_args Configuration for the RPC call.
+ * @param on_done Handler called once the new keys are in use or the resubscription failed.
+ * @return Error code indicating success or failure.
+ */
+error_code GnmiClient::rpc_resubscribe_stats_stream(const client_context_args& context_args,
+                                                    rpc_args& rpc_args,
+                                                    std::function<void(grpc::Status)> on_done)
+{
+    auto pbr_interface = GnmiClientDetails::pbr_counters_of(interface);
+    if (pbr_interface == nullptr)
+    {
+        return error_code::CLIENT_TYPE_FAILURE;
+    }
+
+    auto prepared =
+        impl_->prepare_subscription(context_args, rpc_args, *pbr_interface, stream_mode::STREAM);
+    if (prepared.second != error_code::SUCCESS)
+    {
+        return prepared.second;
+    }
+    gnmi::SubscribeRequest& request = prepared.first.request;
+    auto plan = std::move(prepared.first.plan);
+
+    // Opening or switching is decided under one hold, a concurrent call cannot open a second.
+    std::unique_lock<std::mutex> lock(impl_->stream.mtx);
+    if (impl_->stream.call == nullptr)
+    {
+        // Nothing to switch from, the keys are in use once the stream is open.
+        const error_code err = open_stream(context_args, rpc_args, request, std::move(plan));
+        lock.unlock();
+        if (err == error_code::SUCCESS && on_done)
+        {
+            run_handler([on_done]() { on_done(grpc::Status::OK); });
+        }
+        return err;
+    }
+
+    // A previous resubscription not in sync yet is superseded by this one.
+    if (impl_->stream.pending_call != nullptr)
+    {
+        impl_->stream.pending_call->cancel();
+        impl_->stream.retired_calls.push_back(std::move(impl_->stream.pending_call));
+        impl_->stream.pending_call = nullptr;
+        impl_->stream.pending_responses.clear();
+    }
+    impl_->stream.pending_done = nullptr;
+    {
+        std::lock_guard<std::mutex> reconnect_lock(impl_->reconnect.mtx);
+        impl_->reconnect.done = nullptr;
+    }
+    impl_->stream.retired_calls.erase(
+        std::remove_if(impl_->stream.retired_calls.begin(), impl_->stream.retired_calls.end(),
+                       [](const std::shared_ptr<gnmi_subscribe_call>& retired)
+                       { return retired->is_finished(); }),
+        impl_->stream.retired_calls.end());
+
+    // On the queue of the current stream, so both are handled by the same poller thread.
+    const uint64_t generation = ++impl_->stream.last_generation;
+    impl_->stream.pending_generation = generation;
+    impl_->stream.pending_call = std::make_shared<gnmi_subscribe_call>(
+        impl_->engine, impl_->stream.call->get_completion_queue(),
+        [this, generation](const gnmi::SubscribeResponse& response)
+        { return on_call_response(generation, response); },
+        [this, generation](const grpc::Status& status) { on_call_finish(generation, status); });
+    const bool queued = impl_->stream.pending_call->write(request);
+    impl_->stream.pending_call->start(*impl_->stub, context_args);
+    impl_->stream.pending_request = std::move(request);
+    impl_->stream.pending_context = context_args;
+    impl_->stream.pending_plan = std::move(plan);
+    impl_->stream.resume_updates_only = rpc_args.resume_updates_only;
+
+    if (!queued)
+    {
+        logger_manager::get_instance().log("Resubscribe Request: Write operation failed",
+                                           log_level::ERROR);
+        return error_code::RPC_FAILURE;
+    }
+    impl_->stream.pending_done = std::move(on_done);
+    logger_manager::get_instance().log("Resubscribe Request: Write operation queued",
+                                       log_level::VERBOSE);
+    return error_code::SUCCESS;
+}
+
+/**
+ * @brief Seeds a latest value state with one Get, then streams only the changes.
+ * @param context_args Configuration for the client context.
+ * @param rpc_args Configuration for the RPC call.
+ * @param latest The state the values of the Get are merged into.
+ * @return Error code of the stream registration.
+ */
+error_code GnmiClient::rpc_seed_stats_stream(const client_context_args& context_args,
+                                             const rpc_args& rpc_args, pbr_latest_values& latest)
+{
+    auto pbr_interface = GnmiClientDetails::pbr_counters_of(interface);
+    if (pbr_interface == nullptr)
+    {
+        return error_code::CLIENT_TYPE_FAILURE;
+    }
+    if (context_args.username.empty() || context_args.password.empty())
+    {
+        logger_manager::get_instance().log("Username or password is empty", log_level::ERROR);
+        return error_code::CLIENT_TYPE_FAILURE;
+    }
+
+    // The flags of the stream are set on a copy, the rpc_args of the caller are unchanged.
+    auto stream_args = rpc_args;
+    if (stream_args.negotiate)
+    {
+        if (!impl_->negotiate(context_args, stream_args, pbr_interface->path_origin))
+        {
+            logger_manager::get_instance().log(
+                "Capabilities failed, seeding with the encoding and models of the rpc_args",
+                log_level::ERROR);
+        }
+        // Negotiated once for the Get and the stream.
+        stream_args.negotiate = false;
+    }
+    std::vector<std::shared_ptr<PBRBase::pbr_stat>> stats;
+    const grpc::Status status = impl_->get_stats(context_args, stream_args, *pbr_interface,
+                                                 gnmi::GetRequest::ALL, &stats);
+
+    bool seeded = status.ok();
+    if (seeded)
+    {
+        for (const auto& stat : stats)
+        {
+            const auto* basic_stat = dynamic_cast<const PbrBasicStat*>(stat.get());
+            if (basic_stat != nullptr)
+            {
+                latest.merge(*basic_stat);
+            }
+        }
+    }
+    else
+    {
+        logger_manager::get_instance().log(
+            fmt::format("Seeding Get failed, streaming the initial state instead: {}",
+                        status.error_message()),
+            log_level::ERROR);
+    }
+
+    stream_args.updates_only = seeded;
+    stream_args.resume_updates_only = true;
+    return rpc_register_stats_stream(context_args, stream_args);
+}
+
+/**
+ * @brief Reads the state of the keys with a single Get request.
+ * @param context_args Configuration for the client context.
+ * @param rpc_args Configuration for the RPC call.
+ * @return Pair of error code and grpc::Status indicating success or failure.
+ */
+std::pair<error_code, grpc::Status> GnmiClient::rpc_get_stats(
+    const client_context_args& context_args, rpc_args& rpc_args)
+{
+    std::pair<error_code, grpc::Status> ret_pair(error_code::SUCCESS, grpc::Status());
+    auto pbr_interface = GnmiClientDetails::pbr_counters_of(interface);
+    if (pbr_interface == nullptr)
+    {
+        ret_pair.first = error_code::CLIENT_TYPE_FAILURE;
+        return ret_pair;
+    }
+    if (context_args.username.empty() || context_args.password.empty())
+    {
+        logger_manager::get_instance().log("Username or password is empty", log_level::ERROR);
+        ret_pair.first = error_code::CLIENT_TYPE_FAILURE;
+        return ret_pair;
+    }
+
+    if (rpc_args.negotiate)
+    {
+        impl_->negotiate(context_args, rpc_args, pbr_interface->path_origin);
+    }
+    std::vector<std::shared_ptr<PBRBase::pbr_stat>> stats;
+    ret_pair.second = impl_->get_stats(context_args, rpc_args, *pbr_interface,
+                                       gnmi::GetRequest::STATE, &stats);
+    if (!ret_pair.second.ok())
+    {
+        logger_manager::get_instance().log(
+            fmt::format("Get rpc failed: {}", ret_pair.second.error_message()), log_level::ERROR);
+        ret_pair.first = error_code::RPC_FAILURE;
+        return ret_pair;
+    }
+    for (auto& stat : stats)
+    {
+        pbr_interface->add_stats(std::move(stat));
+    }
+    logger_manager::get_instance().log(
+        fmt::format("Get rpc passed with {} stats", stats.size()), log_level::INFO);
+    return ret_pair;
+}
+
+/**
+ * @brief Returns the capabilities of the target, calling Capabilities once per channel.
+ * @param context_args Configuration for the client context.
+ * @param capabilities Set to the capabilities of the target.
+ * @return Error code of the Capabilities RPC.
+ */
+error_code GnmiClient::rpc_get_capabilities(const client_context_args& context_args,
+                                            gnmi::CapabilityResponse* capabilities)
+{
+    std::shared_ptr<const gnmi::CapabilityResponse> target;
+    if (!capabilities_cache::fetch(*impl_->capabilities, *impl_->stub, context_args, &target)
+             .ok())
+    {
+        return error_code::RPC_FAILURE;
+    }
+    *capabilities = *target;
+    return error_code::SUCCESS;
+}
+
+/**
+ * @brief Sets the encoding and the models of the rpc_args from the target capabilities.
+ * @param context_args Configuration for the client context.
+ * @param rpc_args Configuration for the RPC call, updated.
+ * @return Error code of the Capabilities RPC.
+ */
+error_code GnmiClient::rpc_negotiate(const client_context_args& context_args, rpc_args& rpc_args)
+{
+    auto pbr_interface = std::dynamic_pointer_cast<PBRBase>(interface);
+    const std::string origin = pbr_interface != nullptr ? pbr_interface->path_origin : "";
+    return impl_->negotiate(context_args, rpc_args, origin) ? error_code::SUCCESS
+                                                            : error_code::RPC_FAILURE;
+}
+
+/**
+ * @brief Starts a new stream call with its own generation, with the stream mutex held.
+ * @param context_args Configuration for the client context.
+ * @param request The subscription request sent on the call.
+ * @param completion_queue The queue of the call, nullptr takes the next queue of the engine.
+ * @return False if the request could not be queued.
+ */
+bool GnmiClient::start_stream_call(const client_context_args& context_args,
+                                   const gnmi::SubscribeRequest& request,
+                                   grpc::CompletionQueue* completion_queue)
+{
+    const uint64_t generation = ++impl_->stream.last_generation;
+    impl_->stream.generation = generation;
+    auto on_response = [this, generation](const gnmi::SubscribeResponse& response)
+    { return on_call_response(generation, response); };
+    auto on_finish = [this, generation](const grpc::Status& status)
+    { on_call_finish(generation, status); };
+    if (completion_queue == nullptr)
+    {
+        impl_->stream.call = std::make_shared<gnmi_subscribe_call>(
+            impl_->engine, std::move(on_response), std::move(on_finish));
+    }
+    else
+    {
+        impl_->stream.call = std::make_shared<gnmi_subscribe_call>(
+            impl_->engine, completion_queue, std::move(on_response), std::move(on_finish));
+    }
+    // Queued before the start, a call failing right away reports through the failed handler.
+    const bool queued = impl_->stream.call->write(request);
+    impl_->stream.call->start(*impl_->stub, context_args);
+    return queued;
+}
+
+/**
+ * @brief Routes a response to the delivery, or holds it until its stream is in sync.
+ * @param generation The generation of the call the response was received on.
+ * @param response The response received.
+ * @return False to stop reading until the delivery queue has room.
+ */
+bool GnmiClient::on_call_response(uint64_t generation, const gnmi::SubscribeResponse& response)
+{
+    std::vector<gnmi::SubscribeResponse> held_responses;
+    std::shared_ptr<const pbr_subscription_plan> plan;
+    std::function<void(grpc::Status)> resubscribed;
+    {
+        std::lock_guard<std::mutex> lock(impl_->stream.mtx);
+        if (impl_->stream.pending_call != nullptr && generation == impl_->stream.pending_generation)
+        {
+            if (!response.has_sync_response())
+            {
+                impl_->stream.pending_responses.push_back(response);
+                return true;
+            }
+            // The new stream has sent its initial state, it takes over the delivery.
+            logger_manager::get_instance().log("Resubscribed stream in sync, switching to it",
+                                               log_level::INFO);
+            if (impl_->stream.call != nullptr)
+            {
+                impl_->stream.call->cancel();
+                impl_->stream.retired_calls.push_back(std::move(impl_->stream.call));
+            }
+            impl_->stream.call = std::move(impl_->stream.pending_call);
+            impl_->stream.pending_call = nullptr;
+            impl_->stream.generation = generation;
+            impl_->stream.request = std::move(impl_->stream.pending_request);
+            impl_->stream.context = impl_->stream.pending_context;
+            impl_->stream.plan = std::move(impl_->stream.pending_plan);
+            held_responses.swap(impl_->stream.pending_responses);
+            resubscribed = std::move(impl_->stream.pending_done);
+            impl_->stream.pending_done = nullptr;
+        }
+        else if (generation != impl_->stream.generation)
+        {
+            // Response of a replaced stream, its keys are covered by the current one.
+            return true;
+        }
+
+        std::lock_guard<std::mutex> reconnect_lock(impl_->reconnect.mtx);
+        auto& stats = impl_->reconnect.stats;
+        if (stats.recovering)
+        {
+            const auto outage = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - impl_->reconnect.outage_start);
+            stats.recovering = false;
+            stats.recoveries++;
+            stats.last_time_to_recover = outage;
+            stats.max_time_to_recover = std::max(stats.max_time_to_recover, outage);
+            stats.total_time_to_recover += outage;
+            impl_->reconnect.backoff->reset();
+            logger_manager::get_instance().log(
+                fmt::format("Subscribe stream recovered after {} ms", outage.count()),
+                log_level::INFO);
+            if (impl_->reconnect.done)
+            {
+                resubscribed = std::move(impl_->reconnect.done);
+                impl_->reconnect.done = nullptr;
+            }
+        }
+        plan = impl_->stream.plan;
+    }
+    if (resubscribed)
+    {
+        run_handler([resubscribed]() { resubscribed(grpc::Status::OK); });
+    }
+
+    bool keep_reading = true;
+    for (const auto& held_response : held_responses)
+    {
+        keep_reading = on_stream_response(held_response, plan.get()) && keep_reading;
+    }
+    return on_stream_response(response, plan.get()) && keep_reading;
+}
+
+/**
+ * @brief Reports the end of a call, unless it was replaced by a resubscription.
+ * @param generation The generation of the finished call.
+ * @param status The final status of the call.
+ */
+void GnmiClient::on_call_finish(uint64_t generation, const grpc::Status& status)
+{
+    bool reconnecting = false;
+    bool resubscribe_failed = false;
+    std::function<void(grpc::Status)> resubscribed;
+    {
+        std::lock_guard<std::mutex> lock(impl_->stream.mtx);
+        std::lock_guard<std::mutex> reconnect_lock(impl_->reconnect.mtx);
+        if (generation == impl_->stream.generation)
+        {
+            reconnecting = schedule_reconnect(generation, status);
+            if (!reconnecting)
+            {
+                // A resubscription taken over by the reconnection fails with the stream.
+                resubscribed = std::move(impl_->reconnect.done);
+                impl_->reconnect.done = nullptr;
+            }
+        }
+        else if (generation == impl_->stream.pending_generation &&
+                 impl_->stream.pending_call != nullptr)
+        {
+            // The stream in use keeps running with the previous keys, it did not end.
+            impl_->stream.pending_call = nullptr;
+            impl_->stream.pending_responses.clear();
+            resubscribed = std::move(impl_->stream.pending_done);
+            impl_->stream.pending_done = nullptr;
+            resubscribe_failed = true;
+        }
+        else
+        {
+            logger_manager::get_instance().log("Replaced stream finished", log_level::VERBOSE);
+            return;
+        }
+    }
+    if (resubscribe_failed || resubscribed)
+    {
+        const grpc::Status failure =
+            status.ok() ? grpc::Status(grpc::StatusCode::ABORTED,
+                                       "Stream ended before the resubscription was in sync")
+                        : status;
+        if (resubscribe_failed)
+        {
+            logger_manager::get_instance().log(
+                fmt::format("Resubscribe failed with error: {}", failure.error_message()),
+                log_level::ERROR);
+        }
+        if (resubscribed)
+        {
+            run_handler([resubscribed, failure]() { resubscribed(failure); });
+        }
+        if (resubscribe_failed)
+        {
+            return;
+        }
+    }
+    on_stream_finish(status, reconnecting);
+}
+
+/**
+ * @brief Arms the timer of the next reconnection, with the stream and reconnect mutexes held.
+ * @param generation The generation of the failed stream call.
+ * @param status The final status of the call.
+ * @return True if the stream is reconnected, false if the failure is reported.
+ */
+bool GnmiClient::schedule_reconnect(uint64_t generation, const grpc::Status& status)
+{
+    if (status.ok() || status.error_code() == grpc::StatusCode::CANCELLED ||
+        impl_->stream.call == nullptr)
+    {
+        return false;
+    }
+    auto& stats = impl_->reconnect.stats;
+    stats.failures++;
+    if (impl_->reconnect.backoff == nullptr)
+    {
+        return false;
+    }
+    if (status.error_code() == grpc::StatusCode::DEADLINE_EXCEEDED &&
+        impl_->stream.context.set_deadline)
+    {
+        // The deadline of the context is over, another attempt would fail right away.
+        stats.recovering = false;
+        impl_->reconnect.backoff->reset();
+        return false;
+    }
+    if (!stats.recovering)
+    {
+        stats.recovering = true;
+        impl_->reconnect.outage_start = std::chrono::steady_clock::now();
+    }
+    if (impl_->reconnect.backoff->exhausted())
+    {
+        logger_manager::get_instance().log(
+            fmt::format("Subscribe stream not recovered after {} attempts, giving up",
+                        impl_->reconnect.backoff->attempts()),
+            log_level::ERROR);
+        stats.give_ups++;
+        stats.recovering = false;
+        impl_->reconnect.backoff->reset();
+        return false;
+    }
+
+    const auto delay = impl_->reconnect.backoff->next_delay();
+    logger_manager::get_instance().log(
+        fmt::format("Subscribe stream failed with error: {}, reconnecting in {} ms",
+                    status.error_message(), delay.count()),
+        log_level::WARNING);
+    impl_->reconnect.pending = true;
+    impl_->reconnect.admitted = false;
+    impl_->reconnect.generation = generation;
+    impl_->reconnect.status = status;
+    // On the queue of the failed call, the timer and the new call stay on its poller thread.
+    impl_->reconnect.queue = impl_->stream.call->get_completion_queue();
+    impl_->reconnect.alarm = std::make_unique<grpc::Alarm>();
+    impl_->reconnect.alarm->Set(impl_->reconnect.queue, std::chrono::system_clock::now() + delay,
+                                impl_->reconnect.tag.get());
+    return true;
+}
+
+/**
+ * @brief Opens the stream again once the backoff elapsed, called on a poller thread.
+ * @param ok False if the timer was cancelled.
+ */
+void GnmiClient::on_reconnect_timer(bool ok)
+{
+    bool gave_up = false;
+    grpc::Status status;
+    std::function<void(grpc::Status)> resubscribed;
+    {
+        std::lock_guard<std::mutex> lock(impl_->stream.mtx);
+        std::lock_guard<std::mutex> reconnect_lock(impl_->reconnect.mtx);
+        // Nothing to do if the stream was closed, or registered again, in the meantime.
+        const bool current = impl_->stream.call != nullptr &&
+                             impl_->stream.generation == impl_->reconnect.generation;
+        if (current && impl_->reconnect.backoff == nullptr)
+        {
+            // The reconnection was disabled while the attempt was pending.
+            logger_manager::get_instance().log(
+                "Subscribe stream reconnection disabled, giving up", log_level::ERROR);
+            impl_->reconnect.stats.give_ups++;
+            impl_->reconnect.stats.recovering = false;
+            gave_up = true;
+            status = impl_->reconnect.status;
+            resubscribed = std::move(impl_->reconnect.done);
+            impl_->reconnect.done = nullptr;
+        }
+        else if (ok && current)
+        {
+            if (!impl_->reconnect.admitted)
+            {
+                impl_->reconnect.admitted = true;
+                const auto wait = reconnect_limiter::global().acquire();
+                if (wait.count() > 0)
+                {
+                    impl_->reconnect.stats.limited++;
+                    impl_->reconnect.queue = impl_->stream.call->get_completion_queue();
+                    impl_->reconnect.alarm = std::make_unique<grpc::Alarm>();
+                    impl_->reconnect.alarm->Set(impl_->reconnect.queue,
+                                                std::chrono::system_clock::now() + wait,
+                                                impl_->reconnect.tag.get());
+                    return;
+                }
+            }
+
+            impl_->reconnect.stats.attempts++;
+            logger_manager::get_instance().log(
+                fmt::format("Reconnecting the subscribe stream, attempt {}",
+                            impl_->reconnect.backoff->attempts()),
+                log_level::INFO);
+            if (impl_->stream.pending_call != nullptr)
+            {
+                // The resubscription not in sync yet is taken over by the new stream.
+                impl_->stream.pending_call->cancel();
+                impl_->stream.retired_calls.push_back(std::move(impl_->stream.pending_call));
+                impl_->stream.pending_call = nullptr;
+                impl_->stream.pending_responses.clear();
+                impl_->stream.request = std::move(impl_->stream.pending_request);
+                impl_->stream.context = impl_->stream.pending_context;
+                impl_->stream.plan = std::move(impl_->stream.pending_plan);
+                impl_->reconnect.done = std::move(impl_->stream.pending_done);
+                impl_->stream.pending_done = nullptr;
+            }
+            if (impl_->stream.resume_updates_only)
+            {
+                // The values held by the client stand for the initial state.
+                gnmi::SubscribeRequest request = impl_->stream.request;
+                request.mutable_subscribe()->set_updates_only(true);
+                start_stream_call(impl_->stream.context, request, impl_->reconnect.queue);
+            }
+            else
+            {
+                start_stream_call(impl_->stream.context, impl_->stream.request,
+                                  impl_->reconnect.queue);
+            }
+        }
+        if (!gave_up)
+        {
+            impl_->reconnect.pending = false;
+        }
+    }
+    if (gave_up)
+    {
+        if (resubscribed)
+        {
+            run_handler([resubscribed, status]() { resubscribed(status); });
+        }
+        on_stream_finish(status, false);
+        // A close waits for the timer, it is only released once the failure is reported.
+        std::lock_guard<std::mutex> lock(impl_->reconnect.mtx);
+        impl_->reconnect.pending = false;
+    }
+    impl_->reconnect.cv.notify_all();
+}
+
+/**
+ * @brief Processes one response of the stream, called on a poller thread.
+ * @param response The response received on the stream.
+ * @param plan The plan of the paths of the stream, to drop the rules which are not keys.
+ * @return False to stop reading until the delivery queue has room.
+ */
+bool GnmiClient::on_stream_response(const gnmi::SubscribeResponse& response,
+                                    const pbr_subscription_plan* plan)
+{
+    auto pbr_interface = std::dynamic_pointer_cast<PBRBase>(interface);
+    // If the interface no longer exists, we do not want to use it
+    if (pbr_interface == nullptr)
+    {
+        return true;
+    }
+    std::vector<std::string> keys;
+    const bool keyed = impl_->delivery.queue != nullptr || impl_->handler_strands.size() > 1;
+    auto expected_response_stats =
+        impl_->check_response(response, *pbr_interface, keyed ? &keys : nullptr, plan);
+    if (expected_response_stats.second == internal_error_code::KEY_FILTERED)
+    {
+        return true;
+    }
+    if (expected_response_stats.second != internal_error_code::SUCCESS)
+    {
+        std::string message = fmt::format("Error while processing response: {}",
+                                          static_cast<int>(expected_response_stats.second));
+        logger_manager::get_instance().log(message, log_level::ERROR);
+        return true;
+    }
+    logger_manager::get_instance().log("Client received a response.", log_level::VERBOSE);
+    auto& stats = expected_response_stats.first;
+
+    if (impl_->delivery.queue == nullptr)
+    {
+        for (size_t i = 0; i < stats.size(); i++)
+        {
+            auto deliver = [this, pbr_interface, stat = std::move(stats[i])]()
+            {
+                add_stream_stat(*pbr_interface, stat);
+                if (rpc_success_handler)
+                {
+                    rpc_success_handler(pbr_interface);
+                }
+                if (rpc_batch_handler)
+                {
+                    on_new_stats();
+                }
+            };
+            run_key_handler(i < keys.size() ? keys[i] : std::string(), std::move(deliver));
+        }
+        return true;
+    }
+
+    bool keep_reading = true;
+    {
+        std::lock_guard<std::mutex> lock(impl_->delivery.mtx);
+        for (size_t i = 0; i < stats.size(); i++)
+        {
+            delivery_item item{std::move(keys[i]), std::move(stats[i])};
+            // Samples already waiting go first, to keep the order of the responses.
+            if (!impl_->delivery.blocked_items.empty() ||
+                impl_->delivery.queue->push(item) == delivery_queue::push_result::FULL)
+            {
+                impl_->delivery.blocked_items.push_back(std::move(item));
+                keep_reading = false;
+            }
+        }
+    }
+    if (!impl_->delivery.drain_scheduled.exchange(true))
+    {
+        // Not a strand task, the drain only hands the samples to the strands of their keys.
+        auto drain = [this]() { drain_delivery_queue(); };
+        if (impl_->handler_executor == nullptr || !impl_->handler_executor->submit(drain))
+        {
+            drain();
+        }
+    }
+    return keep_reading;
+}
+
+/**
+ * @brief Hands the queued samples to the strands of their keys, one batch at a time.
+ *
+ * The next batch is taken once every sample of the current one is delivered, so the
+ * samples of a key keep their order and the queue still bounds the samples in flight.
+ */
+void GnmiClient::drain_delivery_queue()
+{
+    constexpr size_t DRAIN_BATCH = 64;
+    auto pbr_interface = std::dynamic_pointer_cast<PBRBase>(interface);
+    std::vector<delivery_item> batch;
+    while (true)
+    {
+        batch.clear();
+        bool resume = false;
+        bool done = false;
+        {
+            std::lock_guard<std::mutex> lock(impl_->delivery.mtx);
+            impl_->delivery.queue->pop_batch(batch, DRAIN_BATCH);
+            const bool blocked = !impl_->delivery.blocked_items.empty();
+            while (!impl_->delivery.blocked_items.empty() &&
+                   impl_->delivery.queue->push(impl_->delivery.blocked_items.front()) !=
+                       delivery_queue::push_result::FULL)
+            {
+                impl_->delivery.blocked_items.pop_front();
+            }
+            resume = blocked && impl_->delivery.blocked_items.empty();
+            if (batch.empty() && impl_->delivery.queue->size() == 0)
+            {
+                // A sample queued after this schedules a new drain.
+                impl_->delivery.drain_scheduled = false;
+                impl_->delivery.drain_cv.notify_all();
+                done = true;
+            }
+        }
+        if (done)
+        {
+            // The close may be over once the flag is cleared, nothing is touched after it.
+            return;
+        }
+        if (resume)
+        {
+            std::lock_guard<std::mutex> lock(impl_->stream.mtx);
+            if (impl_->stream.call != nullptr)
+            {
+                impl_->stream.call->resume_reads();
+            }
+        }
+        if (batch.empty())
+        {
+            continue;
+        }
+
+        // One more than the samples, held by the drain until they are all dispatched.
+        auto remaining = std::make_shared<std::atomic<size_t>>(batch.size() + 1);
+        for (auto& item : batch)
+        {
+            auto deliver = [this, pbr_interface, remaining, stat = std::move(item.stat)]()
+            {
+                add_stream_stat(*pbr_interface, stat);
+                if (rpc_success_handler)
+                {
+                    rpc_success_handler(pbr_interface);
+                }
+                if (--*remaining == 0)
+                {
+                    // The last sample of the batch delivered takes the next one.
+                    if (rpc_batch_handler)
+                    {
+                        on_new_stats();
+                    }
+                    drain_delivery_queue();
+                }
+            };
+            run_key_handler(item.key, std::move(deliver));
+        }
+        if (--*remaining != 0)
+        {
+            return;
+        }
+        // Every sample was delivered inline.
+        if (rpc_batch_handler)
+        {
+            on_new_stats();
+        }
+    }
+}
+
+/**
+ * @brief Hands the new stats to the batch handler now, or once the quantum elapsed.
+ */
+void GnmiClient::on_new_stats()
+{
+    if (batch_quantum.count() == 0)
+    {
+        flush_batch();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(impl_->batch.mtx);
+    if (impl_->batch.timer_pending)
+    {
+        return;
+    }
+    impl_->batch.timer_pending = true;
+    // Without handler executor the flush must run on the poller thread delivering the stats.
+    grpc::CompletionQueue* queue = impl_->engine->current_completion_queue();
+    if (queue == nullptr)
+    {
+        queue = impl_->engine->next_completion_queue();
+    }
+    impl_->batch.queue = queue;
+    impl_->batch.alarm = std::make_unique<grpc::Alarm>();
+    impl_->batch.alarm->Set(queue, std::chrono::system_clock::now() + batch_quantum,
+                            impl_->batch.tag.get());
+}
+
+/**
+ * @brief Adds a stat of the stream to the counters, and to the batch if there is a handler.
+ * @param counters The counters of the client.
+ * @param stat The decoded stat.
+ */
+void GnmiClient::add_stream_stat(PBRBase& counters, const std::shared_ptr<PBRBase::pbr_stat>& stat)
+{
+    std::lock_guard<std::mutex> lock(impl_->stats_mtx);
+    counters.add_stats(stat);
+    if (impl_->batch.counters != nullptr)
+    {
+        // Kept apart from the stats vector, which the handlers may erase from.
+        const auto* basic_stat = dynamic_cast<const PbrBasicStat*>(stat.get());
+        if (basic_stat != nullptr)
+        {
+            impl_->batch.stats.push_back(*basic_stat);
+        }
+    }
+}
+
+/**
+ * @brief Calls the batch handler with the stats added since the previous call.
+ */
+void GnmiClient::flush_batch()
+{
+    std::lock_guard<std::mutex> lock(impl_->stats_mtx);
+    if (impl_->batch.stats.empty())
+    {
+        return;
+    }
+    std::vector<PbrBasicStat> flushed;
+    flushed.swap(impl_->batch.stats);
+    rpc_batch_handler(stat_span<PbrBasicStat>(flushed.data(), flushed.size()));
+}
+
+/**
+ * @brief Flushes the batch once the quantum elapsed, called on a poller thread.
+ * @param ok False if the timer was cancelled.
+ */
+void GnmiClient::on_batch_timer(bool ok)
+{
+    if (ok)
+    {
+        run_handler([this]() { flush_batch(); });
+    }
+    {
+        std::lock_guard<std::mutex> lock(impl_->batch.mtx);
+        impl_->batch.timer_pending = false;
+    }
+    impl_->batch.cv.notify_all();
+}
+
+/**
+ * @brief Reports the final status of the stream, called on a poller thread.
+ * @param status The final status of the stream.
+ * @param reconnecting Whether the stream is reconnected instead of reporting the failure.
+ */
+void GnmiClient::on_stream_finish(const grpc::Status& status, bool reconnecting)
+{
+    if (rpc_batch_handler)
+    {
+        run_handler([this]() { flush_batch(); });
+    }
+    if (reconnecting)
+    {
+        // Reported once the client gives up reconnecting.
+        return;
+    }
+    if (!status.ok())
+    {
+        if (status.error_code() != grpc::StatusCode::CANCELLED)
+        {
+            std::string result =
+                fmt::format("Subscribe stream RPC failed with error: {}", status.error_message());
+            logger_manager::get_instance().log(result, log_level::ERROR);
+            if (rpc_failed_handler)
+            {
+                run_handler([this, status]() { rpc_failed_handler(status); });
+            }
+        }
+        else
+        {
+            std::string result = fmt::format("Subscribe rpc passed: {}", status.error_message());
+            logger_manager::get_instance().log(result, log_level::INFO);
+        }
+    }
+    else
+    {
+        logger_manager::get_instance().log("Subscribe rpc passed.", log_level::INFO);
+    }
+    if (rpc_finished_handler)
+    {
+        run_handler([this, status]() { rpc_finished_handler(status); });
+    }
+}
+
+/**
+ * @brief Runs a handler once every strand of the handler executor reached it, or inline if
+ * there is none.
+ * @param handler The handler invocation.
+ */
+void GnmiClient::run_handler(std::function<void()> handler)
+{
+    const auto& strands = impl_->handler_strands;
+    if (impl_->handler_executor == nullptr || strands.size() == 1)
+    {
+        run_key_handler(std::string(), std::move(handler));
+        return;
+    }
+    // The strand reaching it last runs it, after the handlers of every key queued before.
+    auto remaining = std::make_shared<std::atomic<size_t>>(strands.size());
+    auto shared_handler = std::make_shared<std::function<void()>>(std::move(handler));
+    for (const auto& strand : strands)
+    {
+        auto arrive = [remaining, shared_handler]()
+        {
+            if (--*remaining == 0)
+            {
+                (*shared_handler)();
+            }
+        };
+        if (!impl_->handler_executor->submit(strand, arrive))
+        {
+            arrive();
+        }
+    }
+}
+
+/**
+ * @brief Runs a handler on the strand of its key, or inline if there is no handler executor.
+ * @param key The policy|rule key of the stat the handler delivers.
+ * @param handler The handler invocation.
+ */
+void GnmiClient::run_key_handler(const std::string& key, std::function<void()> handler)
+{
+    const auto& strands = impl_->handler_strands;
+    if (impl_->handler_executor != nullptr &&
+        impl_->handler_executor->submit(strands[std::hash<std::string>()(key) % strands.size()],
+                                        handler))
+    {
+        return;
+    }
+    handler();
+}
+
+/**
+ * @brief Creates a subscription sharing the channel, stub and engine of the client.
+ * @param counters The counters subscribed to.
+ * @return The idle subscription.
+ */
+std::shared_ptr<gnmi_subscription> GnmiClient::subscribe(std::shared_ptr<GnmiCounters> counters)
+{
+    return std::make_shared<gnmi_subscription>(impl_, std::move(counters));
 }
 
 std::vector<std::string> GnmiClient::get_counter_gnmi_paths(const GnmiCounters& counter) const
@@ -20,22 +20,182 @@
 #define MGBL_API_IMPL_H_
 
 #include <fmt/format.h>
+#include <grpcpp/alarm.h>
 #include <grpcpp/grpcpp.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <mutex>
 #include <thread>
+#include <vector>
 #include "gnmi.pb.h"
+#include "gnmi/mgbl_gnmi_async_engine.h"
+#include "gnmi/mgbl_gnmi_capabilities.h"
+#include "gnmi/mgbl_gnmi_delivery_queue.h"
+#include "gnmi/mgbl_gnmi_executor.h"
 #include "gnmi/mgbl_gnmi_helper.h"
+#include "gnmi/mgbl_gnmi_reconnect.h"
+#include "gnmi/mgbl_gnmi_subscribe_call.h"
 #include "logger/logger.h"
 #include "mgbl_api.h"
+#include "pbr/mgbl_pbr.h"
 
 namespace mgbl_api
 {
 /** \addtogroup gnmi
  *  @{
  */
+/**
+ * @brief The SubscribeRequest of the keys of a counter and the plan it was built from.
+ */
+struct prepared_subscription
+{
+    gnmi::SubscribeRequest request;                    /**< The request, ready to be written */
+    std::shared_ptr<const pbr_subscription_plan> plan; /**< Filters the rules of wildcards */
+};
+
+/**
+ * @brief The stream of a client, its generations and the resubscription switching to it.
+ */
+struct stream_state
+{
+    /** Guards every member. Taken before the mutex of the reconnect_state. */
+    std::mutex mtx;
+
+    /** Asynchronous Subscribe call used within rpc_register_stats_stream and
+     * rpc_stream_close
+     */
+    std::shared_ptr<gnmi_subscribe_call> call = nullptr;
+
+    /** Generation of call, responses of other generations are not delivered. */
+    uint64_t generation = 0;
+
+    /** Last generation given to a stream call. */
+    uint64_t last_generation = 0;
+
+    /** Request and context of call, sent again on reconnect. */
+    gnmi::SubscribeRequest request;
+    client_context_args context;
+
+    /** Plan of the paths of the stream. */
+    std::shared_ptr<const pbr_subscription_plan> plan;
+
+    /** Whether the reconnections of the stream skip the initial state. */
+    bool resume_updates_only = false;
+
+    /** Call of rpc_resubscribe_stats_stream waiting for its sync_response, and its generation. */
+    std::shared_ptr<gnmi_subscribe_call> pending_call = nullptr;
+    uint64_t pending_generation = 0;
+
+    /** Request, context and plan of pending_call, taken over by the stream once in sync. */
+    gnmi::SubscribeRequest pending_request;
+    client_context_args pending_context;
+    std::shared_ptr<const pbr_subscription_plan> pending_plan;
+
+    /** Callback of the resubscription of pending_call, called once it is in sync or failed. */
+    std::function<void(grpc::Status)> pending_done;
+
+    /** Responses of pending_call received before its sync_response. */
+    std::vector<gnmi::SubscribeResponse> pending_responses;
+
+    /** Replaced stream calls, cancelled and possibly not finished yet. */
+    std::vector<std::shared_ptr<gnmi_subscribe_call>> retired_calls;
+
+    /** Calls detached by a close while one of their handlers was still running. */
+    std::vector<std::shared_ptr<gnmi_subscribe_call>> detached_calls;
+
+    /** Whether a close gave up waiting at its deadline, the next close waits again. */
+    bool close_unfinished = false;
+};
+
+/**
+ * @brief The backoff and the timer reconnecting the stream of a client.
+ */
+struct reconnect_state
+{
+    /** Guards every member, taken alone or after the mutex of the stream_state. */
+    std::mutex mtx;
+
+    /** Backoff of the stream reconnection, nullptr if the stream is not reconnected. */
+    std::unique_ptr<reconnect_backoff> backoff;
+
+    /** Timer of the next reconnection attempt, its tag and the queue it is set on. */
+    std::unique_ptr<grpc::Alarm> alarm;
+    std::unique_ptr<callback_tag> tag;
+    grpc::CompletionQueue* queue = nullptr;
+
+    /** Notified when the timer is no longer pending, for the close. */
+    std::condition_variable cv;
+    bool pending = false;
+
+    /** Whether the pending attempt was admitted by the global reconnect limiter. */
+    bool admitted = false;
+
+    /** Generation of the failed stream call and its status, reported on give up. */
+    uint64_t generation = 0;
+    grpc::Status status;
+
+    /** Callback of a resubscription taken over by a reconnection, called once it recovered. */
+    std::function<void(grpc::Status)> done;
+
+    reconnect_statistics stats;
+    std::chrono::steady_clock::time_point outage_start;
+};
+
+/**
+ * @brief The timer handing the new stats of a client to its batch handler.
+ */
+struct batch_state
+{
+    /** Guards the timer. The counters and stats are guarded by the stats mutex of the client. */
+    std::mutex mtx;
+
+    /** Counters whose new stats are handed to the batch handler. */
+    PBRBasic* counters = nullptr;
+
+    /** Stats added to the counters and not handed to the batch handler yet. */
+    std::vector<PbrBasicStat> stats;
+
+    /** Timer flushing the batch once the quantum elapsed, its tag and the queue it is set on. */
+    std::unique_ptr<grpc::Alarm> alarm;
+    std::unique_ptr<callback_tag> tag;
+    grpc::CompletionQueue* queue = nullptr;
+
+    /** Notified when the timer is no longer pending, for the close. */
+    std::condition_variable cv;
+    bool timer_pending = false;
+};
+
+/**
+ * @brief The bounded queue between the poller thread and the handlers of a client.
+ */
+struct delivery_state
+{
+    /** Guards blocked_items together with the pushes to the queue. */
+    std::mutex mtx;
+
+    /** Optional bounded queue, nullptr hands the samples to the handlers directly. */
+    std::shared_ptr<delivery_queue> queue;
+
+    /** Samples refused by a full BLOCK queue, queued in order once the handlers free slots. */
+    std::deque<delivery_item> blocked_items;
+
+    /** Whether a drain of the queue is queued, running or waiting for its batch. */
+    std::atomic<bool> drain_scheduled{false};
+
+    /** Notified with mtx when the drain ends, for the close. */
+    std::condition_variable drain_cv;
+};
+
 /**
  * @brief The Impl class is a helper
  * class for the GnmiClient class.
+ *
+ * The state of the stream, the reconnection, the batch and the delivery each have their own
+ * mutex. Only the stream and the reconnection are locked together, in this order. The
+ * delivery, batch, once and close mutexes are never held with another one, but the stats
+ * mutex, which is taken last.
  */
 /*
    Reconsider if this class is helpful or shouldn't be merged with GnmiClient and later extract
@@ -44,28 +204,114 @@ namespace mgbl_api
 class GnmiClientDetails
 {
    public:
-    /** ClientReaderWriter used within rpc_register_stats_stream and
-     * rpc_stream_close
-     */
-    std::shared_ptr<grpc::ClientReaderWriter<gnmi::SubscribeRequest, gnmi::SubscribeResponse>>
-        subscribe_stream_rw;
+    stream_state stream;       /**< The stream and its resubscription */
+    reconnect_state reconnect; /**< The reconnection of the stream */
+    batch_state batch;         /**< The timer of the batch handler */
+    delivery_state delivery;   /**< The delivery queue of the stream */
 
-    /** gRPC ClientContext used within rpc_register_stats_stream and
-     * rpc_stream_close
-     */
-    std::shared_ptr<grpc::ClientContext> stream_context = nullptr;
+    /** Number of rpc_stream_close_async not finished yet, waited for by the destructor. */
+    std::mutex close_mtx;
+    std::condition_variable close_cv;
+    uint32_t closes_in_flight = 0;
+
+    /** Asynchronous Subscribe call of rpc_register_stats_once_async, while in flight. */
+    std::shared_ptr<gnmi_subscribe_call> once_call = nullptr;
+
+    /** Once requests whose finish handler has not returned yet, and its notification. */
+    uint32_t once_in_flight = 0;
+    std::condition_variable once_cv;
+
+    /** Guards once_call and once_in_flight. */
+    std::mutex once_mtx;
+
+    /** Engine whose poller threads drive the stream of the client. */
+    std::shared_ptr<gnmi_async_engine> engine;
+
+    /** Optional executor running the handlers, nullptr runs them on the poller thread. */
+    std::shared_ptr<work_stealing_executor> handler_executor;
+
+    /** Keep the handlers of every key in the order of the responses, hashed by policy|rule. */
+    std::vector<std::shared_ptr<executor_strand>> handler_strands;
+
+    /** Guards the stats vector of the counters, appended by the strands of every key. */
+    std::mutex stats_mtx;
 
     /** Stub created on instantiation of GnmiClient. */
     std::shared_ptr<gnmi::gNMI::Stub> stub;
 
-    /** Used to separate types of different streams into their own instance */
-    std::string client_type;
+    /** Capabilities of the target, shared with the clients of the same channel. */
+    std::shared_ptr<capabilities_cache::entry> capabilities;
 
-    /** Thread use within rpc_register_stats_stream and rpc_stream_close */
-    std::thread receive_thread;
+    /**
+     * @brief Sets the encoding and the models of the rpc_args from the target capabilities.
+     *
+     * The capabilities are fetched once per channel. Without `may_block`, only capabilities
+     * already fetched are used, so a poller or handler thread never waits on Capabilities.
+     *
+     * @param context_args The context arguments for the Capabilities RPC.
+     * @param rpc_args The rpc metadata to update.
+     * @param origin The origin of the paths of the counters.
+     * @param may_block False if the Capabilities RPC must not be called.
+     * @return False if the Capabilities RPC failed, or if they were not fetched yet without
+     * `may_block`. The rpc_args are then unchanged.
+     */
+    bool negotiate(const client_context_args& context_args, rpc_args& rpc_args,
+                   const std::string& origin, bool may_block = true);
+
+    /**
+     * @brief Returns the PBR counters of an interface, logging an error for any other type.
+     * @param interface The counters of a client or subscription.
+     * @return The PBR counters, nullptr if the interface is not a PBR one.
+     */
+    static std::shared_ptr<PBRBase> pbr_counters_of(const std::shared_ptr<GnmiCounters>& interface);
+
+    /**
+     * @brief Negotiates, plans and builds the SubscribeRequest of the keys of a counter.
+     *
+     * Every Subscribe entry point goes through it. A failed negotiation keeps the rpc_args,
+     * except without `may_block` where capabilities not fetched yet refuse the request.
+     *
+     * @param context_args The context arguments, for the Capabilities RPC.
+     * @param rpc_args The rpc metadata, updated by the negotiation and set to `mode`.
+     * @param pbr_counter The counter whose keys are subscribed.
+     * @param mode The mode of the subscription.
+     * @param may_block False if the Capabilities RPC must not be called.
+     * @return The request and its plan, and error_code::CLIENT_TYPE_FAILURE if it could not
+     * be built.
+     */
+    std::pair<prepared_subscription, error_code> prepare_subscription(
+        const client_context_args& context_args, rpc_args& rpc_args, PBRBase& pbr_counter,
+        stream_mode mode, bool may_block = true);
 
-    /** Used to keep client context in line with subscription */
-    std::mutex subscription_mode_stream_mtx;
+    /**
+     * @brief Sends a subscribe once request on its own RPC and reads it until it ends.
+     * @param context_args The context arguments for the RPC.
+     * @param request The SubscribeRequest in ONCE mode.
+     * @param pbr_counter The counter the responses are decoded for.
+     * @param plan The plan of the paths of the request, to drop the rules which are not keys.
+     * @param stats Set to the decoded stats.
+     * @return A pair of error_code and grpc::Status.
+     */
+    std::pair<error_code, grpc::Status> subscribe_once(
+        const client_context_args& context_args, const gnmi::SubscribeRequest& request,
+        PBRBase& pbr_counter, const pbr_subscription_plan& plan,
+        std::vector<std::shared_ptr<PBRBase::pbr_stat>>* stats);
+
+    /**
+     * @brief Reads the stats of the keys of a counter with one Get, planned like a Subscribe.
+     * @param context_args The context arguments for the Get RPC.
+     * @param rpc_args The rpc metadata, for the encoding, models, prefix and planner.
+     * @param pbr_counter The counter whose keys are read.
+     * @param type The data type of the Get.
+     * @param stats Set to the decoded stats of the keys, on success.
+     * @return The status of the Get RPC.
+     */
+    grpc::Status get_stats(const client_context_args& context_args, const rpc_args& rpc_args,
+                           PBRBase& pbr_counter, gnmi::GetRequest::DataType type,
+                           std::vector<std::shared_ptr<PBRBase::pbr_stat>>* stats);
+
+    /** Used to separate types of different streams into their own instance */
+    std::string client_type;
 
     /**
      * @brief Helper function to populate the subscription request object.
@@ -81,51 +327,74 @@ class GnmiClientDetails
     /**
      * @brief Checks if the SubscribeResponse object is valid.
      * @param response The SubscribeResponse object.
-     * @param response_stats Pointer to the response stats.
-     * @param interface The interface object.
-     * @return Internal error code indicating success or failure.
+     * @param pbr_counter The counter the response is decoded for.
+     * @param keys If not nullptr, set to the policy and rule names of every stat.
+     * @param plan If not nullptr, the plan whose wildcards may bring rules which are not keys.
+     * @return The stats of the rules of the response, one per policy and rule, and an
+     * internal error code indicating success or failure, KEY_FILTERED if only rules which
+     * are not keys were received.
      */
-    std::pair<std::shared_ptr<PBRBase::pbr_stat>, internal_error_code> check_response(
-        const gnmi::SubscribeResponse& response, PBRBase& pbr_counter);
+    std::pair<std::vector<std::shared_ptr<PBRBase::pbr_stat>>, internal_error_code>
+    check_response(const gnmi::SubscribeResponse& response, PBRBase& pbr_counter,
+                   std::vector<std::string>* keys = nullptr,
+                   const pbr_subscription_plan* plan = nullptr);
+
+    /**
+     * @brief Decodes the stats of the rules of a notification, one per policy and rule.
+     * @param notification The notification of a SubscribeResponse or a GetResponse.
+     * @param pbr_counter The counter the notification is decoded for.
+     * @param plan If not nullptr, the plan whose wildcards may bring rules which are not keys.
+     * @param stats The stats of the rules are appended to it.
+     * @param keys If not nullptr, the policy and rule names of every stat are appended to it.
+     * @return Internal error code indicating success or failure, KEY_FILTERED if only rules
+     * which are not keys were received.
+     */
+    internal_error_code decode_notification(
+        const gnmi::Notification& notification, PBRBase& pbr_counter,
+        const pbr_subscription_plan* plan, std::vector<std::shared_ptr<PBRBase::pbr_stat>>* stats,
+        std::vector<std::string>* keys);
 
     /**
      * @brief Decode a gnmi::Update as Json IETF format and returns a map of the flattened json
      *
      * @param data_update A gnmi::Update object
      * @param flattened_json Pointer to the map to be populated
+     * @param resolved_path If not nullptr, the path below the rule the json keys are under.
      * @throws nlohmann::json::exception if the json string is not valid
      */
     void gnmi_decode_json_ietf(
         const gnmi::Update& data_update,
-        std::shared_ptr<std::unordered_map<std::string, std::string>>& flattened_json);
+        std::shared_ptr<std::unordered_map<std::string, std::string>>& flattened_json,
+        const std::string* resolved_path = nullptr);
 
     /**
      * @brief Decode a gnmi::Update as Proto format and returns a map of the flattened proto
      *
      * @param data_update A gnmi::Update object
      * @param flattened_proto Pointer to the map to be populated
+     * @param resolved_path If not nullptr, the path below the rule the value is stored under,
+     * instead of the path of the update.
      */
     void gnmi_decode_proto(
         const gnmi::Update& data_update,
-        std::shared_ptr<std::unordered_map<std::string, std::string>>& flattened_proto);
+        std::shared_ptr<std::unordered_map<std::string, std::string>>& flattened_proto,
+        const std::string* resolved_path = nullptr);
 
     /**
-     * @brief Generates and populates pbr return structure from the subscription response
+     * @brief Generates and populates pbr return structures from the subscription response
+     *
+     * The path of every update is resolved against the prefix of the notification, the keys
+     * of the rule can be in either of them. A prefix above the rules lets a notification
+     * carry several rules, their updates are grouped by policy and rule.
      *
      * @param notification Reference to the gnmi::Notification object
-     * @param pbr_stats Pointer to the pbr_stats structure to be populated
-     * @return internal_error_code Error code indicating the result of the operation
+     * @param path_origin The origin the prefix of the notification must have
+     * @return The flattened maps of the rules, one per policy and rule, in the order of
+     * their first update, and an internal_error_code indicating the result of the operation
      */
-    std::pair<std::shared_ptr<std::unordered_map<std::string, std::string>>, internal_error_code>
+    std::pair<std::vector<std::shared_ptr<std::unordered_map<std::string, std::string>>>,
+              internal_error_code>
     gnmi_parse_response(const gnmi::Notification& notification, std::string path_origin);
-
-    ~GnmiClientDetails()
-    {
-        if (receive_thread.joinable())
-        {
-            receive_thread.join();  // Ensure thread cleanup
-        }
-    }
 };
 /** @} */  // end of gnmi
 }  // namespace mgbl_api
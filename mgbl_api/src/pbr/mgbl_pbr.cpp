@@ -55,12 +55,16 @@ std::shared_ptr<PBRBase::pbr_stat> PBRBasic::unordered_map_to_stats(
     if (it != map.end())
     {
         stats->byte_count = std::stoull(it->second);
+        stats->has_counters = true;
+        stats->has_byte_count = true;
     }
 
     it = map.find("/fib-stats/packet-count");
     if (it != map.end())
     {
         stats->packet_count = std::stoull(it->second);
+        stats->has_counters = true;
+        stats->has_packet_count = true;
     }
 
     it = map.find("/fib-stats/collection-timestamp/seconds");
@@ -79,11 +83,13 @@ std::shared_ptr<PBRBase::pbr_stat> PBRBasic::unordered_map_to_stats(
     if (it != map.end())
     {
         stats->path_grp_name = it->second;
+        stats->has_action = true;
     }
     it = map.find("/paction/policy-rule-action/act-un/type");
     if (it != map.end())
     {
         stats->policy_action_type = it->second;
+        stats->has_action = true;
     }
     return stats;
 }
@@ -102,4 +108,316 @@ std::vector<std::string> PBRBase::get_gnmi_paths() const
     return paths;
 }
 
+/**
+ * @brief Sample interval of every key, in the order of get_gnmi_paths.
+ *
+ * @param class_intervals The sample interval of every key class.
+ * @return The interval of the key, else the one of its class, else 0.
+ */
+std::vector<uint64_t> PBRBase::get_sample_intervals(
+    const std::map<std::string, uint64_t>& class_intervals) const
+{
+    std::vector<uint64_t> intervals;
+    intervals.reserve(keys.size());
+    for (const auto& key : keys)
+    {
+        uint64_t interval = key.sample_interval_nsec;
+        if (interval == 0 && !key.key_class.empty())
+        {
+            const auto it = class_intervals.find(key.key_class);
+            if (it != class_intervals.end())
+            {
+                interval = it->second;
+            }
+            else
+            {
+                logger_manager::get_instance().log(
+                    fmt::format("Key class {} has no sample interval, using the default one",
+                                key.key_class),
+                    log_level::WARNING);
+            }
+        }
+        intervals.push_back(interval);
+    }
+    return intervals;
+}
+
+/**
+ * @brief Whether a received rule is one of the keys, rather than one of a wildcard.
+ *
+ * @param policy_name The policy name.
+ * @param rule_name The rule name.
+ */
+bool pbr_subscription_plan::is_wanted(const std::string& policy_name,
+                                      const std::string& rule_name) const
+{
+    const auto it = filtered_rules.find(policy_name);
+    return it == filtered_rules.end() || it->second.count(rule_name) != 0;
+}
+
+/**
+ * @brief Plans the paths subscribed for the keys of pbr counters.
+ *
+ * @param counters The counters whose keys are subscribed.
+ * @param rpc_args The subscription rpc metadata, with the planner options and key classes.
+ * @return The plan of the paths.
+ */
+pbr_subscription_plan plan_subscription(const PBRBase& counters, const rpc_args& rpc_args)
+{
+    pbr_subscription_plan plan;
+    plan.key_paths = counters.keys.size();
+    std::vector<std::string> paths = counters.get_gnmi_paths();
+    std::vector<uint64_t> intervals =
+        counters.get_sample_intervals(rpc_args.class_sample_intervals_nsec);
+    const planner_options& options = rpc_args.planner;
+    if (options.min_rules_per_wildcard == 0 && options.rules_per_policy.empty())
+    {
+        plan.paths = std::move(paths);
+        plan.sample_intervals_nsec = std::move(intervals);
+        return plan;
+    }
+
+    struct policy_keys
+    {
+        std::unordered_set<std::string> rules;
+        uint64_t interval = 0;
+        bool single_interval = true;
+    };
+    std::unordered_map<std::string, policy_keys> policies;
+    for (size_t i = 0; i < counters.keys.size(); i++)
+    {
+        auto& policy = policies[counters.keys[i].key_policy];
+        if (policy.rules.empty())
+        {
+            policy.interval = intervals[i];
+        }
+        // A wildcard has one sample interval, and can't tell which rule wanted which.
+        policy.single_interval = policy.single_interval && policy.interval == intervals[i];
+        policy.rules.insert(counters.keys[i].key_rule);
+    }
+
+    std::unordered_set<std::string> wildcarded;
+    for (size_t i = 0; i < counters.keys.size(); i++)
+    {
+        const std::string& policy_name = counters.keys[i].key_policy;
+        const auto& policy = policies[policy_name];
+        const auto total = options.rules_per_policy.find(policy_name);
+        const bool all_rules =
+            total != options.rules_per_policy.end() && policy.rules.size() >= total->second;
+        const bool many_rules = options.min_rules_per_wildcard != 0 &&
+                                policy.rules.size() >= options.min_rules_per_wildcard;
+        if (!policy.single_interval || (!all_rules && !many_rules))
+        {
+            plan.paths.push_back(std::move(paths[i]));
+            plan.sample_intervals_nsec.push_back(intervals[i]);
+            continue;
+        }
+        if (!wildcarded.insert(policy_name).second)
+        {
+            continue;
+        }
+        plan.paths.push_back(fmt::format(
+            "{}:pbr-stats/policy-maps/policy-map[policy-name={}]/rule-names/"
+            "rule-name[rule-name=*]/",
+            counters.path_origin, policy_name));
+        plan.sample_intervals_nsec.push_back(policy.interval);
+        if (!all_rules)
+        {
+            plan.filtered_rules[policy_name] = policy.rules;
+        }
+    }
+
+    if (plan.saved_paths() > 0)
+    {
+        logger_manager::get_instance().log(
+            fmt::format("Subscription planner saved {} of {} paths with {} wildcards",
+                        plan.saved_paths(), plan.key_paths, wildcarded.size()),
+            log_level::INFO);
+    }
+    return plan;
+}
+
+/**
+ * @brief Creates an empty state.
+ *
+ * @param sample_interval The sample interval of a subscription suppressing redundant updates.
+ */
+pbr_latest_values::pbr_latest_values(std::chrono::nanoseconds sample_interval)
+    : sample_interval(sample_interval)
+{
+}
+
+namespace
+{
+/**
+ * @brief Rate of a counter since its previous value, 0 if it went backwards.
+ *
+ * @param previous The previous value of the counter.
+ * @param current The value received.
+ * @param since When the previous value was received.
+ * @param current_nsec The collection timestamp of the value received, 0 if not sent.
+ * @param now The arrival time of the value received.
+ * @param sample_interval The sample interval of a subscription suppressing redundant updates.
+ */
+double counter_rate(uint64_t previous, uint64_t current, const pbr_counter_time& since,
+                    uint64_t current_nsec, std::chrono::steady_clock::time_point now,
+                    std::chrono::nanoseconds sample_interval)
+{
+    // The collection timestamps of the device, or the arrival times without them.
+    auto elapsed = since.collection_nsec != 0 && current_nsec > since.collection_nsec
+                       ? std::chrono::nanoseconds(current_nsec - since.collection_nsec)
+                       : std::chrono::duration_cast<std::chrono::nanoseconds>(now - since.received);
+    // The samples suppressed in between were unchanged, the counter moved since the last.
+    if (sample_interval.count() != 0 && elapsed > sample_interval)
+    {
+        elapsed = sample_interval;
+    }
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    // A counter going backwards was cleared, its rate is unknown until the next change.
+    if (seconds <= 0 || current < previous)
+    {
+        return 0;
+    }
+    return static_cast<double>(current - previous) / seconds;
+}
+}  // namespace
+
+/**
+ * @brief Merges a stat into the latest value of its rule.
+ *
+ * @param stat The stat, possibly carrying only some of the fields.
+ */
+void pbr_latest_values::merge(const PbrBasicStat& stat)
+{
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(values_mtx);
+    auto& value = values[stat.policy_name + "|" + stat.rule_name];
+    value.stat.policy_name = stat.policy_name;
+    value.stat.rule_name = stat.rule_name;
+    value.updates++;
+    if (stat.has_action)
+    {
+        value.stat.path_grp_name = stat.path_grp_name;
+        value.stat.policy_action_type = stat.policy_action_type;
+        value.stat.has_action = true;
+    }
+    if (!stat.has_counters)
+    {
+        return;
+    }
+
+    // A stat only flagged with has_counters carries both counters.
+    const bool both = !stat.has_byte_count && !stat.has_packet_count;
+    const uint64_t current_nsec =
+        stat.collection_timestamp_seconds * 1000000000ULL + stat.collection_timestamp_nanoseconds;
+    if (stat.has_byte_count || both)
+    {
+        if (value.stat.has_byte_count)
+        {
+            value.bytes_per_second =
+                counter_rate(value.stat.byte_count, stat.byte_count, value.byte_count_time,
+                             current_nsec, now, sample_interval);
+        }
+        value.stat.byte_count = stat.byte_count;
+        value.stat.has_byte_count = true;
+        value.byte_count_time = {current_nsec, now};
+    }
+    if (stat.has_packet_count || both)
+    {
+        if (value.stat.has_packet_count)
+        {
+            value.packets_per_second =
+                counter_rate(value.stat.packet_count, stat.packet_count, value.packet_count_time,
+                             current_nsec, now, sample_interval);
+        }
+        value.stat.packet_count = stat.packet_count;
+        value.stat.has_packet_count = true;
+        value.packet_count_time = {current_nsec, now};
+    }
+    value.stat.collection_timestamp_seconds = stat.collection_timestamp_seconds;
+    value.stat.collection_timestamp_nanoseconds = stat.collection_timestamp_nanoseconds;
+    value.stat.has_counters = true;
+    value.last_counters = now;
+}
+
+/**
+ * @brief Merges stats into the latest values of their rules.
+ *
+ * @param stats The stats.
+ */
+void pbr_latest_values::merge(stat_span<PbrBasicStat> stats)
+{
+    for (const auto& stat : stats)
+    {
+        merge(stat);
+    }
+}
+
+/**
+ * @brief Returns the latest value of a rule.
+ *
+ * @param policy_name The policy name.
+ * @param rule_name The rule name.
+ * @param value Set to the latest value.
+ * @return False if nothing was received for the rule.
+ */
+bool pbr_latest_values::get(const std::string& policy_name, const std::string& rule_name,
+                            pbr_latest_value* value)
+{
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(values_mtx);
+    auto found = values.find(policy_name + "|" + rule_name);
+    if (found == values.end())
+    {
+        return false;
+    }
+    *value = current_locked(found->second, now);
+    return true;
+}
+
+/**
+ * @brief Returns the latest values of every rule.
+ */
+std::vector<pbr_latest_value> pbr_latest_values::snapshot()
+{
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(values_mtx);
+    std::vector<pbr_latest_value> result;
+    result.reserve(values.size());
+    for (const auto& value : values)
+    {
+        result.push_back(current_locked(value.second, now));
+    }
+    return result;
+}
+
+/**
+ * @brief Number of rules with a latest value.
+ */
+size_t pbr_latest_values::size()
+{
+    std::lock_guard<std::mutex> lock(values_mtx);
+    return values.size();
+}
+
+/**
+ * @brief Returns a latest value with its rates as of now.
+ *
+ * @param value The latest value.
+ * @param now The current time.
+ */
+pbr_latest_value pbr_latest_values::current_locked(const pbr_latest_value& value,
+                                                   std::chrono::steady_clock::time_point now) const
+{
+    pbr_latest_value result = value;
+    // Two sample intervals without counters, the device suppressed unchanged samples.
+    if (sample_interval.count() != 0 && result.stat.has_counters &&
+        now - result.last_counters > 2 * sample_interval)
+    {
+        result.bytes_per_second = 0;
+        result.packets_per_second = 0;
+    }
+    return result;
+}
+
 }  // namespace mgbl_api
\ No newline at end of file
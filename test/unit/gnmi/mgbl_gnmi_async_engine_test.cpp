@@ -0,0 +1,149 @@
+#include "gnmi/mgbl_gnmi_async_engine.h"
+#include <gtest/gtest.h>
+#include <grpcpp/alarm.h>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+#include "gnmi/mgbl_gnmi_client.h"
+#include "gnmi/mgbl_gnmi_subscribe_call.h"
+#include "pbr/mgbl_pbr.h"
+
+using namespace mgbl_api;
+
+/*
+ * Unit tests for gnmi_async_engine
+ *
+ * gnmi_async_engine owns one completion queue per poller thread and
+ * drives every stream of the clients bound to it.
+ *
+ */
+
+/*
+ * We test if the engine refuses to start without poller threads.
+ */
+TEST(GnmiAsyncEngineTest, ZeroPollerThreads)
+{
+    gnmi_async_engine::options options;
+    options.poller_threads = 0;
+    EXPECT_THROW(gnmi_async_engine engine(options), std::invalid_argument);
+}
+
+/*
+ * We test if the engine starts the requested number of poller threads
+ * and that the calling thread is not reported as a poller.
+ */
+TEST(GnmiAsyncEngineTest, PollerCount)
+{
+    gnmi_async_engine::options options;
+    options.poller_threads = 3;
+    gnmi_async_engine engine(options);
+
+    EXPECT_EQ(engine.poller_count(), 3);
+    EXPECT_FALSE(engine.is_poller_thread());
+    EXPECT_NE(engine.next_completion_queue(), nullptr);
+    EXPECT_NO_THROW(engine.shutdown());
+    EXPECT_NO_THROW(engine.shutdown());
+}
+
+/*
+ * We test if the default engine is shared.
+ */
+TEST(GnmiAsyncEngineTest, DefaultEngineIsShared)
+{
+    EXPECT_EQ(gnmi_async_engine::default_engine(), gnmi_async_engine::default_engine());
+}
+
+/*
+ * We test if a stream to an unreachable server reports the failure
+ * through rpc_failed_handler on a poller thread of the engine.
+ */
+TEST(GnmiAsyncEngineTest, StreamFailureOnPollerThread)
+{
+    auto engine = std::make_shared<gnmi_async_engine>();
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+
+    std::mutex failure_mtx;
+    std::condition_variable failure_cv;
+    bool failed = false;
+    bool on_poller = false;
+    grpc::StatusCode code = grpc::StatusCode::OK;
+
+    GnmiClient client(connection.get_channel(), pbr_counters, engine);
+    client.set_rpc_failed_handler(
+        [&](grpc::Status status)
+        {
+            std::lock_guard<std::mutex> lock(failure_mtx);
+            failed = true;
+            on_poller = engine->is_poller_thread();
+            code = status.error_code();
+            failure_cv.notify_one();
+        });
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+
+    std::unique_lock<std::mutex> lock(failure_mtx);
+    EXPECT_TRUE(failure_cv.wait_for(lock, std::chrono::seconds(10), [&] { return failed; }));
+    EXPECT_TRUE(on_poller);
+    EXPECT_EQ(code, grpc::StatusCode::UNAVAILABLE);
+    lock.unlock();
+
+    // Once the stream failed, writing again requires closing the stream first.
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::RPC_FAILURE);
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+}
+
+/*
+ * We test if a handler running on a poller thread waits for a call bound to the queue of
+ * another poller thread, and only skips the wait for a call bound to its own queue.
+ */
+TEST(GnmiAsyncEngineTest, WaitFromOtherPollerThread)
+{
+    gnmi_async_engine::options options;
+    options.poller_threads = 2;
+    auto engine = std::make_shared<gnmi_async_engine>(options);
+    grpc::CompletionQueue* own_queue = engine->next_completion_queue();
+    grpc::CompletionQueue* other_queue = engine->next_completion_queue();
+    ASSERT_NE(own_queue, other_queue);
+
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    auto stub = gnmi::gNMI::NewStub(connection.get_channel());
+    client_context_args context_args{"user", "password", false, {}};
+    auto ignore_response = [](const gnmi::SubscribeResponse&) { return true; };
+    // The finish handler is slow, returning before it ran would be seen.
+    auto slow_finish = [](const grpc::Status&)
+    { std::this_thread::sleep_for(std::chrono::milliseconds(200)); };
+    auto other_call = std::make_shared<gnmi_subscribe_call>(engine, other_queue, ignore_response,
+                                                            slow_finish);
+    auto own_call = std::make_shared<gnmi_subscribe_call>(engine, own_queue, ignore_response,
+                                                          slow_finish);
+
+    std::promise<std::pair<bool, bool>> waited;
+    callback_tag tag(
+        [&](bool)
+        {
+            other_call->start(*stub, context_args);
+            const bool in_time = other_call->wait_finished_until(
+                std::chrono::steady_clock::now() + std::chrono::seconds(10));
+            const bool other_finished = other_call->is_finished();
+            // Waiting for a call of its own queue would never return.
+            own_call->start(*stub, context_args);
+            own_call->wait_finished();
+            waited.set_value({in_time, other_finished});
+        });
+    grpc::Alarm alarm;
+    alarm.Set(own_queue, std::chrono::system_clock::now(), &tag);
+
+    auto result = waited.get_future();
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(20)), std::future_status::ready);
+    const auto waits = result.get();
+    EXPECT_TRUE(waits.first);
+    EXPECT_TRUE(waits.second);
+    own_call->wait_finished();
+    EXPECT_TRUE(own_call->is_finished());
+}
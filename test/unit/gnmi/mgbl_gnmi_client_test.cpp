@@ -1,7 +1,23 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include "mgbl_api.h"
 #include "mgbl_api_impl.h"
+#include "gnmi/mgbl_gnmi_channel_pool.h"
+#include "gnmi/mgbl_gnmi_client.h"
+#include "gnmi/mgbl_gnmi_executor.h"
+#include "gnmi/mgbl_gnmi_once_cache.h"
+#include "mgbl_gnmi_fake_server.h"
+#include "pbr/mgbl_pbr.h"
 
 using namespace mgbl_api;
 /*
@@ -33,6 +49,35 @@ TEST(GnmiClientTest, CheckSslCertificateValid)
         gnmi_client_connection connection(rpc_channel_args{"", true, "a certificate", "", ""}));
 }
 
+/*
+ * We test if gnmi_client_connection creates a channel with the high throughput tuning.
+ */
+TEST(GnmiClientTest, ChannelTuningHighThroughput)
+{
+    rpc_channel_args channel_args{"localhost:1", false};
+    channel_args.tuning = channel_tuning::high_throughput();
+    channel_args.tuning.buffer_pool_bytes = 64 * 1024 * 1024;
+    EXPECT_EQ(channel_args.tuning.max_receive_message_size, 64 * 1024 * 1024);
+
+    gnmi_client_connection connection(channel_args);
+    EXPECT_NE(connection.get_channel(), nullptr);
+}
+
+/*
+ * We test if gnmi_client_connection throws an exception for a negative or inconsistent tuning.
+ */
+TEST(GnmiClientTest, ChannelTuningInvalid)
+{
+    rpc_channel_args channel_args{"localhost:1", false};
+    channel_args.tuning.http2_stream_window = -1;
+    EXPECT_THROW(gnmi_client_connection connection(channel_args), std::invalid_argument);
+
+    channel_args.tuning = channel_tuning();
+    channel_args.tuning.min_reconnect_backoff = std::chrono::milliseconds(2000);
+    channel_args.tuning.max_reconnect_backoff = std::chrono::milliseconds(1000);
+    EXPECT_THROW(gnmi_client_connection connection(channel_args), std::invalid_argument);
+}
+
 /*
  * Unit tests for wait_for_grpc_server_connection
  *
@@ -54,4 +99,1130 @@ TEST(GnmiClientConnectionTest, WaitForConnectionRetries)
 
     bool connected = connection.wait_for_grpc_server_connection(3, std::chrono::seconds(1));
     EXPECT_FALSE(connected);
-}
\ No newline at end of file
+}
+/*
+ * Unit tests for set_rpc_batch_handler
+ *
+ * set_rpc_batch_handler hands the stats decoded since its previous call to the
+ * user as a stat_span over the stats vector of the PBRBasic CounterInterface.
+ *
+ */
+namespace
+{
+class OtherCounters : public GnmiCounters
+{
+   public:
+    std::string name() override
+    {
+        return "other";
+    }
+    std::vector<std::string> get_gnmi_paths() const override
+    {
+        return {};
+    }
+};
+}  // namespace
+
+/*
+ * We test if the batch handler is refused for a CounterInterface other than PBRBasic.
+ */
+TEST(GnmiClientTest, BatchHandlerRequiresPbrBasic)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    GnmiClient other_client(connection.get_channel(), std::make_shared<OtherCounters>());
+    EXPECT_EQ(other_client.set_rpc_batch_handler([](stat_span<PbrBasicStat>) {}),
+              error_code::CLIENT_TYPE_FAILURE);
+
+    GnmiClient pbr_client(connection.get_channel(), std::make_shared<PBRBasic>());
+    EXPECT_EQ(pbr_client.set_rpc_batch_handler([](stat_span<PbrBasicStat>) {},
+                                               std::chrono::milliseconds(10)),
+              error_code::SUCCESS);
+}
+
+/*
+ * We test if stat_span exposes the viewed range.
+ */
+TEST(GnmiClientTest, StatSpanRange)
+{
+    std::vector<PbrBasicStat> stats(3);
+    stats[1].byte_count = 10;
+    stats[2].byte_count = 20;
+    stat_span<PbrBasicStat> span(stats.data() + 1, 2);
+
+    EXPECT_EQ(span.size(), 2);
+    EXPECT_FALSE(span.empty());
+    EXPECT_EQ(span[0].byte_count, 10);
+    uint64_t total = 0;
+    for (const auto& stat : span)
+    {
+        total += stat.byte_count;
+    }
+    EXPECT_EQ(total, 30);
+    EXPECT_TRUE(stat_span<PbrBasicStat>(nullptr, 0).empty());
+}
+
+namespace
+{
+/*
+ * Collects the byte counts of every batch handed to the batch handler.
+ */
+struct batch_recorder
+{
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<std::vector<uint64_t>> batches;
+    std::vector<std::chrono::steady_clock::time_point> times;
+
+    void record(stat_span<PbrBasicStat> span)
+    {
+        std::vector<uint64_t> byte_counts;
+        for (const auto& stat : span)
+        {
+            byte_counts.push_back(stat.byte_count);
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        batches.push_back(std::move(byte_counts));
+        times.push_back(std::chrono::steady_clock::now());
+        cv.notify_all();
+    }
+
+    bool wait_batches(size_t count)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        return cv.wait_for(lock, std::chrono::seconds(10),
+                           [&] { return batches.size() >= count; });
+    }
+};
+
+/*
+ * Collects the statuses handed to a handler.
+ */
+struct status_recorder
+{
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<grpc::Status> statuses;
+
+    void record(grpc::Status status)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        statuses.push_back(std::move(status));
+        cv.notify_all();
+    }
+
+    bool wait_statuses(size_t count)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        return cv.wait_for(lock, std::chrono::seconds(10),
+                           [&] { return statuses.size() >= count; });
+    }
+
+    size_t count()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return statuses.size();
+    }
+};
+
+/*
+ * Reads the subscribe request, then sends the byte counts as updates of p1/r1.
+ */
+void write_updates(fake_gnmi_server::subscribe_stream* stream,
+                   const std::vector<uint64_t>& byte_counts)
+{
+    gnmi::SubscribeRequest request;
+    stream->Read(&request);
+    for (const auto byte_count : byte_counts)
+    {
+        stream->Write(fake_gnmi_server::pbr_update("p1", "r1", byte_count));
+    }
+}
+}  // namespace
+
+/*
+ * We test if, without quantum, every response is handed over on its own, and if the
+ * stats erased by the handler are not handed over again.
+ */
+TEST(GnmiClientTest, BatchHandlerPerRead)
+{
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            write_updates(stream, {1, 2, 3});
+            stream->Write(fake_gnmi_server::sync_response());
+            return fake_gnmi_server::wait_cancelled(stream);
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(server.channel(), pbr_counters);
+    batch_recorder recorder;
+    ASSERT_EQ(client.set_rpc_batch_handler(
+                  [&](stat_span<PbrBasicStat> span)
+                  {
+                      recorder.record(span);
+                      pbr_counters->stats.clear();
+                  }),
+              error_code::SUCCESS);
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    EXPECT_TRUE(recorder.wait_batches(3));
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+
+    EXPECT_EQ(recorder.batches, (std::vector<std::vector<uint64_t>>{{1}, {2}, {3}}));
+    EXPECT_TRUE(pbr_counters->stats.empty());
+}
+
+/*
+ * We test if, with a strand per key, the stats of every key keep their order, and if the
+ * finished handler runs once the stats of every key were added.
+ */
+TEST(GnmiClientTest, KeyStrandsKeepKeyOrder)
+{
+    const std::vector<std::string> rules{"r1", "r2", "r3", "r4"};
+    constexpr uint64_t UPDATES_PER_RULE = 50;
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [&](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            gnmi::SubscribeRequest request;
+            stream->Read(&request);
+            for (uint64_t i = 1; i <= UPDATES_PER_RULE; i++)
+            {
+                for (const auto& rule : rules)
+                {
+                    stream->Write(fake_gnmi_server::pbr_update("p1", rule, i));
+                }
+            }
+            return grpc::Status::OK;
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    for (const auto& rule : rules)
+    {
+        pbr_counters->keys.push_back({"p1", rule});
+    }
+    GnmiClient client(server.channel(), pbr_counters);
+    client.set_handler_executor(std::make_shared<work_stealing_executor>(), 4);
+    std::map<std::string, std::vector<uint64_t>> byte_counts;
+    ASSERT_EQ(client.set_rpc_batch_handler(
+                  [&](stat_span<PbrBasicStat> span)
+                  {
+                      for (const auto& stat : span)
+                      {
+                          byte_counts[stat.rule_name].push_back(stat.byte_count);
+                      }
+                  }),
+              error_code::SUCCESS);
+    status_recorder finished;
+    size_t stats_when_finished = 0;
+    client.set_rpc_finished_handler(
+        [&](grpc::Status status)
+        {
+            stats_when_finished = pbr_counters->stats.size();
+            finished.record(status);
+        });
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    ASSERT_TRUE(finished.wait_statuses(1));
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+
+    EXPECT_EQ(stats_when_finished, rules.size() * UPDATES_PER_RULE);
+    std::vector<uint64_t> expected;
+    for (uint64_t i = 1; i <= UPDATES_PER_RULE; i++)
+    {
+        expected.push_back(i);
+    }
+    for (const auto& rule : rules)
+    {
+        EXPECT_EQ(byte_counts[rule], expected) << rule;
+    }
+}
+
+/*
+ * We test if the stats received within the quantum are handed over together once it
+ * elapsed, and the later ones in the next batch.
+ */
+TEST(GnmiClientTest, BatchHandlerQuantum)
+{
+    std::promise<void> send_more;
+    std::shared_future<void> more_requested = send_more.get_future().share();
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [more_requested](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            write_updates(stream, {1, 2, 3});
+            stream->Write(fake_gnmi_server::sync_response());
+            if (more_requested.wait_for(std::chrono::seconds(10)) == std::future_status::ready)
+            {
+                stream->Write(fake_gnmi_server::pbr_update("p1", "r1", 4));
+            }
+            return fake_gnmi_server::wait_cancelled(stream);
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(server.channel(), pbr_counters);
+    batch_recorder recorder;
+    const auto quantum = std::chrono::milliseconds(300);
+    ASSERT_EQ(client.set_rpc_batch_handler(
+                  [&](stat_span<PbrBasicStat> span) { recorder.record(span); }, quantum),
+              error_code::SUCCESS);
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    ASSERT_TRUE(recorder.wait_batches(1));
+    send_more.set_value();
+    EXPECT_TRUE(recorder.wait_batches(2));
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+
+    EXPECT_EQ(recorder.batches, (std::vector<std::vector<uint64_t>>{{1, 2, 3}, {4}}));
+    EXPECT_GE(recorder.times[0] - start, quantum);
+    EXPECT_EQ(pbr_counters->stats.size(), 4);
+}
+
+/*
+ * We test if the stats erased from the stats vector by the success handler, while the
+ * quantum is pending, are still handed over to the batch handler.
+ */
+TEST(GnmiClientTest, BatchHandlerKeepsErasedStats)
+{
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            write_updates(stream, {1, 2, 3, 4, 5});
+            return fake_gnmi_server::wait_cancelled(stream);
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(server.channel(), pbr_counters);
+    client.set_rpc_success_handler(
+        [&](std::shared_ptr<GnmiCounters>)
+        {
+            // Keeps the latest stat only.
+            pbr_counters->stats.erase(pbr_counters->stats.begin(), pbr_counters->stats.end() - 1);
+        });
+    batch_recorder recorder;
+    const auto quantum = std::chrono::milliseconds(300);
+    ASSERT_EQ(client.set_rpc_batch_handler(
+                  [&](stat_span<PbrBasicStat> span) { recorder.record(span); }, quantum),
+              error_code::SUCCESS);
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    ASSERT_TRUE(recorder.wait_batches(1));
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+
+    std::vector<uint64_t> handed_over;
+    for (const auto& batch : recorder.batches)
+    {
+        handed_over.insert(handed_over.end(), batch.begin(), batch.end());
+    }
+    EXPECT_EQ(handed_over, (std::vector<uint64_t>{1, 2, 3, 4, 5}));
+    ASSERT_EQ(pbr_counters->stats.size(), 1);
+    EXPECT_EQ(pbr_counters->stats[0].byte_count, 5);
+}
+
+/*
+ * We test if the stats not handed over yet are flushed when the server ends the stream,
+ * without waiting for the quantum.
+ */
+TEST(GnmiClientTest, BatchHandlerFlushOnStreamEnd)
+{
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            write_updates(stream, {1, 2});
+            return grpc::Status::OK;
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(server.channel(), pbr_counters);
+    batch_recorder recorder;
+    ASSERT_EQ(client.set_rpc_batch_handler([&](stat_span<PbrBasicStat> span)
+                                           { recorder.record(span); },
+                                           std::chrono::milliseconds(60000)),
+              error_code::SUCCESS);
+    bool failed = false;
+    client.set_rpc_failed_handler([&failed](grpc::Status) { failed = true; });
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    EXPECT_TRUE(recorder.wait_batches(1));
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+
+    EXPECT_EQ(recorder.batches, (std::vector<std::vector<uint64_t>>{{1, 2}}));
+    EXPECT_FALSE(failed);
+}
+
+/*
+ * Unit tests for rpc_register_stats_once_async
+ *
+ * rpc_register_stats_once_async sends a subscription once request on the engine
+ * of the client and reports its outcome to a handler instead of blocking.
+ *
+ */
+
+/*
+ * We test if the request is refused without credentials or capabilities to negotiate, and
+ * if the failure of an unreachable server is reported to the handler.
+ */
+TEST(GnmiClientTest, OnceAsyncReportsFailure)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(connection.get_channel(), pbr_counters);
+    rpc_args rpc_args;
+
+    client_context_args no_credentials{"", "", false, {}};
+    EXPECT_EQ(client.rpc_register_stats_once_async(no_credentials, rpc_args,
+                                                   [](error_code, grpc::Status) {}),
+              error_code::CLIENT_TYPE_FAILURE);
+
+    // Negotiating would block on the Capabilities RPC, the capabilities must be fetched first.
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args.negotiate = true;
+    EXPECT_EQ(client.rpc_register_stats_once_async(context_args, rpc_args,
+                                                   [](error_code, grpc::Status) {}),
+              error_code::CLIENT_TYPE_FAILURE);
+    rpc_args.negotiate = false;
+
+    std::mutex done_mtx;
+    std::condition_variable done_cv;
+    bool done = false;
+    error_code result = error_code::SUCCESS;
+    grpc::Status result_status;
+    EXPECT_EQ(client.rpc_register_stats_once_async(context_args, rpc_args,
+                                                   [&](error_code err, grpc::Status status)
+                                                   {
+                                                       std::lock_guard<std::mutex> lock(done_mtx);
+                                                       result = err;
+                                                       result_status = status;
+                                                       done = true;
+                                                       done_cv.notify_one();
+                                                   }),
+              error_code::SUCCESS);
+
+    std::unique_lock<std::mutex> lock(done_mtx);
+    EXPECT_TRUE(done_cv.wait_for(lock, std::chrono::seconds(10), [&] { return done; }));
+    EXPECT_EQ(result, error_code::RPC_FAILURE);
+    EXPECT_EQ(result_status.error_code(), grpc::StatusCode::UNAVAILABLE);
+    EXPECT_TRUE(pbr_counters->stats.empty());
+}
+
+/*
+ * We test if the clients sharing a once cache only share the results of identical
+ * credentials: a client differing by its password sends its own request.
+ */
+TEST(GnmiClientTest, OnceCacheKeyedByCredentials)
+{
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [](int call, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            write_updates(stream, {static_cast<uint64_t>(call + 1)});
+            stream->Write(fake_gnmi_server::sync_response());
+            return grpc::Status::OK;
+        });
+    auto cache = std::make_shared<once_cache>();
+    rpc_args rpc_args;
+    auto once = [&](const std::string& password)
+    {
+        auto pbr_counters = std::make_shared<PBRBasic>();
+        pbr_counters->keys.push_back({"p1", "r1"});
+        GnmiClient client(server.channel(), pbr_counters);
+        client.set_once_cache(cache, "router1:57400");
+        client_context_args context_args{"user", password, false, {}};
+        EXPECT_EQ(client.rpc_register_stats_once(context_args, rpc_args).first,
+                  error_code::SUCCESS);
+        EXPECT_EQ(pbr_counters->stats.size(), 1);
+        return pbr_counters->stats.empty() ? 0 : pbr_counters->stats[0].byte_count;
+    };
+
+    EXPECT_EQ(once("password1"), 1);
+    EXPECT_EQ(once("password2"), 2);
+    EXPECT_EQ(once("password1"), 1);
+    EXPECT_EQ(server.subscribe_passwords(),
+              (std::vector<std::string>{"password1", "password2"}));
+    const once_cache_statistics stats = cache->get_statistics();
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.hits, 1u);
+}
+
+/*
+ * Unit tests for rpc_resubscribe_stats_stream
+ *
+ * rpc_resubscribe_stats_stream opens a stream with the current keys and only
+ * replaces the running one once the new stream has sent its sync_response.
+ *
+ */
+
+/*
+ * We test if resubscribing refuses other counters, opens the stream when none is running,
+ * and reports the failure of the new RPC to its own handler, not to the failed handler.
+ */
+TEST(GnmiClientTest, ResubscribeReportsFailure)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+
+    GnmiClient other_client(connection.get_channel(), std::make_shared<OtherCounters>());
+    EXPECT_EQ(other_client.rpc_resubscribe_stats_stream(context_args, rpc_args),
+              error_code::CLIENT_TYPE_FAILURE);
+
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(connection.get_channel(), pbr_counters);
+    status_recorder failures;
+    client.set_rpc_failed_handler([&](grpc::Status status) { failures.record(status); });
+
+    status_recorder resubscribed;
+    auto on_done = [&](grpc::Status status) { resubscribed.record(status); };
+    EXPECT_EQ(client.rpc_resubscribe_stats_stream(context_args, rpc_args, on_done),
+              error_code::SUCCESS);
+    ASSERT_TRUE(resubscribed.wait_statuses(1));
+    EXPECT_TRUE(resubscribed.statuses[0].ok());
+    ASSERT_TRUE(failures.wait_statuses(1));
+    EXPECT_EQ(failures.statuses[0].error_code(), grpc::StatusCode::UNAVAILABLE);
+
+    pbr_counters->keys.push_back({"p1", "r2"});
+    EXPECT_EQ(client.rpc_resubscribe_stats_stream(context_args, rpc_args, on_done),
+              error_code::SUCCESS);
+    ASSERT_TRUE(resubscribed.wait_statuses(2));
+    EXPECT_EQ(resubscribed.statuses[1].error_code(), grpc::StatusCode::UNAVAILABLE);
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+    EXPECT_EQ(failures.count(), 1);
+}
+
+/*
+ * We test if a failed resubscription leaves the running stream alone: the failed and
+ * finished handlers are not called, the stream keeps delivering and can be resubscribed.
+ */
+TEST(GnmiClientTest, ResubscribeFailureKeepsStream)
+{
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [](int call, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            if (call == 1)
+            {
+                gnmi::SubscribeRequest request;
+                stream->Read(&request);
+                return grpc::Status(grpc::StatusCode::PERMISSION_DENIED, "Key not allowed");
+            }
+            write_updates(stream, {call == 0 ? 1u : 5u});
+            stream->Write(fake_gnmi_server::sync_response());
+            return fake_gnmi_server::wait_cancelled(stream);
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(server.channel(), pbr_counters);
+    batch_recorder recorder;
+    ASSERT_EQ(client.set_rpc_batch_handler(
+                  [&](stat_span<PbrBasicStat> span)
+                  {
+                      recorder.record(span);
+                      pbr_counters->stats.clear();
+                  }),
+              error_code::SUCCESS);
+    status_recorder ended;
+    client.set_rpc_failed_handler([&](grpc::Status status) { ended.record(status); });
+    client.set_rpc_finished_handler([&](grpc::Status status) { ended.record(status); });
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    ASSERT_TRUE(recorder.wait_batches(1));
+
+    status_recorder resubscribed;
+    auto on_done = [&](grpc::Status status) { resubscribed.record(status); };
+    pbr_counters->keys.push_back({"p1", "r2"});
+    EXPECT_EQ(client.rpc_resubscribe_stats_stream(context_args, rpc_args, on_done),
+              error_code::SUCCESS);
+    ASSERT_TRUE(resubscribed.wait_statuses(1));
+    EXPECT_EQ(resubscribed.statuses[0].error_code(), grpc::StatusCode::PERMISSION_DENIED);
+
+    EXPECT_EQ(client.rpc_resubscribe_stats_stream(context_args, rpc_args, on_done),
+              error_code::SUCCESS);
+    ASSERT_TRUE(resubscribed.wait_statuses(2));
+    EXPECT_TRUE(resubscribed.statuses[1].ok());
+    ASSERT_TRUE(recorder.wait_batches(2));
+    EXPECT_EQ(recorder.batches[1], std::vector<uint64_t>{5});
+    EXPECT_EQ(ended.count(), 0);
+
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+    ASSERT_TRUE(ended.wait_statuses(1));
+    EXPECT_EQ(ended.statuses[0].error_code(), grpc::StatusCode::CANCELLED);
+    EXPECT_EQ(server.subscribe_calls(), 3);
+}
+
+/*
+ * We test if a second request on an open stream is refused instead of being written to the
+ * Subscribe RPC, and if the stream keeps delivering.
+ */
+TEST(GnmiClientTest, RegisterOnOpenStreamRefused)
+{
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            write_updates(stream, {1});
+            stream->Write(fake_gnmi_server::sync_response());
+            return fake_gnmi_server::wait_cancelled(stream);
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(server.channel(), pbr_counters);
+    batch_recorder recorder;
+    ASSERT_EQ(client.set_rpc_batch_handler([&](stat_span<PbrBasicStat> span)
+                                           { recorder.record(span); }),
+              error_code::SUCCESS);
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    ASSERT_TRUE(recorder.wait_batches(1));
+    pbr_counters->keys.push_back({"p1", "r2"});
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::RPC_FAILURE);
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+    EXPECT_EQ(server.subscribe_calls(), 1);
+}
+
+/*
+ * We test if the asynchronous, bounded and bulk closes finish the streams of the clients.
+ */
+TEST(GnmiClientTest, CloseAsyncAndCloseAll)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+
+    std::vector<std::unique_ptr<GnmiClient>> clients;
+    std::vector<GnmiClient*> client_pointers;
+    for (int i = 0; i < 8; i++)
+    {
+        auto pbr_counters = std::make_shared<PBRBasic>();
+        pbr_counters->keys.push_back({"p1", "r1"});
+        clients.push_back(std::make_unique<GnmiClient>(connection.get_channel(), pbr_counters));
+        EXPECT_EQ(clients.back()->rpc_register_stats_stream(context_args, rpc_args),
+                  error_code::SUCCESS);
+        client_pointers.push_back(clients.back().get());
+    }
+
+    std::future<error_code> closed = clients[0]->rpc_stream_close_async();
+    ASSERT_EQ(closed.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(closed.get(), error_code::SUCCESS);
+    EXPECT_EQ(clients[1]->rpc_stream_close(std::chrono::milliseconds(5000)), error_code::SUCCESS);
+    EXPECT_EQ(GnmiClient::rpc_stream_close_all(client_pointers, std::chrono::milliseconds(5000)),
+              error_code::SUCCESS);
+
+    // A client can be destroyed while its asynchronous close is pending.
+    EXPECT_EQ(clients[2]->rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    closed = clients[2]->rpc_stream_close_async();
+    clients[2].reset();
+    EXPECT_EQ(closed.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+}
+
+/*
+ * We test if a bounded close returns at its deadline while a handler is still running, and
+ * if the next close waits for it.
+ */
+TEST(GnmiClientTest, CloseTimeoutWithRunningHandler)
+{
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            write_updates(stream, {1});
+            return fake_gnmi_server::wait_cancelled(stream);
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(server.channel(), pbr_counters);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    batch_recorder recorder;
+    ASSERT_EQ(client.set_rpc_batch_handler(
+                  [&](stat_span<PbrBasicStat> span)
+                  {
+                      recorder.record(span);
+                      released.wait();
+                  }),
+              error_code::SUCCESS);
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    ASSERT_TRUE(recorder.wait_batches(1));
+
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(client.rpc_stream_close(std::chrono::milliseconds(100)), error_code::RPC_FAILURE);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+
+    release.set_value();
+    EXPECT_EQ(client.rpc_stream_close(std::chrono::milliseconds(5000)), error_code::SUCCESS);
+    EXPECT_EQ(recorder.batches.size(), 1);
+}
+
+/*
+ * We test if closing from a success handler with several strands on a single worker only
+ * cancels the stream, and if the next close waits for the handlers still queued.
+ */
+TEST(GnmiClientTest, CloseFromHandlerWithKeyStrands)
+{
+    const std::vector<std::string> rules{"r1", "r2", "r3", "r4"};
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [&](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            gnmi::SubscribeRequest request;
+            stream->Read(&request);
+            for (uint64_t i = 1; i <= 20; i++)
+            {
+                for (const auto& rule : rules)
+                {
+                    stream->Write(fake_gnmi_server::pbr_update("p1", rule, i));
+                }
+            }
+            return fake_gnmi_server::wait_cancelled(stream);
+        });
+    work_stealing_executor::options executor_options;
+    executor_options.worker_threads = 1;
+    auto executor = std::make_shared<work_stealing_executor>(executor_options);
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    for (const auto& rule : rules)
+    {
+        pbr_counters->keys.push_back({"p1", rule});
+    }
+    GnmiClient client(server.channel(), pbr_counters);
+    client.set_handler_executor(executor, 4);
+    std::promise<error_code> closed;
+    bool first = true;
+    client.set_rpc_success_handler(
+        [&](std::shared_ptr<GnmiCounters>)
+        {
+            // The success handlers of the strands are serialized by the single worker.
+            if (first)
+            {
+                first = false;
+                // Waits for the other strands to have handlers queued behind this one.
+                const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+                while (executor->get_statistics().pending_tasks < rules.size() &&
+                       std::chrono::steady_clock::now() < give_up)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                closed.set_value(client.rpc_stream_close());
+            }
+        });
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    auto result = closed.get_future();
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_EQ(result.get(), error_code::SUCCESS);
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+    EXPECT_EQ(executor->get_statistics().pending_tasks, 0);
+}
+
+/*
+ * We test if the samples drained from the delivery queue run on the strands of their keys, in
+ * parallel across keys and in order within a key.
+ */
+TEST(GnmiClientTest, DeliveryQueueDrainsOnKeyStrands)
+{
+    // Two rules whose keys hash to different strands out of two.
+    std::vector<std::string> rules;
+    for (int i = 1; rules.size() < 2; i++)
+    {
+        const std::string rule = "r" + std::to_string(i);
+        if (rules.empty() || std::hash<std::string>()("p1|" + rule) % 2 !=
+                                 std::hash<std::string>()("p1|" + rules[0]) % 2)
+        {
+            rules.push_back(rule);
+        }
+    }
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [&](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            gnmi::SubscribeRequest request;
+            stream->Read(&request);
+            for (uint64_t i = 1; i <= 5; i++)
+            {
+                for (const auto& rule : rules)
+                {
+                    stream->Write(fake_gnmi_server::pbr_update("p1", rule, i));
+                }
+            }
+            return fake_gnmi_server::wait_cancelled(stream);
+        });
+    work_stealing_executor::options executor_options;
+    executor_options.worker_threads = 2;
+    auto executor = std::make_shared<work_stealing_executor>(executor_options);
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    for (const auto& rule : rules)
+    {
+        pbr_counters->keys.push_back({"p1", rule});
+    }
+    GnmiClient client(server.channel(), pbr_counters);
+    client.set_handler_executor(executor, 2);
+    client.set_delivery_queue(delivery_queue_options{});
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    int running = 0;
+    int delivered = 0;
+    bool overlapped = false;
+    client.set_rpc_success_handler(
+        [&](std::shared_ptr<GnmiCounters>)
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            running++;
+            overlapped = overlapped || running > 1;
+            cv.notify_all();
+            // Gives the handler of the other key the time to start next to this one, a batch
+            // drained before the other key arrived holds a single key.
+            cv.wait_for(lock, std::chrono::milliseconds(200), [&] { return overlapped; });
+            running--;
+            delivered++;
+            cv.notify_all();
+        });
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        EXPECT_TRUE(cv.wait_for(lock, std::chrono::seconds(10),
+                                [&] { return delivered == 5 * static_cast<int>(rules.size()); }));
+        EXPECT_TRUE(overlapped);
+    }
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+    std::map<std::string, std::vector<uint64_t>> byte_counts;
+    for (const auto& stat : pbr_counters->stats)
+    {
+        byte_counts[stat.rule_name].push_back(stat.byte_count);
+    }
+    for (const auto& rule : rules)
+    {
+        EXPECT_EQ(byte_counts[rule], (std::vector<uint64_t>{1, 2, 3, 4, 5}));
+    }
+}
+
+namespace
+{
+/*
+ * Writes the log to stderr, where the death tests look for it.
+ */
+class stderr_logger : public logger
+{
+   public:
+    void log(const std::string& message, log_level) override
+    {
+        std::cerr << message << std::endl;
+    }
+};
+
+/*
+ * Destroys a client from its failed handler, which does not return.
+ */
+void destroy_client_from_handler()
+{
+    logger_manager::get_instance().set_logger(std::make_shared<stderr_logger>());
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    auto client = std::make_unique<GnmiClient>(connection.get_channel(), pbr_counters);
+    std::promise<void> destroyed;
+    client->set_rpc_failed_handler(
+        [&](grpc::Status)
+        {
+            client.reset();
+            destroyed.set_value();
+        });
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    client->rpc_register_stats_stream(context_args, rpc_args);
+    destroyed.get_future().wait_for(std::chrono::seconds(10));
+}
+}  // namespace
+
+/*
+ * We test if a client destroyed from its own handler terminates the process, in every build,
+ * rather than waiting on the poller thread running the handler.
+ */
+TEST(GnmiClientTest, DestroyedFromHandlerTerminates)
+{
+    ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+    EXPECT_DEATH(destroy_client_from_handler(), "destroyed from its own handler");
+}
+
+/*
+ * We test if a stream seeded from an unreachable target still starts, with an empty state.
+ */
+TEST(GnmiClientTest, SeedFallsBackToInitialState)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(connection.get_channel(), pbr_counters);
+
+    pbr_latest_values latest;
+    EXPECT_EQ(client.rpc_seed_stats_stream(context_args, rpc_args, latest), error_code::SUCCESS);
+    EXPECT_EQ(latest.size(), 0);
+    // The flags of the stream are not written back to the rpc_args.
+    EXPECT_FALSE(rpc_args.updates_only);
+    EXPECT_FALSE(rpc_args.resume_updates_only);
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+}
+
+/*
+ * We test if the cheapest supported encoding and the models of the origin are selected.
+ */
+TEST(GnmiClientTest, SelectFromCapabilities)
+{
+    gnmi::CapabilityResponse capabilities;
+    EXPECT_EQ(select_encoding(capabilities, gnmi::JSON), gnmi::JSON);
+    capabilities.add_supported_encodings(gnmi::JSON_IETF);
+    EXPECT_EQ(select_encoding(capabilities, gnmi::JSON), gnmi::JSON_IETF);
+    capabilities.add_supported_encodings(gnmi::PROTO);
+    EXPECT_EQ(select_encoding(capabilities, gnmi::JSON), gnmi::PROTO);
+
+    gnmi::ModelData* model = capabilities.add_supported_models();
+    model->set_name("Cisco-IOS-XR-pbr-oper");
+    model->set_version("7.0.0");
+    capabilities.add_supported_models()->set_name("openconfig-interfaces");
+    auto models = select_models(capabilities, "Cisco-IOS-XR-pbr-oper");
+    ASSERT_EQ(models.size(), 1);
+    EXPECT_EQ(models[0].version(), "7.0.0");
+    EXPECT_TRUE(select_models(capabilities, "").empty());
+}
+
+/*
+ * We test if a failed negotiation leaves the rpc_args unchanged and is not cached.
+ */
+TEST(GnmiClientTest, NegotiateFailureKeepsArgs)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    rpc_args.encoding = gnmi::JSON_IETF;
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(connection.get_channel(), pbr_counters);
+
+    gnmi::CapabilityResponse capabilities;
+    EXPECT_EQ(client.rpc_get_capabilities(context_args, &capabilities), error_code::RPC_FAILURE);
+    EXPECT_EQ(client.rpc_negotiate(context_args, rpc_args), error_code::RPC_FAILURE);
+    EXPECT_EQ(rpc_args.encoding, gnmi::JSON_IETF);
+    EXPECT_TRUE(rpc_args.use_models.empty());
+}
+
+/*
+ * We test if a Get from an unreachable target fails without adding stats.
+ */
+TEST(GnmiClientTest, GetStatsFailure)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    client_context_args context_args{"user", "password", true,
+                                     std::chrono::system_clock::now() + std::chrono::seconds(5)};
+    rpc_args rpc_args;
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(connection.get_channel(), pbr_counters);
+
+    auto result = client.rpc_get_stats(context_args, rpc_args);
+    EXPECT_EQ(result.first, error_code::RPC_FAILURE);
+    EXPECT_FALSE(result.second.ok());
+    EXPECT_TRUE(pbr_counters->stats.empty());
+
+    client_context_args no_credentials{"", "", false, {}};
+    EXPECT_EQ(client.rpc_get_stats(no_credentials, rpc_args).first,
+              error_code::CLIENT_TYPE_FAILURE);
+}
+
+namespace
+{
+/*
+ * Returns a GetResponse with one notification holding the byte counts of several rules,
+ * under a prefix above the policy maps.
+ */
+gnmi::GetResponse multi_rule_get_response(
+    const std::vector<std::pair<std::string, uint64_t>>& rule_byte_counts)
+{
+    gnmi::GetResponse response;
+    gnmi::Notification* notification = response.add_notification();
+    *notification->mutable_prefix() = string_to_gnmipath("pbr-stats/policy-maps");
+    notification->mutable_prefix()->set_origin("Cisco-IOS-XR-pbr-fwd-stats-oper");
+    for (const auto& rule_byte_count : rule_byte_counts)
+    {
+        gnmi::Update* update = notification->add_update();
+        *update->mutable_path() = string_to_gnmipath(
+            "policy-map[policy-name=p1]/rule-names/rule-name[rule-name=" +
+            rule_byte_count.first + "]/fib-stats/byte-count");
+        update->mutable_val()->set_uint_val(rule_byte_count.second);
+    }
+    return response;
+}
+}  // namespace
+
+/*
+ * We test if the GetRequest of rpc_get_stats holds the type, encoding and the keys split
+ * into a prefix and paths, and if every rule of a notification is added as its own stat.
+ */
+TEST(GnmiClientTest, GetStatsRequestAndRules)
+{
+    fake_gnmi_server server;
+    server.on_get(
+        [](const gnmi::GetRequest&, gnmi::GetResponse* response)
+        {
+            *response = multi_rule_get_response({{"r1", 100}, {"r2", 200}});
+            return grpc::Status::OK;
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    pbr_counters->keys.push_back({"p1", "r2"});
+    GnmiClient client(server.channel(), pbr_counters);
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    rpc_args.encoding = gnmi::JSON_IETF;
+    auto result = client.rpc_get_stats(context_args, rpc_args);
+    ASSERT_EQ(result.first, error_code::SUCCESS);
+
+    const auto requests = server.get_requests();
+    ASSERT_EQ(requests.size(), 1);
+    const gnmi::GetRequest& request = requests[0];
+    EXPECT_EQ(request.type(), gnmi::GetRequest_DataType_STATE);
+    EXPECT_EQ(request.encoding(), gnmi::JSON_IETF);
+    EXPECT_EQ(request.prefix().origin(), "Cisco-IOS-XR-pbr-fwd-stats-oper");
+    EXPECT_EQ(gnmipath_to_string(request.prefix()), "/pbr-stats/policy-maps");
+    ASSERT_EQ(request.path_size(), 2);
+    EXPECT_EQ(gnmipath_to_string(request.path(0)),
+              "/policy-map[policy-name=p1]/rule-names/rule-name[rule-name=r1]");
+    EXPECT_EQ(gnmipath_to_string(request.path(1)),
+              "/policy-map[policy-name=p1]/rule-names/rule-name[rule-name=r2]");
+
+    ASSERT_EQ(pbr_counters->stats.size(), 2);
+    std::map<std::string, uint64_t> byte_counts;
+    for (const auto& stat : pbr_counters->stats)
+    {
+        EXPECT_EQ(stat.policy_name, "p1");
+        byte_counts[stat.rule_name] = stat.byte_count;
+    }
+    EXPECT_EQ(byte_counts, (std::map<std::string, uint64_t>{{"r1", 100}, {"r2", 200}}));
+}
+
+/*
+ * We test if a seeded stream reads every rule of the Get into the latest values, then
+ * subscribes for the updates only.
+ */
+TEST(GnmiClientTest, SeedMergesEveryRule)
+{
+    fake_gnmi_server server;
+    server.on_get(
+        [](const gnmi::GetRequest&, gnmi::GetResponse* response)
+        {
+            *response = multi_rule_get_response({{"r1", 100}, {"r2", 200}});
+            return grpc::Status::OK;
+        });
+    std::promise<gnmi::SubscribeRequest> subscribed;
+    server.on_subscribe(
+        [&](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            gnmi::SubscribeRequest request;
+            stream->Read(&request);
+            subscribed.set_value(request);
+            return fake_gnmi_server::wait_cancelled(stream);
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    pbr_counters->keys.push_back({"p1", "r2"});
+    GnmiClient client(server.channel(), pbr_counters);
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    pbr_latest_values latest;
+    EXPECT_EQ(client.rpc_seed_stats_stream(context_args, rpc_args, latest), error_code::SUCCESS);
+    auto request = subscribed.get_future();
+    ASSERT_EQ(request.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    EXPECT_TRUE(request.get().subscribe().updates_only());
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+
+    const auto requests = server.get_requests();
+    ASSERT_EQ(requests.size(), 1);
+    EXPECT_EQ(requests[0].type(), gnmi::GetRequest_DataType_ALL);
+    EXPECT_EQ(latest.size(), 2);
+    pbr_latest_value value;
+    ASSERT_TRUE(latest.get("p1", "r1", &value));
+    EXPECT_EQ(value.stat.byte_count, 100);
+    ASSERT_TRUE(latest.get("p1", "r2", &value));
+    EXPECT_EQ(value.stat.byte_count, 200);
+}
+
+/*
+ * We test if a seed with empty credentials is refused before its Get is sent.
+ */
+TEST(GnmiClientTest, SeedRequiresCredentials)
+{
+    fake_gnmi_server server;
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(server.channel(), pbr_counters);
+
+    client_context_args context_args{"user", "", false, {}};
+    rpc_args rpc_args;
+    pbr_latest_values latest;
+    EXPECT_EQ(client.rpc_seed_stats_stream(context_args, rpc_args, latest),
+              error_code::CLIENT_TYPE_FAILURE);
+    EXPECT_TRUE(server.get_requests().empty());
+    EXPECT_EQ(latest.size(), 0);
+}
+
+/*
+ * We test if pooled connections to a target share its channels, spread over its
+ * subchannels, and if the channels are closed with their last connection.
+ */
+TEST(GnmiClientTest, ChannelPoolSharesChannels)
+{
+    rpc_channel_args channel_args{"localhost:2", false};
+    channel_args.pool_subchannels = 2;
+    const channel_pool_statistics before = channel_pool::get_instance().get_statistics();
+    {
+        gnmi_client_connection first(channel_args);
+        gnmi_client_connection second(channel_args);
+        gnmi_client_connection third(channel_args);
+        EXPECT_NE(first.get_channel(), second.get_channel());
+        EXPECT_TRUE(third.get_channel() == first.get_channel() ||
+                    third.get_channel() == second.get_channel());
+
+        rpc_channel_args other_args{"localhost:3", false};
+        other_args.pool_subchannels = 2;
+        gnmi_client_connection other(other_args);
+        EXPECT_NE(other.get_channel(), first.get_channel());
+        EXPECT_NE(other.get_channel(), second.get_channel());
+
+        const channel_pool_statistics statistics = channel_pool::get_instance().get_statistics();
+        EXPECT_EQ(statistics.channels, before.channels + 3);
+        EXPECT_EQ(statistics.targets, before.targets + 2);
+        EXPECT_EQ(statistics.reused, before.reused + 1);
+    }
+    EXPECT_EQ(channel_pool::get_instance().get_statistics().channels, before.channels);
+
+    gnmi_client_connection own(rpc_channel_args{"localhost:2", false});
+    EXPECT_EQ(channel_pool::get_instance().get_statistics().created, before.created + 3);
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "gnmi/mgbl_gnmi_coroutine.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "gnmi/mgbl_gnmi_client.h"
+#include "mgbl_gnmi_fake_server.h"
+#include "pbr/mgbl_pbr.h"
+
+using namespace mgbl_api;
+
+/*
+ * Unit tests for the coroutine interface
+ *
+ * sample_stream and subscribe_once let a C++20 coroutine await the samples of
+ * a stream and the result of a once request. The target is a fake gNMI server.
+ *
+ */
+
+#ifndef MGBL_API_HAS_COROUTINES
+#error "The coroutine tests must be compiled with C++20 coroutine support"
+#endif
+
+namespace
+{
+/*
+ * Awaits the batches of the stream until it ends, collecting their byte counts.
+ */
+gnmi_task collect_batches(sample_stream* stream, std::vector<uint64_t>* byte_counts)
+{
+    while (true)
+    {
+        std::vector<PbrBasicStat> batch = co_await stream->next_batch();
+        if (batch.empty())
+        {
+            co_return;
+        }
+        for (const auto& stat : batch)
+        {
+            byte_counts->push_back(stat.byte_count);
+        }
+    }
+}
+
+gnmi_task await_once(GnmiClient* client, client_context_args context_args, rpc_args args,
+                     std::shared_ptr<work_stealing_executor> executor,
+                     std::pair<error_code, grpc::Status>* result)
+{
+    *result = co_await subscribe_once(*client, context_args, args, executor);
+}
+
+bool wait_done(const gnmi_task& task)
+{
+    const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!task.done() && std::chrono::steady_clock::now() < give_up)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return task.done();
+}
+
+std::shared_ptr<work_stealing_executor> make_executor()
+{
+    work_stealing_executor::options options;
+    options.worker_threads = 2;
+    return std::make_shared<work_stealing_executor>(options);
+}
+}  // namespace
+
+/*
+ * We test if the coroutine gets the samples of the stream, then an empty batch once the
+ * server ended the stream with OK.
+ */
+TEST(GnmiCoroutineTest, NextBatchUntilServerEnd)
+{
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            gnmi::SubscribeRequest request;
+            stream->Read(&request);
+            stream->Write(fake_gnmi_server::pbr_update("p1", "r1", 1));
+            stream->Write(fake_gnmi_server::pbr_update("p1", "r1", 2));
+            return grpc::Status::OK;
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(server.channel(), pbr_counters);
+    auto executor = make_executor();
+    sample_stream stream(client, pbr_counters, std::chrono::milliseconds(0), executor);
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    std::vector<uint64_t> byte_counts;
+    gnmi_task task = collect_batches(&stream, &byte_counts);
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+
+    ASSERT_TRUE(wait_done(task));
+    EXPECT_EQ(byte_counts, (std::vector<uint64_t>{1, 2}));
+    EXPECT_TRUE(stream.status().ok());
+    EXPECT_TRUE(pbr_counters->stats.empty());
+    stream.close();
+}
+
+/*
+ * We test if closing the stream, through sample_stream or directly on the client, wakes
+ * the awaiting coroutine with CANCELLED.
+ */
+TEST(GnmiCoroutineTest, CloseWakesAwaiter)
+{
+    fake_gnmi_server server;
+    server.on_subscribe([](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+                        { return fake_gnmi_server::wait_cancelled(stream); });
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    auto executor = make_executor();
+
+    for (const bool close_client : {false, true})
+    {
+        auto pbr_counters = std::make_shared<PBRBasic>();
+        pbr_counters->keys.push_back({"p1", "r1"});
+        GnmiClient client(server.channel(), pbr_counters);
+        sample_stream stream(client, pbr_counters, std::chrono::milliseconds(0), executor);
+        std::vector<uint64_t> byte_counts;
+        gnmi_task task = collect_batches(&stream, &byte_counts);
+        EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        EXPECT_FALSE(task.done());
+
+        if (close_client)
+        {
+            EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+        }
+        else
+        {
+            stream.close();
+        }
+        ASSERT_TRUE(wait_done(task));
+        EXPECT_TRUE(byte_counts.empty());
+        EXPECT_EQ(stream.status().error_code(), grpc::StatusCode::CANCELLED);
+    }
+}
+
+/*
+ * We test if awaiting a once request resumes the coroutine with its result and its stats.
+ */
+TEST(GnmiCoroutineTest, SubscribeOnce)
+{
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            gnmi::SubscribeRequest request;
+            stream->Read(&request);
+            // Not EXPECT_EQ, which would odr-use the constexpr member, defined inline here
+            // and out of line by the C++14 gnmi.pb.cc.
+            EXPECT_TRUE(request.subscribe().mode() == gnmi::SubscriptionList::ONCE);
+            stream->Write(fake_gnmi_server::pbr_update("p1", "r1", 7));
+            stream->Write(fake_gnmi_server::sync_response());
+            return grpc::Status::OK;
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(server.channel(), pbr_counters);
+    auto executor = make_executor();
+
+    client_context_args context_args{"user", "password", false, {}};
+    std::pair<error_code, grpc::Status> result{error_code::RPC_FAILURE, grpc::Status::CANCELLED};
+    gnmi_task task = await_once(&client, context_args, rpc_args(), executor, &result);
+    ASSERT_TRUE(wait_done(task));
+    task.wait();
+    EXPECT_EQ(result.first, error_code::SUCCESS);
+    EXPECT_TRUE(result.second.ok());
+    ASSERT_EQ(pbr_counters->stats.size(), 1);
+    EXPECT_EQ(pbr_counters->stats[0].byte_count, 7);
+
+    // Without credentials the request is refused without suspending.
+    client_context_args no_credentials{"", "", false, {}};
+    gnmi_task refused = await_once(&client, no_credentials, rpc_args(), executor, &result);
+    ASSERT_TRUE(wait_done(refused));
+    EXPECT_EQ(result.first, error_code::CLIENT_TYPE_FAILURE);
+}
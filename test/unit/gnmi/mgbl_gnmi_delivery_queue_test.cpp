@@ -0,0 +1,163 @@
+#include "gnmi/mgbl_gnmi_delivery_queue.h"
+#include <gtest/gtest.h>
+#include <vector>
+#include "pbr/mgbl_pbr.h"
+
+using namespace mgbl_api;
+
+/*
+ * Unit tests for delivery_queue
+ *
+ * delivery_queue bounds the samples waiting between the poller thread
+ * and the handlers, and counts every sample dropped or coalesced.
+ *
+ */
+namespace
+{
+delivery_item make_item(const std::string& key, uint64_t byte_count)
+{
+    auto stat = std::make_shared<PbrBasicStat>();
+    stat->byte_count = byte_count;
+    return delivery_item{key, stat};
+}
+
+std::vector<uint64_t> drain(delivery_queue& queue)
+{
+    std::vector<delivery_item> items;
+    queue.pop_batch(items, 100);
+    std::vector<uint64_t> byte_counts;
+    for (const auto& item : items)
+    {
+        byte_counts.push_back(std::dynamic_pointer_cast<PbrBasicStat>(item.stat)->byte_count);
+    }
+    return byte_counts;
+}
+
+delivery_queue::push_result push(delivery_queue& queue, const std::string& key,
+                                 uint64_t byte_count)
+{
+    delivery_item item = make_item(key, byte_count);
+    return queue.push(item);
+}
+}  // namespace
+
+/*
+ * We test if the queue refuses a capacity of 0.
+ */
+TEST(DeliveryQueueTest, ZeroCapacity)
+{
+    delivery_queue_options options;
+    options.capacity = 0;
+    EXPECT_THROW(delivery_queue queue(options), std::invalid_argument);
+}
+
+/*
+ * We test if a full BLOCK queue refuses the sample and leaves it untouched.
+ */
+TEST(DeliveryQueueTest, BlockRefusesWhenFull)
+{
+    delivery_queue queue(delivery_queue_options{2, overflow_policy::BLOCK});
+    EXPECT_EQ(push(queue, "a", 1), delivery_queue::push_result::QUEUED);
+    EXPECT_EQ(push(queue, "b", 2), delivery_queue::push_result::QUEUED);
+
+    delivery_item item = make_item("c", 3);
+    EXPECT_EQ(queue.push(item), delivery_queue::push_result::FULL);
+    EXPECT_NE(item.stat, nullptr);
+    EXPECT_EQ(queue.get_statistics().blocked, 1);
+
+    EXPECT_EQ(drain(queue), (std::vector<uint64_t>{1, 2}));
+    EXPECT_EQ(queue.push(item), delivery_queue::push_result::QUEUED);
+    EXPECT_EQ(drain(queue), (std::vector<uint64_t>{3}));
+}
+
+/*
+ * We test if DROP_OLDEST makes room by dropping the oldest samples.
+ */
+TEST(DeliveryQueueTest, DropOldest)
+{
+    delivery_queue queue(delivery_queue_options{2, overflow_policy::DROP_OLDEST});
+    for (uint64_t i = 1; i <= 5; i++)
+    {
+        EXPECT_EQ(push(queue, "a", i), delivery_queue::push_result::QUEUED);
+    }
+    EXPECT_EQ(drain(queue), (std::vector<uint64_t>{4, 5}));
+    const auto statistics = queue.get_statistics();
+    EXPECT_EQ(statistics.dropped_oldest, 3);
+    EXPECT_EQ(statistics.enqueued, 5);
+    EXPECT_EQ(statistics.delivered, 2);
+    EXPECT_EQ(statistics.max_depth, 2);
+    EXPECT_EQ(statistics.depth, 0);
+}
+
+/*
+ * We test if DROP_NEWEST keeps the queued samples and drops the new ones.
+ */
+TEST(DeliveryQueueTest, DropNewest)
+{
+    delivery_queue queue(delivery_queue_options{2, overflow_policy::DROP_NEWEST});
+    EXPECT_EQ(push(queue, "a", 1), delivery_queue::push_result::QUEUED);
+    EXPECT_EQ(push(queue, "a", 2), delivery_queue::push_result::QUEUED);
+    EXPECT_EQ(push(queue, "a", 3), delivery_queue::push_result::DROPPED);
+    EXPECT_EQ(drain(queue), (std::vector<uint64_t>{1, 2}));
+    EXPECT_EQ(queue.get_statistics().dropped_newest, 1);
+}
+
+/*
+ * We test if COALESCE_LATEST keeps one sample per key, at the position of the
+ * first one, and drops the oldest key when a new key does not fit.
+ */
+TEST(DeliveryQueueTest, CoalesceLatest)
+{
+    delivery_queue queue(delivery_queue_options{2, overflow_policy::COALESCE_LATEST});
+    EXPECT_EQ(push(queue, "a", 1), delivery_queue::push_result::QUEUED);
+    EXPECT_EQ(push(queue, "b", 2), delivery_queue::push_result::QUEUED);
+    EXPECT_EQ(push(queue, "a", 3), delivery_queue::push_result::QUEUED);
+    EXPECT_EQ(push(queue, "b", 4), delivery_queue::push_result::QUEUED);
+    EXPECT_EQ(queue.size(), 2);
+    EXPECT_EQ(push(queue, "c", 5), delivery_queue::push_result::QUEUED);
+    EXPECT_EQ(drain(queue), (std::vector<uint64_t>{4, 5}));
+
+    // Keys leave the index with their sample, a delivered key is queued again.
+    EXPECT_EQ(push(queue, "b", 6), delivery_queue::push_result::QUEUED);
+    EXPECT_EQ(drain(queue), (std::vector<uint64_t>{6}));
+
+    const auto statistics = queue.get_statistics();
+    EXPECT_EQ(statistics.coalesced, 2);
+    EXPECT_EQ(statistics.dropped_oldest, 1);
+}
+
+/*
+ * We test if COALESCE_LATEST merges two partial samples of a key instead of
+ * dropping the fields the newer one does not carry.
+ */
+TEST(DeliveryQueueTest, CoalesceMergesPartialStats)
+{
+    delivery_queue queue(delivery_queue_options{2, overflow_policy::COALESCE_LATEST});
+    auto bytes = std::make_shared<PbrBasicStat>();
+    bytes->byte_count = 1;
+    bytes->path_grp_name = "grp";
+    bytes->has_counters = true;
+    bytes->has_byte_count = true;
+    bytes->has_action = true;
+    delivery_item first{"a", bytes};
+    EXPECT_EQ(queue.push(first), delivery_queue::push_result::QUEUED);
+
+    auto packets = std::make_shared<PbrBasicStat>();
+    packets->packet_count = 7;
+    packets->has_counters = true;
+    packets->has_packet_count = true;
+    delivery_item second{"a", packets};
+    EXPECT_EQ(queue.push(second), delivery_queue::push_result::QUEUED);
+
+    std::vector<delivery_item> items;
+    queue.pop_batch(items, 100);
+    ASSERT_EQ(items.size(), 1);
+    const auto stat = std::dynamic_pointer_cast<PbrBasicStat>(items[0].stat);
+    EXPECT_EQ(stat->byte_count, 1);
+    EXPECT_EQ(stat->packet_count, 7);
+    EXPECT_TRUE(stat->has_byte_count);
+    EXPECT_TRUE(stat->has_packet_count);
+    EXPECT_TRUE(stat->has_action);
+    EXPECT_EQ(stat->path_grp_name, "grp");
+    EXPECT_EQ(queue.get_statistics().coalesced, 1);
+}
@@ -0,0 +1,189 @@
+#include "gnmi/mgbl_gnmi_executor.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include "gnmi/mgbl_gnmi_client.h"
+#include "pbr/mgbl_pbr.h"
+
+using namespace mgbl_api;
+
+/*
+ * Unit tests for work_stealing_executor
+ *
+ * work_stealing_executor runs the handlers of the streams on a pool of
+ * worker threads, keeping the order of the tasks of each executor_strand.
+ *
+ */
+
+/*
+ * We test if the executor refuses to start without worker threads.
+ */
+TEST(WorkStealingExecutorTest, InvalidOptions)
+{
+    work_stealing_executor::options options;
+    options.worker_threads = 0;
+    EXPECT_THROW(work_stealing_executor executor(options), std::invalid_argument);
+    options.worker_threads = 1;
+    options.tasks_per_turn = 0;
+    EXPECT_THROW(work_stealing_executor executor(options), std::invalid_argument);
+}
+
+/*
+ * We test if the tasks of every strand run in submission order, one at a time,
+ * while many strands are served by the pool.
+ */
+TEST(WorkStealingExecutorTest, StrandOrdering)
+{
+    const int strands = 16;
+    const int tasks = 2000;
+    work_stealing_executor executor;
+    std::vector<std::shared_ptr<executor_strand>> strand_list;
+    std::vector<std::vector<int>> results(strands);
+    std::vector<std::atomic<int>> running(strands);
+    std::atomic<bool> overlapped{false};
+    for (int i = 0; i < strands; i++)
+    {
+        strand_list.push_back(work_stealing_executor::make_strand());
+        running[i] = 0;
+    }
+
+    for (int task = 0; task < tasks; task++)
+    {
+        for (int i = 0; i < strands; i++)
+        {
+            EXPECT_TRUE(executor.submit(strand_list[i],
+                                        [&, i, task]()
+                                        {
+                                            if (++running[i] != 1)
+                                            {
+                                                overlapped = true;
+                                            }
+                                            results[i].push_back(task);
+                                            running[i]--;
+                                        }));
+        }
+    }
+    for (auto& strand : strand_list)
+    {
+        strand->wait_idle();
+        EXPECT_EQ(strand->pending(), 0);
+    }
+
+    EXPECT_FALSE(overlapped);
+    for (const auto& result : results)
+    {
+        ASSERT_EQ(result.size(), tasks);
+        for (int task = 0; task < tasks; task++)
+        {
+            EXPECT_EQ(result[task], task);
+        }
+    }
+    const auto statistics = executor.get_statistics();
+    EXPECT_EQ(statistics.executed_tasks, strands * tasks);
+    EXPECT_EQ(statistics.pending_tasks, 0);
+    EXPECT_GT(statistics.max_pending_tasks, 0);
+    EXPECT_EQ(statistics.queue_depths.size(), executor.worker_count());
+}
+
+/*
+ * We test if the tasks queued behind a blocked worker are stolen by the idle workers.
+ */
+TEST(WorkStealingExecutorTest, IdleWorkersSteal)
+{
+    work_stealing_executor::options options;
+    options.worker_threads = 2;
+    work_stealing_executor executor(options);
+
+    std::mutex block_mtx;
+    std::condition_variable block_cv;
+    bool release = false;
+    std::atomic<int> done{0};
+
+    // The blocking task fills its worker queue from inside, those tasks can only run if stolen.
+    executor.submit(
+        [&]()
+        {
+            for (int i = 0; i < 100; i++)
+            {
+                executor.submit([&]() { done++; });
+            }
+            std::unique_lock<std::mutex> lock(block_mtx);
+            block_cv.wait(lock, [&] { return release; });
+        });
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (done < 100 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(done, 100);
+    EXPECT_GT(executor.get_statistics().stolen_tasks, 0);
+    {
+        std::lock_guard<std::mutex> lock(block_mtx);
+        release = true;
+    }
+    block_cv.notify_all();
+}
+
+/*
+ * We test if shutdown runs the pending tasks, even after a task threw anything, and
+ * rejects the later ones.
+ */
+TEST(WorkStealingExecutorTest, ShutdownDrainsThenRejects)
+{
+    work_stealing_executor executor;
+    auto strand = work_stealing_executor::make_strand();
+    std::atomic<int> done{0};
+    executor.submit(strand, []() { throw 1; });
+    for (int i = 0; i < 500; i++)
+    {
+        executor.submit(strand, [&]() { done++; });
+    }
+    executor.shutdown();
+    EXPECT_EQ(done, 500);
+    EXPECT_FALSE(executor.submit([&]() { done++; }));
+    EXPECT_FALSE(executor.submit(strand, [&]() { done++; }));
+    EXPECT_EQ(done, 500);
+    EXPECT_NO_THROW(executor.shutdown());
+}
+
+/*
+ * We test if the failed handler of a client bound to an executor runs on a
+ * worker thread instead of the poller thread.
+ */
+TEST(WorkStealingExecutorTest, ClientHandlersOnWorker)
+{
+    auto executor = std::make_shared<work_stealing_executor>();
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+
+    std::mutex failure_mtx;
+    std::condition_variable failure_cv;
+    bool failed = false;
+    bool on_worker = false;
+
+    GnmiClient client(connection.get_channel(), pbr_counters);
+    client.set_handler_executor(executor);
+    client.set_rpc_failed_handler(
+        [&](grpc::Status)
+        {
+            std::lock_guard<std::mutex> lock(failure_mtx);
+            failed = true;
+            on_worker = executor->is_worker_thread();
+            failure_cv.notify_one();
+        });
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    {
+        std::unique_lock<std::mutex> lock(failure_mtx);
+        EXPECT_TRUE(failure_cv.wait_for(lock, std::chrono::seconds(10), [&] { return failed; }));
+        EXPECT_TRUE(on_worker);
+    }
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+}
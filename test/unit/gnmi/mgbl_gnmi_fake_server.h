@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef MGBL_GNMI_FAKE_SERVER_H_
+#define MGBL_GNMI_FAKE_SERVER_H_
+
+#include <grpcpp/grpcpp.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "gnmi.grpc.pb.h"
+#include "gnmi/mgbl_gnmi_helper.h"
+
+/*
+ * In-process gNMI server for the unit tests which need the responses of a target.
+ *
+ * Every Subscribe RPC is counted, its password recorded, then handed to the
+ * handler of the test. Every Get request is recorded, then answered by the Get handler.
+ * Capabilities returns the capabilities set by the test, none by default. The channel of the server does not go through the network, the
+ * server also listens on a local port for the code creating its own channel.
+ */
+class fake_gnmi_server
+{
+   public:
+    using subscribe_stream =
+        grpc::ServerReaderWriter<gnmi::SubscribeResponse, gnmi::SubscribeRequest>;
+    using subscribe_handler =
+        std::function<grpc::Status(int call, grpc::ServerContext*, subscribe_stream*)>;
+    using get_handler =
+        std::function<grpc::Status(const gnmi::GetRequest& request, gnmi::GetResponse*)>;
+
+    fake_gnmi_server() : service(this)
+    {
+        grpc::ServerBuilder builder;
+        builder.RegisterService(&service);
+        builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(), &port);
+        server = builder.BuildAndStart();
+    }
+
+    ~fake_gnmi_server()
+    {
+        // The RPCs still running are cancelled, so the handlers reading them return.
+        server->Shutdown(std::chrono::system_clock::now() + std::chrono::seconds(1));
+        server->Wait();
+    }
+
+    /*
+     * Sets the handler of the next Subscribe RPCs, given the index of the RPC.
+     */
+    void on_subscribe(subscribe_handler handler)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        subscribe = std::move(handler);
+    }
+
+    /*
+     * Sets the handler of the next Get RPCs.
+     */
+    void on_get(get_handler handler)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        get = std::move(handler);
+    }
+
+    void set_capabilities(const gnmi::CapabilityResponse& response)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        capabilities = response;
+    }
+
+    std::shared_ptr<grpc::Channel> channel()
+    {
+        return server->InProcessChannel(grpc::ChannelArguments());
+    }
+
+    /**
+     * Returns the address of the server, for the code creating its own channel.
+     */
+    std::string address() const
+    {
+        return "127.0.0.1:" + std::to_string(port);
+    }
+
+    int subscribe_calls()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return static_cast<int>(passwords.size());
+    }
+
+    /*
+     * Returns the highest number of Subscribe RPCs which were running at the same time.
+     */
+    int max_concurrent_subscribes()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return max_running;
+    }
+
+    std::vector<std::string> subscribe_passwords()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return passwords;
+    }
+
+    std::vector<gnmi::GetRequest> get_requests()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return gets;
+    }
+
+    /*
+     * Returns a response with the byte count of a PBR rule.
+     */
+    static gnmi::SubscribeResponse pbr_update(const std::string& policy, const std::string& rule,
+                                              uint64_t byte_count)
+    {
+        gnmi::SubscribeResponse response;
+        gnmi::Notification* notification = response.mutable_update();
+        *notification->mutable_prefix() = mgbl_api::string_to_gnmipath(
+            "pbr-stats/policy-maps/policy-map[policy-name=" + policy +
+            "]/rule-names/rule-name[rule-name=" + rule + "]");
+        notification->mutable_prefix()->set_origin("Cisco-IOS-XR-pbr-fwd-stats-oper");
+        gnmi::Update* update = notification->add_update();
+        *update->mutable_path() = mgbl_api::string_to_gnmipath("fib-stats/byte-count");
+        update->mutable_val()->set_uint_val(byte_count);
+        return response;
+    }
+
+    static gnmi::SubscribeResponse sync_response()
+    {
+        gnmi::SubscribeResponse response;
+        response.set_sync_response(true);
+        return response;
+    }
+
+    /*
+     * Reads the stream until the client cancels it or the server shuts down.
+     */
+    static grpc::Status wait_cancelled(subscribe_stream* stream)
+    {
+        gnmi::SubscribeRequest request;
+        while (stream->Read(&request))
+        {
+        }
+        return grpc::Status::CANCELLED;
+    }
+
+   private:
+    class fake_service : public gnmi::gNMI::Service
+    {
+       public:
+        explicit fake_service(fake_gnmi_server* owner) : owner(owner) {}
+
+        grpc::Status Subscribe(grpc::ServerContext* context, subscribe_stream* stream) override
+        {
+            subscribe_handler handler;
+            int call = 0;
+            {
+                std::lock_guard<std::mutex> lock(owner->mtx);
+                const auto password = context->client_metadata().find("password");
+                owner->passwords.emplace_back(
+                    password != context->client_metadata().end()
+                        ? std::string(password->second.data(), password->second.size())
+                        : std::string());
+                call = static_cast<int>(owner->passwords.size()) - 1;
+                handler = owner->subscribe;
+                owner->max_running = std::max(owner->max_running, ++owner->running);
+            }
+            const grpc::Status status =
+                handler ? handler(call, context, stream)
+                        : grpc::Status(grpc::StatusCode::UNIMPLEMENTED, "No subscribe handler");
+            std::lock_guard<std::mutex> lock(owner->mtx);
+            owner->running--;
+            return status;
+        }
+
+        grpc::Status Capabilities(grpc::ServerContext*, const gnmi::CapabilityRequest*,
+                                  gnmi::CapabilityResponse* response) override
+        {
+            std::lock_guard<std::mutex> lock(owner->mtx);
+            *response = owner->capabilities;
+            return grpc::Status::OK;
+        }
+
+        grpc::Status Get(grpc::ServerContext*, const gnmi::GetRequest* request,
+                         gnmi::GetResponse* response) override
+        {
+            get_handler handler;
+            {
+                std::lock_guard<std::mutex> lock(owner->mtx);
+                owner->gets.push_back(*request);
+                handler = owner->get;
+            }
+            if (!handler)
+            {
+                return grpc::Status(grpc::StatusCode::UNIMPLEMENTED, "No get handler");
+            }
+            return handler(*request, response);
+        }
+
+       private:
+        fake_gnmi_server* owner;
+    };
+
+    std::mutex mtx;
+    subscribe_handler subscribe;
+    std::vector<std::string> passwords;
+    int running = 0;
+    int max_running = 0;
+    gnmi::CapabilityResponse capabilities;
+    get_handler get;
+    std::vector<gnmi::GetRequest> gets;
+    fake_service service;
+    std::unique_ptr<grpc::Server> server;
+    int port = 0;
+};
+
+#endif  // MGBL_GNMI_FAKE_SERVER_H_
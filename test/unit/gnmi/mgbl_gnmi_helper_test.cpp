@@ -156,6 +156,8 @@ TEST(StringToGnmiPathTest, PathWithKeysConversion)
  *
  */
 
+namespace
+{
 class Derived : public GnmiClient
 {
    public:
@@ -169,6 +171,7 @@ class Derived : public GnmiClient
         return this->impl_.get();
     }
 };
+}  // namespace
 
 /*
  * We are testing if gnmi_decode_json_ietf correctly parses simple data.
@@ -387,8 +390,162 @@ TEST(GnmiParseResponseTest, CreateParseResponseValidNotification)
         instance.get_impl()->gnmi_parse_response(notification, "Cisco-IOS-XR-pbr-fwd-stats-oper");
 
     EXPECT_EQ(result.second, internal_error_code::SUCCESS);
-    EXPECT_EQ((*result.first)["policy_name"], "key_policy");
-    EXPECT_EQ((*result.first)["rule_name"], "key_rule");
-    EXPECT_EQ((*result.first)["/fib-stats/byte-count"], "1000");
-    EXPECT_EQ((*result.first)["/fib-stats/packet-count"], "500");
+    EXPECT_EQ((*result.first[0])["policy_name"], "key_policy");
+    EXPECT_EQ((*result.first[0])["rule_name"], "key_rule");
+    EXPECT_EQ((*result.first[0])["/fib-stats/byte-count"], "1000");
+    EXPECT_EQ((*result.first[0])["/fib-stats/packet-count"], "500");
+}
+
+/*
+ * We test if gnmi_parse_response resolves update paths relative to a prefix above the rule,
+ * and json values below the rule.
+ */
+TEST(GnmiParseResponseTest, CreateParseResponseRelativePaths)
+{
+    rpc_channel_args channel_args("localhost:50051", false, "", "", "");
+    gnmi_client_connection dummyConnection(channel_args);
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    Derived instance(dummyConnection.get_channel(), pbr_counters);
+
+    gnmi::Notification notification;
+    gnmi::Path* prefix = notification.mutable_prefix();
+    *prefix = string_to_gnmipath("pbr-stats/policy-maps");
+    prefix->set_origin("Cisco-IOS-XR-pbr-fwd-stats-oper");
+    gnmi::Update* update = notification.add_update();
+    *update->mutable_path() = string_to_gnmipath(
+        "policy-map[policy-name=key_policy]/rule-names/rule-name[rule-name=key_rule]/fib-stats/"
+        "byte-count");
+    update->mutable_val()->set_uint_val(1000);
+
+    auto result =
+        instance.get_impl()->gnmi_parse_response(notification, "Cisco-IOS-XR-pbr-fwd-stats-oper");
+    ASSERT_EQ(result.second, internal_error_code::SUCCESS);
+    EXPECT_EQ((*result.first[0])["policy_name"], "key_policy");
+    EXPECT_EQ((*result.first[0])["rule_name"], "key_rule");
+    EXPECT_EQ((*result.first[0])["/fib-stats/byte-count"], "1000");
+
+    // A json value of a path below the rule is stored under that path.
+    notification.Clear();
+    *notification.mutable_prefix() = string_to_gnmipath(
+        "pbr-stats/policy-maps/policy-map[policy-name=key_policy]/rule-names/"
+        "rule-name[rule-name=key_rule]");
+    notification.mutable_prefix()->set_origin("Cisco-IOS-XR-pbr-fwd-stats-oper");
+    update = notification.add_update();
+    *update->mutable_path() = string_to_gnmipath("fib-stats");
+    update->mutable_val()->set_json_ietf_val(R"({"packet-count": 500})");
+
+    result =
+        instance.get_impl()->gnmi_parse_response(notification, "Cisco-IOS-XR-pbr-fwd-stats-oper");
+    ASSERT_EQ(result.second, internal_error_code::SUCCESS);
+    EXPECT_EQ((*result.first[0])["rule_name"], "key_rule");
+    EXPECT_EQ((*result.first[0])["/fib-stats/packet-count"], "500");
+
+    // The elements of a prefix below the rule are part of the path.
+    notification.Clear();
+    *notification.mutable_prefix() = string_to_gnmipath(
+        "pbr-stats/policy-maps/policy-map[policy-name=key_policy]/rule-names/"
+        "rule-name[rule-name=key_rule]/fib-stats");
+    notification.mutable_prefix()->set_origin("Cisco-IOS-XR-pbr-fwd-stats-oper");
+    update = notification.add_update();
+    *update->mutable_path() = string_to_gnmipath("byte-count");
+    update->mutable_val()->set_uint_val(2000);
+
+    result =
+        instance.get_impl()->gnmi_parse_response(notification, "Cisco-IOS-XR-pbr-fwd-stats-oper");
+    ASSERT_EQ(result.second, internal_error_code::SUCCESS);
+    EXPECT_EQ((*result.first[0])["rule_name"], "key_rule");
+    EXPECT_EQ((*result.first[0])["/fib-stats/byte-count"], "2000");
+    EXPECT_EQ(result.first[0]->count("/byte-count"), 0);
+}
+
+/*
+ * We test if check_response drops the rules of a wildcard which are not keys.
+ */
+TEST(GnmiParseResponseTest, CheckResponseFiltersWildcardRules)
+{
+    rpc_channel_args channel_args("localhost:50051", false, "", "", "");
+    gnmi_client_connection dummyConnection(channel_args);
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    pbr_counters->keys.push_back({"p1", "r2"});
+    Derived instance(dummyConnection.get_channel(), pbr_counters);
+    rpc_args rpc_args;
+    rpc_args.planner.min_rules_per_wildcard = 2;
+    const pbr_subscription_plan plan = plan_subscription(*pbr_counters, rpc_args);
+
+    gnmi::SubscribeResponse response;
+    gnmi::Notification* notification = response.mutable_update();
+    *notification->mutable_prefix() = string_to_gnmipath(
+        "pbr-stats/policy-maps/policy-map[policy-name=p1]/rule-names/rule-name[rule-name=r3]");
+    notification->mutable_prefix()->set_origin(pbr_counters->path_origin);
+    gnmi::Update* update = notification->add_update();
+    *update->mutable_path() = string_to_gnmipath("fib-stats/byte-count");
+    update->mutable_val()->set_uint_val(1000);
+
+    auto result = instance.get_impl()->check_response(response, *pbr_counters, nullptr, &plan);
+    EXPECT_EQ(result.second, internal_error_code::KEY_FILTERED);
+    EXPECT_TRUE(result.first.empty());
+
+    (*notification->mutable_prefix()->mutable_elem(4)->mutable_key())["rule-name"] = "r2";
+    result = instance.get_impl()->check_response(response, *pbr_counters, nullptr, &plan);
+    EXPECT_EQ(result.second, internal_error_code::SUCCESS);
+}
+
+/*
+ * We test if gnmi_parse_response returns one map per rule when the prefix stops above the
+ * policy maps, without mixing the counters of the rules.
+ */
+TEST(GnmiParseResponseTest, CreateParseResponseSeveralRules)
+{
+    rpc_channel_args channel_args("localhost:50051", false, "", "", "");
+    gnmi_client_connection dummyConnection(channel_args);
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    Derived instance(dummyConnection.get_channel(), pbr_counters);
+
+    gnmi::SubscribeResponse response;
+    gnmi::Notification* notification = response.mutable_update();
+    *notification->mutable_prefix() = string_to_gnmipath("pbr-stats/policy-maps");
+    notification->mutable_prefix()->set_origin(pbr_counters->path_origin);
+    auto add_update = [notification](const std::string& rule, const std::string& leaf,
+                                     uint64_t value)
+    {
+        gnmi::Update* update = notification->add_update();
+        *update->mutable_path() = string_to_gnmipath(
+            "policy-map[policy-name=p1]/rule-names/rule-name[rule-name=" + rule + "]/fib-stats/" +
+            leaf);
+        update->mutable_val()->set_uint_val(value);
+    };
+    add_update("r1", "byte-count", 1000);
+    add_update("r2", "byte-count", 2000);
+    add_update("r1", "packet-count", 10);
+
+    auto result =
+        instance.get_impl()->gnmi_parse_response(*notification, pbr_counters->path_origin);
+    ASSERT_EQ(result.second, internal_error_code::SUCCESS);
+    ASSERT_EQ(result.first.size(), 2);
+    EXPECT_EQ((*result.first[0])["rule_name"], "r1");
+    EXPECT_EQ((*result.first[0])["/fib-stats/byte-count"], "1000");
+    EXPECT_EQ((*result.first[0])["/fib-stats/packet-count"], "10");
+    EXPECT_EQ((*result.first[1])["rule_name"], "r2");
+    EXPECT_EQ((*result.first[1])["/fib-stats/byte-count"], "2000");
+    EXPECT_EQ(result.first[1]->count("/fib-stats/packet-count"), 0);
+
+    // check_response returns one stat and one key per rule.
+    std::vector<std::string> keys;
+    auto stats = instance.get_impl()->check_response(response, *pbr_counters, &keys);
+    ASSERT_EQ(stats.second, internal_error_code::SUCCESS);
+    ASSERT_EQ(stats.first.size(), 2);
+    ASSERT_EQ(keys.size(), 2);
+    auto first = std::dynamic_pointer_cast<PbrBasicStat>(stats.first[0]);
+    auto second = std::dynamic_pointer_cast<PbrBasicStat>(stats.first[1]);
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    EXPECT_EQ(first->rule_name, "r1");
+    EXPECT_EQ(first->byte_count, 1000);
+    EXPECT_EQ(first->packet_count, 10);
+    EXPECT_EQ(second->rule_name, "r2");
+    EXPECT_EQ(second->byte_count, 2000);
+    EXPECT_EQ(second->packet_count, 0);
+    EXPECT_NE(keys[0], keys[1]);
 }
@@ -97,6 +97,8 @@ TEST(StringToGnmiPathTest, ConsecutiveSlashesTest)
  *
  * See mgbl_api_helper_test.cpp
  */
+namespace
+{
 class Derived : public GnmiClient
 {
    public:
@@ -110,6 +112,7 @@ class Derived : public GnmiClient
         return this->impl_.get();
     }
 };
+}  // namespace
 
 /*
  * We test if gnmi_decode_json_ietf returns an empty struct
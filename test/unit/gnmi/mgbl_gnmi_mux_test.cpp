@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "gnmi/mgbl_gnmi_mux.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "mgbl_gnmi_fake_server.h"
+#include "pbr/mgbl_pbr.h"
+
+using namespace mgbl_api;
+
+/*
+ * Unit tests for the gnmi_subscription_mux
+ *
+ * gnmi_subscription_mux shares one stream per target between its consumers. The target
+ * of these tests is a fake gNMI server, only the keys of the streams are checked.
+ *
+ */
+
+namespace
+{
+gnmi_subscription_mux::options no_reconnect()
+{
+    gnmi_subscription_mux::options options;
+    options.reconnect.enabled = false;
+    return options;
+}
+
+/*
+ * Answers a subscription with its sync_response, then keeps it open until it is cancelled.
+ */
+grpc::Status sync_and_wait(fake_gnmi_server::subscribe_stream* stream)
+{
+    gnmi::SubscribeRequest request;
+    stream->Read(&request);
+    stream->Write(fake_gnmi_server::sync_response());
+    return fake_gnmi_server::wait_cancelled(stream);
+}
+
+/*
+ * Waits until the streams of the mux are in sync with the given number of keys.
+ */
+bool wait_upstream_keys(gnmi_subscription_mux& mux, size_t keys)
+{
+    const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (mux.get_statistics().upstream_keys != keys &&
+           std::chrono::steady_clock::now() < give_up)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return mux.get_statistics().upstream_keys == keys;
+}
+}  // namespace
+
+/*
+ * We test if the mux refuses duplicate targets, unknown targets, empty keys and handlers.
+ */
+TEST(GnmiSubscriptionMuxTest, InvalidArguments)
+{
+    gnmi_subscription_mux mux(rpc_args(), no_reconnect());
+    client_context_args context_args{"user", "password", false, {}};
+    mux.add_target("router", rpc_channel_args{"localhost:1", false}, context_args);
+    EXPECT_THROW(mux.add_target("router", rpc_channel_args{"localhost:1", false}, context_args),
+                 std::invalid_argument);
+
+    auto handler = [](const std::string&, stat_span<PbrBasicStat>) {};
+    EXPECT_THROW(mux.subscribe("unknown", {{"p1", "r1"}}, handler), std::invalid_argument);
+    EXPECT_THROW(mux.subscribe("router", {}, handler), std::invalid_argument);
+    EXPECT_THROW(mux.subscribe("router", {{"p1", "r1"}}, nullptr), std::invalid_argument);
+    EXPECT_FALSE(mux.unsubscribe(1));
+}
+
+/*
+ * We test if the consumers of a target share one stream on the union of their keys, and
+ * if the stream follows the consumers which leave.
+ */
+TEST(GnmiSubscriptionMuxTest, SharesOneStreamPerTarget)
+{
+    fake_gnmi_server server;
+    server.on_subscribe([](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+                        { return sync_and_wait(stream); });
+    gnmi_subscription_mux mux(rpc_args(), no_reconnect());
+    client_context_args context_args{"user", "password", false, {}};
+    mux.add_target("router", rpc_channel_args{server.address(), false}, context_args);
+    auto handler = [](const std::string&, stat_span<PbrBasicStat>) {};
+
+    const uint64_t first = mux.subscribe("router", {{"p1", "r1"}, {"p1", "r2"}}, handler);
+    const uint64_t second = mux.subscribe("router", {{"p1", "r2"}, {"p2", "r1"}}, handler);
+    const uint64_t third = mux.subscribe("router", {{"p1", "r1"}}, handler);
+    EXPECT_TRUE(wait_upstream_keys(mux, 3));
+    subscription_mux_statistics statistics = mux.get_statistics();
+    EXPECT_EQ(statistics.targets, 1);
+    EXPECT_EQ(statistics.consumers, 3);
+    EXPECT_EQ(statistics.streams, 1);
+
+    EXPECT_TRUE(mux.unsubscribe(second));
+    EXPECT_TRUE(wait_upstream_keys(mux, 2));
+    EXPECT_TRUE(mux.unsubscribe(first));
+    EXPECT_TRUE(wait_upstream_keys(mux, 1));
+    EXPECT_TRUE(mux.unsubscribe(third));
+    statistics = mux.get_statistics();
+    EXPECT_EQ(statistics.upstream_keys, 0);
+    EXPECT_EQ(statistics.streams, 0);
+    EXPECT_FALSE(mux.unsubscribe(third));
+}
+
+/*
+ * We test if a stream which could not be moved to new keys keeps the previous ones, and
+ * if the failure is reported.
+ */
+TEST(GnmiSubscriptionMuxTest, FailedResubscriptionKeepsKeys)
+{
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            gnmi::SubscribeRequest request;
+            stream->Read(&request);
+            if (request.ShortDebugString().find("p2") != std::string::npos)
+            {
+                return grpc::Status(grpc::StatusCode::PERMISSION_DENIED, "Policy not allowed");
+            }
+            stream->Write(fake_gnmi_server::sync_response());
+            return fake_gnmi_server::wait_cancelled(stream);
+        });
+    gnmi_subscription_mux mux(rpc_args(), no_reconnect());
+    std::mutex failure_mtx;
+    std::condition_variable failure_cv;
+    std::vector<grpc::Status> failures;
+    mux.set_failed_handler(
+        [&](const std::string& target, grpc::Status status)
+        {
+            EXPECT_EQ(target, "router");
+            std::lock_guard<std::mutex> lock(failure_mtx);
+            failures.push_back(std::move(status));
+            failure_cv.notify_all();
+        });
+    client_context_args context_args{"user", "password", false, {}};
+    mux.add_target("router", rpc_channel_args{server.address(), false}, context_args);
+    auto handler = [](const std::string&, stat_span<PbrBasicStat>) {};
+
+    mux.subscribe("router", {{"p1", "r1"}}, handler);
+    EXPECT_TRUE(wait_upstream_keys(mux, 1));
+    const uint64_t refused = mux.subscribe("router", {{"p2", "r1"}}, handler);
+    {
+        std::unique_lock<std::mutex> lock(failure_mtx);
+        ASSERT_TRUE(failure_cv.wait_for(lock, std::chrono::seconds(10),
+                                        [&] { return !failures.empty(); }));
+        EXPECT_EQ(failures[0].error_code(), grpc::StatusCode::PERMISSION_DENIED);
+    }
+    EXPECT_EQ(mux.get_statistics().upstream_keys, 1);
+
+    // The stream is back on the previous keys, so they are not subscribed again.
+    EXPECT_TRUE(mux.unsubscribe(refused));
+    EXPECT_EQ(server.subscribe_calls(), 2);
+
+    mux.subscribe("router", {{"p3", "r1"}}, handler);
+    EXPECT_TRUE(wait_upstream_keys(mux, 2));
+    EXPECT_EQ(server.subscribe_calls(), 3);
+    std::lock_guard<std::mutex> lock(failure_mtx);
+    EXPECT_EQ(failures.size(), 1);
+}
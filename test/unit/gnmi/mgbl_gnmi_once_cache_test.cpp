@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "gnmi/mgbl_gnmi_once_cache.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "pbr/mgbl_pbr.h"
+
+using namespace mgbl_api;
+
+/*
+ * Unit tests for the once_cache
+ *
+ * once_cache shares the results of identical once requests. The requests of these
+ * tests are functions counting how often they are sent.
+ *
+ */
+
+namespace
+{
+once_cache::once_result send_one_stat(std::atomic<int>& sent, once_cache::stats_vector* stats,
+                                      error_code code = error_code::SUCCESS)
+{
+    sent++;
+    auto stat = std::make_shared<PbrBasicStat>();
+    stat->policy_name = "p1";
+    stats->push_back(stat);
+    return once_cache::once_result(code, grpc::Status());
+}
+}  // namespace
+
+/*
+ * We test if the cache refuses a negative ttl.
+ */
+TEST(GnmiOnceCacheTest, InvalidArguments)
+{
+    once_cache::options options;
+    options.ttl = std::chrono::milliseconds(-1);
+    EXPECT_THROW(once_cache cache(options), std::invalid_argument);
+}
+
+/*
+ * We test if a successful result is served until its ttl elapsed, while another key
+ * and a failed result are sent again.
+ */
+TEST(GnmiOnceCacheTest, ServesFreshResults)
+{
+    once_cache::options options;
+    options.ttl = std::chrono::milliseconds(200);
+    once_cache cache(options);
+    std::atomic<int> sent{0};
+    auto request = [&sent](once_cache::stats_vector* stats) { return send_one_stat(sent, stats); };
+
+    once_cache::stats_vector stats;
+    EXPECT_EQ(cache.fetch("a", nullptr, request, &stats).first, error_code::SUCCESS);
+    EXPECT_EQ(cache.fetch("a", nullptr, request, &stats).first, error_code::SUCCESS);
+    ASSERT_EQ(stats.size(), 1);
+    EXPECT_EQ(sent, 1);
+    cache.fetch("b", nullptr, request, &stats);
+    EXPECT_EQ(sent, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    cache.fetch("a", nullptr, request, &stats);
+    EXPECT_EQ(sent, 3);
+
+    auto failing = [&sent](once_cache::stats_vector* stats)
+    { return send_one_stat(sent, stats, error_code::RPC_FAILURE); };
+    EXPECT_EQ(cache.fetch("c", nullptr, failing, &stats).first, error_code::RPC_FAILURE);
+    EXPECT_EQ(cache.fetch("c", nullptr, failing, &stats).first, error_code::RPC_FAILURE);
+    EXPECT_EQ(sent, 5);
+
+    once_cache_statistics statistics = cache.get_statistics();
+    EXPECT_EQ(statistics.hits, 1);
+    EXPECT_EQ(statistics.misses, 5);
+    EXPECT_EQ(statistics.entries, 2);
+    cache.clear();
+    EXPECT_EQ(cache.get_statistics().entries, 0);
+}
+
+/*
+ * We test if identical requests in flight share one request, and if a waiter gives up
+ * at its deadline.
+ */
+TEST(GnmiOnceCacheTest, CoalescesRequestsInFlight)
+{
+    once_cache::options options;
+    options.ttl = std::chrono::milliseconds(0);
+    once_cache cache(options);
+    std::atomic<int> sent{0};
+    auto slow_request = [&sent](once_cache::stats_vector* stats)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        return send_one_stat(sent, stats);
+    };
+
+    std::vector<std::thread> callers;
+    std::atomic<int> received{0};
+    for (int i = 0; i < 8; i++)
+    {
+        callers.emplace_back(
+            [&]()
+            {
+                once_cache::stats_vector stats;
+                if (cache.fetch("a", nullptr, slow_request, &stats).first == error_code::SUCCESS)
+                {
+                    received += static_cast<int>(stats.size());
+                }
+            });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const auto deadline = std::chrono::system_clock::now() + std::chrono::milliseconds(10);
+    once_cache::stats_vector stats;
+    auto expired = cache.fetch("a", &deadline, slow_request, &stats);
+    EXPECT_EQ(expired.second.error_code(), grpc::StatusCode::DEADLINE_EXCEEDED);
+    for (auto& caller : callers)
+    {
+        caller.join();
+    }
+    EXPECT_EQ(sent, 1);
+    EXPECT_EQ(received, 8);
+    EXPECT_EQ(cache.get_statistics().coalesced, 8);
+
+    // With a ttl of 0 nothing is kept once the request ended.
+    cache.fetch("a", nullptr, slow_request, &stats);
+    EXPECT_EQ(sent, 2);
+}
+
+/*
+ * We test if a request which throws wakes the identical requests waiting for it with a
+ * failure, and is sent again by the next fetch.
+ */
+TEST(GnmiOnceCacheTest, ThrowingRequestReleasesWaiters)
+{
+    once_cache cache;
+    std::atomic<int> sent{0};
+    auto throwing = [&sent](once_cache::stats_vector*) -> once_cache::once_result
+    {
+        sent++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        throw std::runtime_error("request failed");
+    };
+
+    std::thread thrower(
+        [&]()
+        {
+            once_cache::stats_vector stats;
+            EXPECT_THROW(cache.fetch("a", nullptr, throwing, &stats), std::runtime_error);
+        });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    once_cache::stats_vector stats;
+    auto waited = cache.fetch("a", nullptr, throwing, &stats);
+    thrower.join();
+    EXPECT_EQ(waited.first, error_code::RPC_FAILURE);
+    EXPECT_EQ(waited.second.error_code(), grpc::StatusCode::INTERNAL);
+    EXPECT_TRUE(stats.empty());
+    EXPECT_EQ(sent, 1);
+    EXPECT_EQ(cache.get_statistics().entries, 0);
+
+    auto request = [&sent](once_cache::stats_vector* stats) { return send_one_stat(sent, stats); };
+    EXPECT_EQ(cache.fetch("a", nullptr, request, &stats).first, error_code::SUCCESS);
+    EXPECT_EQ(sent, 2);
+}
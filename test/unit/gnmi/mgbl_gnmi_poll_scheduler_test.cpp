@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "gnmi/mgbl_gnmi_poll_scheduler.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "gnmi/mgbl_gnmi_client.h"
+#include "gnmi/mgbl_gnmi_connection.h"
+#include "gnmi/mgbl_gnmi_subscription.h"
+#include "mgbl_gnmi_fake_server.h"
+#include "pbr/mgbl_pbr.h"
+
+using namespace mgbl_api;
+
+/*
+ * Unit tests for the poll_scheduler
+ *
+ * poll_scheduler polls POLL subscriptions from a timer wheel. Unless a fake gNMI server
+ * is the target, the subscriptions of these tests are not started, so every poll fails
+ * and is counted as such.
+ *
+ */
+
+/*
+ * We test if the scheduler refuses invalid options and schedules.
+ */
+TEST(GnmiPollSchedulerTest, RejectsInvalidArguments)
+{
+    poll_scheduler::options options;
+    options.wheel_slots = 0;
+    EXPECT_THROW(poll_scheduler scheduler(options), std::invalid_argument);
+    options = poll_scheduler::options();
+    options.jitter = 1.5;
+    EXPECT_THROW(poll_scheduler scheduler(options), std::invalid_argument);
+
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    GnmiClient client(connection.get_channel(), std::make_shared<PBRBasic>());
+    poll_scheduler scheduler;
+    EXPECT_THROW(scheduler.add(nullptr, std::chrono::milliseconds(100)), std::invalid_argument);
+    EXPECT_THROW(scheduler.add(client.subscribe(std::make_shared<PBRBasic>()),
+                               std::chrono::milliseconds(0)),
+                 std::invalid_argument);
+    EXPECT_FALSE(scheduler.remove(1));
+}
+
+/*
+ * We test if every subscription is polled once per interval, including around the wheel.
+ */
+TEST(GnmiPollSchedulerTest, PollsEveryInterval)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    GnmiClient client(connection.get_channel(), std::make_shared<PBRBasic>());
+    poll_scheduler::options options;
+    options.tick = std::chrono::milliseconds(5);
+    options.wheel_slots = 8;
+    options.jitter = 0.0;
+    poll_scheduler scheduler(options);
+
+    const int SUBSCRIPTIONS = 20;
+    for (int i = 0; i < SUBSCRIPTIONS; i++)
+    {
+        scheduler.add(client.subscribe(std::make_shared<PBRBasic>()),
+                      std::chrono::milliseconds(60));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(630));
+
+    auto statistics = scheduler.get_statistics();
+    EXPECT_EQ(statistics.subscriptions, static_cast<size_t>(SUBSCRIPTIONS));
+    EXPECT_EQ(statistics.polls_sent, 0u);
+    EXPECT_EQ(statistics.polls_coalesced, 0u);
+    // 10 intervals elapsed, the first poll is somewhere in the first one.
+    EXPECT_GE(statistics.polls_failed, static_cast<uint64_t>(SUBSCRIPTIONS * 8));
+    EXPECT_LE(statistics.polls_failed, static_cast<uint64_t>(SUBSCRIPTIONS * 11));
+}
+
+/*
+ * We test if a removed subscription is no longer polled.
+ */
+TEST(GnmiPollSchedulerTest, RemoveStopsPolls)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    GnmiClient client(connection.get_channel(), std::make_shared<PBRBasic>());
+    poll_scheduler::options options;
+    options.tick = std::chrono::milliseconds(5);
+    poll_scheduler scheduler(options);
+
+    std::vector<uint64_t> ids;
+    for (int i = 0; i < 10; i++)
+    {
+        ids.push_back(scheduler.add(client.subscribe(std::make_shared<PBRBasic>()),
+                                    std::chrono::milliseconds(20)));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (const uint64_t id : ids)
+    {
+        EXPECT_TRUE(scheduler.remove(id));
+    }
+    EXPECT_FALSE(scheduler.remove(ids.front()));
+    // A poll may be running while the subscriptions are removed.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const uint64_t failed = scheduler.get_statistics().polls_failed;
+    EXPECT_GT(failed, 0u);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto statistics = scheduler.get_statistics();
+    EXPECT_EQ(statistics.polls_failed, failed);
+    EXPECT_EQ(statistics.subscriptions, 0u);
+}
+
+/*
+ * We test if a poll the target never answers is expired after the timeout and sent again.
+ */
+TEST(GnmiPollSchedulerTest, ExpiresUnansweredPolls)
+{
+    std::atomic<int> polls_received{0};
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [&polls_received](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            gnmi::SubscribeRequest request;
+            stream->Read(&request);
+            stream->Write(fake_gnmi_server::sync_response());
+            while (stream->Read(&request))
+            {
+                polls_received++;
+            }
+            return grpc::Status::CANCELLED;
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(server.channel(), pbr_counters);
+    auto subscription = client.subscribe(pbr_counters);
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args poll_args;
+    poll_args.mode = stream_mode::POLL;
+    ASSERT_EQ(subscription->start(context_args, poll_args), error_code::SUCCESS);
+
+    poll_scheduler::options options;
+    options.tick = std::chrono::milliseconds(5);
+    options.jitter = 0.0;
+    options.poll_timeout_intervals = 2;
+    poll_scheduler scheduler(options);
+    const uint64_t id = scheduler.add(subscription, std::chrono::milliseconds(20));
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    EXPECT_TRUE(scheduler.remove(id));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // About 20 intervals, a poll is sent every 2 of them and expired at the next one.
+    auto statistics = scheduler.get_statistics();
+    EXPECT_GE(statistics.polls_sent, 5u);
+    EXPECT_GE(statistics.polls_failed, 4u);
+    EXPECT_LE(statistics.polls_failed, statistics.polls_sent);
+    EXPECT_GE(statistics.polls_coalesced, statistics.polls_failed);
+    EXPECT_LE(statistics.polls_coalesced, statistics.polls_failed + 1);
+    EXPECT_EQ(subscription->close(), error_code::SUCCESS);
+    EXPECT_GE(static_cast<uint64_t>(polls_received.load()), statistics.polls_failed);
+}
@@ -0,0 +1,246 @@
+#include "gnmi/mgbl_gnmi_reconnect.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include "gnmi/mgbl_gnmi_client.h"
+#include "gnmi/mgbl_gnmi_connection.h"
+#include "pbr/mgbl_pbr.h"
+
+using namespace mgbl_api;
+
+/*
+ * Unit tests for the stream reconnection
+ *
+ * reconnect_backoff computes the capped exponential delays with jitter,
+ * reconnect_limiter bounds the attempts of the process, and GnmiClient
+ * reconnects its stream with them until it gives up.
+ *
+ */
+
+/*
+ * We test if the delays grow by the multiplier up to the cap, and start again on reset.
+ */
+TEST(GnmiReconnectTest, BackoffGrowsUpToCap)
+{
+    reconnect_policy policy;
+    policy.initial_backoff = std::chrono::milliseconds(100);
+    policy.max_backoff = std::chrono::milliseconds(400);
+    policy.jitter = 0.0;
+    policy.max_attempts = 4;
+    reconnect_backoff backoff(policy);
+
+    EXPECT_EQ(backoff.next_delay().count(), 100);
+    EXPECT_EQ(backoff.next_delay().count(), 200);
+    EXPECT_EQ(backoff.next_delay().count(), 400);
+    EXPECT_FALSE(backoff.exhausted());
+    EXPECT_EQ(backoff.next_delay().count(), 400);
+    EXPECT_TRUE(backoff.exhausted());
+    EXPECT_EQ(backoff.attempts(), 4u);
+
+    backoff.reset();
+    EXPECT_FALSE(backoff.exhausted());
+    EXPECT_EQ(backoff.next_delay().count(), 100);
+}
+
+/*
+ * We test if the jitter only shortens the delays, within its share.
+ */
+TEST(GnmiReconnectTest, BackoffJitterRange)
+{
+    reconnect_policy policy;
+    policy.initial_backoff = std::chrono::milliseconds(1000);
+    policy.max_backoff = std::chrono::milliseconds(1000);
+    policy.jitter = 0.5;
+    reconnect_backoff backoff(policy);
+
+    for (int i = 0; i < 100; i++)
+    {
+        const auto delay = backoff.next_delay().count();
+        EXPECT_GE(delay, 500);
+        EXPECT_LE(delay, 1000);
+    }
+}
+
+/*
+ * We test if a policy that cannot back off is refused.
+ */
+TEST(GnmiReconnectTest, InvalidPolicyThrows)
+{
+    reconnect_policy policy;
+    policy.initial_backoff = std::chrono::milliseconds(0);
+    EXPECT_THROW(reconnect_backoff{policy}, std::invalid_argument);
+
+    policy = reconnect_policy{};
+    policy.max_backoff = policy.initial_backoff / 2;
+    EXPECT_THROW(reconnect_backoff{policy}, std::invalid_argument);
+
+    policy = reconnect_policy{};
+    policy.multiplier = 0.5;
+    EXPECT_THROW(reconnect_backoff{policy}, std::invalid_argument);
+
+    policy = reconnect_policy{};
+    policy.jitter = 1.5;
+    EXPECT_THROW(reconnect_backoff{policy}, std::invalid_argument);
+}
+
+/*
+ * We test if the attempts beyond the burst are postponed one refill period after the other.
+ */
+TEST(GnmiReconnectTest, LimiterPostponesBeyondBurst)
+{
+    reconnect_limiter limiter(10.0, 2);
+    EXPECT_EQ(limiter.acquire().count(), 0);
+    EXPECT_EQ(limiter.acquire().count(), 0);
+
+    const auto first_wait = limiter.acquire().count();
+    const auto second_wait = limiter.acquire().count();
+    EXPECT_GT(first_wait, 80);
+    EXPECT_LE(first_wait, 100);
+    EXPECT_GT(second_wait, 180);
+    EXPECT_LE(second_wait, 200);
+
+    limiter.set_limit(0.0, 1);
+    EXPECT_EQ(limiter.acquire().count(), 0);
+    EXPECT_EQ(limiter.acquire().count(), 0);
+}
+
+/*
+ * We test if the client reconnects its stream and only reports the failure once it gives up.
+ */
+TEST(GnmiReconnectTest, ClientGivesUpAfterMaxAttempts)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(connection.get_channel(), pbr_counters);
+
+    reconnect_policy policy;
+    policy.initial_backoff = std::chrono::milliseconds(10);
+    policy.max_backoff = std::chrono::milliseconds(20);
+    policy.max_attempts = 2;
+    client.set_reconnect_policy(policy);
+
+    std::mutex failure_mtx;
+    std::condition_variable failure_cv;
+    int failures = 0;
+    client.set_rpc_failed_handler(
+        [&](grpc::Status status)
+        {
+            std::lock_guard<std::mutex> lock(failure_mtx);
+            EXPECT_EQ(status.error_code(), grpc::StatusCode::UNAVAILABLE);
+            failures++;
+            failure_cv.notify_one();
+        });
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    {
+        std::unique_lock<std::mutex> lock(failure_mtx);
+        EXPECT_TRUE(
+            failure_cv.wait_for(lock, std::chrono::seconds(10), [&] { return failures > 0; }));
+    }
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+
+    const reconnect_statistics stats = client.get_reconnect_statistics();
+    EXPECT_EQ(failures, 1);
+    EXPECT_EQ(stats.failures, 3u);
+    EXPECT_EQ(stats.attempts, 2u);
+    EXPECT_EQ(stats.give_ups, 1u);
+    EXPECT_EQ(stats.recoveries, 0u);
+    EXPECT_FALSE(stats.recovering);
+}
+
+/*
+ * We test if closing the stream cancels the pending reconnection without reporting it.
+ */
+TEST(GnmiReconnectTest, CloseCancelsReconnect)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(connection.get_channel(), pbr_counters);
+
+    reconnect_policy policy;
+    policy.initial_backoff = std::chrono::milliseconds(60000);
+    policy.max_backoff = std::chrono::milliseconds(60000);
+    client.set_reconnect_policy(policy);
+    bool failed = false;
+    client.set_rpc_failed_handler([&failed](grpc::Status) { failed = true; });
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!client.get_reconnect_statistics().recovering &&
+           std::chrono::steady_clock::now() < give_up)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_TRUE(client.get_reconnect_statistics().recovering);
+
+    const auto begin = std::chrono::steady_clock::now();
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+    EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::seconds(10));
+    EXPECT_FALSE(failed);
+    EXPECT_EQ(client.get_reconnect_statistics().attempts, 0u);
+    EXPECT_FALSE(client.get_reconnect_statistics().recovering);
+}
+
+/*
+ * We test if disabling the reconnection while an attempt is pending gives up the outage
+ * right away, with the failure of the stream, instead of attempting it.
+ */
+TEST(GnmiReconnectTest, DisableCancelsPendingReconnect)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(connection.get_channel(), pbr_counters);
+
+    reconnect_policy policy;
+    policy.initial_backoff = std::chrono::milliseconds(60000);
+    policy.max_backoff = std::chrono::milliseconds(60000);
+    client.set_reconnect_policy(policy);
+    std::mutex failure_mtx;
+    std::condition_variable failure_cv;
+    int failures = 0;
+    client.set_rpc_failed_handler(
+        [&](grpc::Status status)
+        {
+            std::lock_guard<std::mutex> lock(failure_mtx);
+            EXPECT_EQ(status.error_code(), grpc::StatusCode::UNAVAILABLE);
+            failures++;
+            failure_cv.notify_one();
+        });
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(client.rpc_register_stats_stream(context_args, rpc_args), error_code::SUCCESS);
+    const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!client.get_reconnect_statistics().recovering &&
+           std::chrono::steady_clock::now() < give_up)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(client.get_reconnect_statistics().recovering);
+
+    reconnect_policy disabled;
+    disabled.enabled = false;
+    client.set_reconnect_policy(disabled);
+    {
+        std::unique_lock<std::mutex> lock(failure_mtx);
+        EXPECT_TRUE(
+            failure_cv.wait_for(lock, std::chrono::seconds(10), [&] { return failures > 0; }));
+    }
+    EXPECT_EQ(client.rpc_stream_close(), error_code::SUCCESS);
+
+    const reconnect_statistics stats = client.get_reconnect_statistics();
+    EXPECT_EQ(failures, 1);
+    EXPECT_EQ(stats.attempts, 0u);
+    EXPECT_EQ(stats.give_ups, 1u);
+    EXPECT_FALSE(stats.recovering);
+}
@@ -0,0 +1,129 @@
+#include "gnmi/mgbl_gnmi_subscription_manager.h"
+#include <gtest/gtest.h>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <vector>
+
+using namespace mgbl_api;
+
+/*
+ * Unit tests for gnmi_subscription_manager
+ *
+ * gnmi_subscription_manager shards its targets over single threaded
+ * event loops with a consistent_hash_ring and resubscribes failed streams.
+ *
+ */
+
+/*
+ * We test if the ring refuses to be built without shards or virtual nodes.
+ */
+TEST(ConsistentHashRingTest, InvalidArguments)
+{
+    EXPECT_THROW(consistent_hash_ring ring(0), std::invalid_argument);
+    EXPECT_THROW(consistent_hash_ring ring(4, 0), std::invalid_argument);
+}
+
+/*
+ * We test if the names are spread over every shard, and if adding a shard
+ * only moves the names that the new shard takes over.
+ */
+TEST(ConsistentHashRingTest, DistributionAndStability)
+{
+    const uint32_t names = 4000;
+    consistent_hash_ring four_shards(4);
+    consistent_hash_ring five_shards(5);
+
+    std::vector<uint32_t> per_shard(4, 0);
+    uint32_t moved = 0;
+    for (uint32_t i = 0; i < names; i++)
+    {
+        const std::string name = "router-" + std::to_string(i);
+        const uint32_t shard = four_shards.shard_of(name);
+        ASSERT_LT(shard, 4);
+        EXPECT_EQ(shard, four_shards.shard_of(name));
+        per_shard[shard]++;
+
+        const uint32_t new_shard = five_shards.shard_of(name);
+        if (new_shard != shard)
+        {
+            EXPECT_EQ(new_shard, 4);
+            moved++;
+        }
+    }
+    for (const uint32_t count : per_shard)
+    {
+        EXPECT_GT(count, names / 8);
+        EXPECT_LT(count, names / 2);
+    }
+    EXPECT_GT(moved, 0);
+    EXPECT_LT(moved, names / 3);
+}
+
+/*
+ * We test if the manager refuses duplicate targets and a zero shard count.
+ */
+TEST(GnmiSubscriptionManagerTest, InvalidArguments)
+{
+    gnmi_target target{"r1", rpc_channel_args{"localhost:1", false}, {}, {{"p1", "r1"}}};
+    gnmi_subscription_manager::options options;
+    EXPECT_THROW(gnmi_subscription_manager manager({target, target}, rpc_args{}, options),
+                 std::invalid_argument);
+    options.shards = 0;
+    EXPECT_THROW(gnmi_subscription_manager manager({target}, rpc_args{}, options),
+                 std::invalid_argument);
+}
+
+/*
+ * We test if unreachable targets are reconnected up to max_attempts times, reported
+ * once given up and accounted in the statistics of their shard.
+ */
+TEST(GnmiSubscriptionManagerTest, RetriesUnreachableTargets)
+{
+    std::vector<gnmi_target> targets;
+    for (int i = 0; i < 4; i++)
+    {
+        targets.push_back({"r" + std::to_string(i), rpc_channel_args{"localhost:1", false},
+                           client_context_args{"user", "password", false, {}},
+                           {{"p1", "r1"}}});
+    }
+    gnmi_subscription_manager::options options;
+    options.shards = 2;
+    options.reconnect.initial_backoff = std::chrono::milliseconds(10);
+    options.reconnect.max_backoff = std::chrono::milliseconds(20);
+    options.reconnect.max_attempts = 2;
+    gnmi_subscription_manager manager(targets, rpc_args{}, options);
+
+    std::mutex failure_mtx;
+    std::condition_variable failure_cv;
+    std::multiset<std::string> failed_targets;
+    manager.set_failed_handler(
+        [&](const std::string& target, grpc::Status status)
+        {
+            std::lock_guard<std::mutex> lock(failure_mtx);
+            EXPECT_EQ(status.error_code(), grpc::StatusCode::UNAVAILABLE);
+            failed_targets.insert(target);
+            failure_cv.notify_one();
+        });
+
+    EXPECT_EQ(manager.start(), error_code::SUCCESS);
+    EXPECT_EQ(manager.start(), error_code::RPC_FAILURE);
+    {
+        // Reported once every target gave up reconnecting.
+        std::unique_lock<std::mutex> lock(failure_mtx);
+        EXPECT_TRUE(failure_cv.wait_for(lock, std::chrono::seconds(20),
+                                        [&] { return failed_targets.size() == 4; }));
+        EXPECT_EQ(failed_targets.count("r0"), 1);
+    }
+    manager.stop();
+
+    const auto statistics = manager.get_statistics();
+    ASSERT_EQ(statistics.shards.size(), 2);
+    EXPECT_EQ(statistics.total.targets, 4);
+    EXPECT_EQ(statistics.total.failures, 12);
+    EXPECT_EQ(statistics.total.retries, 8);
+    EXPECT_EQ(statistics.total.samples, 0);
+    EXPECT_EQ(statistics.shards[0].targets + statistics.shards[1].targets, 4);
+    EXPECT_NE(manager.get_counters("r0"), nullptr);
+    EXPECT_EQ(manager.get_counters("unknown"), nullptr);
+}
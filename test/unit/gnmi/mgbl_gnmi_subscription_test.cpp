@@ -0,0 +1,223 @@
+#include "gnmi/mgbl_gnmi_subscription.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "gnmi/mgbl_gnmi_client.h"
+#include "gnmi/mgbl_gnmi_connection.h"
+#include "mgbl_gnmi_fake_server.h"
+#include "pbr/mgbl_pbr.h"
+
+using namespace mgbl_api;
+
+/*
+ * Unit tests for gnmi_subscription
+ *
+ * gnmi_subscription runs one Subscribe RPC of a GnmiClient, several of them
+ * share the channel of the client and are started and closed on their own.
+ *
+ */
+namespace
+{
+class OtherCounters : public GnmiCounters
+{
+   public:
+    std::string name() override
+    {
+        return "other";
+    }
+    std::vector<std::string> get_gnmi_paths() const override
+    {
+        return {};
+    }
+};
+}  // namespace
+
+/*
+ * We test if a subscription refuses counters other than pbr.
+ */
+TEST(GnmiSubscriptionTest, RequiresPbrCounters)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    GnmiClient client(connection.get_channel(), std::make_shared<PBRBasic>());
+    auto subscription = client.subscribe(std::make_shared<OtherCounters>());
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    EXPECT_EQ(subscription->start(context_args, rpc_args), error_code::CLIENT_TYPE_FAILURE);
+    EXPECT_FALSE(subscription->is_active());
+    EXPECT_EQ(subscription->close(), error_code::SUCCESS);
+}
+
+/*
+ * We test if every subscription of a client reports its own failure, whatever its mode,
+ * and can be started again once finished.
+ */
+TEST(GnmiSubscriptionTest, IndependentFailures)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    GnmiClient client(connection.get_channel(), std::make_shared<PBRBasic>());
+
+    std::mutex failure_mtx;
+    std::condition_variable failure_cv;
+    std::vector<int> failures(2, 0);
+    std::vector<std::shared_ptr<gnmi_subscription>> subscriptions;
+    for (int i = 0; i < 2; i++)
+    {
+        auto pbr_counters = std::make_shared<PBRBasic>();
+        pbr_counters->keys.push_back({"p1", "r1"});
+        subscriptions.push_back(client.subscribe(pbr_counters));
+        subscriptions.back()->set_rpc_failed_handler(
+            [&, i](grpc::Status status)
+            {
+                std::lock_guard<std::mutex> lock(failure_mtx);
+                EXPECT_EQ(status.error_code(), grpc::StatusCode::UNAVAILABLE);
+                failures[i]++;
+                failure_cv.notify_one();
+            });
+    }
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args stream_args;
+    rpc_args once_args;
+    once_args.mode = stream_mode::ONCE;
+    EXPECT_EQ(subscriptions[0]->start(context_args, stream_args), error_code::SUCCESS);
+    EXPECT_EQ(subscriptions[1]->start(context_args, once_args), error_code::SUCCESS);
+    {
+        std::unique_lock<std::mutex> lock(failure_mtx);
+        EXPECT_TRUE(failure_cv.wait_for(lock, std::chrono::seconds(10),
+                                        [&] { return failures[0] == 1 && failures[1] == 1; }));
+    }
+
+    EXPECT_EQ(subscriptions[0]->close(), error_code::SUCCESS);
+    EXPECT_FALSE(subscriptions[0]->is_active());
+    EXPECT_EQ(subscriptions[1]->start(context_args, once_args), error_code::SUCCESS);
+    {
+        std::unique_lock<std::mutex> lock(failure_mtx);
+        EXPECT_TRUE(failure_cv.wait_for(lock, std::chrono::seconds(10),
+                                        [&] { return failures[1] == 2; }));
+        EXPECT_EQ(failures[0], 1);
+    }
+}
+
+namespace
+{
+/*
+ * Writes the log to stderr, where the death tests look for it.
+ */
+class stderr_logger : public logger
+{
+   public:
+    void log(const std::string& message, log_level) override
+    {
+        std::cerr << message << std::endl;
+    }
+};
+
+/*
+ * Destroys a subscription from its failed handler, which does not return.
+ */
+void destroy_subscription_from_handler()
+{
+    logger_manager::get_instance().set_logger(std::make_shared<stderr_logger>());
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    GnmiClient client(connection.get_channel(), std::make_shared<PBRBasic>());
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    auto subscription = client.subscribe(pbr_counters);
+    std::promise<void> destroyed;
+    subscription->set_rpc_failed_handler(
+        [&](grpc::Status)
+        {
+            subscription.reset();
+            destroyed.set_value();
+        });
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args rpc_args;
+    subscription->start(context_args, rpc_args);
+    destroyed.get_future().wait_for(std::chrono::seconds(10));
+}
+}  // namespace
+
+/*
+ * We test if a subscription destroyed from its own handler terminates the process, in every
+ * build, rather than waiting on the poller thread running the handler.
+ */
+TEST(GnmiSubscriptionTest, DestroyedFromHandlerTerminates)
+{
+    ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+    EXPECT_DEATH(destroy_subscription_from_handler(), "destroyed from its own handler");
+}
+
+/*
+ * We test if a poll is refused outside of a running POLL subscription.
+ */
+TEST(GnmiSubscriptionTest, PollNeedsPollMode)
+{
+    gnmi_client_connection connection(rpc_channel_args{"localhost:1", false});
+    GnmiClient client(connection.get_channel(), std::make_shared<PBRBasic>());
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    auto subscription = client.subscribe(pbr_counters);
+    EXPECT_EQ(subscription->poll(), error_code::RPC_FAILURE);
+
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args stream_args;
+    EXPECT_EQ(subscription->start(context_args, stream_args), error_code::SUCCESS);
+    EXPECT_EQ(subscription->poll(), error_code::RPC_FAILURE);
+    EXPECT_FALSE(subscription->is_poll_pending());
+    EXPECT_EQ(subscription->close(), error_code::SUCCESS);
+}
+
+/*
+ * We test if the sync_response of the initial updates does not end a poll, and the
+ * sync_response of its snapshot does.
+ */
+TEST(GnmiSubscriptionTest, InitialSyncDoesNotEndPoll)
+{
+    std::atomic<bool> answer{false};
+    fake_gnmi_server server;
+    server.on_subscribe(
+        [&answer](int, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            gnmi::SubscribeRequest request;
+            stream->Read(&request);
+            // The poll is sent before the initial updates end.
+            stream->Read(&request);
+            EXPECT_TRUE(request.has_poll());
+            stream->Write(fake_gnmi_server::sync_response());
+            while (!answer)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            stream->Write(fake_gnmi_server::pbr_update("p1", "r1", 3));
+            stream->Write(fake_gnmi_server::sync_response());
+            return fake_gnmi_server::wait_cancelled(stream);
+        });
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    GnmiClient client(server.channel(), pbr_counters);
+    auto subscription = client.subscribe(pbr_counters);
+    client_context_args context_args{"user", "password", false, {}};
+    rpc_args poll_args;
+    poll_args.mode = stream_mode::POLL;
+    ASSERT_EQ(subscription->start(context_args, poll_args), error_code::SUCCESS);
+    EXPECT_EQ(subscription->poll(), error_code::SUCCESS);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_TRUE(subscription->is_poll_pending());
+
+    answer = true;
+    const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (subscription->is_poll_pending() && std::chrono::steady_clock::now() < give_up)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_FALSE(subscription->is_poll_pending());
+    EXPECT_FALSE(subscription->expire_poll());
+    EXPECT_EQ(subscription->close(), error_code::SUCCESS);
+}
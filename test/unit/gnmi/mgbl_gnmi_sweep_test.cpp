@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "gnmi/mgbl_gnmi_sweep.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mgbl_gnmi_fake_server.h"
+#include "pbr/mgbl_pbr.h"
+
+using namespace mgbl_api;
+
+/*
+ * Unit tests for the gnmi_sweep
+ *
+ * gnmi_sweep sends concurrent once requests to many targets. Unreachable targets fail
+ * and are reported as such, the targets of a fake_gnmi_server answer with their stats.
+ *
+ */
+
+namespace
+{
+std::vector<gnmi_target> unreachable_targets(size_t count)
+{
+    std::vector<gnmi_target> targets;
+    for (size_t i = 0; i < count; i++)
+    {
+        gnmi_target target;
+        target.name = "device-" + std::to_string(i);
+        target.channel_args = rpc_channel_args{"localhost:1", false};
+        target.context_args = client_context_args{"user", "password", false, {}};
+        target.keys.push_back({"p1", "r1"});
+        targets.push_back(std::move(target));
+    }
+    return targets;
+}
+}  // namespace
+
+/*
+ * We test if the sweep refuses invalid options and duplicate targets.
+ */
+TEST(GnmiSweepTest, InvalidArguments)
+{
+    gnmi_sweep::options options;
+    options.max_in_flight = 0;
+    EXPECT_THROW(gnmi_sweep sweep(unreachable_targets(1), options), std::invalid_argument);
+    options = gnmi_sweep::options();
+    options.target_timeout = std::chrono::milliseconds(0);
+    EXPECT_THROW(gnmi_sweep sweep(unreachable_targets(1), options), std::invalid_argument);
+
+    auto targets = unreachable_targets(2);
+    targets[1].name = targets[0].name;
+    EXPECT_THROW(gnmi_sweep sweep(targets, gnmi_sweep::options()), std::invalid_argument);
+}
+
+/*
+ * We test if every target gets exactly one result, with fewer requests in flight than
+ * targets, and if the latency distribution is ordered.
+ */
+TEST(GnmiSweepTest, ReportsEveryTarget)
+{
+    gnmi_sweep::options options;
+    options.max_in_flight = 3;
+    options.target_timeout = std::chrono::milliseconds(2000);
+    gnmi_sweep sweep(unreachable_targets(10), options);
+
+    std::multiset<std::string> reported;
+    rpc_args rpc_args;
+    for (int run = 0; run < 2; run++)
+    {
+        reported.clear();
+        sweep_statistics statistics = sweep.run(
+            rpc_args,
+            [&reported](const sweep_result& result)
+            {
+                EXPECT_EQ(result.code, error_code::RPC_FAILURE);
+                EXPECT_NE(result.counters, nullptr);
+                reported.insert(result.target);
+            });
+        EXPECT_EQ(reported.size(), 10);
+        EXPECT_EQ(std::set<std::string>(reported.begin(), reported.end()).size(), 10);
+        EXPECT_EQ(statistics.targets, 10);
+        EXPECT_EQ(statistics.succeeded, 0);
+        EXPECT_EQ(statistics.failed, 10);
+        EXPECT_LE(statistics.min, statistics.p50);
+        EXPECT_LE(statistics.p50, statistics.p90);
+        EXPECT_LE(statistics.p90, statistics.p99);
+        EXPECT_LE(statistics.p99, statistics.max);
+        EXPECT_LE(statistics.max, statistics.elapsed);
+    }
+    EXPECT_NE(sweep.get_counters("device-0"), nullptr);
+    EXPECT_EQ(sweep.get_counters("unknown"), nullptr);
+}
+
+/*
+ * We test if a negotiated sweep of a server delivers the stats of every target, never runs
+ * more than max_in_flight Subscribe RPCs at a time, and reports a target whose
+ * Capabilities failed without sending its request.
+ */
+TEST(GnmiSweepTest, NegotiatedSweepOfServer)
+{
+    fake_gnmi_server server;
+    gnmi::CapabilityResponse capabilities;
+    capabilities.add_supported_encodings(gnmi::PROTO);
+    server.set_capabilities(capabilities);
+    std::mutex encodings_mtx;
+    std::set<int> encodings;
+    server.on_subscribe(
+        [&](int call, grpc::ServerContext*, fake_gnmi_server::subscribe_stream* stream)
+        {
+            gnmi::SubscribeRequest request;
+            stream->Read(&request);
+            {
+                std::lock_guard<std::mutex> lock(encodings_mtx);
+                encodings.insert(request.subscribe().encoding());
+            }
+            // Long enough for the requests to overlap if they were not limited.
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            stream->Write(fake_gnmi_server::pbr_update("p1", "r1", 100 + call));
+            stream->Write(fake_gnmi_server::sync_response());
+            return grpc::Status::OK;
+        });
+
+    std::vector<gnmi_target> targets = unreachable_targets(7);
+    for (size_t i = 1; i < targets.size(); i++)
+    {
+        targets[i].channel_args = rpc_channel_args{server.address(), false};
+    }
+    gnmi_sweep::options options;
+    options.max_in_flight = 2;
+    options.target_timeout = std::chrono::milliseconds(5000);
+    gnmi_sweep sweep(std::move(targets), options);
+
+    rpc_args rpc_args;
+    rpc_args.negotiate = true;
+    std::set<uint64_t> byte_counts;
+    sweep_statistics statistics = sweep.run(
+        rpc_args,
+        [&byte_counts](const sweep_result& result)
+        {
+            if (result.target == "device-0")
+            {
+                EXPECT_EQ(result.code, error_code::RPC_FAILURE);
+                return;
+            }
+            EXPECT_EQ(result.code, error_code::SUCCESS) << result.status.error_message();
+            ASSERT_EQ(result.counters->stats.size(), 1);
+            EXPECT_EQ(result.counters->stats[0].rule_name, "r1");
+            byte_counts.insert(result.counters->stats[0].byte_count);
+        });
+    EXPECT_EQ(statistics.succeeded, 6);
+    EXPECT_EQ(statistics.failed, 1);
+    EXPECT_EQ(byte_counts, (std::set<uint64_t>{100, 101, 102, 103, 104, 105}));
+    EXPECT_EQ(server.subscribe_calls(), 6);
+    EXPECT_LE(server.max_concurrent_subscribes(), 2);
+    EXPECT_EQ(encodings, std::set<int>{gnmi::PROTO});
+}
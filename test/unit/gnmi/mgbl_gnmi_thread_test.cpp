@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2024 Cisco Systems, Inc. and its affiliates
+ * All rights reserved.
+ *
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "gnmi/mgbl_gnmi_thread.h"
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "gnmi/mgbl_gnmi_async_engine.h"
+#include "gnmi/mgbl_gnmi_executor.h"
+
+using namespace mgbl_api;
+
+/*
+ * Unit tests for the thread_factory
+ *
+ * thread_factory creates the poller, worker and closer threads of the library
+ * with the name, CPU affinity, scheduling and stack size set for their role.
+ * Every test restores the options it changes.
+ *
+ */
+
+namespace
+{
+/*
+ * Restores the options and the start hook of a role at the end of a test.
+ */
+class role_options_guard
+{
+   public:
+    explicit role_options_guard(thread_role role)
+        : role(role), saved(thread_factory::get_instance().get_options(role))
+    {
+    }
+    ~role_options_guard()
+    {
+        thread_factory::get_instance().set_options(role, saved);
+        thread_factory::get_instance().set_start_hook(nullptr);
+    }
+
+   private:
+    thread_role role;
+    thread_options saved;
+};
+}  // namespace
+
+/*
+ * We test if the threads are named after their role and index, within the 15 characters.
+ */
+TEST(GnmiThreadTest, NamesThreads)
+{
+    role_options_guard guard(thread_role::WORKER);
+    thread_options options;
+    options.name = "collector-worker";
+    thread_factory::get_instance().set_options(thread_role::WORKER, options);
+
+    char name[16] = {};
+    gnmi_thread thread = thread_factory::get_instance().create(
+        thread_role::WORKER, 12, [&name]() { pthread_getname_np(pthread_self(), name, 16); });
+    EXPECT_TRUE(thread.joinable());
+    thread.join();
+    EXPECT_FALSE(thread.joinable());
+    EXPECT_STREQ(name, "collector-wo-12");
+}
+
+/*
+ * We test if the threads run on the CPUs of their role, with the stack size asked.
+ */
+TEST(GnmiThreadTest, AffinityAndStackSize)
+{
+    role_options_guard guard(thread_role::POLLER);
+    cpu_set_t allowed;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    uint32_t cpu = 0;
+    while (!CPU_ISSET(cpu, &allowed))
+    {
+        cpu++;
+    }
+    thread_options options;
+    options.cpus = {cpu};
+    options.stack_size = 4 * 1024 * 1024;
+    thread_factory::get_instance().set_options(thread_role::POLLER, options);
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    size_t stack_size = 0;
+    gnmi_thread thread = thread_factory::get_instance().create(
+        thread_role::POLLER, 0,
+        [&cpus, &stack_size]()
+        {
+            pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+            pthread_attr_t attributes;
+            pthread_getattr_np(pthread_self(), &attributes);
+            pthread_attr_getstacksize(&attributes, &stack_size);
+            pthread_attr_destroy(&attributes);
+        });
+    thread.join();
+    EXPECT_EQ(CPU_COUNT(&cpus), 1);
+    EXPECT_TRUE(CPU_ISSET(cpu, &cpus));
+    EXPECT_GE(stack_size, options.stack_size);
+}
+
+/*
+ * We test if the start hook runs on every thread of an engine and an executor.
+ */
+TEST(GnmiThreadTest, StartHookSeesEveryThread)
+{
+    role_options_guard guard(thread_role::POLLER);
+    std::atomic<int> pollers{0};
+    std::atomic<int> workers{0};
+    thread_factory::get_instance().set_start_hook(
+        [&pollers, &workers](thread_role role, uint32_t)
+        {
+            if (role == thread_role::POLLER)
+            {
+                pollers++;
+            }
+            else if (role == thread_role::WORKER)
+            {
+                workers++;
+            }
+        });
+    {
+        gnmi_async_engine::options engine_options;
+        engine_options.poller_threads = 3;
+        gnmi_async_engine engine(engine_options);
+        work_stealing_executor::options executor_options;
+        executor_options.worker_threads = 2;
+        work_stealing_executor executor(executor_options);
+    }
+    EXPECT_EQ(pollers.load(), 3);
+    EXPECT_EQ(workers.load(), 2);
+}
+
+/*
+ * We test if the options of a role are refused for a CPU or a priority out of range.
+ */
+TEST(GnmiThreadTest, RejectsInvalidOptions)
+{
+    role_options_guard guard(thread_role::CLOSER);
+    thread_options options;
+    options.cpus = {CPU_SETSIZE};
+    EXPECT_THROW(thread_factory::get_instance().set_options(thread_role::CLOSER, options),
+                 std::invalid_argument);
+
+    options.cpus.clear();
+    options.scheduling = thread_scheduling::OTHER;
+    options.priority = 20;
+    EXPECT_THROW(thread_factory::get_instance().set_options(thread_role::CLOSER, options),
+                 std::invalid_argument);
+
+    options.scheduling = thread_scheduling::FIFO;
+    options.priority = 0;
+    EXPECT_THROW(thread_factory::get_instance().set_options(thread_role::CLOSER, options),
+                 std::invalid_argument);
+
+    EXPECT_EQ(thread_factory::get_instance().get_options(thread_role::CLOSER).name,
+              "gnmi-closer");
+}
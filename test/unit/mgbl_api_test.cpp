@@ -23,6 +23,8 @@ using namespace mgbl_api;
 /*
 Dummy class to test the subscribe_request_helper
 */
+namespace
+{
 class Derived : public GnmiClient
 {
    public:
@@ -44,6 +46,7 @@ class Derived : public GnmiClient
     std::function<void(grpc::Status)> failure_handler = [&](grpc::Status status)
     { std::cout << "rpc_failed_handler: This rpc failed" << std::endl; };
 };
+}  // namespace
 
 /*
  * Unit tests for subscribe_request_helper
@@ -150,6 +153,176 @@ TEST(SubscribeRequestHelperTest, ModeStreamTest)
     EXPECT_EQ(path.elem(3).key().at("rule-name"), "key_rule");
 }
 
+/*
+ * We test if subscribe_request_helper subscribes the paths below every key with their mode.
+ */
+TEST(SubscribeRequestHelperTest, PathModesTest)
+{
+    rpc_channel_args channel_args;
+    gnmi_client_connection dummyConnection(channel_args);
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    Derived instance(dummyConnection.get_channel(), pbr_counters);
+    auto impl_instance = instance.get_impl();
+
+    gnmi::SubscribeRequest request;
+    rpc_args rpc_args;
+    rpc_stream_args info;
+
+    rpc_args.sample_interval_nsec = 15000;
+    path_subscription counters;
+    counters.relative_path = "fib-stats";
+    counters.suppress_redundant = true;
+    counters.heartbeat_interval_nsec = 60000000000;
+    path_subscription actions;
+    actions.relative_path = "/paction";
+    actions.mode = subscription_mode::ON_CHANGE;
+    actions.heartbeat_interval_nsec = 600000000000;
+    rpc_args.path_modes = {counters, actions};
+    info.paths_of_interest.push_back(
+        "policy-maps/policy-map[policy-name=key_policy]/rule-names/rule-name[rule-name=key_rule]/");
+
+    EXPECT_EQ(impl_instance->subscribe_request_helper(&request, rpc_args, info),
+              internal_error_code::SUCCESS);
+    ASSERT_EQ(request.subscribe().subscription_size(), 2);
+
+    const auto& sampled = request.subscribe().subscription(0);
+    EXPECT_EQ(sampled.mode(), gnmi::SubscriptionMode::SAMPLE);
+    EXPECT_EQ(sampled.sample_interval(), 15000);
+    EXPECT_EQ(sampled.heartbeat_interval(), 60000000000);
+    EXPECT_TRUE(sampled.suppress_redundant());
+    ASSERT_EQ(sampled.path().elem_size(), 5);
+    EXPECT_EQ(sampled.path().elem(4).name(), "fib-stats");
+
+    const auto& on_change = request.subscribe().subscription(1);
+    EXPECT_EQ(on_change.mode(), gnmi::SubscriptionMode::ON_CHANGE);
+    EXPECT_EQ(on_change.sample_interval(), 0);
+    EXPECT_EQ(on_change.heartbeat_interval(), 600000000000);
+    EXPECT_FALSE(on_change.suppress_redundant());
+    ASSERT_EQ(on_change.path().elem_size(), 5);
+    EXPECT_EQ(on_change.path().elem(3).key().at("rule-name"), "key_rule");
+    EXPECT_EQ(on_change.path().elem(4).name(), "paction");
+
+    // Without path modes, the keys are subscribed as a whole with the mode of the rpc_args.
+    rpc_args.path_modes.clear();
+    rpc_args.path_mode = subscription_mode::TARGET_DEFINED;
+    request.Clear();
+    EXPECT_EQ(impl_instance->subscribe_request_helper(&request, rpc_args, info),
+              internal_error_code::SUCCESS);
+    ASSERT_EQ(request.subscribe().subscription_size(), 1);
+    EXPECT_EQ(request.subscribe().subscription(0).mode(),
+              gnmi::SubscriptionMode::TARGET_DEFINED);
+    EXPECT_EQ(request.subscribe().subscription(0).path().elem_size(), 4);
+    EXPECT_FALSE(request.subscribe().updates_only());
+
+    rpc_args.updates_only = true;
+    request.Clear();
+    EXPECT_EQ(impl_instance->subscribe_request_helper(&request, rpc_args, info),
+              internal_error_code::SUCCESS);
+    EXPECT_TRUE(request.subscribe().updates_only());
+
+    // An invalid relative path is refused, instead of subscribing the whole key.
+    path_subscription invalid;
+    invalid.relative_path = "fib-stats[byte-count";
+    rpc_args.path_modes = {counters, invalid};
+    request.Clear();
+    EXPECT_EQ(impl_instance->subscribe_request_helper(&request, rpc_args, info),
+              internal_error_code::INVALID_RELATIVE_PATH);
+    EXPECT_EQ(request.subscribe().subscription_size(), 0);
+}
+
+/*
+ * We test if subscribe_request_helper moves the containers shared by the keys to the prefix.
+ */
+TEST(SubscribeRequestHelperTest, PrefixTest)
+{
+    rpc_channel_args channel_args;
+    gnmi_client_connection dummyConnection(channel_args);
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "r1"});
+    pbr_counters->keys.push_back({"p2", "r2"});
+    Derived instance(dummyConnection.get_channel(), pbr_counters);
+    auto impl_instance = instance.get_impl();
+
+    gnmi::SubscribeRequest request;
+    rpc_args rpc_args;
+    rpc_stream_args info;
+    path_subscription counters;
+    counters.relative_path = "fib-stats";
+    rpc_args.path_modes = {counters};
+    info.paths_of_interest = pbr_counters->get_gnmi_paths();
+    info.prefix = pbr_counters->path_origin;
+
+    EXPECT_EQ(impl_instance->subscribe_request_helper(&request, rpc_args, info),
+              internal_error_code::SUCCESS);
+    const gnmi::Path& prefix = request.subscribe().prefix();
+    EXPECT_EQ(prefix.origin(), pbr_counters->path_origin);
+    ASSERT_EQ(prefix.elem_size(), 2);
+    EXPECT_EQ(prefix.elem(0).name(), "pbr-stats");
+    EXPECT_EQ(prefix.elem(1).name(), "policy-maps");
+
+    ASSERT_EQ(request.subscribe().subscription_size(), 2);
+    const gnmi::Path& path = request.subscribe().subscription(1).path();
+    ASSERT_EQ(path.elem_size(), 4);
+    EXPECT_EQ(path.elem(0).key().at("policy-name"), "p2");
+    EXPECT_EQ(path.elem(2).key().at("rule-name"), "r2");
+    EXPECT_EQ(path.elem(3).name(), "fib-stats");
+
+    // Without the prefix, the paths are sent whole, with the origin in their first element.
+    rpc_args.use_prefix = false;
+    request.Clear();
+    EXPECT_EQ(impl_instance->subscribe_request_helper(&request, rpc_args, info),
+              internal_error_code::SUCCESS);
+    EXPECT_FALSE(request.subscribe().has_prefix());
+    ASSERT_EQ(request.subscribe().subscription(0).path().elem_size(), 6);
+    EXPECT_EQ(request.subscribe().subscription(0).path().elem(0).name(),
+              pbr_counters->path_origin + ":pbr-stats");
+}
+
+/*
+ * We test if subscribe_request_helper samples every key at the interval of the key or of its
+ * class.
+ */
+TEST(SubscribeRequestHelperTest, ClassIntervalsTest)
+{
+    rpc_channel_args channel_args;
+    gnmi_client_connection dummyConnection(channel_args);
+    auto pbr_counters = std::make_shared<PBRBasic>();
+    pbr_counters->keys.push_back({"p1", "revenue", "gold"});
+    pbr_counters->keys.push_back({"p1", "bulk"});
+    pbr_counters->keys.push_back({"p1", "probe", "gold", 500000000});
+    pbr_counters->keys.push_back({"p1", "other", "unknown"});
+    Derived instance(dummyConnection.get_channel(), pbr_counters);
+    auto impl_instance = instance.get_impl();
+
+    gnmi::SubscribeRequest request;
+    rpc_args rpc_args;
+    rpc_stream_args info;
+    rpc_args.sample_interval_nsec = 60000000000;
+    rpc_args.class_sample_intervals_nsec["gold"] = 1000000000;
+    info.paths_of_interest = pbr_counters->get_gnmi_paths();
+    info.sample_intervals_nsec =
+        pbr_counters->get_sample_intervals(rpc_args.class_sample_intervals_nsec);
+
+    EXPECT_EQ(impl_instance->subscribe_request_helper(&request, rpc_args, info),
+              internal_error_code::SUCCESS);
+    ASSERT_EQ(request.subscribe().subscription_size(), 4);
+    EXPECT_EQ(request.subscribe().subscription(0).sample_interval(), 1000000000);
+    EXPECT_EQ(request.subscribe().subscription(1).sample_interval(), 60000000000);
+    EXPECT_EQ(request.subscribe().subscription(2).sample_interval(), 500000000);
+    // A class without an interval is sampled at the interval of the rpc_args.
+    EXPECT_EQ(request.subscribe().subscription(3).sample_interval(), 60000000000);
+
+    // The interval of a path mode still applies to its path below every key.
+    path_subscription counters;
+    counters.relative_path = "fib-stats";
+    counters.sample_interval_nsec = 10000000000;
+    rpc_args.path_modes = {counters};
+    request.Clear();
+    EXPECT_EQ(impl_instance->subscribe_request_helper(&request, rpc_args, info),
+              internal_error_code::SUCCESS);
+    EXPECT_EQ(request.subscribe().subscription(0).sample_interval(), 10000000000);
+}
+
 /*
  * We test if subscribe_request_helper accepts ONCE mode.
  */
@@ -20,6 +20,8 @@ using namespace mgbl_api;
 /*
 Dummy class to test the subscribe_request_helper
 */
+namespace
+{
 class Derived : public GnmiClient
 {
    public:
@@ -41,6 +43,7 @@ class Derived : public GnmiClient
     std::function<void(grpc::Status)> failure_handler = [&](grpc::Status status)
     { std::cout << "rpc_failed_handler: This rpc failed" << std::endl; };
 };
+}  // namespace
 
 /*
  * Edge cases unit tests for subscribe_request_helper
@@ -1,6 +1,9 @@
 #include "pbr/mgbl_pbr.h"
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
 #include "gnmi/mgbl_gnmi_client.h"
 
 using namespace mgbl_api;
@@ -44,6 +47,10 @@ TEST(MapToPbrStatsTest, ValidMap)
     EXPECT_EQ(pbr_basic_stat->collection_timestamp_nanoseconds, 192021);
     EXPECT_EQ(pbr_basic_stat->path_grp_name, "test_path_grp");
     EXPECT_EQ(pbr_basic_stat->policy_action_type, "test_type");
+    EXPECT_TRUE(pbr_basic_stat->has_counters);
+    EXPECT_TRUE(pbr_basic_stat->has_byte_count);
+    EXPECT_TRUE(pbr_basic_stat->has_packet_count);
+    EXPECT_TRUE(pbr_basic_stat->has_action);
 }
 
 /*
@@ -203,4 +210,161 @@ TEST(AddStatsTest, AddEmptyStats)
     EXPECT_EQ(instance.stats[0].collection_timestamp_nanoseconds, 0);
     EXPECT_EQ(instance.stats[0].path_grp_name, "");
     EXPECT_EQ(instance.stats[0].policy_action_type, "");
-}
\ No newline at end of file
+}
+/*
+ * Unit tests for pbr_latest_values
+ *
+ * pbr_latest_values merges the stats of a rule into its latest value, and computes
+ * the rates of its counters, assuming unchanged counters for suppressed samples.
+ *
+ */
+
+/*
+ * We test if the stats of the counters and of the action of a rule complete each other.
+ */
+TEST(PbrLatestValuesTest, MergesPartialStats)
+{
+    pbr_latest_values latest;
+    PbrBasicStat counters;
+    counters.policy_name = "p1";
+    counters.rule_name = "r1";
+    counters.byte_count = 100;
+    counters.has_counters = true;
+    PbrBasicStat action;
+    action.policy_name = "p1";
+    action.rule_name = "r1";
+    action.policy_action_type = "drop";
+    action.has_action = true;
+
+    latest.merge(counters);
+    latest.merge(action);
+    // A stat without counters does not reset them.
+    latest.merge(action);
+
+    pbr_latest_value value;
+    ASSERT_TRUE(latest.get("p1", "r1", &value));
+    EXPECT_EQ(value.stat.byte_count, 100u);
+    EXPECT_EQ(value.stat.policy_action_type, "drop");
+    EXPECT_EQ(value.updates, 3u);
+    EXPECT_FALSE(latest.get("p1", "r2", &value));
+    EXPECT_EQ(latest.size(), 1u);
+}
+
+/*
+ * We test if the rates only span the last sample interval when samples are suppressed.
+ */
+TEST(PbrLatestValuesTest, RatesWithSuppressedSamples)
+{
+    PbrBasicStat stat;
+    stat.policy_name = "p1";
+    stat.rule_name = "r1";
+    stat.has_counters = true;
+    stat.byte_count = 1000;
+    stat.packet_count = 10;
+    stat.collection_timestamp_seconds = 100;
+    PbrBasicStat later = stat;
+    later.byte_count = 2000;
+    later.packet_count = 20;
+    later.collection_timestamp_seconds = 110;
+
+    pbr_latest_values every_sample;
+    every_sample.merge(stat);
+    every_sample.merge(later);
+    pbr_latest_value value;
+    ASSERT_TRUE(every_sample.get("p1", "r1", &value));
+    EXPECT_DOUBLE_EQ(value.bytes_per_second, 100.0);
+    EXPECT_DOUBLE_EQ(value.packets_per_second, 1.0);
+
+    pbr_latest_values suppressed(std::chrono::milliseconds(50));
+    suppressed.merge(stat);
+    suppressed.merge(later);
+    ASSERT_TRUE(suppressed.get("p1", "r1", &value));
+    EXPECT_DOUBLE_EQ(value.bytes_per_second, 20000.0);
+    EXPECT_DOUBLE_EQ(value.packets_per_second, 200.0);
+
+    // No update for two sample intervals, the counters are unchanged.
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    std::vector<pbr_latest_value> values = suppressed.snapshot();
+    ASSERT_EQ(values.size(), 1u);
+    EXPECT_DOUBLE_EQ(values[0].bytes_per_second, 0.0);
+    EXPECT_EQ(values[0].stat.byte_count, 2000u);
+}
+
+/*
+ * We test if stats carrying a single counter each only update that counter, without the
+ * other one looking cleared.
+ */
+TEST(PbrLatestValuesTest, MergesSingleCounterStats)
+{
+    PbrBasicStat bytes;
+    bytes.policy_name = "p1";
+    bytes.rule_name = "r1";
+    bytes.has_counters = true;
+    bytes.has_byte_count = true;
+    PbrBasicStat packets = bytes;
+    packets.has_byte_count = false;
+    packets.has_packet_count = true;
+
+    pbr_latest_values latest;
+    for (uint64_t second = 100; second <= 130; second += 10)
+    {
+        bytes.byte_count = second * 100;
+        bytes.collection_timestamp_seconds = second;
+        packets.packet_count = second;
+        packets.collection_timestamp_seconds = second;
+        latest.merge(bytes);
+        latest.merge(packets);
+    }
+
+    pbr_latest_value value;
+    ASSERT_TRUE(latest.get("p1", "r1", &value));
+    EXPECT_EQ(value.stat.byte_count, 13000u);
+    EXPECT_EQ(value.stat.packet_count, 130u);
+    EXPECT_DOUBLE_EQ(value.bytes_per_second, 100.0);
+    EXPECT_DOUBLE_EQ(value.packets_per_second, 1.0);
+}
+
+/*
+ * We test if plan_subscription compresses the policies selected by the planner options into
+ * wildcard paths, and only filters the policies which may bring rules that are not keys.
+ */
+TEST(PlanSubscriptionTest, WildcardPolicies)
+{
+    PBRBasic counters;
+    counters.keys.push_back({"p1", "r1"});
+    counters.keys.push_back({"p1", "r2"});
+    counters.keys.push_back({"p1", "r3"});
+    counters.keys.push_back({"p2", "r1"});
+    counters.keys.push_back({"p3", "r1"});
+    counters.keys.push_back({"p3", "r2", "", 5000000000});
+    counters.keys.push_back({"p4", "r1"});
+    counters.keys.push_back({"p4", "r2"});
+    rpc_args rpc_args;
+
+    // Without planner options every key has its own path.
+    pbr_subscription_plan plan = plan_subscription(counters, rpc_args);
+    EXPECT_EQ(plan.paths, counters.get_gnmi_paths());
+    EXPECT_EQ(plan.saved_paths(), 0u);
+
+    rpc_args.planner.min_rules_per_wildcard = 3;
+    rpc_args.planner.rules_per_policy["p4"] = 2;
+    plan = plan_subscription(counters, rpc_args);
+    ASSERT_EQ(plan.paths.size(), 5u);
+    EXPECT_EQ(plan.key_paths, 8u);
+    EXPECT_EQ(plan.saved_paths(), 3u);
+    EXPECT_EQ(plan.paths[0],
+              "Cisco-IOS-XR-pbr-fwd-stats-oper:pbr-stats/policy-maps/"
+              "policy-map[policy-name=p1]/rule-names/rule-name[rule-name=*]/");
+    // The keys of p3 have different sample intervals, they keep their own paths.
+    EXPECT_EQ(plan.sample_intervals_nsec[3], 5000000000u);
+    EXPECT_EQ(plan.paths[4],
+              "Cisco-IOS-XR-pbr-fwd-stats-oper:pbr-stats/policy-maps/"
+              "policy-map[policy-name=p4]/rule-names/rule-name[rule-name=*]/");
+
+    EXPECT_TRUE(plan.is_wanted("p1", "r2"));
+    EXPECT_FALSE(plan.is_wanted("p1", "r9"));
+    EXPECT_TRUE(plan.is_wanted("p2", "r1"));
+    // Every rule of p4 is a key, nothing to filter.
+    EXPECT_EQ(plan.filtered_rules.count("p4"), 0u);
+    EXPECT_TRUE(plan.is_wanted("p4", "r9"));
+}
@@ -14,6 +14,8 @@ using namespace mgbl_api;
  *
  * See mgbl_pbr_test.cpp
  */
+namespace
+{
 class Derived : public GnmiClient
 {
    public:
@@ -27,6 +29,7 @@ class Derived : public GnmiClient
         return this->impl_.get();
     }
 };
+}  // namespace
 /*
  * We are testing if map_to_stats correctly handles a missing key by returning an empty field.
  */